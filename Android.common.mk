@@ -66,6 +66,7 @@ LOCAL_CFLAGS += \
 	-DHAVE_DLADDR \
 	-DHAVE_DLOPEN \
 	-DHAVE_DL_ITERATE_PHDR \
+	-DHAVE_LINUX_FUTEX_H \
 	-DMAJOR_IN_SYSMACROS \
 	-fvisibility=hidden \
 	-Wno-sign-compare
@@ -351,6 +351,8 @@ def generate(env):
 
         if check_header(env, 'xlocale.h'):
             cppdefines += ['HAVE_XLOCALE_H']
+        if check_header(env, 'linux/futex.h'):
+            cppdefines += ['HAVE_LINUX_FUTEX_H']
 
         if check_functions(env, ['strtod_l', 'strtof_l']):
             cppdefines += ['HAVE_STRTOD_L']
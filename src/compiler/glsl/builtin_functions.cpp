@@ -39,7 +39,8 @@
  *
  *    The builtin_builder::create_builtins() function contains lists of all
  *    built-in function signatures, where they're available, what types they
- *    take, and so on.
+ *    take, and so on.  Only the functions a shader actually calls get built,
+ *    see builtin_builder::get_function().
  *
  * 4. Implementations of built-in function signatures
  *
@@ -83,6 +84,7 @@
 #include <math.h>
 #include "builtin_functions.h"
 #include "util/hash_table.h"
+#include "util/set.h"
 
 #define M_PIf   ((float) M_PI)
 #define M_PI_2f ((float) M_PI_2)
@@ -642,8 +644,9 @@ namespace {
  * builtin_builder: A singleton object representing the core of the built-in
  * function module.
  *
- * It generates IR for every built-in function signature, and organizes them
- * into functions.
+ * It generates IR for built-in function signatures, and organizes them
+ * into functions.  A function is only generated the first time a shader
+ * looks it up by name.
  */
 class builtin_builder {
 public:
@@ -654,22 +657,34 @@ public:
    void release();
    ir_function_signature *find(_mesa_glsl_parse_state *state,
                                const char *name, exec_list *actual_parameters);
+   ir_function *get_function(const char *name);
 
    /**
-    * A shader to hold all the built-in signatures; created by this module.
+    * A shader to hold the built-in signatures; created by this module.
     *
-    * This includes signatures for every built-in, regardless of version or
-    * enabled extensions.  The availability predicate associated with each
-    * signature allows matching_signature() to filter out the irrelevant ones.
+    * Once a function has been generated, this includes all its signatures,
+    * regardless of version or enabled extensions.  The availability
+    * predicate associated with each signature allows matching_signature()
+    * to filter out the irrelevant ones.
     */
    gl_shader *shader;
 
 private:
    void *mem_ctx;
 
+   /** Names of all the functions create_builtins() knows about. */
+   struct set *names;
+
+   /**
+    * What create_builtins() is run for: NULL to only collect names, or
+    * the one function to generate.
+    */
+   const char *wanted_function;
+
    void create_shader();
    void create_intrinsics();
    void create_builtins();
+   bool wants_function(const char *name);
 
    /**
     * IR builder helpers:
@@ -1011,7 +1026,7 @@ enum image_function_flags {
  *  @{
  */
 builtin_builder::builtin_builder()
-   : shader(NULL)
+   : shader(NULL), names(NULL), wanted_function(NULL)
 {
    mem_ctx = NULL;
 }
@@ -1034,7 +1049,7 @@ builtin_builder::find(_mesa_glsl_parse_state *state,
     */
    state->uses_builtin_functions = true;
 
-   ir_function *f = shader->symbols->get_function(name);
+   ir_function *f = get_function(name);
    if (f == NULL)
       return NULL;
 
@@ -1055,15 +1070,55 @@ builtin_builder::initialize()
 
    mem_ctx = ralloc_context(NULL);
    create_shader();
+
+   /* The built-ins call into these, so they are always needed */
    create_intrinsics();
+
+   names = _mesa_set_create(mem_ctx, _mesa_key_hash_string,
+                            _mesa_key_string_equal);
+   wanted_function = NULL;
    create_builtins();
 }
 
+/**
+ * Look up a built-in function by name, generating its signatures the
+ * first time it is asked for.
+ */
+ir_function *
+builtin_builder::get_function(const char *name)
+{
+   ir_function *f = shader->symbols->get_function(name);
+   if (f != NULL || !_mesa_set_search(names, name))
+      return f;
+
+   wanted_function = name;
+   create_builtins();
+   wanted_function = NULL;
+
+   return shader->symbols->get_function(name);
+}
+
+/**
+ * Whether create_builtins() should generate the signatures of \p name.
+ * This also records the names of all the built-ins on the first run.
+ */
+bool
+builtin_builder::wants_function(const char *name)
+{
+   if (wanted_function == NULL) {
+      _mesa_set_add(names, name);
+      return false;
+   }
+
+   return strcmp(name, wanted_function) == 0;
+}
+
 void
 builtin_builder::release()
 {
    ralloc_free(mem_ctx);
    mem_ctx = NULL;
+   names = NULL;
 
    ralloc_free(shader);
    shader = NULL;
@@ -1263,10 +1318,18 @@ builtin_builder::create_intrinsics()
 
 }
 
+/* Skip evaluating the signature arguments of all the other functions */
+#define add_function(NAME, ...)                      \
+   do {                                              \
+      if (wants_function(NAME))                      \
+         add_function(NAME, __VA_ARGS__);            \
+   } while (0)
+
 /**
  * Create ir_function and ir_function_signature objects for each built-in.
  *
- * Contains a list of every available built-in.
+ * Contains a list of every available built-in.  Only the function named by
+ * wanted_function is actually created, see get_function().
  */
 void
 builtin_builder::create_builtins()
@@ -3331,6 +3394,8 @@ builtin_builder::create_builtins()
 #undef FIU2_MIXED
 }
 
+#undef add_function
+
 void
 builtin_builder::add_function(const char *name, ...)
 {
@@ -3401,6 +3466,12 @@ builtin_builder::add_image_function(const char *name,
       glsl_type::uimage2DMSArray_type
    };
 
+   /* The GLSL built-ins come from create_builtins(), the intrinsics they
+    * call are always generated.
+    */
+   if ((flags & IMAGE_FUNCTION_EMIT_STUB) && !wants_function(name))
+      return;
+
    ir_function *f = new(mem_ctx) ir_function(name);
 
    for (unsigned i = 0; i < ARRAY_SIZE(types); ++i) {
@@ -6300,7 +6371,7 @@ _mesa_glsl_has_builtin_function(_mesa_glsl_parse_state *state, const char *name)
    ir_function *f;
    bool ret = false;
    mtx_lock(&builtins_lock);
-   f = builtins.shader->symbols->get_function(name);
+   f = builtins.get_function(name);
    if (f != NULL) {
       foreach_in_list(ir_function_signature, sig, &f->signatures) {
          if (sig->is_builtin_available(state)) {
@@ -6314,6 +6385,17 @@ _mesa_glsl_has_builtin_function(_mesa_glsl_parse_state *state, const char *name)
    return ret;
 }
 
+ir_function *
+_mesa_glsl_find_builtin_function_by_name(const char *name)
+{
+   ir_function *f;
+   mtx_lock(&builtins_lock);
+   f = builtins.get_function(name);
+   mtx_unlock(&builtins_lock);
+
+   return f;
+}
+
 gl_shader *
 _mesa_glsl_get_builtin_function_shader()
 {
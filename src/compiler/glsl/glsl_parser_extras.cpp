@@ -1936,7 +1936,8 @@ do_late_parsing_checks(struct _mesa_glsl_parse_state *state)
 
 static void
 opt_shader_and_create_symbol_table(struct gl_context *ctx,
-                                   struct gl_shader *shader)
+                                   struct gl_shader *shader,
+                                   GLbitfield glsl_flags)
 {
    assert(shader->CompileStatus != compile_failure &&
           !shader->ir->is_empty());
@@ -1947,15 +1948,14 @@ opt_shader_and_create_symbol_table(struct gl_context *ctx,
    /* Do some optimization at compile time to reduce shader IR size
     * and reduce later work if the same shader is linked multiple times
     */
-   if (ctx->Const.GLSLOptimizeConservatively) {
-      /* Run it just once. */
-      do_common_optimization(shader->ir, false, false, options,
-                             ctx->Const.NativeIntegers);
-   } else {
-      /* Repeat it until it stops making changes. */
-      while (do_common_optimization(shader->ir, false, false, options,
-                                    ctx->Const.NativeIntegers))
-         ;
+   const unsigned iterations =
+      do_common_optimization_loop(shader->ir, false, false, options,
+                                  &ctx->Const);
+
+   if (glsl_flags & GLSL_OPT_STATS) {
+      fprintf(stderr, "GLSL IR optimization of %s shader %u: %u iterations\n",
+              _mesa_shader_stage_to_string(shader->Stage), shader->Name,
+              iterations);
    }
 
    validate_ir_tree(shader->ir);
@@ -2013,9 +2013,10 @@ opt_shader_and_create_symbol_table(struct gl_context *ctx,
    _mesa_glsl_initialize_derived_variables(ctx, shader);
 }
 
-void
-_mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
-                          bool dump_ast, bool dump_hir, bool force_recompile)
+static void
+do_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
+                  bool dump_ast, bool dump_hir, bool force_recompile,
+                  GLbitfield glsl_flags)
 {
    const char *source = force_recompile && shader->FallbackSource ?
       shader->FallbackSource : shader->Source;
@@ -2027,7 +2028,7 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
                                 shader->sha1);
          if (disk_cache_has_key(ctx->Cache, shader->sha1)) {
             /* We've seen this shader before and know it compiles */
-            if (ctx->_Shader->Flags & GLSL_CACHE_INFO) {
+            if (glsl_flags & GLSL_CACHE_INFO) {
                _mesa_sha1_format(buf, shader->sha1);
                fprintf(stderr, "deferring compile of shader: %s\n", buf);
             }
@@ -2047,7 +2048,7 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
          return;
 
       if (shader->CompileStatus == compiled_no_opts) {
-         opt_shader_and_create_symbol_table(ctx, shader);
+         opt_shader_and_create_symbol_table(ctx, shader, glsl_flags);
          shader->CompileStatus = compile_success;
          return;
       }
@@ -2108,7 +2109,7 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
       lower_subroutine(shader->ir, state);
 
       if (!ctx->Cache || force_recompile)
-         opt_shader_and_create_symbol_table(ctx, shader);
+         opt_shader_and_create_symbol_table(ctx, shader, glsl_flags);
       else {
          reparent_ir(shader->ir, shader->ir);
          shader->CompileStatus = compiled_no_opts;
@@ -2124,6 +2125,27 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
    ralloc_free(state);
 }
 
+/**
+ * Protects the IR of shaders that get recompiled after a shader cache miss.
+ * With GL_ARB_parallel_shader_compile, several programs sharing a shader
+ * may be linked at the same time.
+ */
+static mtx_t fallback_compile_lock = _MTX_INITIALIZER_NP;
+
+void
+_mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
+                          bool dump_ast, bool dump_hir, bool force_recompile,
+                          GLbitfield glsl_flags)
+{
+   if (force_recompile) {
+      mtx_lock(&fallback_compile_lock);
+      do_compile_shader(ctx, shader, dump_ast, dump_hir, true, glsl_flags);
+      mtx_unlock(&fallback_compile_lock);
+   } else {
+      do_compile_shader(ctx, shader, dump_ast, dump_hir, false, glsl_flags);
+   }
+}
+
 } /* extern "C" */
 /**
  * Do the set of common optimizations passes
@@ -2226,6 +2248,91 @@ do_common_optimization(exec_list *ir, bool linked,
    return progress;
 }
 
+/**
+ * The passes GLSL_OPT_LEVEL_FAST runs: the ones that shrink the shader
+ * cheaply, that linking relies on to drop unused uniforms and varyings,
+ * or that the driver can't do without.
+ */
+static bool
+do_fast_optimization(exec_list *ir, bool linked,
+                     bool uniform_locations_assigned,
+                     const struct gl_shader_compiler_options *options)
+{
+   bool progress = false;
+
+   progress = lower_instructions(ir, SUB_TO_ADD_NEG) || progress;
+
+   if (linked) {
+      progress = do_function_inlining(ir) || progress;
+      progress = do_dead_functions(ir) || progress;
+   }
+   propagate_invariance(ir);
+
+   if (linked)
+      progress = do_dead_code(ir, uniform_locations_assigned) || progress;
+   else
+      progress = do_dead_code_unlinked(ir) || progress;
+   progress = do_constant_folding(ir) || progress;
+   progress = do_lower_jumps(ir, true, true, options->EmitNoMainReturn,
+                             options->EmitNoCont, options->EmitNoLoops)
+              || progress;
+
+   /* Constant indices into vectors become swizzles, like the full pipeline
+    * leaves them.
+    */
+   progress = do_vec_index_to_swizzle(ir) || progress;
+   progress = lower_vector_insert(ir, false) || progress;
+
+   /* The backend can't handle loops at all, so they have to go */
+   if (options->EmitNoLoops && options->MaxUnrollIterations) {
+      loop_state *ls = analyze_loop_variables(ir);
+      if (ls->loop_found)
+         progress = unroll_loops(ir, ls, options) || progress;
+      delete ls;
+   }
+
+   return progress;
+}
+
+/**
+ * Optimize \c ir as much as \c consts->GLSLOptimizeLevel asks for.
+ *
+ * \return How many times the optimization passes were run over \c ir.
+ */
+unsigned
+do_common_optimization_loop(exec_list *ir, bool linked,
+                            bool uniform_locations_assigned,
+                            const struct gl_shader_compiler_options *options,
+                            const struct gl_constants *consts)
+{
+   switch (consts->GLSLOptimizeLevel) {
+   case GLSL_OPT_LEVEL_FAST:
+      do_fast_optimization(ir, linked, uniform_locations_assigned, options);
+      return 1;
+
+   case GLSL_OPT_LEVEL_CONSERVATIVE:
+      /* Run it just once. */
+      do_common_optimization(ir, linked, uniform_locations_assigned,
+                             options, consts->NativeIntegers);
+      return 1;
+
+   case GLSL_OPT_LEVEL_FULL:
+   default: {
+      /* Repeat it until it stops making changes, or the budget runs out. */
+      unsigned iterations = 0;
+      bool progress;
+      do {
+         progress = do_common_optimization(ir, linked,
+                                           uniform_locations_assigned,
+                                           options, consts->NativeIntegers);
+         iterations++;
+      } while (progress && (consts->GLSLOptimizeMaxIterations == 0 ||
+                            iterations < consts->GLSLOptimizeMaxIterations));
+      return iterations;
+   }
+   }
+}
+
 extern "C" {
 
 /**
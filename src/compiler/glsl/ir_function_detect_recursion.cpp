@@ -130,6 +130,9 @@
 namespace {
 
 struct call_node : public exec_node {
+   /* override operator new from exec_node */
+   DECLARE_LINEAR_ALLOC_CXX_OPERATORS(call_node)
+
    class function *func;
 };
 
@@ -141,7 +144,7 @@ public:
       /* empty */
    }
 
-   DECLARE_RALLOC_CXX_OPERATORS(function)
+   DECLARE_LINEAR_ALLOC_CXX_OPERATORS(function)
 
    ir_function_signature *sig;
 
@@ -159,13 +162,14 @@ public:
    {
       progress = false;
       this->mem_ctx = ralloc_context(NULL);
-      this->function_hash = _mesa_hash_table_create(NULL, _mesa_hash_pointer,
+      this->lin_ctx = linear_alloc_parent(this->mem_ctx, 0);
+      this->function_hash = _mesa_hash_table_create(this->mem_ctx,
+                                                    _mesa_hash_pointer,
                                                     _mesa_key_pointer_equal);
    }
 
    ~has_recursion_visitor()
    {
-      _mesa_hash_table_destroy(this->function_hash, NULL);
       ralloc_free(this->mem_ctx);
    }
 
@@ -174,7 +178,7 @@ public:
       function *f;
       hash_entry *entry = _mesa_hash_table_search(this->function_hash, sig);
       if (entry == NULL) {
-         f = new(mem_ctx) function(sig);
+         f = new(lin_ctx) function(sig);
          _mesa_hash_table_insert(this->function_hash, sig, f);
       } else {
          f = (function *) entry->data;
@@ -209,13 +213,13 @@ public:
 
       /* Create a link from the caller to the callee.
        */
-      call_node *node = new(mem_ctx) call_node;
+      call_node *node = new(lin_ctx) call_node;
       node->func = target;
       this->current->callees.push_tail(node);
 
       /* Create a link from the callee to the caller.
        */
-      node = new(mem_ctx) call_node;
+      node = new(lin_ctx) call_node;
       node->func = this->current;
       target->callers.push_tail(node);
       return visit_continue;
@@ -224,6 +228,7 @@ public:
    function *current;
    struct hash_table *function_hash;
    void *mem_ctx;
+   void *lin_ctx;
    bool progress;
 };
 
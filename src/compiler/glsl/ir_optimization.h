@@ -90,6 +90,10 @@ bool do_common_optimization(exec_list *ir, bool linked,
 			    bool uniform_locations_assigned,
                             const struct gl_shader_compiler_options *options,
                             bool native_integers);
+unsigned do_common_optimization_loop(exec_list *ir, bool linked,
+                                     bool uniform_locations_assigned,
+                                     const struct gl_shader_compiler_options *options,
+                                     const struct gl_constants *consts);
 
 bool ir_constant_fold(ir_rvalue **rvalue);
 
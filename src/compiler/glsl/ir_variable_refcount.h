@@ -46,6 +46,8 @@ class ir_variable_refcount_entry
 public:
    ir_variable_refcount_entry(ir_variable *var);
 
+   DECLARE_LINEAR_ALLOC_CXX_OPERATORS(ir_variable_refcount_entry)
+
    ir_variable *var; /* The key: the variable's pointer. */
 
    /**
@@ -86,6 +88,12 @@ public:
    struct hash_table *ht;
 
    void *mem_ctx;
+
+   /**
+    * Linear allocator for the entries and their assignment lists, which are
+    * all freed together with the visitor.
+    */
+   void *lin_ctx;
 };
 
 #endif /* GLSL_IR_VARIABLE_REFCOUNT_H */
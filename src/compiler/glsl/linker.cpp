@@ -2259,9 +2259,7 @@ link_intrastage_shaders(void *mem_ctx,
 
    /* Create program and attach it to the linked shader */
    struct gl_program *gl_prog =
-      ctx->Driver.NewProgram(ctx,
-                             _mesa_shader_stage_to_program(shader_list[0]->Stage),
-                             prog->Name, false);
+      _mesa_new_linked_program(ctx, prog, shader_list[0]->Stage);
    if (!gl_prog) {
       prog->data->LinkStatus = linking_failure;
       _mesa_delete_linked_shader(ctx, linked);
@@ -2314,7 +2312,7 @@ link_intrastage_shaders(void *mem_ctx,
    }
 
    if (!link_function_calls(prog, linked, shader_list, num_shaders)) {
-      _mesa_delete_linked_shader(ctx, linked);
+      _mesa_discard_linked_shader(ctx, prog, linked);
       return NULL;
    }
 
@@ -2332,7 +2330,7 @@ link_intrastage_shaders(void *mem_ctx,
                           &num_ubo_blocks, &ssbo_blocks, &num_ssbo_blocks);
 
       if (!prog->data->LinkStatus) {
-         _mesa_delete_linked_shader(ctx, linked);
+         _mesa_discard_linked_shader(ctx, prog, linked);
          return NULL;
       }
 
@@ -4668,25 +4666,25 @@ link_varyings_and_uniforms(unsigned first, unsigned last,
 }
 
 static void
-linker_optimisation_loop(struct gl_context *ctx, exec_list *ir,
-                         unsigned stage)
+linker_optimisation_loop(struct gl_context *ctx,
+                         struct gl_shader_program *prog, exec_list *ir,
+                         unsigned stage, GLbitfield glsl_flags)
 {
-      if (ctx->Const.GLSLOptimizeConservatively) {
-         /* Run it just once. */
-         do_common_optimization(ir, true, false,
-                                &ctx->Const.ShaderCompilerOptions[stage],
-                                ctx->Const.NativeIntegers);
-      } else {
-         /* Repeat it until it stops making changes. */
-         while (do_common_optimization(ir, true, false,
-                                       &ctx->Const.ShaderCompilerOptions[stage],
-                                       ctx->Const.NativeIntegers))
-            ;
-      }
+   const unsigned iterations =
+      do_common_optimization_loop(ir, true, false,
+                                  &ctx->Const.ShaderCompilerOptions[stage],
+                                  &ctx->Const);
+
+   if (glsl_flags & GLSL_OPT_STATS) {
+      fprintf(stderr, "GLSL IR optimization of %s shader in program %u: "
+              "%u iterations\n", _mesa_shader_stage_to_string(stage),
+              prog->Name, iterations);
+   }
 }
 
 void
-link_shaders(struct gl_context *ctx, struct gl_shader_program *prog)
+link_shaders(struct gl_context *ctx, struct gl_shader_program *prog,
+             GLbitfield glsl_flags)
 {
    prog->data->LinkStatus = linking_success; /* All error paths will set this to false */
    prog->data->Validated = false;
@@ -4715,12 +4713,14 @@ link_shaders(struct gl_context *ctx, struct gl_shader_program *prog)
    bool skip_cache = false;
    if (prog->TransformFeedback.NumVarying > 0) {
       for (unsigned i = 0; i < prog->NumShaders; i++) {
-         _mesa_glsl_compile_shader(ctx, prog->Shaders[i], false, false, true);
+         _mesa_glsl_compile_shader(ctx, prog->Shaders[i], false, false, true,
+                                   glsl_flags);
       }
       skip_cache = true;
    }
 
-   if (!skip_cache && shader_cache_read_program_metadata(ctx, prog))
+   if (!skip_cache &&
+       shader_cache_read_program_metadata(ctx, prog, glsl_flags))
       return;
 #endif
 
@@ -4853,7 +4853,7 @@ link_shaders(struct gl_context *ctx, struct gl_shader_program *prog)
 
          if (!prog->data->LinkStatus) {
             if (sh)
-               _mesa_delete_linked_shader(ctx, sh);
+               _mesa_discard_linked_shader(ctx, prog, sh);
             goto done;
          }
 
@@ -4876,7 +4876,7 @@ link_shaders(struct gl_context *ctx, struct gl_shader_program *prog)
          }
          if (!prog->data->LinkStatus) {
             if (sh)
-               _mesa_delete_linked_shader(ctx, sh);
+               _mesa_discard_linked_shader(ctx, prog, sh);
             goto done;
          }
 
@@ -4998,11 +4998,13 @@ link_shaders(struct gl_context *ctx, struct gl_shader_program *prog)
       /* Call opts before lowering const arrays to uniforms so we can const
        * propagate any elements accessed directly.
        */
-      linker_optimisation_loop(ctx, prog->_LinkedShaders[i]->ir, i);
+      linker_optimisation_loop(ctx, prog, prog->_LinkedShaders[i]->ir, i,
+                               glsl_flags);
 
       /* Call opts after lowering const arrays to copy propagate things. */
       if (lower_const_arrays_to_uniforms(prog->_LinkedShaders[i]->ir, i))
-         linker_optimisation_loop(ctx, prog->_LinkedShaders[i]->ir, i);
+         linker_optimisation_loop(ctx, prog, prog->_LinkedShaders[i]->ir, i,
+                                  glsl_flags);
 
       propagate_invariance(prog->_LinkedShaders[i]->ir);
    }
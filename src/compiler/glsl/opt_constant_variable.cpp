@@ -55,12 +55,13 @@ public:
    virtual ir_visitor_status visit_enter(ir_call *);
 
    struct hash_table *ht;
+   void *lin_ctx;
 };
 
 } /* unnamed namespace */
 
 static struct assignment_entry *
-get_assignment_entry(ir_variable *var, struct hash_table *ht)
+get_assignment_entry(ir_variable *var, struct hash_table *ht, void *lin_ctx)
 {
    struct hash_entry *hte = _mesa_hash_table_search(ht, var);
    struct assignment_entry *entry;
@@ -68,7 +69,8 @@ get_assignment_entry(ir_variable *var, struct hash_table *ht)
    if (hte) {
       entry = (struct assignment_entry *) hte->data;
    } else {
-      entry = (struct assignment_entry *) calloc(1, sizeof(*entry));
+      entry = (struct assignment_entry *) linear_zalloc_child(lin_ctx,
+                                                              sizeof(*entry));
       entry->var = var;
       _mesa_hash_table_insert(ht, var, entry);
    }
@@ -79,7 +81,8 @@ get_assignment_entry(ir_variable *var, struct hash_table *ht)
 ir_visitor_status
 ir_constant_variable_visitor::visit(ir_variable *ir)
 {
-   struct assignment_entry *entry = get_assignment_entry(ir, this->ht);
+   struct assignment_entry *entry =
+      get_assignment_entry(ir, this->ht, this->lin_ctx);
    entry->our_scope = true;
    return visit_continue;
 }
@@ -98,7 +101,8 @@ ir_constant_variable_visitor::visit_enter(ir_assignment *ir)
    ir_constant *constval;
    struct assignment_entry *entry;
 
-   entry = get_assignment_entry(ir->lhs->variable_referenced(), this->ht);
+   entry = get_assignment_entry(ir->lhs->variable_referenced(), this->ht,
+                                this->lin_ctx);
    assert(entry);
    entry->assignment_count++;
 
@@ -159,7 +163,7 @@ ir_constant_variable_visitor::visit_enter(ir_call *ir)
 	 struct assignment_entry *entry;
 
 	 assert(var);
-	 entry = get_assignment_entry(var, this->ht);
+	 entry = get_assignment_entry(var, this->ht, this->lin_ctx);
 	 entry->assignment_count++;
       }
    }
@@ -170,7 +174,7 @@ ir_constant_variable_visitor::visit_enter(ir_call *ir)
       struct assignment_entry *entry;
 
       assert(var);
-      entry = get_assignment_entry(var, this->ht);
+      entry = get_assignment_entry(var, this->ht, this->lin_ctx);
       entry->assignment_count++;
    }
 
@@ -186,7 +190,9 @@ do_constant_variable(exec_list *instructions)
    bool progress = false;
    ir_constant_variable_visitor v;
 
-   v.ht = _mesa_hash_table_create(NULL, _mesa_hash_pointer,
+   void *mem_ctx = ralloc_context(NULL);
+   v.lin_ctx = linear_alloc_parent(mem_ctx, 0);
+   v.ht = _mesa_hash_table_create(mem_ctx, _mesa_hash_pointer,
                                   _mesa_key_pointer_equal);
    v.run(instructions);
 
@@ -198,10 +204,8 @@ do_constant_variable(exec_list *instructions)
 	 entry->var->constant_value = entry->constval;
 	 progress = true;
       }
-      hte->data = NULL;
-      free(entry);
    }
-   _mesa_hash_table_destroy(v.ht, NULL);
+   ralloc_free(mem_ctx);
 
    return progress;
 }
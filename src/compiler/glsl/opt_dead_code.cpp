@@ -111,7 +111,6 @@ do_dead_code(exec_list *instructions, bool uniform_locations_assigned)
                }
 
                assignment_entry->link.remove();
-               free(assignment_entry);
             }
             progress = true;
 	 }
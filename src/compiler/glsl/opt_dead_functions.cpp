@@ -37,6 +37,9 @@ namespace {
 class signature_entry : public exec_node
 {
 public:
+   /* override operator new from exec_node */
+   DECLARE_LINEAR_ALLOC_CXX_OPERATORS(signature_entry)
+
    signature_entry(ir_function_signature *sig)
    {
       this->signature = sig;
@@ -52,6 +55,7 @@ public:
    ir_dead_functions_visitor()
    {
       this->mem_ctx = ralloc_context(NULL);
+      this->lin_ctx = linear_alloc_parent(this->mem_ctx, 0);
    }
 
    ~ir_dead_functions_visitor()
@@ -67,6 +71,7 @@ public:
    /* List of signature_entry */
    exec_list signature_list;
    void *mem_ctx;
+   void *lin_ctx;
 };
 
 } /* unnamed namespace */
@@ -79,7 +84,7 @@ ir_dead_functions_visitor::get_signature_entry(ir_function_signature *sig)
 	 return entry;
    }
 
-   signature_entry *entry = new(mem_ctx) signature_entry(sig);
+   signature_entry *entry = new(lin_ctx) signature_entry(sig);
    this->signature_list.push_tail(entry);
    return entry;
 }
@@ -128,7 +133,6 @@ do_dead_functions(exec_list *instructions)
 	 delete entry->signature;
 	 progress = true;
       }
-      delete(entry);
    }
 
    /* We don't just do this above when we nuked a signature because of
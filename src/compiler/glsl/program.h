@@ -35,14 +35,16 @@ struct gl_shader_program;
 
 extern void
 _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
-			  bool dump_ast, bool dump_hir, bool force_recompile);
+			  bool dump_ast, bool dump_hir, bool force_recompile,
+			  GLbitfield glsl_flags);
 
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
 
 extern void
-link_shaders(struct gl_context *ctx, struct gl_shader_program *prog);
+link_shaders(struct gl_context *ctx, struct gl_shader_program *prog,
+             GLbitfield glsl_flags);
 
 extern void
 build_program_resource_list(struct gl_context *ctx,
@@ -44,6 +44,9 @@
  * corrupt, etc) we will use a fallback path to compile and link the IR.
  */
 
+#include <stdio.h>
+#include <unistd.h>
+
 #include "blob.h"
 #include "compiler/shader_info.h"
 #include "glsl_symbol_table.h"
@@ -68,180 +71,11 @@ extern "C" {
 }
 
 static void
-compile_shaders(struct gl_context *ctx, struct gl_shader_program *prog) {
+compile_shaders(struct gl_context *ctx, struct gl_shader_program *prog,
+                GLbitfield glsl_flags) {
    for (unsigned i = 0; i < prog->NumShaders; i++) {
-      _mesa_glsl_compile_shader(ctx, prog->Shaders[i], false, false, true);
-   }
-}
-
-static void
-get_struct_type_field_and_pointer_sizes(size_t *s_field_size,
-                                        size_t *s_field_ptrs)
-{
-   *s_field_size = sizeof(glsl_struct_field);
-   *s_field_ptrs =
-     sizeof(((glsl_struct_field *)0)->type) +
-     sizeof(((glsl_struct_field *)0)->name);
-}
-
-static void
-encode_type_to_blob(struct blob *blob, const glsl_type *type)
-{
-   uint32_t encoding;
-
-   if (!type) {
-      blob_write_uint32(blob, 0);
-      return;
-   }
-
-   switch (type->base_type) {
-   case GLSL_TYPE_UINT:
-   case GLSL_TYPE_INT:
-   case GLSL_TYPE_FLOAT:
-   case GLSL_TYPE_BOOL:
-   case GLSL_TYPE_DOUBLE:
-   case GLSL_TYPE_UINT64:
-   case GLSL_TYPE_INT64:
-      encoding = (type->base_type << 24) |
-         (type->vector_elements << 4) |
-         (type->matrix_columns);
-      break;
-   case GLSL_TYPE_SAMPLER:
-      encoding = (type->base_type) << 24 |
-         (type->sampler_dimensionality << 4) |
-         (type->sampler_shadow << 3) |
-         (type->sampler_array << 2) |
-         (type->sampled_type);
-      break;
-   case GLSL_TYPE_SUBROUTINE:
-      encoding = type->base_type << 24;
-      blob_write_uint32(blob, encoding);
-      blob_write_string(blob, type->name);
-      return;
-   case GLSL_TYPE_IMAGE:
-      encoding = (type->base_type) << 24 |
-         (type->sampler_dimensionality << 3) |
-         (type->sampler_array << 2) |
-         (type->sampled_type);
-      break;
-   case GLSL_TYPE_ATOMIC_UINT:
-      encoding = (type->base_type << 24);
-      break;
-   case GLSL_TYPE_ARRAY:
-      blob_write_uint32(blob, (type->base_type) << 24);
-      blob_write_uint32(blob, type->length);
-      encode_type_to_blob(blob, type->fields.array);
-      return;
-   case GLSL_TYPE_STRUCT:
-   case GLSL_TYPE_INTERFACE:
-      blob_write_uint32(blob, (type->base_type) << 24);
-      blob_write_string(blob, type->name);
-      blob_write_uint32(blob, type->length);
-
-      size_t s_field_size, s_field_ptrs;
-      get_struct_type_field_and_pointer_sizes(&s_field_size, &s_field_ptrs);
-
-      for (unsigned i = 0; i < type->length; i++) {
-         encode_type_to_blob(blob, type->fields.structure[i].type);
-         blob_write_string(blob, type->fields.structure[i].name);
-
-         /* Write the struct field skipping the pointers */
-         blob_write_bytes(blob,
-                          ((char *)&type->fields.structure[i]) + s_field_ptrs,
-                          s_field_size - s_field_ptrs);
-      }
-
-      if (type->is_interface()) {
-         blob_write_uint32(blob, type->interface_packing);
-         blob_write_uint32(blob, type->interface_row_major);
-      }
-      return;
-   case GLSL_TYPE_VOID:
-   case GLSL_TYPE_ERROR:
-   default:
-      assert(!"Cannot encode type!");
-      encoding = 0;
-      break;
-   }
-
-   blob_write_uint32(blob, encoding);
-}
-
-static const glsl_type *
-decode_type_from_blob(struct blob_reader *blob)
-{
-   uint32_t u = blob_read_uint32(blob);
-
-   if (u == 0) {
-      return NULL;
-   }
-
-   glsl_base_type base_type = (glsl_base_type) (u >> 24);
-
-   switch (base_type) {
-   case GLSL_TYPE_UINT:
-   case GLSL_TYPE_INT:
-   case GLSL_TYPE_FLOAT:
-   case GLSL_TYPE_BOOL:
-   case GLSL_TYPE_DOUBLE:
-   case GLSL_TYPE_UINT64:
-   case GLSL_TYPE_INT64:
-      return glsl_type::get_instance(base_type, (u >> 4) & 0x0f, u & 0x0f);
-   case GLSL_TYPE_SAMPLER:
-      return glsl_type::get_sampler_instance((enum glsl_sampler_dim) ((u >> 4) & 0x07),
-                                             (u >> 3) & 0x01,
-                                             (u >> 2) & 0x01,
-                                             (glsl_base_type) ((u >> 0) & 0x03));
-   case GLSL_TYPE_SUBROUTINE:
-      return glsl_type::get_subroutine_instance(blob_read_string(blob));
-   case GLSL_TYPE_IMAGE:
-      return glsl_type::get_image_instance((enum glsl_sampler_dim) ((u >> 3) & 0x07),
-                                             (u >> 2) & 0x01,
-                                             (glsl_base_type) ((u >> 0) & 0x03));
-   case GLSL_TYPE_ATOMIC_UINT:
-      return glsl_type::atomic_uint_type;
-   case GLSL_TYPE_ARRAY: {
-      unsigned length = blob_read_uint32(blob);
-      return glsl_type::get_array_instance(decode_type_from_blob(blob),
-                                           length);
-   }
-   case GLSL_TYPE_STRUCT:
-   case GLSL_TYPE_INTERFACE: {
-      char *name = blob_read_string(blob);
-      unsigned num_fields = blob_read_uint32(blob);
-
-      size_t s_field_size, s_field_ptrs;
-      get_struct_type_field_and_pointer_sizes(&s_field_size, &s_field_ptrs);
-
-      glsl_struct_field *fields =
-         (glsl_struct_field *) malloc(s_field_size * num_fields);
-      for (unsigned i = 0; i < num_fields; i++) {
-         fields[i].type = decode_type_from_blob(blob);
-         fields[i].name = blob_read_string(blob);
-
-         blob_copy_bytes(blob, ((uint8_t *) &fields[i]) + s_field_ptrs,
-                         s_field_size - s_field_ptrs);
-      }
-
-      const glsl_type *t;
-      if (base_type == GLSL_TYPE_INTERFACE) {
-         enum glsl_interface_packing packing =
-            (glsl_interface_packing) blob_read_uint32(blob);
-         bool row_major = blob_read_uint32(blob);
-         t = glsl_type::get_interface_instance(fields, num_fields, packing,
-                                               row_major, name);
-      } else {
-         t = glsl_type::get_record_instance(fields, num_fields, name);
-      }
-
-      free(fields);
-      return t;
-   }
-   case GLSL_TYPE_VOID:
-   case GLSL_TYPE_ERROR:
-   default:
-      assert(!"Cannot decode type!");
-      return NULL;
+      _mesa_glsl_compile_shader(ctx, prog->Shaders[i], false, false, true,
+                                glsl_flags);
    }
 }
 
@@ -1315,8 +1149,7 @@ create_linked_shader_and_program(struct gl_context *ctx,
    struct gl_linked_shader *linked = rzalloc(NULL, struct gl_linked_shader);
    linked->Stage = stage;
 
-   glprog = ctx->Driver.NewProgram(ctx, _mesa_shader_stage_to_program(stage),
-                                   prog->Name, false);
+   glprog = _mesa_new_linked_program(ctx, prog, stage);
    glprog->info.stage = stage;
    linked->Program = glprog;
 
@@ -1438,7 +1271,8 @@ fail:
 
 bool
 shader_cache_read_program_metadata(struct gl_context *ctx,
-                                   struct gl_shader_program *prog)
+                                   struct gl_shader_program *prog,
+                                   GLbitfield glsl_flags)
 {
    /* Fixed function programs generated by Mesa are not cached. So don't
     * try to read metadata for them from the cache.
@@ -1500,10 +1334,19 @@ shader_cache_read_program_metadata(struct gl_context *ctx,
    disk_cache_compute_key(cache, buf, strlen(buf), prog->data->sha1);
    ralloc_free(buf);
 
+   /* Read straight out of the pack file when the entry is stored
+    * uncompressed, otherwise get our own copy that has to be freed.
+    */
    size_t size;
-   uint8_t *buffer = (uint8_t *) disk_cache_get(cache, prog->data->sha1,
-                                                &size);
-   if (buffer == NULL) {
+   uint8_t *buffer = NULL;
+   const uint8_t *data =
+      (const uint8_t *) disk_cache_get_mapped(cache, prog->data->sha1, &size);
+   if (data == NULL) {
+      buffer = (uint8_t *) disk_cache_get(cache, prog->data->sha1, &size);
+      data = buffer;
+   }
+
+   if (data == NULL) {
       /* Cached program not found. We may have seen the individual shaders
        * before and skipped compiling but they may not have been used together
        * in this combination before. Fall back to linking shaders but first
@@ -1514,18 +1357,18 @@ shader_cache_read_program_metadata(struct gl_context *ctx,
        * changed since the last compile so for now we just recompile
        * everything.
        */
-      compile_shaders(ctx, prog);
+      compile_shaders(ctx, prog, glsl_flags);
       return false;
    }
 
-   if (ctx->_Shader->Flags & GLSL_CACHE_INFO) {
+   if (glsl_flags & GLSL_CACHE_INFO) {
       _mesa_sha1_format(sha1buf, prog->data->sha1);
       fprintf(stderr, "loading shader program meta data from cache: %s\n",
               sha1buf);
    }
 
    struct blob_reader metadata;
-   blob_reader_init(&metadata, buffer, size);
+   blob_reader_init(&metadata, (uint8_t *) data, size);
 
    assert(prog->data->UniformStorage == NULL);
 
@@ -1561,13 +1404,13 @@ shader_cache_read_program_metadata(struct gl_context *ctx,
        */
       assert(!"Invalid GLSL shader disk cache item!");
 
-      if (ctx->_Shader->Flags & GLSL_CACHE_INFO) {
+      if (glsl_flags & GLSL_CACHE_INFO) {
          fprintf(stderr, "Error reading program from cache (invalid GLSL "
                  "cache item)\n");
       }
 
       disk_cache_remove(cache, prog->data->sha1);
-      compile_shaders(ctx, prog);
+      compile_shaders(ctx, prog, glsl_flags);
       free(buffer);
       return false;
    }
@@ -1585,7 +1428,7 @@ shader_cache_read_program_metadata(struct gl_context *ctx,
    for (unsigned i = 0; i < prog->NumShaders; i++) {
       if (prog->Shaders[i]->CompileStatus == compiled_no_opts) {
          disk_cache_put_key(cache, prog->Shaders[i]->sha1);
-         if (ctx->_Shader->Flags & GLSL_CACHE_INFO) {
+         if (glsl_flags & GLSL_CACHE_INFO) {
             _mesa_sha1_format(sha1_buf, prog->Shaders[i]->sha1);
             fprintf(stderr, "re-marking shader: %s\n", sha1_buf);
          }
@@ -1596,3 +1439,103 @@ shader_cache_read_program_metadata(struct gl_context *ctx,
 
    return true;
 }
+
+struct capture_bindings_closure {
+   struct gl_shader_program *prog;
+   char **buf;
+};
+
+static void
+capture_attribute_binding(const char *key, unsigned value, void *closure)
+{
+   struct capture_bindings_closure *c =
+      (struct capture_bindings_closure *) closure;
+
+   ralloc_asprintf_append(c->buf, "attribute location %u %s\n",
+                          value - VERT_ATTRIB_GENERIC0, key);
+}
+
+static void
+capture_frag_data_binding(const char *key, unsigned value, void *closure)
+{
+   struct capture_bindings_closure *c =
+      (struct capture_bindings_closure *) closure;
+   unsigned index = 0;
+
+   c->prog->FragDataIndexBindings->get(index, key);
+   ralloc_asprintf_append(c->buf, "frag data location %u %u %s\n",
+                          value - FRAG_RESULT_DATA0, index, key);
+}
+
+/**
+ * Write a successfully linked program to \p path as a .shader_test file that
+ * can be replayed to warm up a shader cache ahead of time.
+ *
+ * Besides the shader sources, a [cache key] section records the inputs to
+ * the program's cache key above that are under the application's control:
+ * the API and the attribute and fragment data bindings. Files are named
+ * after the SHA-1 of their contents, so captures of several applications
+ * can share a directory and each distinct program is only written once.
+ */
+void
+shader_cache_capture_program(struct gl_context *ctx,
+                             struct gl_shader_program *prog,
+                             const char *path)
+{
+   if (prog->Name == 0 || prog->data->skip_cache ||
+       prog->data->LinkStatus == linking_failure)
+      return;
+
+   char *buf = ralloc_asprintf(NULL, "[require]\nGLSL%s >= %u.%02u\n",
+                               prog->IsES ? " ES" : "",
+                               prog->data->Version / 100,
+                               prog->data->Version % 100);
+   if (prog->SeparateShader)
+      ralloc_strcat(&buf, "GL_ARB_separate_shader_objects\nSSO ENABLED\n");
+
+   ralloc_asprintf_append(&buf, "\n[cache key]\napi %s\n",
+                          ctx->API == API_OPENGL_CORE ? "core" :
+                          ctx->API == API_OPENGL_COMPAT ? "compat" : "es");
+
+   struct capture_bindings_closure closure = { prog, &buf };
+   prog->AttributeBindings->iterate(capture_attribute_binding, &closure);
+   prog->FragDataBindings->iterate(capture_frag_data_binding, &closure);
+   ralloc_strcat(&buf, "\n");
+
+   for (unsigned i = 0; i < prog->NumShaders; i++) {
+      struct gl_shader *sh = prog->Shaders[i];
+      ralloc_asprintf_append(&buf, "[%s shader]\n%s\n",
+                             _mesa_shader_stage_to_string(sh->Stage),
+                             sh->Source);
+   }
+
+   size_t size = strlen(buf);
+   unsigned char sha1[20];
+   char sha1buf[41];
+   _mesa_sha1_compute(buf, size, sha1);
+   _mesa_sha1_format(sha1buf, sha1);
+
+   char *filename = ralloc_asprintf(buf, "%s/%s.shader_test", path, sha1buf);
+   if (access(filename, F_OK) == 0) {
+      ralloc_free(buf);
+      return;
+   }
+
+   /* Several processes may capture the same program at once, so write to a
+    * private file and move it into place.
+    */
+   char *tmp = ralloc_asprintf(buf, "%s.%d.tmp", filename, (int) getpid());
+   FILE *file = fopen(tmp, "w");
+   if (file) {
+      bool ok = fwrite(buf, 1, size, file) == size;
+
+      if (fclose(file) == 0 && ok && rename(tmp, filename) == 0) {
+         ralloc_free(buf);
+         return;
+      }
+      unlink(tmp);
+   }
+
+   _mesa_warning(ctx, "Failed to write %s", filename);
+   ralloc_free(buf);
+}
@@ -32,6 +32,20 @@ shader_cache_write_program_metadata(struct gl_context *ctx,
 
 bool
 shader_cache_read_program_metadata(struct gl_context *ctx,
-                                   struct gl_shader_program *prog);
+                                   struct gl_shader_program *prog,
+                                   GLbitfield glsl_flags);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void
+shader_cache_capture_program(struct gl_context *ctx,
+                             struct gl_shader_program *prog,
+                             const char *path);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* GLSL_SYMBOL_TABLE */
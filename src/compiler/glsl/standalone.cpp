@@ -381,7 +381,7 @@ compile_shader(struct gl_context *ctx, struct gl_shader *shader)
       new(shader) _mesa_glsl_parse_state(ctx, shader->Stage, shader);
 
    _mesa_glsl_compile_shader(ctx, shader, options->dump_ast,
-                             options->dump_hir, true);
+                             options->dump_hir, true, ctx->_Shader->Flags);
 
    /* Print out the resulting IR */
    if (!state->error && options->dump_lir) {
@@ -506,7 +506,7 @@ standalone_compile_shader(const struct standalone_options *_options,
       _mesa_clear_shader_program_data(ctx, whole_program);
 
       if (options->do_link)  {
-         link_shaders(ctx, whole_program);
+         link_shaders(ctx, whole_program, ctx->_Shader->Flags);
       } else {
          const gl_shader_stage stage = whole_program->Shaders[0]->Stage;
 
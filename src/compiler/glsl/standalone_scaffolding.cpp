@@ -32,6 +32,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
+#include "program/program.h"
 #include "util/ralloc.h"
 #include "util/strtod.h"
 
@@ -126,6 +127,23 @@ _mesa_delete_linked_shader(struct gl_context *ctx,
    ralloc_free(sh);
 }
 
+struct gl_program *
+_mesa_new_linked_program(struct gl_context *ctx,
+                         struct gl_shader_program *shProg,
+                         gl_shader_stage stage)
+{
+   return ctx->Driver.NewProgram(ctx, _mesa_shader_stage_to_program(stage),
+                                 shProg->Name, false);
+}
+
+void
+_mesa_discard_linked_shader(struct gl_context *ctx,
+                            struct gl_shader_program *shProg,
+                            struct gl_linked_shader *sh)
+{
+   _mesa_delete_linked_shader(ctx, sh);
+}
+
 void
 _mesa_clear_shader_program_data(struct gl_context *ctx,
                                 struct gl_shader_program *shProg)
@@ -165,6 +183,9 @@ void initialize_context_to_defaults(struct gl_context *ctx, gl_api api)
 
    ctx->API = api;
 
+   /* The compiler and linker check ctx->_Shader->Flags */
+   ctx->_Shader = &ctx->Shader;
+
    ctx->Extensions.dummy_false = false;
    ctx->Extensions.dummy_true = true;
    ctx->Extensions.ARB_compute_shader = true;
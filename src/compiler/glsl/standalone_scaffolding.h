@@ -60,6 +60,16 @@ extern "C" void
 _mesa_delete_linked_shader(struct gl_context *ctx,
                            struct gl_linked_shader *sh);
 
+extern "C" struct gl_program *
+_mesa_new_linked_program(struct gl_context *ctx,
+                         struct gl_shader_program *shProg,
+                         gl_shader_stage stage);
+
+extern "C" void
+_mesa_discard_linked_shader(struct gl_context *ctx,
+                            struct gl_shader_program *shProg,
+                            struct gl_linked_shader *sh);
+
 extern "C" void
 _mesa_clear_shader_program_data(struct gl_context *ctx,
                                 struct gl_shader_program *);
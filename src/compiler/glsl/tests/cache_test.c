@@ -477,6 +477,211 @@ test_put_key_and_get_key(void)
 
    disk_cache_destroy(cache);
 }
+
+/* Fills a buffer with bytes that don't compress. */
+static void
+fill_random(uint8_t *data, size_t size, uint32_t seed)
+{
+   for (size_t i = 0; i < size; i++) {
+      seed = seed * 1103515245 + 12345;
+      data[i] = seed >> 16;
+   }
+}
+
+static void
+test_pack_put_and_get(void)
+{
+   struct disk_cache *cache, *other;
+   char blob[] = "This is a blob of thirty-seven bytes";
+   uint8_t blob_key[20];
+   uint8_t *zeros, *random, *big[3];
+   uint8_t zeros_key[20], random_key[20], big_key[3][20];
+   cache_key keys[3];
+   const void *mapped;
+   char *result;
+   size_t size;
+   int count, i;
+
+   setenv("MESA_GLSL_CACHE_PACK", "true", 1);
+   setenv("MESA_GLSL_CACHE_MAX_SIZE", "1M", 1);
+   cache = disk_cache_create("test", "make_check", 0);
+   expect_non_null(cache, "disk_cache_create with MESA_GLSL_CACHE_PACK set");
+
+   zeros = calloc(1, 4096);
+   random = malloc(16384);
+   fill_random(random, 16384, 1);
+
+   disk_cache_compute_key(cache, blob, sizeof(blob), blob_key);
+   disk_cache_compute_key(cache, zeros, 4096, zeros_key);
+   disk_cache_compute_key(cache, random, 16384, random_key);
+
+   const void *data[] = { blob, zeros, random };
+   const size_t sizes[] = { sizeof(blob), 4096, 16384 };
+   disk_cache_compute_keys(cache, 3, data, sizes, keys);
+   expect_true(memcmp(keys[0], blob_key, 20) == 0 &&
+               memcmp(keys[1], zeros_key, 20) == 0 &&
+               memcmp(keys[2], random_key, 20) == 0,
+               "disk_cache_compute_keys matches disk_cache_compute_key");
+
+   result = disk_cache_get(cache, blob_key, &size);
+   expect_null(result, "pack get with non-existent item (pointer)");
+   expect_equal(size, 0, "pack get with non-existent item (size)");
+
+   disk_cache_put(cache, blob_key, blob, sizeof(blob), NULL);
+   disk_cache_put(cache, zeros_key, zeros, 4096, NULL);
+   disk_cache_put(cache, random_key, random, 16384, NULL);
+   wait_until_file_written(cache, blob_key);
+   wait_until_file_written(cache, zeros_key);
+   wait_until_file_written(cache, random_key);
+
+   result = disk_cache_get(cache, blob_key, &size);
+   expect_equal_str(blob, result, "pack get of existing item (pointer)");
+   expect_equal(size, sizeof(blob), "pack get of existing item (size)");
+   free(result);
+
+   result = disk_cache_get(cache, zeros_key, &size);
+   expect_true(result && memcmp(result, zeros, 4096) == 0,
+               "pack get of compressed item (pointer)");
+   expect_equal(size, 4096, "pack get of compressed item (size)");
+   free(result);
+
+   /* Only items that are stored uncompressed can be mapped */
+   mapped = disk_cache_get_mapped(cache, zeros_key, &size);
+   expect_null((void *) mapped, "pack get_mapped of compressed item");
+
+   mapped = disk_cache_get_mapped(cache, random_key, &size);
+   expect_true(mapped && memcmp(mapped, random, 16384) == 0,
+               "pack get_mapped of uncompressed item (pointer)");
+   expect_equal(size, 16384, "pack get_mapped of uncompressed item (size)");
+
+   /* A second cache object finds the items through the shared index */
+   other = disk_cache_create("test", "make_check", 0);
+   expect_true(does_cache_contain(other, random_key),
+               "pack get through a second cache object");
+
+   disk_cache_remove(cache, blob_key);
+   expect_true(!does_cache_contain(cache, blob_key), "pack remove");
+   expect_true(!does_cache_contain(other, blob_key),
+               "pack remove seen by a second cache object");
+
+   /* Compaction replaces the files, but mapped items stay valid and both
+    * cache objects keep finding the other items.
+    */
+   disk_cache_compact(cache);
+   expect_true(memcmp(mapped, random, 16384) == 0,
+               "pack get_mapped pointer after compaction");
+   expect_true(does_cache_contain(cache, random_key) &&
+               does_cache_contain(cache, zeros_key) &&
+               !does_cache_contain(cache, blob_key),
+               "pack items after compaction");
+   expect_true(does_cache_contain(other, random_key),
+               "pack items after compaction through a second cache object");
+
+   disk_cache_destroy(other);
+   disk_cache_destroy(cache);
+
+   /* Adding an item that doesn't fit evicts the oldest ones. Start with an
+    * empty pack for that.
+    */
+   setenv("MESA_GLSL_CACHE_DIR", CACHE_TEST_TMP "/mesa-glsl-pack-eviction", 1);
+   setenv("MESA_GLSL_CACHE_MAX_SIZE", "64K", 1);
+   cache = disk_cache_create("test", "make_check", 0);
+
+   for (i = 0; i < 3; i++) {
+      big[i] = malloc(24 * 1024);
+      fill_random(big[i], 24 * 1024, i + 2);
+      disk_cache_compute_key(cache, big[i], 24 * 1024, big_key[i]);
+      disk_cache_put(cache, big_key[i], big[i], 24 * 1024, NULL);
+      wait_until_file_written(cache, big_key[i]);
+      free(big[i]);
+   }
+
+   count = 0;
+   for (i = 0; i < 3; i++) {
+      if (does_cache_contain(cache, big_key[i]))
+         count++;
+   }
+
+   expect_true(does_cache_contain(cache, big_key[2]),
+               "pack eviction keeps the last item");
+   expect_equal(count, 1, "pack eviction with MAX_SIZE=64K");
+
+   disk_cache_destroy(cache);
+
+   free(zeros);
+   free(random);
+   unsetenv("MESA_GLSL_CACHE_PACK");
+}
+
+static void
+test_compression_and_prefetch(void)
+{
+   static const char *codecs[] = { "none", "deflate:9", "zstd", "default" };
+   struct disk_cache *cache;
+   uint8_t *zeros, *random;
+   uint8_t zeros_key[20], random_key[20], missing_key[20];
+   char *result;
+   size_t size;
+   unsigned i;
+
+   setenv("MESA_GLSL_CACHE_DIR", CACHE_TEST_TMP "/mesa-glsl-compression", 1);
+   setenv("MESA_GLSL_CACHE_MAX_SIZE", "1M", 1);
+
+   zeros = calloc(1, 4096);
+   random = malloc(4096);
+   fill_random(random, 4096, 42);
+
+   for (i = 0; i < sizeof(codecs) / sizeof(codecs[0]); i++) {
+      /* Entries written with one codec are read back with any other */
+      if (strcmp(codecs[i], "default") == 0)
+         unsetenv("MESA_GLSL_CACHE_COMPRESSION");
+      else
+         setenv("MESA_GLSL_CACHE_COMPRESSION", codecs[i], 1);
+
+      cache = disk_cache_create("test", "make_check", 0);
+
+      disk_cache_compute_key(cache, zeros, 4096, zeros_key);
+      zeros_key[19] = i;
+      disk_cache_compute_key(cache, random, 4096, random_key);
+      random_key[19] = i;
+
+      disk_cache_put(cache, zeros_key, zeros, 4096, NULL);
+      disk_cache_put(cache, random_key, random, 4096, NULL);
+      wait_until_file_written(cache, zeros_key);
+      wait_until_file_written(cache, random_key);
+
+      disk_cache_destroy(cache);
+
+      cache = disk_cache_create("test", "make_check", 0);
+
+      result = disk_cache_get(cache, zeros_key, &size);
+      expect_true(result && size == 4096 && memcmp(result, zeros, 4096) == 0,
+                  "get of item written with each codec");
+      free(result);
+
+      /* Prefetched items come back from memory */
+      disk_cache_prefetch(cache, random_key);
+      disk_cache_prefetch(cache, random_key);
+      result = disk_cache_get(cache, random_key, &size);
+      expect_true(result && size == 4096 && memcmp(result, random, 4096) == 0,
+                  "get of prefetched item");
+      free(result);
+
+      memset(missing_key, i + 1, sizeof(missing_key));
+      disk_cache_prefetch(cache, missing_key);
+      result = disk_cache_get(cache, missing_key, &size);
+      expect_null(result, "get of prefetched missing item (pointer)");
+      expect_equal(size, 0, "get of prefetched missing item (size)");
+
+      /* Prefetches that are never picked up are freed with the cache */
+      disk_cache_prefetch(cache, zeros_key);
+      disk_cache_destroy(cache);
+   }
+
+   unsetenv("MESA_GLSL_CACHE_COMPRESSION");
+   free(zeros);
+   free(random);
+}
 #endif /* ENABLE_SHADER_CACHE */
 
 int
@@ -491,6 +696,10 @@ main(void)
 
    test_put_key_and_get_key();
 
+   test_pack_put_and_get();
+
+   test_compression_and_prefetch();
+
    err = rmrf_local(CACHE_TEST_TMP);
    expect_equal(err, 0, "Removing " CACHE_TEST_TMP " again");
 #endif /* ENABLE_SHADER_CACHE */
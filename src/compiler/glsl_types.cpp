@@ -26,25 +26,254 @@
 #include "compiler/glsl/glsl_parser_extras.h"
 #include "glsl_types.h"
 #include "util/hash_table.h"
+#include "util/u_atomic.h"
+#include "compiler/glsl/blob.h"
 
 
 mtx_t glsl_type::mem_mutex = _MTX_INITIALIZER_NP;
-mtx_t glsl_type::hash_mutex = _MTX_INITIALIZER_NP;
-hash_table *glsl_type::array_types = NULL;
-hash_table *glsl_type::record_types = NULL;
-hash_table *glsl_type::interface_types = NULL;
-hash_table *glsl_type::function_types = NULL;
-hash_table *glsl_type::subroutine_types = NULL;
 void *glsl_type::mem_ctx = NULL;
 
-void
-glsl_type::init_ralloc_type_ctx(void)
+/**
+ * \name Per-thread allocation of types
+ *
+ * Each thread allocates from its own child context of glsl_type::mem_ctx,
+ * so only creating that context needs glsl_type::mem_mutex.  The contexts
+ * are freed along with glsl_type::mem_ctx, the generation tells a thread
+ * that has its context freed under it to make a new one.
+ */
+/*@{*/
+struct thread_mem_ctx {
+   void *mem_ctx;
+   unsigned generation;
+};
+
+static once_flag thread_mem_ctx_once = ONCE_FLAG_INIT;
+static tss_t thread_mem_ctx_key;
+static unsigned mem_ctx_generation;
+
+static void
+init_thread_mem_ctx_key(void)
 {
-   if (glsl_type::mem_ctx == NULL) {
-      glsl_type::mem_ctx = ralloc_context(NULL);
-      assert(glsl_type::mem_ctx != NULL);
+   tss_create(&thread_mem_ctx_key, free);
+}
+
+void *
+glsl_type::get_thread_mem_ctx(void)
+{
+   call_once(&thread_mem_ctx_once, init_thread_mem_ctx_key);
+
+   struct thread_mem_ctx *tctx =
+      (struct thread_mem_ctx *) tss_get(thread_mem_ctx_key);
+   if (tctx == NULL) {
+      tctx = (struct thread_mem_ctx *) calloc(1, sizeof(*tctx));
+      assert(tctx != NULL);
+      tss_set(thread_mem_ctx_key, tctx);
    }
+
+   if (tctx->mem_ctx == NULL || tctx->generation != mem_ctx_generation) {
+      mtx_lock(&glsl_type::mem_mutex);
+
+      if (glsl_type::mem_ctx == NULL) {
+         glsl_type::mem_ctx = ralloc_context(NULL);
+         assert(glsl_type::mem_ctx != NULL);
+      }
+
+      tctx->mem_ctx = ralloc_context(glsl_type::mem_ctx);
+      tctx->generation = mem_ctx_generation;
+
+      mtx_unlock(&glsl_type::mem_mutex);
+   }
+
+   return tctx->mem_ctx;
 }
+/*@}*/
+
+/**
+ * \name Interning tables for the derived types
+ *
+ * Looking up a type takes no lock.  Each table is split in shards by the
+ * low bits of the hash.  A shard publishes its slot array with a release
+ * store, and a slot's type pointer is written once, after its hash, so a
+ * reader sees either nothing or a complete slot.
+ *
+ * Adding a type takes the lock of its shard only.  When a shard grows, the
+ * old slot array is kept until _mesa_glsl_release_types(), as readers may
+ * still be walking it.  A reader that misses a type because of that looks
+ * again under the lock before creating it.
+ */
+/*@{*/
+#define TYPE_TABLE_SHARD_BITS 4
+#define TYPE_TABLE_SHARDS (1 << TYPE_TABLE_SHARD_BITS)
+
+struct type_table_slot {
+   uint32_t hash;
+   const glsl_type *type;
+};
+
+struct type_table_slots {
+   unsigned size;
+   struct type_table_slot *slot;
+
+   /** The array this one replaced, see above */
+   struct type_table_slots *retired;
+};
+
+struct type_table_shard {
+   mtx_t mutex;
+   struct type_table_slots *slots;
+   unsigned entries;
+};
+
+struct type_table {
+   struct type_table_shard shard[TYPE_TABLE_SHARDS];
+};
+
+typedef bool (*type_key_equal_func)(const glsl_type *type, const void *key);
+
+static struct type_table array_types;
+static struct type_table record_types;
+static struct type_table interface_types;
+static struct type_table function_types;
+static struct type_table subroutine_types;
+
+static struct type_table *const type_tables[] = {
+   &array_types,
+   &record_types,
+   &interface_types,
+   &function_types,
+   &subroutine_types,
+};
+
+static once_flag type_tables_once = ONCE_FLAG_INIT;
+
+static void
+init_type_tables(void)
+{
+   for (unsigned i = 0; i < ARRAY_SIZE(type_tables); i++) {
+      for (unsigned j = 0; j < TYPE_TABLE_SHARDS; j++)
+         mtx_init(&type_tables[i]->shard[j].mutex, mtx_plain);
+   }
+}
+
+static const glsl_type *
+type_table_search_slots(const struct type_table_slots *slots, uint32_t hash,
+                        type_key_equal_func equal, const void *key)
+{
+   if (slots == NULL)
+      return NULL;
+
+   /* At most half of the slots are used, so this hits an empty one */
+   const unsigned mask = slots->size - 1;
+   unsigned i = (hash >> TYPE_TABLE_SHARD_BITS) & mask;
+   for (;; i = (i + 1) & mask) {
+      const glsl_type *type = p_atomic_read(&slots->slot[i].type);
+      if (type == NULL)
+         return NULL;
+
+      if (slots->slot[i].hash == hash && equal(type, key))
+         return type;
+   }
+}
+
+static void
+type_table_slots_add(struct type_table_slots *slots, uint32_t hash,
+                     const glsl_type *type)
+{
+   const unsigned mask = slots->size - 1;
+   unsigned i = (hash >> TYPE_TABLE_SHARD_BITS) & mask;
+   while (slots->slot[i].type != NULL)
+      i = (i + 1) & mask;
+
+   slots->slot[i].hash = hash;
+   p_atomic_set(&slots->slot[i].type, type);
+}
+
+/**
+ * Find the type matching \p key.
+ *
+ * If there is none, the shard the type belongs in is returned in \p shard,
+ * locked.  The caller must then create the type and hand it to
+ * type_table_insert(), which unlocks the shard.
+ */
+static const glsl_type *
+type_table_lookup(struct type_table *table, uint32_t hash,
+                  type_key_equal_func equal, const void *key,
+                  struct type_table_shard **shard)
+{
+   struct type_table_shard *s = &table->shard[hash & (TYPE_TABLE_SHARDS - 1)];
+
+   const glsl_type *type =
+      type_table_search_slots(p_atomic_read(&s->slots), hash, equal, key);
+   if (type != NULL)
+      return type;
+
+   call_once(&type_tables_once, init_type_tables);
+   mtx_lock(&s->mutex);
+
+   type = type_table_search_slots(s->slots, hash, equal, key);
+   if (type != NULL) {
+      mtx_unlock(&s->mutex);
+      return type;
+   }
+
+   *shard = s;
+   return NULL;
+}
+
+static void
+type_table_insert(struct type_table_shard *shard, uint32_t hash,
+                  const glsl_type *type)
+{
+   struct type_table_slots *slots = shard->slots;
+
+   if (slots == NULL || (shard->entries + 1) * 2 > slots->size) {
+      struct type_table_slots *grown =
+         (struct type_table_slots *) malloc(sizeof(*grown));
+      assert(grown != NULL);
+
+      grown->size = slots != NULL ? slots->size * 2 : 16;
+      grown->slot = (struct type_table_slot *)
+         calloc(grown->size, sizeof(*grown->slot));
+      assert(grown->slot != NULL);
+      grown->retired = slots;
+
+      if (slots != NULL) {
+         for (unsigned i = 0; i < slots->size; i++) {
+            if (slots->slot[i].type != NULL) {
+               type_table_slots_add(grown, slots->slot[i].hash,
+                                    slots->slot[i].type);
+            }
+         }
+      }
+
+      p_atomic_set(&shard->slots, grown);
+      slots = grown;
+   }
+
+   type_table_slots_add(slots, hash, type);
+   shard->entries++;
+
+   mtx_unlock(&shard->mutex);
+}
+
+static void
+type_table_release(struct type_table *table)
+{
+   for (unsigned i = 0; i < TYPE_TABLE_SHARDS; i++) {
+      struct type_table_slots *slots = table->shard[i].slots;
+
+      while (slots != NULL) {
+         struct type_table_slots *retired = slots->retired;
+         free(slots->slot);
+         free(slots);
+         slots = retired;
+      }
+
+      table->shard[i].slots = NULL;
+      table->shard[i].entries = 0;
+   }
+}
+/*@}*/
 
 glsl_type::glsl_type(GLenum gl_type,
                      glsl_base_type base_type, unsigned vector_elements,
@@ -63,13 +292,8 @@ glsl_type::glsl_type(GLenum gl_type,
    STATIC_ASSERT((unsigned(GLSL_TYPE_INT)   & 3) == unsigned(GLSL_TYPE_INT));
    STATIC_ASSERT((unsigned(GLSL_TYPE_FLOAT) & 3) == unsigned(GLSL_TYPE_FLOAT));
 
-   mtx_lock(&glsl_type::mem_mutex);
-
-   init_ralloc_type_ctx();
    assert(name != NULL);
-   this->name = ralloc_strdup(this->mem_ctx, name);
-
-   mtx_unlock(&glsl_type::mem_mutex);
+   this->name = ralloc_strdup(get_thread_mem_ctx(), name);
 
    /* Neither dimension is zero or both dimensions are zero.
     */
@@ -86,13 +310,8 @@ glsl_type::glsl_type(GLenum gl_type, glsl_base_type base_type,
    sampler_array(array), sampled_type(type), interface_packing(0),
    interface_row_major(0), length(0)
 {
-   mtx_lock(&glsl_type::mem_mutex);
-
-   init_ralloc_type_ctx();
    assert(name != NULL);
-   this->name = ralloc_strdup(this->mem_ctx, name);
-
-   mtx_unlock(&glsl_type::mem_mutex);
+   this->name = ralloc_strdup(get_thread_mem_ctx(), name);
 
    memset(& fields, 0, sizeof(fields));
 
@@ -110,12 +329,11 @@ glsl_type::glsl_type(const glsl_struct_field *fields, unsigned num_fields,
 {
    unsigned int i;
 
-   mtx_lock(&glsl_type::mem_mutex);
+   void *mem_ctx = get_thread_mem_ctx();
 
-   init_ralloc_type_ctx();
    assert(name != NULL);
-   this->name = ralloc_strdup(this->mem_ctx, name);
-   this->fields.structure = ralloc_array(this->mem_ctx,
+   this->name = ralloc_strdup(mem_ctx, name);
+   this->fields.structure = ralloc_array(mem_ctx,
                                          glsl_struct_field, length);
 
    for (i = 0; i < length; i++) {
@@ -123,8 +341,6 @@ glsl_type::glsl_type(const glsl_struct_field *fields, unsigned num_fields,
       this->fields.structure[i].name = ralloc_strdup(this->fields.structure,
                                                      fields[i].name);
    }
-
-   mtx_unlock(&glsl_type::mem_mutex);
 }
 
 glsl_type::glsl_type(const glsl_struct_field *fields, unsigned num_fields,
@@ -140,20 +356,17 @@ glsl_type::glsl_type(const glsl_struct_field *fields, unsigned num_fields,
 {
    unsigned int i;
 
-   mtx_lock(&glsl_type::mem_mutex);
+   void *mem_ctx = get_thread_mem_ctx();
 
-   init_ralloc_type_ctx();
    assert(name != NULL);
-   this->name = ralloc_strdup(this->mem_ctx, name);
-   this->fields.structure = rzalloc_array(this->mem_ctx,
+   this->name = ralloc_strdup(mem_ctx, name);
+   this->fields.structure = rzalloc_array(mem_ctx,
                                           glsl_struct_field, length);
    for (i = 0; i < length; i++) {
       this->fields.structure[i] = fields[i];
       this->fields.structure[i].name = ralloc_strdup(this->fields.structure,
                                                      fields[i].name);
    }
-
-   mtx_unlock(&glsl_type::mem_mutex);
 }
 
 glsl_type::glsl_type(const glsl_type *return_type,
@@ -167,11 +380,7 @@ glsl_type::glsl_type(const glsl_type *return_type,
 {
    unsigned int i;
 
-   mtx_lock(&glsl_type::mem_mutex);
-
-   init_ralloc_type_ctx();
-
-   this->fields.parameters = rzalloc_array(this->mem_ctx,
+   this->fields.parameters = rzalloc_array(get_thread_mem_ctx(),
                                            glsl_function_param, num_params + 1);
 
    /* We store the return type as the first parameter */
@@ -185,8 +394,6 @@ glsl_type::glsl_type(const glsl_type *return_type,
       this->fields.parameters[i + 1].in = params[i].in;
       this->fields.parameters[i + 1].out = params[i].out;
    }
-
-   mtx_unlock(&glsl_type::mem_mutex);
 }
 
 glsl_type::glsl_type(const char *subroutine_name) :
@@ -197,12 +404,8 @@ glsl_type::glsl_type(const char *subroutine_name) :
    vector_elements(1), matrix_columns(1),
    length(0)
 {
-   mtx_lock(&glsl_type::mem_mutex);
-
-   init_ralloc_type_ctx();
    assert(subroutine_name != NULL);
-   this->name = ralloc_strdup(this->mem_ctx, subroutine_name);
-   mtx_unlock(&glsl_type::mem_mutex);
+   this->name = ralloc_strdup(get_thread_mem_ctx(), subroutine_name);
 }
 
 bool
@@ -411,33 +614,12 @@ _mesa_glsl_release_types(void)
     * object, or if process terminates), so no mutex-locking should be
     * necessary.
     */
-   if (glsl_type::array_types != NULL) {
-      _mesa_hash_table_destroy(glsl_type::array_types, NULL);
-      glsl_type::array_types = NULL;
-   }
-
-   if (glsl_type::record_types != NULL) {
-      _mesa_hash_table_destroy(glsl_type::record_types, NULL);
-      glsl_type::record_types = NULL;
-   }
-
-   if (glsl_type::interface_types != NULL) {
-      _mesa_hash_table_destroy(glsl_type::interface_types, NULL);
-      glsl_type::interface_types = NULL;
-   }
-
-   if (glsl_type::function_types != NULL) {
-      _mesa_hash_table_destroy(glsl_type::function_types, NULL);
-      glsl_type::function_types = NULL;
-   }
-
-   if (glsl_type::subroutine_types != NULL) {
-      _mesa_hash_table_destroy(glsl_type::subroutine_types, NULL);
-      glsl_type::subroutine_types = NULL;
-   }
+   for (unsigned i = 0; i < ARRAY_SIZE(type_tables); i++)
+      type_table_release(type_tables[i]);
 
    ralloc_free(glsl_type::mem_ctx);
    glsl_type::mem_ctx = NULL;
+   mem_ctx_generation++;
 }
 
 
@@ -461,9 +643,7 @@ glsl_type::glsl_type(const glsl_type *array, unsigned length) :
     */
    const unsigned name_length = strlen(array->name) + 10 + 3;
 
-   mtx_lock(&glsl_type::mem_mutex);
-   char *const n = (char *) ralloc_size(this->mem_ctx, name_length);
-   mtx_unlock(&glsl_type::mem_mutex);
+   char *const n = (char *) ralloc_size(get_thread_mem_ctx(), name_length);
 
    if (length == 0)
       snprintf(n, name_length, "%s[]", array->name);
@@ -872,121 +1052,89 @@ glsl_type::get_image_instance(enum glsl_sampler_dim dim,
    unreachable("switch statement above should be complete");
 }
 
+struct array_type_key {
+   const glsl_type *base;
+   unsigned length;
+};
+
+static bool
+array_type_key_equal(const glsl_type *type, const void *key)
+{
+   const struct array_type_key *k = (const struct array_type_key *) key;
+   return type->fields.array == k->base && type->length == k->length;
+}
+
 const glsl_type *
 glsl_type::get_array_instance(const glsl_type *base, unsigned array_size)
 {
-   /* Generate a name using the base type pointer in the key.  This is
+   /* The key uses the base type pointer rather than its name.  This is
     * done because the name of the base type may not be unique across
     * shaders.  For example, two shaders may have different record types
     * named 'foo'.
     */
-   char key[128];
-   snprintf(key, sizeof(key), "%p[%u]", (void *) base, array_size);
-
-   mtx_lock(&glsl_type::hash_mutex);
-
-   if (array_types == NULL) {
-      array_types = _mesa_hash_table_create(NULL, _mesa_key_hash_string,
-                                            _mesa_key_string_equal);
+   const struct array_type_key key = { base, array_size };
+   uint32_t hash = _mesa_fnv32_1a_offset_bias;
+   hash = _mesa_fnv32_1a_accumulate(hash, key.base);
+   hash = _mesa_fnv32_1a_accumulate(hash, key.length);
+
+   struct type_table_shard *shard;
+   const glsl_type *t = type_table_lookup(&array_types, hash,
+                                          array_type_key_equal, &key, &shard);
+   if (t == NULL) {
+      t = new glsl_type(base, array_size);
+      type_table_insert(shard, hash, t);
    }
 
-   const struct hash_entry *entry = _mesa_hash_table_search(array_types, key);
-   if (entry == NULL) {
-      const glsl_type *t = new glsl_type(base, array_size);
-
-      entry = _mesa_hash_table_insert(array_types,
-                                      ralloc_strdup(mem_ctx, key),
-                                      (void *) t);
-   }
-
-   assert(((glsl_type *) entry->data)->base_type == GLSL_TYPE_ARRAY);
-   assert(((glsl_type *) entry->data)->length == array_size);
-   assert(((glsl_type *) entry->data)->fields.array == base);
-
-   mtx_unlock(&glsl_type::hash_mutex);
+   assert(t->base_type == GLSL_TYPE_ARRAY);
+   assert(t->length == array_size);
+   assert(t->fields.array == base);
 
-   return (glsl_type *) entry->data;
+   return t;
 }
 
 
-bool
-glsl_type::record_compare(const glsl_type *b, bool match_locations) const
+static bool
+record_fields_equal(const glsl_struct_field *a, const glsl_struct_field *b,
+                    unsigned length, bool match_locations)
 {
-   if (this->length != b->length)
-      return false;
-
-   if (this->interface_packing != b->interface_packing)
-      return false;
-
-   if (this->interface_row_major != b->interface_row_major)
-      return false;
-
-   /* From the GLSL 4.20 specification (Sec 4.2):
-    *
-    *     "Structures must have the same name, sequence of type names, and
-    *     type definitions, and field names to be considered the same type."
-    *
-    * GLSL ES behaves the same (Ver 1.00 Sec 4.2.4, Ver 3.00 Sec 4.2.5).
-    */
-   if (strcmp(this->name, b->name) != 0)
-      return false;
-
-   for (unsigned i = 0; i < this->length; i++) {
-      if (this->fields.structure[i].type != b->fields.structure[i].type)
+   for (unsigned i = 0; i < length; i++) {
+      if (a[i].type != b[i].type)
          return false;
-      if (strcmp(this->fields.structure[i].name,
-                 b->fields.structure[i].name) != 0)
+      if (strcmp(a[i].name, b[i].name) != 0)
          return false;
-      if (this->fields.structure[i].matrix_layout
-         != b->fields.structure[i].matrix_layout)
-        return false;
-      if (match_locations && this->fields.structure[i].location
-          != b->fields.structure[i].location)
+      if (a[i].matrix_layout != b[i].matrix_layout)
          return false;
-      if (this->fields.structure[i].offset
-          != b->fields.structure[i].offset)
+      if (match_locations && a[i].location != b[i].location)
          return false;
-      if (this->fields.structure[i].interpolation
-          != b->fields.structure[i].interpolation)
+      if (a[i].offset != b[i].offset)
          return false;
-      if (this->fields.structure[i].centroid
-          != b->fields.structure[i].centroid)
+      if (a[i].interpolation != b[i].interpolation)
          return false;
-      if (this->fields.structure[i].sample
-          != b->fields.structure[i].sample)
+      if (a[i].centroid != b[i].centroid)
          return false;
-      if (this->fields.structure[i].patch
-          != b->fields.structure[i].patch)
+      if (a[i].sample != b[i].sample)
          return false;
-      if (this->fields.structure[i].memory_read_only
-          != b->fields.structure[i].memory_read_only)
+      if (a[i].patch != b[i].patch)
          return false;
-      if (this->fields.structure[i].memory_write_only
-          != b->fields.structure[i].memory_write_only)
+      if (a[i].memory_read_only != b[i].memory_read_only)
          return false;
-      if (this->fields.structure[i].memory_coherent
-          != b->fields.structure[i].memory_coherent)
+      if (a[i].memory_write_only != b[i].memory_write_only)
          return false;
-      if (this->fields.structure[i].memory_volatile
-          != b->fields.structure[i].memory_volatile)
+      if (a[i].memory_coherent != b[i].memory_coherent)
          return false;
-      if (this->fields.structure[i].memory_restrict
-          != b->fields.structure[i].memory_restrict)
+      if (a[i].memory_volatile != b[i].memory_volatile)
          return false;
-      if (this->fields.structure[i].image_format
-          != b->fields.structure[i].image_format)
+      if (a[i].memory_restrict != b[i].memory_restrict)
          return false;
-      if (this->fields.structure[i].precision
-          != b->fields.structure[i].precision)
+      if (a[i].image_format != b[i].image_format)
          return false;
-      if (this->fields.structure[i].explicit_xfb_buffer
-          != b->fields.structure[i].explicit_xfb_buffer)
+      if (a[i].precision != b[i].precision)
          return false;
-      if (this->fields.structure[i].xfb_buffer
-          != b->fields.structure[i].xfb_buffer)
+      if (a[i].explicit_xfb_buffer != b[i].explicit_xfb_buffer)
          return false;
-      if (this->fields.structure[i].xfb_stride
-          != b->fields.structure[i].xfb_stride)
+      if (a[i].xfb_buffer != b[i].xfb_buffer)
+         return false;
+      if (a[i].xfb_stride != b[i].xfb_stride)
          return false;
    }
 
@@ -995,36 +1143,71 @@ glsl_type::record_compare(const glsl_type *b, bool match_locations) const
 
 
 bool
-glsl_type::record_key_compare(const void *a, const void *b)
+glsl_type::record_compare(const glsl_type *b, bool match_locations) const
 {
-   const glsl_type *const key1 = (glsl_type *) a;
-   const glsl_type *const key2 = (glsl_type *) b;
+   if (this->length != b->length)
+      return false;
+
+   if (this->interface_packing != b->interface_packing)
+      return false;
+
+   if (this->interface_row_major != b->interface_row_major)
+      return false;
+
+   /* From the GLSL 4.20 specification (Sec 4.2):
+    *
+    *     "Structures must have the same name, sequence of type names, and
+    *     type definitions, and field names to be considered the same type."
+    *
+    * GLSL ES behaves the same (Ver 1.00 Sec 4.2.4, Ver 3.00 Sec 4.2.5).
+    */
+   if (strcmp(this->name, b->name) != 0)
+      return false;
 
-   return strcmp(key1->name, key2->name) == 0 && key1->record_compare(key2);
+   return record_fields_equal(this->fields.structure, b->fields.structure,
+                              this->length, match_locations);
 }
 
 
 /**
- * Generate an integer hash value for a glsl_type structure type.
+ * Key for looking up record and interface types, without creating one.
  */
-unsigned
-glsl_type::record_key_hash(const void *a)
+struct record_type_key {
+   const glsl_struct_field *fields;
+   unsigned length;
+   unsigned packing;
+   bool row_major;
+   const char *name;
+};
+
+static bool
+record_type_key_equal(const glsl_type *type, const void *key)
 {
-   const glsl_type *const key = (glsl_type *) a;
-   uintptr_t hash = key->length;
-   unsigned retval;
+   const struct record_type_key *k = (const struct record_type_key *) key;
+
+   return type->length == k->length &&
+          type->interface_packing == k->packing &&
+          type->interface_row_major == (unsigned) k->row_major &&
+          strcmp(type->name, k->name) == 0 &&
+          record_fields_equal(type->fields.structure, k->fields, k->length,
+                              true);
+}
 
-   for (unsigned i = 0; i < key->length; i++) {
-      /* casting pointer to uintptr_t */
-      hash = (hash * 13 ) + (uintptr_t) key->fields.structure[i].type;
-   }
 
-   if (sizeof(hash) == 8)
-      retval = (hash & 0xffffffff) ^ ((uint64_t) hash >> 32);
-   else
-      retval = hash;
+/**
+ * Generate an integer hash value for a record or interface type.
+ */
+static uint32_t
+record_type_key_hash(const struct record_type_key *key)
+{
+   uint32_t hash = _mesa_fnv32_1a_offset_bias;
 
-   return retval;
+   hash = _mesa_fnv32_1a_accumulate(hash, key->length);
+   for (unsigned i = 0; i < key->length; i++)
+      hash = _mesa_fnv32_1a_accumulate(hash, key->fields[i].type);
+
+   return _mesa_fnv32_1a_accumulate_block(hash, key->name,
+                                          strlen(key->name));
 }
 
 
@@ -1033,30 +1216,23 @@ glsl_type::get_record_instance(const glsl_struct_field *fields,
                                unsigned num_fields,
                                const char *name)
 {
-   const glsl_type key(fields, num_fields, name);
-
-   mtx_lock(&glsl_type::hash_mutex);
-
-   if (record_types == NULL) {
-      record_types = _mesa_hash_table_create(NULL, record_key_hash,
-                                             record_key_compare);
+   const struct record_type_key key = { fields, num_fields, 0, false, name };
+   const uint32_t hash = record_type_key_hash(&key);
+
+   struct type_table_shard *shard;
+   const glsl_type *t = type_table_lookup(&record_types, hash,
+                                          record_type_key_equal, &key,
+                                          &shard);
+   if (t == NULL) {
+      t = new glsl_type(fields, num_fields, name);
+      type_table_insert(shard, hash, t);
    }
 
-   const struct hash_entry *entry = _mesa_hash_table_search(record_types,
-                                                            &key);
-   if (entry == NULL) {
-      const glsl_type *t = new glsl_type(fields, num_fields, name);
+   assert(t->base_type == GLSL_TYPE_STRUCT);
+   assert(t->length == num_fields);
+   assert(strcmp(t->name, name) == 0);
 
-      entry = _mesa_hash_table_insert(record_types, t, (void *) t);
-   }
-
-   assert(((glsl_type *) entry->data)->base_type == GLSL_TYPE_STRUCT);
-   assert(((glsl_type *) entry->data)->length == num_fields);
-   assert(strcmp(((glsl_type *) entry->data)->name, name) == 0);
-
-   mtx_unlock(&glsl_type::hash_mutex);
-
-   return (glsl_type *) entry->data;
+   return t;
 }
 
 
@@ -1067,82 +1243,96 @@ glsl_type::get_interface_instance(const glsl_struct_field *fields,
                                   bool row_major,
                                   const char *block_name)
 {
-   const glsl_type key(fields, num_fields, packing, row_major, block_name);
-
-   mtx_lock(&glsl_type::hash_mutex);
-
-   if (interface_types == NULL) {
-      interface_types = _mesa_hash_table_create(NULL, record_key_hash,
-                                                record_key_compare);
-   }
-
-   const struct hash_entry *entry = _mesa_hash_table_search(interface_types,
-                                                            &key);
-   if (entry == NULL) {
-      const glsl_type *t = new glsl_type(fields, num_fields,
-                                         packing, row_major, block_name);
-
-      entry = _mesa_hash_table_insert(interface_types, t, (void *) t);
+   const struct record_type_key key = {
+      fields, num_fields, (unsigned) packing, row_major, block_name
+   };
+   const uint32_t hash = record_type_key_hash(&key);
+
+   struct type_table_shard *shard;
+   const glsl_type *t = type_table_lookup(&interface_types, hash,
+                                          record_type_key_equal, &key,
+                                          &shard);
+   if (t == NULL) {
+      t = new glsl_type(fields, num_fields, packing, row_major, block_name);
+      type_table_insert(shard, hash, t);
    }
 
-   assert(((glsl_type *) entry->data)->base_type == GLSL_TYPE_INTERFACE);
-   assert(((glsl_type *) entry->data)->length == num_fields);
-   assert(strcmp(((glsl_type *) entry->data)->name, block_name) == 0);
+   assert(t->base_type == GLSL_TYPE_INTERFACE);
+   assert(t->length == num_fields);
+   assert(strcmp(t->name, block_name) == 0);
 
-   mtx_unlock(&glsl_type::hash_mutex);
+   return t;
+}
 
-   return (glsl_type *) entry->data;
+static bool
+subroutine_type_key_equal(const glsl_type *type, const void *key)
+{
+   return strcmp(type->name, (const char *) key) == 0;
 }
 
 const glsl_type *
 glsl_type::get_subroutine_instance(const char *subroutine_name)
 {
-   const glsl_type key(subroutine_name);
-
-   mtx_lock(&glsl_type::hash_mutex);
-
-   if (subroutine_types == NULL) {
-      subroutine_types = _mesa_hash_table_create(NULL, record_key_hash,
-                                                 record_key_compare);
+   const uint32_t hash = _mesa_key_hash_string(subroutine_name);
+
+   struct type_table_shard *shard;
+   const glsl_type *t = type_table_lookup(&subroutine_types, hash,
+                                          subroutine_type_key_equal,
+                                          subroutine_name, &shard);
+   if (t == NULL) {
+      t = new glsl_type(subroutine_name);
+      type_table_insert(shard, hash, t);
    }
 
-   const struct hash_entry *entry = _mesa_hash_table_search(subroutine_types,
-                                                            &key);
-   if (entry == NULL) {
-      const glsl_type *t = new glsl_type(subroutine_name);
+   assert(t->base_type == GLSL_TYPE_SUBROUTINE);
+   assert(strcmp(t->name, subroutine_name) == 0);
 
-      entry = _mesa_hash_table_insert(subroutine_types, t, (void *) t);
-   }
-
-   assert(((glsl_type *) entry->data)->base_type == GLSL_TYPE_SUBROUTINE);
-   assert(strcmp(((glsl_type *) entry->data)->name, subroutine_name) == 0);
-
-   mtx_unlock(&glsl_type::hash_mutex);
-
-   return (glsl_type *) entry->data;
+   return t;
 }
 
 
+struct function_type_key {
+   const glsl_type *return_type;
+   const glsl_function_param *params;
+   unsigned num_params;
+};
+
 static bool
-function_key_compare(const void *a, const void *b)
+function_type_key_equal(const glsl_type *type, const void *key)
 {
-   const glsl_type *const key1 = (glsl_type *) a;
-   const glsl_type *const key2 = (glsl_type *) b;
+   const struct function_type_key *k = (const struct function_type_key *) key;
 
-   if (key1->length != key2->length)
+   if (type->length != k->num_params ||
+       type->fields.parameters[0].type != k->return_type)
       return false;
 
-   return memcmp(key1->fields.parameters, key2->fields.parameters,
-                 (key1->length + 1) * sizeof(*key1->fields.parameters)) == 0;
+   /* The return type is stored as the first parameter */
+   for (unsigned i = 0; i < k->num_params; i++) {
+      const glsl_function_param *param = &type->fields.parameters[i + 1];
+      if (param->type != k->params[i].type ||
+          param->in != k->params[i].in ||
+          param->out != k->params[i].out)
+         return false;
+   }
+
+   return true;
 }
 
 
 static uint32_t
-function_key_hash(const void *a)
+function_type_key_hash(const struct function_type_key *key)
 {
-   const glsl_type *const key = (glsl_type *) a;
-   return _mesa_hash_data(key->fields.parameters,
-                          (key->length + 1) * sizeof(*key->fields.parameters));
+   uint32_t hash = _mesa_fnv32_1a_offset_bias;
+
+   hash = _mesa_fnv32_1a_accumulate(hash, key->return_type);
+   hash = _mesa_fnv32_1a_accumulate(hash, key->num_params);
+   for (unsigned i = 0; i < key->num_params; i++) {
+      const uint8_t inout = key->params[i].in | (key->params[i].out << 1);
+      hash = _mesa_fnv32_1a_accumulate(hash, key->params[i].type);
+      hash = _mesa_fnv32_1a_accumulate(hash, inout);
+   }
+
+   return hash;
 }
 
 const glsl_type *
@@ -1150,29 +1340,21 @@ glsl_type::get_function_instance(const glsl_type *return_type,
                                  const glsl_function_param *params,
                                  unsigned num_params)
 {
-   const glsl_type key(return_type, params, num_params);
-
-   mtx_lock(&glsl_type::hash_mutex);
-
-   if (function_types == NULL) {
-      function_types = _mesa_hash_table_create(NULL, function_key_hash,
-                                               function_key_compare);
-   }
-
-   struct hash_entry *entry = _mesa_hash_table_search(function_types, &key);
-   if (entry == NULL) {
-      const glsl_type *t = new glsl_type(return_type, params, num_params);
-
-      entry = _mesa_hash_table_insert(function_types, t, (void *) t);
+   const struct function_type_key key = { return_type, params, num_params };
+   const uint32_t hash = function_type_key_hash(&key);
+
+   struct type_table_shard *shard;
+   const glsl_type *t = type_table_lookup(&function_types, hash,
+                                          function_type_key_equal, &key,
+                                          &shard);
+   if (t == NULL) {
+      t = new glsl_type(return_type, params, num_params);
+      type_table_insert(shard, hash, t);
    }
 
-   const glsl_type *t = (const glsl_type *)entry->data;
-
    assert(t->base_type == GLSL_TYPE_FUNCTION);
    assert(t->length == num_params);
 
-   mtx_unlock(&glsl_type::hash_mutex);
-
    return t;
 }
 
@@ -2052,6 +2234,180 @@ glsl_type::coordinate_components() const
    return size;
 }
 
+static void
+get_struct_type_field_and_pointer_sizes(size_t *s_field_size,
+                                        size_t *s_field_ptrs)
+{
+   *s_field_size = sizeof(glsl_struct_field);
+   *s_field_ptrs =
+     sizeof(((glsl_struct_field *)0)->type) +
+     sizeof(((glsl_struct_field *)0)->name);
+}
+
+void
+encode_type_to_blob(struct blob *blob, const glsl_type *type)
+{
+   uint32_t encoding;
+
+   if (!type) {
+      blob_write_uint32(blob, 0);
+      return;
+   }
+
+   switch (type->base_type) {
+   case GLSL_TYPE_UINT:
+   case GLSL_TYPE_INT:
+   case GLSL_TYPE_FLOAT:
+   case GLSL_TYPE_BOOL:
+   case GLSL_TYPE_DOUBLE:
+   case GLSL_TYPE_UINT64:
+   case GLSL_TYPE_INT64:
+      encoding = (type->base_type << 24) |
+         (type->vector_elements << 4) |
+         (type->matrix_columns);
+      break;
+   case GLSL_TYPE_SAMPLER:
+      encoding = (type->base_type) << 24 |
+         (type->sampler_dimensionality << 4) |
+         (type->sampler_shadow << 3) |
+         (type->sampler_array << 2) |
+         (type->sampled_type);
+      break;
+   case GLSL_TYPE_SUBROUTINE:
+      encoding = type->base_type << 24;
+      blob_write_uint32(blob, encoding);
+      blob_write_string(blob, type->name);
+      return;
+   case GLSL_TYPE_IMAGE:
+      encoding = (type->base_type) << 24 |
+         (type->sampler_dimensionality << 3) |
+         (type->sampler_array << 2) |
+         (type->sampled_type);
+      break;
+   case GLSL_TYPE_ATOMIC_UINT:
+      encoding = (type->base_type << 24);
+      break;
+   case GLSL_TYPE_ARRAY:
+      blob_write_uint32(blob, (type->base_type) << 24);
+      blob_write_uint32(blob, type->length);
+      encode_type_to_blob(blob, type->fields.array);
+      return;
+   case GLSL_TYPE_STRUCT:
+   case GLSL_TYPE_INTERFACE:
+      blob_write_uint32(blob, (type->base_type) << 24);
+      blob_write_string(blob, type->name);
+      blob_write_uint32(blob, type->length);
+
+      size_t s_field_size, s_field_ptrs;
+      get_struct_type_field_and_pointer_sizes(&s_field_size, &s_field_ptrs);
+
+      for (unsigned i = 0; i < type->length; i++) {
+         encode_type_to_blob(blob, type->fields.structure[i].type);
+         blob_write_string(blob, type->fields.structure[i].name);
+
+         /* Write the struct field skipping the pointers */
+         blob_write_bytes(blob,
+                          ((char *)&type->fields.structure[i]) + s_field_ptrs,
+                          s_field_size - s_field_ptrs);
+      }
+
+      if (type->is_interface()) {
+         blob_write_uint32(blob, type->interface_packing);
+         blob_write_uint32(blob, type->interface_row_major);
+      }
+      return;
+   case GLSL_TYPE_VOID:
+      encoding = (type->base_type << 24);
+      break;
+   case GLSL_TYPE_ERROR:
+   default:
+      assert(!"Cannot encode type!");
+      encoding = 0;
+      break;
+   }
+
+   blob_write_uint32(blob, encoding);
+}
+
+const glsl_type *
+decode_type_from_blob(struct blob_reader *blob)
+{
+   uint32_t u = blob_read_uint32(blob);
+
+   if (u == 0) {
+      return NULL;
+   }
+
+   glsl_base_type base_type = (glsl_base_type) (u >> 24);
+
+   switch (base_type) {
+   case GLSL_TYPE_UINT:
+   case GLSL_TYPE_INT:
+   case GLSL_TYPE_FLOAT:
+   case GLSL_TYPE_BOOL:
+   case GLSL_TYPE_DOUBLE:
+   case GLSL_TYPE_UINT64:
+   case GLSL_TYPE_INT64:
+      return glsl_type::get_instance(base_type, (u >> 4) & 0x0f, u & 0x0f);
+   case GLSL_TYPE_SAMPLER:
+      return glsl_type::get_sampler_instance((enum glsl_sampler_dim) ((u >> 4) & 0x07),
+                                             (u >> 3) & 0x01,
+                                             (u >> 2) & 0x01,
+                                             (glsl_base_type) ((u >> 0) & 0x03));
+   case GLSL_TYPE_SUBROUTINE:
+      return glsl_type::get_subroutine_instance(blob_read_string(blob));
+   case GLSL_TYPE_IMAGE:
+      return glsl_type::get_image_instance((enum glsl_sampler_dim) ((u >> 3) & 0x07),
+                                             (u >> 2) & 0x01,
+                                             (glsl_base_type) ((u >> 0) & 0x03));
+   case GLSL_TYPE_ATOMIC_UINT:
+      return glsl_type::atomic_uint_type;
+   case GLSL_TYPE_ARRAY: {
+      unsigned length = blob_read_uint32(blob);
+      return glsl_type::get_array_instance(decode_type_from_blob(blob),
+                                           length);
+   }
+   case GLSL_TYPE_STRUCT:
+   case GLSL_TYPE_INTERFACE: {
+      char *name = blob_read_string(blob);
+      unsigned num_fields = blob_read_uint32(blob);
+
+      size_t s_field_size, s_field_ptrs;
+      get_struct_type_field_and_pointer_sizes(&s_field_size, &s_field_ptrs);
+
+      glsl_struct_field *fields =
+         (glsl_struct_field *) malloc(s_field_size * num_fields);
+      for (unsigned i = 0; i < num_fields; i++) {
+         fields[i].type = decode_type_from_blob(blob);
+         fields[i].name = blob_read_string(blob);
+
+         blob_copy_bytes(blob, ((uint8_t *) &fields[i]) + s_field_ptrs,
+                         s_field_size - s_field_ptrs);
+      }
+
+      const glsl_type *t;
+      if (base_type == GLSL_TYPE_INTERFACE) {
+         enum glsl_interface_packing packing =
+            (glsl_interface_packing) blob_read_uint32(blob);
+         bool row_major = blob_read_uint32(blob);
+         t = glsl_type::get_interface_instance(fields, num_fields, packing,
+                                               row_major, name);
+      } else {
+         t = glsl_type::get_record_instance(fields, num_fields, name);
+      }
+
+      free(fields);
+      return t;
+   }
+   case GLSL_TYPE_VOID:
+      return glsl_type::void_type;
+   case GLSL_TYPE_ERROR:
+   default:
+      assert(!"Cannot decode type!");
+      return NULL;
+   }
+}
+
 /**
  * Declarations of type flyweights (glsl_type::_foo_type) and
  * convenience pointers (glsl_type::foo_type).
@@ -36,6 +36,9 @@ extern "C" {
 
 struct _mesa_glsl_parse_state;
 struct glsl_symbol_table;
+struct blob;
+struct blob_reader;
+struct glsl_type;
 
 extern void
 _mesa_glsl_initialize_types(struct _mesa_glsl_parse_state *state);
@@ -43,6 +46,12 @@ _mesa_glsl_initialize_types(struct _mesa_glsl_parse_state *state);
 extern void
 _mesa_glsl_release_types(void);
 
+void
+encode_type_to_blob(struct blob *blob, const struct glsl_type *type);
+
+const struct glsl_type *
+decode_type_from_blob(struct blob_reader *blob);
+
 #ifdef __cplusplus
 }
 #endif
@@ -155,28 +164,20 @@ struct glsl_type {
     * easier to just ralloc_free 'mem_ctx' (or any of its ancestors). */
    static void* operator new(size_t size)
    {
-      mtx_lock(&glsl_type::mem_mutex);
-
-      /* mem_ctx should have been created by the static members */
-      assert(glsl_type::mem_ctx != NULL);
-
       void *type;
 
-      type = ralloc_size(glsl_type::mem_ctx, size);
+      type = ralloc_size(glsl_type::get_thread_mem_ctx(), size);
       assert(type != NULL);
 
-      mtx_unlock(&glsl_type::mem_mutex);
-
       return type;
    }
 
-   /* If the user *does* call delete, that's OK, we will just
-    * ralloc_free in that case. */
-   static void operator delete(void *type)
+   /* If the user *does* call delete, that's OK, the type is freed along
+    * with all the others in _mesa_glsl_release_types().  The ralloc
+    * context it lives in may be in use by another thread, so it can't be
+    * freed on its own. */
+   static void operator delete(void *)
    {
-      mtx_lock(&glsl_type::mem_mutex);
-      ralloc_free(type);
-      mtx_unlock(&glsl_type::mem_mutex);
    }
 
    /**
@@ -847,17 +848,19 @@ struct glsl_type {
 
 private:
 
+   /** Protects mem_ctx */
    static mtx_t mem_mutex;
-   static mtx_t hash_mutex;
 
    /**
     * ralloc context for all glsl_type allocations
     *
-    * Set on the first call to \c glsl_type::new.
+    * Set on the first call to \c glsl_type::new.  Types are not allocated
+    * from it directly, but from a child context per thread, see
+    * get_thread_mem_ctx().
     */
    static void *mem_ctx;
 
-   void init_ralloc_type_ctx(void);
+   static void *get_thread_mem_ctx(void);
 
    /** Constructor for vector and matrix types */
    glsl_type(GLenum gl_type,
@@ -888,24 +891,6 @@ private:
    /** Constructor for subroutine types */
    glsl_type(const char *name);
 
-   /** Hash table containing the known array types. */
-   static struct hash_table *array_types;
-
-   /** Hash table containing the known record types. */
-   static struct hash_table *record_types;
-
-   /** Hash table containing the known interface types. */
-   static struct hash_table *interface_types;
-
-   /** Hash table containing the known subroutine types. */
-   static struct hash_table *subroutine_types;
-
-   /** Hash table containing the known function types. */
-   static struct hash_table *function_types;
-
-   static bool record_key_compare(const void *a, const void *b);
-   static unsigned record_key_hash(const void *key);
-
    /**
     * \name Built-in type flyweights
     */
@@ -29,6 +29,15 @@
 #include "nir_control_flow_private.h"
 #include <assert.h>
 
+static void
+shader_destructor(void *ptr)
+{
+   nir_shader *shader = ptr;
+
+   /* Called once all the children, including the instructions, are gone */
+   ralloc_pool_destroy(shader->instr_pool);
+}
+
 nir_shader *
 nir_shader_create(void *mem_ctx,
                   gl_shader_stage stage,
@@ -60,6 +69,9 @@ nir_shader_create(void *mem_ctx,
 
    shader->stage = stage;
 
+   shader->instr_pool = ralloc_pool_create();
+   ralloc_set_destructor(shader, shader_destructor);
+
    return shader;
 }
 
@@ -451,8 +463,8 @@ nir_alu_instr_create(nir_shader *shader, nir_op op)
    unsigned num_srcs = nir_op_infos[op].num_inputs;
    /* TODO: don't use rzalloc */
    nir_alu_instr *instr =
-      rzalloc_size(shader,
-                   sizeof(nir_alu_instr) + num_srcs * sizeof(nir_alu_src));
+      rzalloc_pool_size(shader->instr_pool, shader,
+                        sizeof(nir_alu_instr) + num_srcs * sizeof(nir_alu_src));
 
    instr_init(&instr->instr, nir_instr_type_alu);
    instr->op = op;
@@ -466,7 +478,8 @@ nir_alu_instr_create(nir_shader *shader, nir_op op)
 nir_jump_instr *
 nir_jump_instr_create(nir_shader *shader, nir_jump_type type)
 {
-   nir_jump_instr *instr = ralloc(shader, nir_jump_instr);
+   nir_jump_instr *instr =
+      ralloc_pool_size(shader->instr_pool, shader, sizeof(nir_jump_instr));
    instr_init(&instr->instr, nir_instr_type_jump);
    instr->type = type;
    return instr;
@@ -476,7 +489,8 @@ nir_load_const_instr *
 nir_load_const_instr_create(nir_shader *shader, unsigned num_components,
                             unsigned bit_size)
 {
-   nir_load_const_instr *instr = ralloc(shader, nir_load_const_instr);
+   nir_load_const_instr *instr =
+      ralloc_pool_size(shader->instr_pool, shader, sizeof(nir_load_const_instr));
    instr_init(&instr->instr, nir_instr_type_load_const);
 
    nir_ssa_def_init(&instr->instr, &instr->def, num_components, bit_size, NULL);
@@ -490,8 +504,8 @@ nir_intrinsic_instr_create(nir_shader *shader, nir_intrinsic_op op)
    unsigned num_srcs = nir_intrinsic_infos[op].num_srcs;
    /* TODO: don't use rzalloc */
    nir_intrinsic_instr *instr =
-      rzalloc_size(shader,
-                  sizeof(nir_intrinsic_instr) + num_srcs * sizeof(nir_src));
+      rzalloc_pool_size(shader->instr_pool, shader,
+                        sizeof(nir_intrinsic_instr) + num_srcs * sizeof(nir_src));
 
    instr_init(&instr->instr, nir_instr_type_intrinsic);
    instr->intrinsic = op;
@@ -508,7 +522,8 @@ nir_intrinsic_instr_create(nir_shader *shader, nir_intrinsic_op op)
 nir_call_instr *
 nir_call_instr_create(nir_shader *shader, nir_function *callee)
 {
-   nir_call_instr *instr = ralloc(shader, nir_call_instr);
+   nir_call_instr *instr =
+      ralloc_pool_size(shader->instr_pool, shader, sizeof(nir_call_instr));
    instr_init(&instr->instr, nir_instr_type_call);
 
    instr->callee = callee;
@@ -522,7 +537,8 @@ nir_call_instr_create(nir_shader *shader, nir_function *callee)
 nir_tex_instr *
 nir_tex_instr_create(nir_shader *shader, unsigned num_srcs)
 {
-   nir_tex_instr *instr = rzalloc(shader, nir_tex_instr);
+   nir_tex_instr *instr =
+      rzalloc_pool_size(shader->instr_pool, shader, sizeof(nir_tex_instr));
    instr_init(&instr->instr, nir_instr_type_tex);
 
    dest_init(&instr->dest);
@@ -560,7 +576,8 @@ nir_tex_instr_remove_src(nir_tex_instr *tex, unsigned src_idx)
 nir_phi_instr *
 nir_phi_instr_create(nir_shader *shader)
 {
-   nir_phi_instr *instr = ralloc(shader, nir_phi_instr);
+   nir_phi_instr *instr =
+      ralloc_pool_size(shader->instr_pool, shader, sizeof(nir_phi_instr));
    instr_init(&instr->instr, nir_instr_type_phi);
 
    dest_init(&instr->dest);
@@ -584,7 +601,8 @@ nir_ssa_undef_instr_create(nir_shader *shader,
                            unsigned num_components,
                            unsigned bit_size)
 {
-   nir_ssa_undef_instr *instr = ralloc(shader, nir_ssa_undef_instr);
+   nir_ssa_undef_instr *instr =
+      ralloc_pool_size(shader->instr_pool, shader, sizeof(nir_ssa_undef_instr));
    instr_init(&instr->instr, nir_instr_type_ssa_undef);
 
    nir_ssa_def_init(&instr->instr, &instr->def, num_components, bit_size, NULL);
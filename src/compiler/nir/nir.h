@@ -41,9 +41,7 @@
 #include "compiler/shader_info.h"
 #include <stdio.h>
 
-#ifdef DEBUG
 #include "util/debug.h"
-#endif /* DEBUG */
 
 #include "nir_opcodes.h"
 
@@ -1893,6 +1891,15 @@ typedef struct nir_shader {
 
    /** The shader stage, such as MESA_SHADER_VERTEX. */
    gl_shader_stage stage;
+
+   /**
+    * Memory for the instructions of the shader.
+    *
+    * Instructions are still ralloc'd with the shader as their parent, the
+    * pool only saves a malloc per instruction.  nir_sweep() gives the pages
+    * that only held dead instructions back to the system.
+    */
+   struct ralloc_pool *instr_pool;
 } nir_shader;
 
 static inline nir_function_impl *
@@ -2301,6 +2308,8 @@ nir_variable *nir_variable_clone(const nir_variable *c, nir_shader *shader);
 nir_deref *nir_deref_clone(const nir_deref *deref, void *mem_ctx);
 nir_deref_var *nir_deref_var_clone(const nir_deref_var *deref, void *mem_ctx);
 
+nir_shader *nir_shader_serialize_deserialize(void *mem_ctx, nir_shader *s);
+
 #ifdef DEBUG
 void nir_validate_shader(nir_shader *shader);
 void nir_metadata_set_validation_flag(nir_shader *shader);
@@ -2316,6 +2325,16 @@ should_clone_nir(void)
    return should_clone;
 }
 
+static inline bool
+should_serialize_deserialize_nir(void)
+{
+   static int test_serialize = -1;
+   if (test_serialize < 0)
+      test_serialize = env_var_as_boolean("NIR_TEST_SERIALIZE", false);
+
+   return test_serialize;
+}
+
 static inline bool
 should_print_nir(void)
 {
@@ -2330,6 +2349,7 @@ static inline void nir_validate_shader(nir_shader *shader) { (void) shader; }
 static inline void nir_metadata_set_validation_flag(nir_shader *shader) { (void) shader; }
 static inline void nir_metadata_check_validation_flag(nir_shader *shader) { (void) shader; }
 static inline bool should_clone_nir(void) { return false; }
+static inline bool should_serialize_deserialize_nir(void) { return false; }
 static inline bool should_print_nir(void) { return false; }
 #endif /* DEBUG */
 
@@ -2341,13 +2361,51 @@ static inline bool should_print_nir(void) { return false; }
       ralloc_free(nir);                                              \
       nir = clone;                                                   \
    }                                                                 \
+   if (should_serialize_deserialize_nir()) {                         \
+      void *mem_ctx = ralloc_parent(nir);                            \
+      nir = nir_shader_serialize_deserialize(mem_ctx, nir);          \
+   }                                                                 \
 } while (0)
 
+/* Set NIR_PASS_STATS to get the time spent in every pass and how often it
+ * made progress printed at exit.  Unlike the debug options above, this is
+ * also available in release builds.
+ */
+static inline bool
+should_record_nir_pass_stats(void)
+{
+   static int should_record = -1;
+   if (should_record < 0)
+      should_record = env_var_as_boolean("NIR_PASS_STATS", false);
+
+   return should_record;
+}
+
+uint64_t nir_pass_stats_time(void);
+void nir_pass_stats_record(const char *pass, uint64_t start, bool progress);
+void nir_pass_stats_record_skip(const char *pass);
+
+static inline uint64_t
+nir_pass_stats_begin(void)
+{
+   return should_record_nir_pass_stats() ? nir_pass_stats_time() : 0;
+}
+
+static inline void
+nir_pass_stats_end(const char *pass, uint64_t start, bool progress)
+{
+   if (should_record_nir_pass_stats())
+      nir_pass_stats_record(pass, start, progress);
+}
+
 #define NIR_PASS(progress, nir, pass, ...) _PASS(nir,                \
    nir_metadata_set_validation_flag(nir);                            \
    if (should_print_nir())                                           \
       printf("%s\n", #pass);                                         \
-   if (pass(nir, ##__VA_ARGS__)) {                                   \
+   uint64_t _pass_start = nir_pass_stats_begin();                    \
+   bool _pass_progress = pass(nir, ##__VA_ARGS__);                   \
+   nir_pass_stats_end(#pass, _pass_start, _pass_progress);           \
+   if (_pass_progress) {                                             \
       progress = true;                                               \
       if (should_print_nir())                                        \
          nir_print_shader(nir, stdout);                              \
@@ -2358,11 +2416,45 @@ static inline bool should_print_nir(void) { return false; }
 #define NIR_PASS_V(nir, pass, ...) _PASS(nir,                        \
    if (should_print_nir())                                           \
       printf("%s\n", #pass);                                         \
+   uint64_t _pass_start = nir_pass_stats_begin();                    \
    pass(nir, ##__VA_ARGS__);                                         \
+   nir_pass_stats_end(#pass, _pass_start, false);                    \
    if (should_print_nir())                                           \
       nir_print_shader(nir, stdout);                                 \
 )
 
+/* NIR_PASS for the body of a fixpoint loop.
+ *
+ * A pass which didn't make progress won't make any the next time either,
+ * unless something else changed the shader in between.  skip_set remembers
+ * the passes that ran without progress since the last time any pass in the
+ * loop made progress, and those are skipped instead of being run again.
+ * This typically saves the tail of the last iteration as well as repeated
+ * cleanup passes that have nothing left to clean up.
+ *
+ * skip_set has to be created with _mesa_key_hash_string and
+ * _mesa_key_string_equal.  Passes are told apart by the text of the pass
+ * name and arguments, so arguments must not change value inside the loop,
+ * and every pass that can change the shader inside the loop has to go
+ * through NIR_LOOP_PASS with the same skip_set.
+ */
+#define NIR_LOOP_PASS(progress, skip_set, nir, pass, ...) do {       \
+   const char *_loop_pass_key = #pass "(" #__VA_ARGS__ ")";          \
+   if (_mesa_set_search(skip_set, _loop_pass_key)) {                 \
+      if (should_record_nir_pass_stats())                            \
+         nir_pass_stats_record_skip(#pass);                          \
+   } else {                                                          \
+      bool _loop_pass_progress = false;                              \
+      NIR_PASS(_loop_pass_progress, nir, pass, ##__VA_ARGS__);       \
+      if (_loop_pass_progress) {                                     \
+         _mesa_set_clear(skip_set, NULL);                            \
+         progress = true;                                            \
+      } else {                                                       \
+         _mesa_set_add(skip_set, _loop_pass_key);                    \
+      }                                                              \
+   }                                                                 \
+} while (0)
+
 void nir_calc_dominance_impl(nir_function_impl *impl);
 void nir_calc_dominance(nir_shader *shader);
 
@@ -25,6 +25,7 @@
 
 from __future__ import print_function
 import ast
+from collections import defaultdict
 import itertools
 import struct
 import sys
@@ -495,6 +496,169 @@ class SearchAndReplace(object):
 
       BitSizeValidator(varset).validate(self.search, self.replace)
 
+class TreeAutomaton(object):
+   """This class calculates a bottom-up tree automaton to quickly search for
+   the left-hand sides of transforms.
+
+   Instead of trying every transform for a given opcode one after another,
+   the generated pass first walks the shader once and assigns a state to
+   every SSA value.  A state is the set of search (sub)expressions, called
+   items, which could possibly match the value.  The state of an ALU
+   instruction only depends on its opcode and on the states of its sources,
+   so it can be computed with a single table lookup per instruction.  Only
+   the transforms whose search expression is in the final state then need to
+   be handed to nir_replace_instr(), which still does the full match.
+
+   Items only describe the shape of the search expressions.  Variables match
+   anything (the wildcard item) while constants and '#' variables match
+   load_const instructions (the const item).  Bit sizes, types, conditions
+   and swizzles are left to nir_replace_instr(), so a state is a superset of
+   what actually matches and the generated pass gives exactly the same
+   results as trying every transform.
+
+   In order to keep the tables small, each opcode has a filter which maps
+   the global states to the subset of items that can appear as a source of
+   that opcode.  The transition table of the opcode is indexed by the
+   filtered states of its sources instead of the global ones.
+   """
+   def __init__(self, transforms):
+      self.patterns = [t.search for t in transforms]
+      self._compute_items()
+      self._build_table()
+
+   class IndexMap(object):
+      """An indexed set of hashable objects, numbered in insertion order."""
+      def __init__(self):
+         self.objects = []
+         self.map = {}
+
+      def __getitem__(self, obj):
+         return self.map[obj]
+
+      def __contains__(self, obj):
+         return obj in self.map
+
+      def __len__(self):
+         return len(self.objects)
+
+      def __iter__(self):
+         return iter(self.objects)
+
+      def add(self, obj):
+         if obj not in self.map:
+            self.map[obj] = len(self.objects)
+            self.objects.append(obj)
+         return self.map[obj]
+
+   def _compute_items(self):
+      """Assign an item to every distinct search (sub)expression.
+
+      An item is an (opcode, source items) tuple.  Structurally identical
+      subexpressions share an item, even across transforms.
+      """
+      self.items = self.IndexMap()
+      self.wildcard = self.items.add(('__wildcard', ()))
+      self.const = self.items.add(('__const', ()))
+      self.opcodes = self.IndexMap()
+
+      def process_subpattern(src):
+         if isinstance(src, Constant):
+            return self.const
+         elif isinstance(src, Variable):
+            return self.const if src.is_constant else self.wildcard
+         else:
+            assert isinstance(src, Expression)
+            srcs = tuple(process_subpattern(s) for s in src.sources)
+            self.opcodes.add(src.opcode)
+            return self.items.add((src.opcode, srcs))
+
+      self.pattern_items = [process_subpattern(p) for p in self.patterns]
+
+      # The items rooted at each opcode and the items that can appear as one
+      # of their sources.
+      self.opcode_items = defaultdict(list)
+      self.opcode_srcs = defaultdict(set)
+      for (index, (opcode, srcs)) in enumerate(self.items):
+         if index in (self.wildcard, self.const):
+            continue
+         self.opcode_items[opcode].append(index)
+         self.opcode_srcs[opcode].update(srcs)
+
+   def _transition(self, opcode, src_states):
+      """Compute the state of an opcode applied to sources in src_states."""
+      commutative = 'commutative' in opcodes[opcode].algebraic_properties
+      state = set([self.wildcard])
+      for item in self.opcode_items[opcode]:
+         srcs = self.items.objects[item][1]
+         if all(src in src_states[i] for (i, src) in enumerate(srcs)):
+            state.add(item)
+         elif commutative and srcs[0] in src_states[1] and \
+              srcs[1] in src_states[0]:
+            # Mirrors the swapped attempt in nir_search's match_expression()
+            state.add(item)
+      return frozenset(state)
+
+   def _build_table(self):
+      """Compute all reachable states and the per-opcode transition tables.
+
+      State 0 is used for everything that isn't an ALU instruction or a
+      constant and state 1 for load_const instructions.  These have to match
+      nir_algebraic_automaton() in nir_search.c.
+      """
+      self.states = self.IndexMap()
+      self.states.add(frozenset([self.wildcard]))
+      self.states.add(frozenset([self.wildcard, self.const]))
+
+      self.filter = dict((op, []) for op in self.opcodes)
+      self.rep = dict((op, self.IndexMap()) for op in self.opcodes)
+      self.table = dict((op, {}) for op in self.opcodes)
+
+      # Keep going until no opcode produces a state we haven't seen yet.
+      # Every pass filters the newly found states and then fills in the
+      # transitions for any new combinations of filtered states.
+      changed = True
+      while changed:
+         changed = False
+         for op in self.opcodes:
+            op_filter = self.filter[op]
+            rep = self.rep[op]
+            num_reps = len(rep)
+
+            while len(op_filter) < len(self.states):
+               state = self.states.objects[len(op_filter)]
+               op_filter.append(rep.add(state & self.opcode_srcs[op]))
+
+            if len(rep) == num_reps:
+               continue
+
+            num_srcs = opcodes[op].num_inputs
+            for srcs in itertools.product(range(len(rep)), repeat=num_srcs):
+               if srcs in self.table[op]:
+                  continue
+
+               state = self._transition(op, [rep.objects[s] for s in srcs])
+               if state not in self.states:
+                  changed = True
+               self.table[op][srcs] = self.states.add(state)
+
+      # The generated C code stores states as uint16_t
+      assert len(self.states) <= 0x10000
+
+   def flat_table(self, op):
+      """Return the transition table of op as a row-major list."""
+      num_srcs = opcodes[op].num_inputs
+      num_reps = len(self.rep[op])
+      return [self.table[op][srcs] for srcs in
+              itertools.product(range(num_reps), repeat=num_srcs)]
+
+   def state_transforms(self):
+      """Return, for every state, the indices of the transforms whose
+      search expression is in that state, in the order they were given.
+      """
+      return [tuple(i for (i, item) in enumerate(self.pattern_items)
+                    if item in state)
+              for state in self.states]
+
 _algebraic_pass_template = mako.template.Template("""
 #include "nir.h"
 #include "nir_search.h"
@@ -509,24 +673,67 @@ struct transform {
    unsigned condition_offset;
 };
 
+struct transform_list {
+   unsigned start;
+   unsigned count;
+};
+
 #endif
 
-% for (opcode, xform_list) in xform_dict.iteritems():
-% for xform in xform_list:
+% for xform in xforms:
    ${xform.search.render()}
    ${xform.replace.render()}
 % endfor
 
-static const struct transform ${pass_name}_${opcode}_xforms[] = {
-% for xform in xform_list:
+static const struct transform ${pass_name}_xforms[] = {
+% for xform in xforms:
    { &${xform.search.name}, ${xform.replace.c_ptr}, ${xform.condition_index} },
 % endfor
 };
+
+% for op in automaton.opcodes:
+static const uint16_t ${pass_name}_${op}_filter[] = {
+% for line in c_array(automaton.filter[op]):
+   ${line}
 % endfor
+};
+
+static const uint16_t ${pass_name}_${op}_table[] = {
+% for line in c_array(automaton.flat_table(op)):
+   ${line}
+% endfor
+};
+
+% endfor
+static const struct per_op_table ${pass_name}_table[nir_num_opcodes] = {
+% for op in automaton.opcodes:
+   [nir_op_${op}] = {
+      ${pass_name}_${op}_filter,
+      ${len(automaton.rep[op])},
+      ${pass_name}_${op}_table,
+   },
+% endfor
+};
+
+/* The transforms that can match a value in a given automaton state, as
+ * indices into ${pass_name}_xforms.  States with the same transforms share
+ * their entries.
+ */
+static const uint16_t ${pass_name}_state_xform_indices[] = {
+% for line in c_array(state_xform_indices):
+   ${line}
+% endfor
+};
+
+static const struct transform_list ${pass_name}_state_xforms[] = {
+% for (start, count) in state_xforms:
+   { ${start}, ${count} },
+% endfor
+};
 
 static bool
 ${pass_name}_block(nir_block *block, const bool *condition_flags,
-                   void *mem_ctx)
+                   const uint16_t *states, void *mem_ctx)
 {
    bool progress = false;
 
@@ -538,22 +745,18 @@ ${pass_name}_block(nir_block *block, const bool *condition_flags,
       if (!alu->dest.dest.is_ssa)
          continue;
 
-      switch (alu->op) {
-      % for opcode in xform_dict.keys():
-      case nir_op_${opcode}:
-         for (unsigned i = 0; i < ARRAY_SIZE(${pass_name}_${opcode}_xforms); i++) {
-            const struct transform *xform = &${pass_name}_${opcode}_xforms[i];
-            if (condition_flags[xform->condition_offset] &&
-                nir_replace_instr(alu, xform->search, xform->replace,
-                                  mem_ctx)) {
-               progress = true;
-               break;
-            }
+      const struct transform_list *list =
+         &${pass_name}_state_xforms[states[alu->dest.dest.ssa.index]];
+
+      for (unsigned i = 0; i < list->count; i++) {
+         const struct transform *xform =
+            &${pass_name}_xforms[${pass_name}_state_xform_indices[list->start + i]];
+         if (condition_flags[xform->condition_offset] &&
+             nir_replace_instr(alu, xform->search, xform->replace,
+                               mem_ctx)) {
+            progress = true;
+            break;
          }
-         break;
-      % endfor
-      default:
-         break;
       }
    }
 
@@ -566,10 +769,22 @@ ${pass_name}_impl(nir_function_impl *impl, const bool *condition_flags)
    void *mem_ctx = ralloc_parent(impl);
    bool progress = false;
 
+   /* Replacing an instruction only touches its uses, which the reverse walk
+    * below has already visited, so the states computed up front stay valid
+    * for every instruction that is still to be matched.
+    */
+   uint16_t *states = calloc(impl->ssa_alloc, sizeof(*states));
+   if (impl->ssa_alloc && !states)
+      return false;
+
+   nir_algebraic_automaton(impl, states, ${pass_name}_table);
+
    nir_foreach_block_reverse(block, impl) {
-      progress |= ${pass_name}_block(block, condition_flags, mem_ctx);
+      progress |= ${pass_name}_block(block, condition_flags, states, mem_ctx);
    }
 
+   free(states);
+
    if (progress)
       nir_metadata_preserve(impl, nir_metadata_block_index |
                                   nir_metadata_dominance);
@@ -599,9 +814,15 @@ ${pass_name}(nir_shader *shader)
 }
 """)
 
+def c_array(values, per_line=12):
+   """Format a list of integers as the lines of a C array initializer."""
+   values = list(values)
+   return [' '.join(str(v) + ',' for v in values[i:i + per_line])
+           for i in range(0, len(values), per_line)]
+
 class AlgebraicPass(object):
    def __init__(self, pass_name, transforms):
-      self.xform_dict = {}
+      self.xforms = []
       self.pass_name = pass_name
 
       error = False
@@ -618,15 +839,28 @@ class AlgebraicPass(object):
                error = True
                continue
 
-         if xform.search.opcode not in self.xform_dict:
-            self.xform_dict[xform.search.opcode] = []
-
-         self.xform_dict[xform.search.opcode].append(xform)
+         self.xforms.append(xform)
 
       if error:
          sys.exit(1)
 
+      self.automaton = TreeAutomaton(self.xforms)
+
    def render(self):
+      # Flatten the per-state transform lists, sharing identical ones
+      state_xform_indices = []
+      state_xforms = []
+      list_start = {}
+      for xform_list in self.automaton.state_transforms():
+         if xform_list not in list_start:
+            list_start[xform_list] = len(state_xform_indices)
+            state_xform_indices.extend(xform_list)
+         state_xforms.append((list_start[xform_list], len(xform_list)))
+
       return _algebraic_pass_template.render(pass_name=self.pass_name,
-                                             xform_dict=self.xform_dict,
-                                             condition_list=condition_list)
+                                             xforms=self.xforms,
+                                             automaton=self.automaton,
+                                             state_xform_indices=state_xform_indices,
+                                             state_xforms=state_xforms,
+                                             condition_list=condition_list,
+                                             c_array=c_array)
@@ -0,0 +1,176 @@
+/*
+ * Copyright © 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \file nir_pass_stats.c
+ *
+ * Compile time accounting for NIR_PASS, NIR_PASS_V and NIR_LOOP_PASS.
+ *
+ * When the NIR_PASS_STATS environment variable is set, every pass run
+ * through those macros is timed and the number of runs, of runs that made
+ * progress and of runs skipped by NIR_LOOP_PASS is counted per pass.  The
+ * totals for the whole process are printed to stderr at exit, most
+ * expensive pass first.
+ */
+
+#include "nir.h"
+#include "c11/threads.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+struct pass_stats {
+   const char *name;
+   unsigned runs;
+   unsigned progress;
+   unsigned skipped;
+   uint64_t time_ns;
+};
+
+static once_flag stats_once_flag = ONCE_FLAG_INIT;
+static mtx_t stats_mutex = _MTX_INITIALIZER_NP;
+static struct hash_table *stats_table;
+
+uint64_t
+nir_pass_stats_time(void)
+{
+#ifdef _WIN32
+   LARGE_INTEGER freq, counter;
+   QueryPerformanceFrequency(&freq);
+   QueryPerformanceCounter(&counter);
+   return (uint64_t)((double)counter.QuadPart * 1e9 / freq.QuadPart);
+#else
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+static int
+compare_pass_time(const void *a, const void *b)
+{
+   const struct pass_stats *sa = *(const struct pass_stats **)a;
+   const struct pass_stats *sb = *(const struct pass_stats **)b;
+
+   if (sa->time_ns != sb->time_ns)
+      return sa->time_ns < sb->time_ns ? 1 : -1;
+
+   return strcmp(sa->name, sb->name);
+}
+
+static void
+print_pass_stats(void)
+{
+   mtx_lock(&stats_mutex);
+
+   unsigned count = 0;
+   struct pass_stats **sorted =
+      malloc(stats_table->entries * sizeof(*sorted));
+   if (!sorted) {
+      mtx_unlock(&stats_mutex);
+      return;
+   }
+
+   struct hash_entry *entry;
+   hash_table_foreach(stats_table, entry)
+      sorted[count++] = entry->data;
+
+   qsort(sorted, count, sizeof(*sorted), compare_pass_time);
+
+   unsigned runs = 0, progress = 0, skipped = 0;
+   uint64_t time_ns = 0;
+
+   fprintf(stderr, "%-40s %8s %8s %8s %12s\n",
+           "NIR pass", "runs", "progress", "skipped", "time (ms)");
+   for (unsigned i = 0; i < count; i++) {
+      const struct pass_stats *stats = sorted[i];
+      fprintf(stderr, "%-40s %8u %8u %8u %12.3f\n", stats->name,
+              stats->runs, stats->progress, stats->skipped,
+              stats->time_ns / 1000000.0);
+
+      runs += stats->runs;
+      progress += stats->progress;
+      skipped += stats->skipped;
+      time_ns += stats->time_ns;
+   }
+   fprintf(stderr, "%-40s %8u %8u %8u %12.3f\n", "total",
+           runs, progress, skipped, time_ns / 1000000.0);
+
+   free(sorted);
+   mtx_unlock(&stats_mutex);
+}
+
+static void
+pass_stats_init(void)
+{
+   stats_table = _mesa_hash_table_create(NULL, _mesa_key_hash_string,
+                                         _mesa_key_string_equal);
+   atexit(print_pass_stats);
+}
+
+/* Must be called with stats_mutex held.  The pass names are string literals
+ * coming from the NIR_PASS macros, so they don't need to be copied.
+ */
+static struct pass_stats *
+get_pass_stats(const char *pass)
+{
+   struct hash_entry *entry = _mesa_hash_table_search(stats_table, pass);
+   if (entry)
+      return entry->data;
+
+   struct pass_stats *stats = rzalloc(stats_table, struct pass_stats);
+   stats->name = pass;
+   _mesa_hash_table_insert(stats_table, pass, stats);
+
+   return stats;
+}
+
+void
+nir_pass_stats_record(const char *pass, uint64_t start, bool progress)
+{
+   uint64_t time_ns = nir_pass_stats_time() - start;
+
+   call_once(&stats_once_flag, pass_stats_init);
+
+   mtx_lock(&stats_mutex);
+   struct pass_stats *stats = get_pass_stats(pass);
+   stats->runs++;
+   stats->time_ns += time_ns;
+   if (progress)
+      stats->progress++;
+   mtx_unlock(&stats_mutex);
+}
+
+void
+nir_pass_stats_record_skip(const char *pass)
+{
+   call_once(&stats_once_flag, pass_stats_init);
+
+   mtx_lock(&stats_mutex);
+   get_pass_stats(pass)->skipped++;
+   mtx_unlock(&stats_mutex);
+}
@@ -567,6 +567,59 @@ construct_value(const nir_search_value *value,
    }
 }
 
+static uint16_t
+src_automaton_state(nir_src src, const uint16_t *states)
+{
+   /* Non-SSA sources never match anything but a variable */
+   return src.is_ssa ? states[src.ssa->index] : 0;
+}
+
+/**
+ * Compute the automaton state of every SSA value in impl.
+ *
+ * \p states is indexed by SSA def index and has to be zeroed by the caller;
+ * values that aren't ALU instructions or constants stay in state 0.  Sources
+ * are always visited before their uses, except through phis, which are in
+ * state 0 anyway.
+ */
+void
+nir_algebraic_automaton(nir_function_impl *impl, uint16_t *states,
+                        const struct per_op_table *pass_op_table)
+{
+   nir_foreach_block(block, impl) {
+      nir_foreach_instr(instr, block) {
+         switch (instr->type) {
+         case nir_instr_type_alu: {
+            nir_alu_instr *alu = nir_instr_as_alu(instr);
+            const struct per_op_table *tbl = &pass_op_table[alu->op];
+
+            if (!alu->dest.dest.is_ssa || tbl->num_filtered_states == 0)
+               break;
+
+            unsigned index = 0;
+            for (unsigned i = 0; i < nir_op_infos[alu->op].num_inputs; i++) {
+               index *= tbl->num_filtered_states;
+               index += tbl->filter[src_automaton_state(alu->src[i].src,
+                                                        states)];
+            }
+
+            states[alu->dest.dest.ssa.index] = tbl->table[index];
+            break;
+         }
+
+         case nir_instr_type_load_const: {
+            nir_load_const_instr *load = nir_instr_as_load_const(instr);
+            states[load->def.index] = 1;
+            break;
+         }
+
+         default:
+            break;
+         }
+      }
+   }
+}
+
 nir_alu_instr *
 nir_replace_instr(nir_alu_instr *instr, const nir_search_expression *search,
                   const nir_search_value *replace, void *mem_ctx)
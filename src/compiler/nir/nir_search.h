@@ -123,6 +123,24 @@ NIR_DEFINE_CAST(nir_search_value_as_expression, nir_search_value,
                 nir_search_expression, value,
                 type, nir_search_value_expression)
 
+/** Per-opcode tables of the tree automaton generated by nir_algebraic.py
+ *
+ * The state of an ALU instruction is looked up in \c table, which is indexed
+ * by the filtered states of its sources in row-major order.  \c filter maps
+ * the state of a source to one of \c num_filtered_states classes.  Opcodes
+ * which don't appear in any search expression have no tables and always
+ * end up in state 0.
+ */
+struct per_op_table {
+   const uint16_t *filter;
+   unsigned num_filtered_states;
+   const uint16_t *table;
+};
+
+void
+nir_algebraic_automaton(nir_function_impl *impl, uint16_t *states,
+                        const struct per_op_table *pass_op_table);
+
 nir_alu_instr *
 nir_replace_instr(nir_alu_instr *instr, const nir_search_expression *search,
                   const nir_search_value *replace, void *mem_ctx);
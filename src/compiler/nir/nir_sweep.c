@@ -145,6 +145,186 @@ sweep_function(nir_shader *nir, nir_function *f)
       sweep_impl(nir, f->impl);
 }
 
+/* Moving instructions
+ * ===================
+ *
+ * Once the dead instructions are gone, the survivors are scattered over
+ * pages of the shader's instruction pool that are mostly empty.  Moving them
+ * to denser pages lets those be released.  An instruction is copied as a
+ * whole, so every pointer to it or into it has to be updated: its node in
+ * the block, the use and def lists its sources and destinations are linked
+ * into, the sources using its SSA defs and the parent_instr of its sources.
+ * nir_sweep() throws the metadata away, so nothing else refers to it.
+ */
+
+struct move_state {
+   nir_instr *instr;
+   const char *old;
+   size_t size;
+};
+
+static size_t
+instr_size(const nir_instr *instr)
+{
+   switch (instr->type) {
+   case nir_instr_type_alu: {
+      const nir_alu_instr *alu = nir_instr_as_alu(instr);
+      return sizeof(nir_alu_instr) +
+             nir_op_infos[alu->op].num_inputs * sizeof(nir_alu_src);
+   }
+   case nir_instr_type_intrinsic: {
+      const nir_intrinsic_instr *intrin = nir_instr_as_intrinsic(instr);
+      return sizeof(nir_intrinsic_instr) +
+             nir_intrinsic_infos[intrin->intrinsic].num_srcs * sizeof(nir_src);
+   }
+   case nir_instr_type_tex:
+      return sizeof(nir_tex_instr);
+   case nir_instr_type_call:
+      return sizeof(nir_call_instr);
+   case nir_instr_type_jump:
+      return sizeof(nir_jump_instr);
+   case nir_instr_type_load_const:
+      return sizeof(nir_load_const_instr);
+   case nir_instr_type_ssa_undef:
+      return sizeof(nir_ssa_undef_instr);
+   case nir_instr_type_phi:
+      return sizeof(nir_phi_instr);
+   case nir_instr_type_parallel_copy:
+      return sizeof(nir_parallel_copy_instr);
+   default:
+      unreachable("Invalid instruction type");
+   }
+}
+
+/* Translates a pointer into the old copy of the instruction */
+static void *
+moved_ptr(struct move_state *state, void *ptr)
+{
+   if ((const char *) ptr >= state->old &&
+       (const char *) ptr < state->old + state->size)
+      return (char *) state->instr + ((const char *) ptr - state->old);
+
+   return ptr;
+}
+
+static bool
+is_moved(struct move_state *state, void *ptr)
+{
+   return (char *) ptr >= (char *) state->instr &&
+          (char *) ptr < (char *) state->instr + state->size;
+}
+
+static void
+move_list_link(struct move_state *state, struct list_head *link)
+{
+   link->next = moved_ptr(state, link->next);
+   link->prev = moved_ptr(state, link->prev);
+   link->next->prev = link;
+   link->prev->next = link;
+}
+
+static bool
+move_src(nir_src *src, void *_state)
+{
+   struct move_state *state = _state;
+
+   src->parent_instr = state->instr;
+
+   if (is_moved(state, src) &&
+       (src->is_ssa ? src->ssa != NULL : src->reg.reg != NULL))
+      move_list_link(state, &src->use_link);
+
+   return true;
+}
+
+static bool
+move_dest(nir_dest *dest, void *_state)
+{
+   struct move_state *state = _state;
+
+   if (!dest->is_ssa) {
+      dest->reg.parent_instr = state->instr;
+      if (dest->reg.reg != NULL)
+         move_list_link(state, &dest->reg.def_link);
+   }
+
+   return true;
+}
+
+static bool
+move_ssa_def(nir_ssa_def *def, void *_state)
+{
+   struct move_state *state = _state;
+
+   def->parent_instr = state->instr;
+   move_list_link(state, &def->uses);
+   move_list_link(state, &def->if_uses);
+
+   return true;
+}
+
+static bool
+point_uses_at_ssa_def(nir_ssa_def *def, void *state)
+{
+   nir_foreach_use(use, def)
+      use->ssa = def;
+   nir_foreach_if_use(use, def)
+      use->ssa = def;
+
+   return true;
+}
+
+static void
+move_instr(nir_shader *nir, nir_instr *old)
+{
+   nir_instr *instr = ralloc_pool_move(nir->instr_pool, old);
+   if (instr == old)
+      return;
+
+   struct move_state state = {
+      .instr = instr,
+      .old = (const char *) old,
+      .size = instr_size(instr),
+   };
+
+   instr->node.next->prev = &instr->node;
+   instr->node.prev->next = &instr->node;
+
+   if (instr->type == nir_instr_type_phi) {
+      struct exec_list *srcs = &nir_instr_as_phi(instr)->srcs;
+
+      srcs->head_sentinel.next = moved_ptr(&state, srcs->head_sentinel.next);
+      srcs->head_sentinel.next->prev = &srcs->head_sentinel;
+      srcs->tail_sentinel.prev = moved_ptr(&state, srcs->tail_sentinel.prev);
+      srcs->tail_sentinel.prev->next = &srcs->tail_sentinel;
+   }
+
+   /* Fix up all the links first, the use lists can be walked after that */
+   nir_foreach_src(instr, move_src, &state);
+   nir_foreach_dest(instr, move_dest, &state);
+   nir_foreach_ssa_def(instr, move_ssa_def, &state);
+   nir_foreach_ssa_def(instr, point_uses_at_ssa_def, NULL);
+}
+
+static void
+compact_instrs(nir_shader *nir)
+{
+   if (ralloc_pool_begin_compact(nir->instr_pool)) {
+      nir_foreach_function(func, nir) {
+         if (!func->impl)
+            continue;
+
+         nir_foreach_block(block, func->impl) {
+            nir_foreach_instr_safe(instr, block)
+               move_instr(nir, instr);
+         }
+      }
+   }
+
+   /* Give the pages that are now empty back to the system. */
+   ralloc_pool_compact(nir->instr_pool);
+}
+
 void
 nir_sweep(nir_shader *nir)
 {
@@ -173,4 +353,6 @@ nir_sweep(nir_shader *nir)
 
    /* Free everything we didn't steal back. */
    ralloc_free(rubbish);
+
+   compact_instrs(nir);
 }
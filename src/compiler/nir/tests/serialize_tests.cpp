@@ -0,0 +1,269 @@
+/*
+ * Copyright © 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include <string>
+#include "nir.h"
+#include "nir_builder.h"
+#include "nir_serialize.h"
+
+class nir_serialize_test : public ::testing::Test {
+protected:
+   nir_serialize_test();
+   ~nir_serialize_test();
+
+   void build_shader();
+   void round_trip(nir_shader *s, nir_shader **ns);
+   static std::string print(nir_shader *s);
+
+   nir_builder b;
+   struct blob *first;
+   struct blob *second;
+};
+
+static const nir_shader_compiler_options options = { };
+
+nir_serialize_test::nir_serialize_test()
+{
+   nir_builder_init_simple_shader(&b, NULL, MESA_SHADER_FRAGMENT, &options);
+   first = blob_create();
+   second = blob_create();
+}
+
+nir_serialize_test::~nir_serialize_test()
+{
+   ralloc_free(b.shader);
+   blob_destroy(first);
+   blob_destroy(second);
+}
+
+/* Builds a shader that touches every instruction type, a loop-carried phi,
+ * indirect derefs, constant initializers and a function call.
+ */
+void
+nir_serialize_test::build_shader()
+{
+   nir_shader *s = b.shader;
+   s->info.name = ralloc_strdup(s, "serialize");
+
+   nir_variable *in = nir_variable_create(s, nir_var_shader_in,
+      glsl_array_type(glsl_vec4_type(), 4), "in");
+   in->data.location = VARYING_SLOT_VAR0;
+   nir_variable *out = nir_variable_create(s, nir_var_shader_out,
+                                           glsl_vec4_type(), "out");
+   out->data.location = FRAG_RESULT_DATA0;
+   nir_variable *tex_var = nir_variable_create(s, nir_var_uniform,
+      glsl_sampler_type(GLSL_SAMPLER_DIM_2D, false, false, GLSL_TYPE_FLOAT),
+      "tex");
+   nir_variable *glob = nir_variable_create(s, nir_var_global,
+                                            glsl_float_type(), NULL);
+   glob->constant_initializer = rzalloc(glob, nir_constant);
+   glob->constant_initializer->values[0].f32[0] = 0.25f;
+
+   nir_variable *counter = nir_local_variable_create(b.impl, glsl_int_type(),
+                                                     "counter");
+   nir_variable *acc = nir_local_variable_create(b.impl, glsl_vec4_type(),
+                                                 "acc");
+
+   /* A helper function that is only ever called */
+   nir_function *helper = nir_function_create(s, "helper");
+   nir_function_impl *helper_impl = nir_function_impl_create(helper);
+   nir_builder hb;
+   nir_builder_init(&hb, helper_impl);
+   hb.cursor = nir_after_cf_list(&helper_impl->body);
+   nir_store_var(&hb, glob, nir_imm_float(&hb, 1.0f), 0x1);
+
+   nir_call_instr *call = nir_call_instr_create(s, helper);
+   nir_builder_instr_insert(&b, &call->instr);
+
+   nir_store_var(&b, counter, nir_imm_int(&b, 0), 0x1);
+   nir_store_var(&b, acc, nir_imm_vec4(&b, 0.0f, 0.5f, 1.0f, 2.0f), 0xf);
+
+   /* in[counter & 3], through an indirect array deref */
+   nir_loop *loop = nir_push_loop(&b);
+   {
+      nir_ssa_def *i = nir_load_var(&b, counter);
+      nir_if *nif = nir_push_if(&b, nir_ige(&b, i, nir_imm_int(&b, 4)));
+      nir_jump(&b, nir_jump_break);
+      nir_pop_if(&b, nif);
+
+      nir_deref_var *deref = nir_deref_var_create(b.shader, in);
+      nir_deref_array *arr = nir_deref_array_create(deref);
+      arr->deref.type = glsl_vec4_type();
+      arr->deref_array_type = nir_deref_array_type_indirect;
+      arr->base_offset = 0;
+      arr->indirect = nir_src_for_ssa(nir_iand(&b, i, nir_imm_int(&b, 3)));
+      deref->deref.child = &arr->deref;
+      nir_ssa_def *v = nir_load_deref_var(&b, deref);
+
+      nir_ssa_def *sum = nir_fadd(&b, nir_load_var(&b, acc),
+                                  nir_fabs(&b, nir_fneg(&b, v)));
+      nir_store_var(&b, acc, nir_fsat(&b, sum), 0xf);
+      nir_store_var(&b, counter, nir_iadd(&b, i, nir_imm_int(&b, 1)), 0x1);
+   }
+   nir_pop_loop(&b, loop);
+
+   nir_ssa_def *acc_val = nir_load_var(&b, acc);
+
+   nir_tex_instr *tex = nir_tex_instr_create(s, 2);
+   tex->op = nir_texop_txl;
+   tex->sampler_dim = GLSL_SAMPLER_DIM_2D;
+   tex->dest_type = nir_type_float;
+   tex->coord_components = 2;
+   tex->texture = nir_deref_var_create(tex, tex_var);
+   tex->sampler = nir_deref_var_create(tex, tex_var);
+   tex->src[0].src_type = nir_tex_src_coord;
+   tex->src[0].src = nir_src_for_ssa(nir_channels(&b, acc_val, 0x3));
+   tex->src[1].src_type = nir_tex_src_lod;
+   tex->src[1].src = nir_src_for_ssa(nir_imm_float(&b, 0.0f));
+   nir_ssa_dest_init(&tex->instr, &tex->dest, 4, 32, "texel");
+   nir_builder_instr_insert(&b, &tex->instr);
+
+   nir_if *nif = nir_push_if(&b, nir_flt(&b, nir_channel(&b, acc_val, 3),
+                                         nir_load_var(&b, glob)));
+   nir_ssa_def *then_val = nir_fmul(&b, &tex->dest.ssa, acc_val);
+   nir_push_else(&b, nif);
+   nir_ssa_def *else_val = nir_ssa_undef(&b, 4, 32);
+   nir_pop_if(&b, nif);
+   nir_ssa_def *res = nir_if_phi(&b, then_val, else_val);
+
+   nir_ssa_def *d = nir_f2f64(&b, nir_channel(&b, res, 0));
+   d = nir_fadd(&b, d, nir_imm_double(&b, 1.0 / 3.0));
+   nir_ssa_def *x = nir_f2f32(&b, d);
+   nir_store_var(&b, out, nir_vec4(&b, x, nir_channel(&b, res, 1),
+                                   nir_channel(&b, res, 2),
+                                   nir_i2f32(&b, nir_i2i32(&b,
+                                      nir_imm_int64(&b, 7)))), 0xf);
+
+   nir_validate_shader(s);
+}
+
+void
+nir_serialize_test::round_trip(nir_shader *s, nir_shader **ns)
+{
+   nir_serialize(first, s);
+
+   struct blob_reader reader;
+   blob_reader_init(&reader, first->data, first->size);
+   *ns = nir_deserialize(NULL, &options, &reader);
+   ASSERT_TRUE(*ns != NULL);
+   EXPECT_EQ(reader.current, reader.end);
+   EXPECT_FALSE(reader.overrun);
+
+   nir_validate_shader(*ns);
+
+   /* Writing the result again must give back exactly the same bytes */
+   nir_serialize(second, *ns);
+   ASSERT_EQ(first->size, second->size);
+   EXPECT_EQ(0, memcmp(first->data, second->data, first->size));
+}
+
+std::string
+nir_serialize_test::print(nir_shader *s)
+{
+   nir_index_global_regs(s);
+   nir_foreach_function(func, s) {
+      if (func->impl) {
+         nir_index_local_regs(func->impl);
+         nir_index_ssa_defs(func->impl);
+         nir_index_blocks(func->impl);
+      }
+   }
+
+   char *buf = NULL;
+   size_t size = 0;
+   FILE *fp = open_memstream(&buf, &size);
+   nir_print_shader(s, fp);
+   fclose(fp);
+
+   std::string str(buf, size);
+   free(buf);
+   return str;
+}
+
+TEST_F(nir_serialize_test, variables_and_derefs)
+{
+   build_shader();
+
+   nir_shader *ns = NULL;
+   round_trip(b.shader, &ns);
+   if (HasFatalFailure()) {
+      ralloc_free(ns);
+      return;
+   }
+   EXPECT_EQ(print(b.shader), print(ns));
+   EXPECT_STREQ(b.shader->info.name, ns->info.name);
+
+   ralloc_free(ns);
+}
+
+TEST_F(nir_serialize_test, ssa_with_phis)
+{
+   build_shader();
+   nir_lower_vars_to_ssa(b.shader);
+   nir_validate_shader(b.shader);
+
+   nir_shader *ns = NULL;
+   round_trip(b.shader, &ns);
+   if (HasFatalFailure()) {
+      ralloc_free(ns);
+      return;
+   }
+   EXPECT_EQ(print(b.shader), print(ns));
+
+   ralloc_free(ns);
+}
+
+TEST_F(nir_serialize_test, registers)
+{
+   build_shader();
+   nir_lower_vars_to_ssa(b.shader);
+   nir_lower_locals_to_regs(b.shader);
+   nir_convert_from_ssa(b.shader, false);
+   nir_validate_shader(b.shader);
+
+   nir_shader *ns = NULL;
+   round_trip(b.shader, &ns);
+   if (HasFatalFailure()) {
+      ralloc_free(ns);
+      return;
+   }
+   EXPECT_EQ(print(b.shader), print(ns));
+
+   ralloc_free(ns);
+}
+
+TEST_F(nir_serialize_test, truncated)
+{
+   build_shader();
+   nir_serialize(first, b.shader);
+
+   struct blob_reader reader;
+   blob_reader_init(&reader, first->data, sizeof(uint32_t));
+   EXPECT_TRUE(nir_deserialize(NULL, &options, &reader) == NULL);
+
+   /* A blob written by a different version must be rejected up front */
+   uint32_t version = NIR_SERIALIZE_VERSION + 1;
+   blob_overwrite_bytes(first, 0, &version, sizeof(version));
+   blob_reader_init(&reader, first->data, first->size);
+   EXPECT_TRUE(nir_deserialize(NULL, &options, &reader) == NULL);
+}
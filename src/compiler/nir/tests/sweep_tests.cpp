@@ -0,0 +1,164 @@
+/*
+ * Copyright © 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include <set>
+#include <string>
+#include "nir.h"
+#include "nir_builder.h"
+
+class nir_sweep_test : public ::testing::Test {
+protected:
+   nir_sweep_test();
+   ~nir_sweep_test();
+
+   nir_ssa_def *build_chain(nir_ssa_def *x, nir_op op, unsigned live,
+                            unsigned dead);
+   std::set<nir_instr *> instrs();
+   std::string print();
+
+   nir_builder b;
+};
+
+static const nir_shader_compiler_options options = { };
+
+nir_sweep_test::nir_sweep_test()
+{
+   nir_builder_init_simple_shader(&b, NULL, MESA_SHADER_FRAGMENT, &options);
+}
+
+nir_sweep_test::~nir_sweep_test()
+{
+   ralloc_free(b.shader);
+}
+
+/* Emits a chain of \p live instructions feeding each other, with \p dead
+ * unused ones interleaved so that the pages they share empty out once dead
+ * code is removed.
+ */
+nir_ssa_def *
+nir_sweep_test::build_chain(nir_ssa_def *x, nir_op op, unsigned live,
+                            unsigned dead)
+{
+   unsigned stride = (live + dead) / live;
+
+   for (unsigned i = 0; i < live * stride; i++) {
+      nir_ssa_def *y = nir_build_alu(&b, op, x, nir_imm_float(&b, i),
+                                     NULL, NULL);
+      if (i % stride == 0)
+         x = y;
+   }
+   return x;
+}
+
+std::set<nir_instr *>
+nir_sweep_test::instrs()
+{
+   std::set<nir_instr *> set;
+
+   nir_foreach_block(block, b.impl) {
+      nir_foreach_instr(instr, block)
+         set.insert(instr);
+   }
+   return set;
+}
+
+std::string
+nir_sweep_test::print()
+{
+   nir_index_ssa_defs(b.impl);
+   nir_index_blocks(b.impl);
+
+   char *buf = NULL;
+   size_t size = 0;
+   FILE *fp = open_memstream(&buf, &size);
+   nir_print_shader(b.shader, fp);
+   fclose(fp);
+
+   std::string str(buf, size);
+   free(buf);
+   return str;
+}
+
+TEST_F(nir_sweep_test, compact_phis_and_uses)
+{
+   nir_variable *in = nir_variable_create(b.shader, nir_var_shader_in,
+                                          glsl_float_type(), "in");
+   nir_variable *out = nir_variable_create(b.shader, nir_var_shader_out,
+                                           glsl_float_type(), "out");
+
+   /* Create IR:
+    *
+    * x = in * ...;
+    * if (x < 0) t = x + ...; else e = x * ...;
+    * out = phi(t, e) + x;
+    *
+    * with most of the instructions in each block dead.
+    */
+   nir_ssa_def *x = build_chain(nir_load_var(&b, in), nir_op_fmul, 16, 2000);
+   nir_if *nif = nir_push_if(&b, nir_flt(&b, x, nir_imm_float(&b, 0.0)));
+   nir_ssa_def *t = build_chain(x, nir_op_fadd, 32, 1000);
+   nir_push_else(&b, nif);
+   nir_ssa_def *e = build_chain(x, nir_op_fmul, 32, 1000);
+   nir_pop_if(&b, nif);
+   nir_ssa_def *phi = nir_if_phi(&b, t, e);
+   nir_store_var(&b, out, nir_fadd(&b, phi, x), 0x1);
+
+   nir_validate_shader(b.shader);
+   ASSERT_TRUE(nir_opt_dce(b.shader));
+
+   std::string expected = print();
+   std::set<nir_instr *> before = instrs();
+
+   nir_sweep(b.shader);
+   nir_validate_shader(b.shader);
+
+   /* The sparse pages were evacuated, so some instructions have moved. */
+   std::set<nir_instr *> after = instrs();
+   unsigned moved = 0;
+   for (nir_instr *instr : after)
+      moved += !before.count(instr);
+   EXPECT_EQ(before.size(), after.size());
+   EXPECT_GT(moved, 0u);
+
+   /* The phi sources still point at the values coming out of each branch,
+    * and every use of an SSA value points back at it.
+    */
+   nir_block *after_if = nir_cf_node_as_block(nir_cf_node_next(&nif->cf_node));
+   nir_instr *phi_instr = nir_block_first_instr(after_if);
+   ASSERT_EQ(nir_instr_type_phi, phi_instr->type);
+   nir_foreach_phi_src(src, nir_instr_as_phi(phi_instr)) {
+      ASSERT_TRUE(src->src.is_ssa);
+      EXPECT_EQ(src->pred, src->src.ssa->parent_instr->block);
+   }
+
+   nir_foreach_block(block, b.impl) {
+      nir_foreach_instr(instr, block) {
+         nir_foreach_src(instr, [](nir_src *src, void *data) -> bool {
+               EXPECT_EQ(data, src->parent_instr);
+               return true;
+            }, instr);
+      }
+   }
+
+   EXPECT_EQ(expected, print());
+}
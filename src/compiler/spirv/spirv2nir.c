@@ -29,6 +29,10 @@
  * A simple executable that opens a SPIR-V shader, converts it to NIR, and
  * dumps out the result.  This should be useful for testing the
  * spirv_to_nir code.
+ *
+ * Usage: spirv2nir [-t] <file>
+ *
+ * With -t, the time spent in spirv_to_nir() is printed to stdout.
  */
 
 #include "spirv/nir_spirv.h"
@@ -40,15 +44,41 @@
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
+#include <time.h>
 
 #define WORD_SIZE 4
 
+static double
+get_time_ms(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
 int main(int argc, char **argv)
 {
-   int fd = open(argv[1], O_RDONLY);
+   const char *filename = NULL;
+   bool print_time = false;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-t") == 0)
+         print_time = true;
+      else
+         filename = argv[i];
+   }
+
+   if (filename == NULL)
+   {
+      fprintf(stderr, "Usage: %s [-t] <file>\n", argv[0]);
+      return 1;
+   }
+
+   int fd = open(filename, O_RDONLY);
    if (fd < 0)
    {
-      fprintf(stderr, "Failed to open %s\n", argv[1]);
+      fprintf(stderr, "Failed to open %s\n", filename);
       return 1;
    }
 
@@ -72,8 +102,17 @@ int main(int argc, char **argv)
       return 1;
    }
 
+   double start = get_time_ms();
    nir_function *func = spirv_to_nir(map, word_count, NULL, 0,
                                      MESA_SHADER_FRAGMENT, "main", NULL, NULL);
+   double end = get_time_ms();
+
+   if (print_time)
+   {
+      printf("%s: %zu words in %.3f ms\n", filename, word_count,
+             end - start);
+   }
+
    nir_print_shader(func->shader, stderr);
 
    return 0;
@@ -31,7 +31,7 @@ vtn_cfg_handle_prepass_instruction(struct vtn_builder *b, SpvOp opcode,
    switch (opcode) {
    case SpvOpFunction: {
       assert(b->func == NULL);
-      b->func = rzalloc(b, struct vtn_function);
+      b->func = vtn_zalloc(b, struct vtn_function);
 
       list_inithead(&b->func->body);
       b->func->control = w[3];
@@ -84,7 +84,7 @@ vtn_cfg_handle_prepass_instruction(struct vtn_builder *b, SpvOp opcode,
       nir_variable *param = b->func->impl->params[b->func_param_idx++];
 
       if (type->base_type == vtn_base_type_pointer && type->type == NULL) {
-         struct vtn_variable *vtn_var = rzalloc(b, struct vtn_variable);
+         struct vtn_variable *vtn_var = vtn_zalloc(b, struct vtn_variable);
          vtn_var->type = type->deref;
          vtn_var->var = param;
 
@@ -125,7 +125,7 @@ vtn_cfg_handle_prepass_instruction(struct vtn_builder *b, SpvOp opcode,
 
    case SpvOpLabel: {
       assert(b->block == NULL);
-      b->block = rzalloc(b, struct vtn_block);
+      b->block = vtn_zalloc(b, struct vtn_block);
       b->block->node.type = vtn_cf_node_type_block;
       b->block->label = w;
       vtn_push_value(b, w[1], vtn_value_type_block)->block = b->block;
@@ -180,7 +180,7 @@ vtn_add_case(struct vtn_builder *b, struct vtn_switch *swtch,
       return;
 
    if (case_block->switch_case == NULL) {
-      struct vtn_case *c = ralloc(b, struct vtn_case);
+      struct vtn_case *c = vtn_alloc(b, struct vtn_case);
 
       list_inithead(&c->body);
       c->start_block = case_block;
@@ -263,7 +263,7 @@ vtn_cfg_walk_blocks(struct vtn_builder *b, struct list_head *cf_list,
    while (block != end) {
       if (block->merge && (*block->merge & SpvOpCodeMask) == SpvOpLoopMerge &&
           !block->loop) {
-         struct vtn_loop *loop = ralloc(b, struct vtn_loop);
+         struct vtn_loop *loop = vtn_alloc(b, struct vtn_loop);
 
          loop->node.type = vtn_cf_node_type_loop;
          list_inithead(&loop->body);
@@ -335,7 +335,7 @@ vtn_cfg_walk_blocks(struct vtn_builder *b, struct list_head *cf_list,
          struct vtn_block *else_block =
             vtn_value(b, block->branch[3], vtn_value_type_block)->block;
 
-         struct vtn_if *if_stmt = ralloc(b, struct vtn_if);
+         struct vtn_if *if_stmt = vtn_alloc(b, struct vtn_if);
 
          if_stmt->node.type = vtn_cf_node_type_if;
          if_stmt->condition = block->branch[1];
@@ -412,7 +412,7 @@ vtn_cfg_walk_blocks(struct vtn_builder *b, struct list_head *cf_list,
          struct vtn_block *break_block =
             vtn_value(b, block->merge[1], vtn_value_type_block)->block;
 
-         struct vtn_switch *swtch = ralloc(b, struct vtn_switch);
+         struct vtn_switch *swtch = vtn_alloc(b, struct vtn_switch);
 
          swtch->node.type = vtn_cf_node_type_switch;
          swtch->selector = block->branch[1];
@@ -491,6 +491,11 @@ vtn_build_cfg(struct vtn_builder *b, const uint32_t *words, const uint32_t *end)
    }
 }
 
+struct vtn_phi {
+   const uint32_t *w;
+   nir_variable *var;
+};
+
 static bool
 vtn_handle_phis_first_pass(struct vtn_builder *b, SpvOp opcode,
                            const uint32_t *w, unsigned count)
@@ -516,7 +521,8 @@ vtn_handle_phis_first_pass(struct vtn_builder *b, SpvOp opcode,
    struct vtn_type *type = vtn_value(b, w[1], vtn_value_type_type)->type;
    nir_variable *phi_var =
       nir_local_variable_create(b->nb.impl, type->type, "phi");
-   _mesa_hash_table_insert(b->phi_table, w, phi_var);
+   struct vtn_phi phi = { .w = w, .var = phi_var };
+   util_dynarray_append(&b->phis, struct vtn_phi, phi);
 
    vtn_push_ssa(b, w[2], type,
                 vtn_local_load(b, nir_deref_var_create(b, phi_var)));
@@ -524,16 +530,11 @@ vtn_handle_phis_first_pass(struct vtn_builder *b, SpvOp opcode,
    return true;
 }
 
-static bool
-vtn_handle_phi_second_pass(struct vtn_builder *b, SpvOp opcode,
-                           const uint32_t *w, unsigned count)
+static void
+vtn_handle_phi_second_pass(struct vtn_builder *b, const uint32_t *w,
+                           nir_variable *phi_var)
 {
-   if (opcode != SpvOpPhi)
-      return true;
-
-   struct hash_entry *phi_entry = _mesa_hash_table_search(b->phi_table, w);
-   assert(phi_entry);
-   nir_variable *phi_var = phi_entry->data;
+   unsigned count = w[0] >> SpvWordCountShift;
 
    for (unsigned i = 3; i < count; i += 2) {
       struct vtn_block *pred =
@@ -545,8 +546,13 @@ vtn_handle_phi_second_pass(struct vtn_builder *b, SpvOp opcode,
 
       vtn_local_store(b, src, nir_deref_var_create(b, phi_var));
    }
+}
 
-   return true;
+static int
+compare_phi_position(const void *_a, const void *_b)
+{
+   const struct vtn_phi *a = _a, *b = _b;
+   return a->w < b->w ? -1 : a->w > b->w;
 }
 
 static void
@@ -769,13 +775,20 @@ vtn_function_emit(struct vtn_builder *b, struct vtn_function *func,
    nir_builder_init(&b->nb, func->impl);
    b->nb.cursor = nir_after_cf_list(&func->impl->body);
    b->has_loop_continue = false;
-   b->phi_table = _mesa_hash_table_create(b, _mesa_hash_pointer,
-                                          _mesa_key_pointer_equal);
+   util_dynarray_clear(&b->phis);
 
    vtn_emit_cf_list(b, &func->body, NULL, NULL, instruction_handler);
 
-   vtn_foreach_instruction(b, func->start_block->label, func->end,
-                           vtn_handle_phi_second_pass);
+   /* Every phi was recorded by the first pass, so there's no need to walk
+    * the function again.  They're recorded in the order the blocks were
+    * emitted though, so sort them back into module order, which is the
+    * order the stores to each predecessor end up in.
+    */
+   unsigned num_phis = b->phis.size / sizeof(struct vtn_phi);
+   struct vtn_phi *phis = util_dynarray_begin(&b->phis);
+   qsort(phis, num_phis, sizeof(*phis), compare_phi_position);
+   for (unsigned i = 0; i < num_phis; i++)
+      vtn_handle_phi_second_pass(b, phis[i].w, phis[i].var);
 
    /* Continue blocks for loops get inserted before the body of the loop
     * but instructions in the continue may use SSA defs in the loop body.
@@ -482,10 +482,11 @@ struct vtn_builder {
    struct hash_table *const_table;
 
    /*
-    * Map from phi instructions (pointer to the start of the instruction)
-    * to the variable corresponding to it.
+    * The phi instructions of the current function (pointers to the start of
+    * the instruction) and the variables they have been lowered to, as
+    * struct vtn_phi.
     */
-   struct hash_table *phi_table;
+   struct util_dynarray phis;
 
    unsigned num_specializations;
    struct nir_spirv_specialization *specializations;
@@ -506,8 +507,26 @@ struct vtn_builder {
    unsigned func_param_idx;
 
    bool has_loop_continue;
+
+   /* Linear allocator for everything that lives exactly as long as the
+    * builder, see vtn_alloc() and friends.
+    */
+   void *lin_ctx;
 };
 
+/* Allocations that are only freed along with the builder.  These come
+ * from a linear allocator, so they can't be freed, reallocated or used as
+ * ralloc contexts.
+ */
+#define vtn_alloc(b, type) \
+   ((type *) linear_alloc_child((b)->lin_ctx, sizeof(type)))
+#define vtn_zalloc(b, type) \
+   ((type *) linear_zalloc_child((b)->lin_ctx, sizeof(type)))
+#define vtn_alloc_array(b, type, count) \
+   ((type *) linear_alloc_child((b)->lin_ctx, sizeof(type) * (count)))
+#define vtn_zalloc_array(b, type, count) \
+   ((type *) linear_zalloc_child((b)->lin_ctx, sizeof(type) * (count)))
+
 nir_ssa_def *
 vtn_pointer_to_ssa(struct vtn_builder *b, struct vtn_pointer *ptr);
 struct vtn_pointer *
@@ -36,7 +36,7 @@ vtn_access_chain_create(struct vtn_builder *b, unsigned length)
    /* Subtract 1 from the length since there's already one built in */
    size_t size = sizeof(*chain) +
                  (MAX2(length, 1) - 1) * sizeof(chain->link[0]);
-   chain = rzalloc_size(b, size);
+   chain = linear_zalloc_child(b->lin_ctx, size);
    chain->length = length;
 
    return chain;
@@ -85,7 +85,7 @@ vtn_access_chain_pointer_dereference(struct vtn_builder *b,
       }
    }
 
-   struct vtn_pointer *ptr = rzalloc(b, struct vtn_pointer);
+   struct vtn_pointer *ptr = vtn_zalloc(b, struct vtn_pointer);
    ptr->mode = base->mode;
    ptr->type = type;
    ptr->var = base->var;
@@ -213,7 +213,7 @@ vtn_ssa_offset_pointer_dereference(struct vtn_builder *b,
       }
    }
 
-   struct vtn_pointer *ptr = rzalloc(b, struct vtn_pointer);
+   struct vtn_pointer *ptr = vtn_zalloc(b, struct vtn_pointer);
    ptr->mode = base->mode;
    ptr->type = type;
    ptr->block_index = block_index;
@@ -254,7 +254,7 @@ struct vtn_pointer *
 vtn_pointer_for_variable(struct vtn_builder *b,
                          struct vtn_variable *var, struct vtn_type *ptr_type)
 {
-   struct vtn_pointer *pointer = rzalloc(b, struct vtn_pointer);
+   struct vtn_pointer *pointer = vtn_zalloc(b, struct vtn_pointer);
 
    pointer->mode = var->mode;
    pointer->type = var->type;
@@ -896,9 +896,9 @@ _vtn_variable_load_store(struct vtn_builder *b, bool load,
       unsigned elems = glsl_get_length(ptr->type->type);
       if (load) {
          assert(*inout == NULL);
-         *inout = rzalloc(b, struct vtn_ssa_value);
+         *inout = vtn_zalloc(b, struct vtn_ssa_value);
          (*inout)->type = ptr->type->type;
-         (*inout)->elems = rzalloc_array(b, struct vtn_ssa_value *, elems);
+         (*inout)->elems = vtn_zalloc_array(b, struct vtn_ssa_value *, elems);
       }
 
       struct vtn_access_chain chain = {
@@ -1521,7 +1521,7 @@ vtn_pointer_from_ssa(struct vtn_builder *b, nir_ssa_def *ssa,
    /* This pointer type needs to have actual storage */
    assert(ptr_type->type);
 
-   struct vtn_pointer *ptr = rzalloc(b, struct vtn_pointer);
+   struct vtn_pointer *ptr = vtn_zalloc(b, struct vtn_pointer);
    ptr->mode = vtn_storage_class_to_mode(ptr_type->storage_class,
                                          ptr_type, NULL);
    ptr->type = ptr_type->deref;
@@ -1587,7 +1587,7 @@ vtn_create_variable(struct vtn_builder *b, struct vtn_value *val,
       break;
    }
 
-   struct vtn_variable *var = rzalloc(b, struct vtn_variable);
+   struct vtn_variable *var = vtn_zalloc(b, struct vtn_variable);
    var->type = type;
    var->mode = mode;
 
@@ -1667,7 +1667,7 @@ vtn_create_variable(struct vtn_builder *b, struct vtn_value *val,
       if (glsl_type_is_struct(interface_type->type)) {
          /* It's a struct.  Split it. */
          unsigned num_members = glsl_get_length(interface_type->type);
-         var->members = ralloc_array(b, nir_variable *, num_members);
+         var->members = vtn_alloc_array(b, nir_variable *, num_members);
 
          for (unsigned i = 0; i < num_members; i++) {
             const struct glsl_type *mtype = interface_type->members[i]->type;
@@ -1804,7 +1804,7 @@ vtn_handle_variables(struct vtn_builder *b, SpvOp opcode,
           */
          struct vtn_value *val =
             vtn_push_value(b, w[2], vtn_value_type_sampled_image);
-         val->sampled_image = ralloc(b, struct vtn_sampled_image);
+         val->sampled_image = vtn_alloc(b, struct vtn_sampled_image);
          val->sampled_image->image =
             vtn_pointer_dereference(b, base_val->sampled_image->image, chain);
          val->sampled_image->sampler = base_val->sampled_image->sampler;
@@ -0,0 +1,679 @@
+/*
+ * Copyright © 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file shader_cache_warm.c
+ *
+ * Fills the shader cache ahead of time by compiling and linking programs
+ * captured with MESA_GLSL_CACHE_CAPTURE_PATH (or MESA_SHADER_CAPTURE_PATH)
+ * in headless EGL contexts.  Everything the driver stores in the cache while
+ * linking ends up in the cache directory, keyed by that driver build and GPU
+ * just like it would be for the application, so the directory can be copied
+ * to other machines with the same driver and GPU.
+ *
+ * Usage: shader_cache_warm [-j jobs] [-o cache dir] file or directory...
+ */
+
+#include <dlfcn.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include "util/disk_cache.h"
+#include "util/macros.h"
+
+#define MAX_SHADERS 16
+#define MAX_NAME_LENGTH 1024
+
+enum api {
+   API_COMPAT,
+   API_CORE,
+   API_ES,
+   API_COUNT
+};
+
+static const char *api_names[API_COUNT] = { "compat", "core", "es" };
+
+static const struct {
+   const char *name;
+   GLenum type;
+} stages[] = {
+   { "vertex shader", GL_VERTEX_SHADER },
+   { "tessellation control shader", GL_TESS_CONTROL_SHADER },
+   { "tessellation evaluation shader", GL_TESS_EVALUATION_SHADER },
+   { "geometry shader", GL_GEOMETRY_SHADER },
+   { "fragment shader", GL_FRAGMENT_SHADER },
+   { "compute shader", GL_COMPUTE_SHADER },
+};
+
+/* libEGL is loaded at run time, so that the tool works the same with and
+ * without libglvnd.
+ */
+static struct {
+   EGLint (EGLAPIENTRY *GetError)(void);
+   EGLBoolean (EGLAPIENTRY *Initialize)(EGLDisplay, EGLint *, EGLint *);
+   EGLBoolean (EGLAPIENTRY *Terminate)(EGLDisplay);
+   EGLBoolean (EGLAPIENTRY *BindAPI)(EGLenum);
+   EGLContext (EGLAPIENTRY *CreateContext)(EGLDisplay, EGLConfig,
+                                           EGLContext, const EGLint *);
+   EGLBoolean (EGLAPIENTRY *DestroyContext)(EGLDisplay, EGLContext);
+   EGLBoolean (EGLAPIENTRY *MakeCurrent)(EGLDisplay, EGLSurface,
+                                         EGLSurface, EGLContext);
+   EGLBoolean (EGLAPIENTRY *ReleaseThread)(void);
+   __eglMustCastToProperFunctionPointerType
+      (EGLAPIENTRY *GetProcAddress)(const char *);
+   PFNEGLGETPLATFORMDISPLAYEXTPROC GetPlatformDisplayEXT;
+} egl;
+
+static struct {
+   const GLubyte *(GLAPIENTRY *GetString)(GLenum);
+   PFNGLCREATESHADERPROC CreateShader;
+   PFNGLSHADERSOURCEPROC ShaderSource;
+   PFNGLCOMPILESHADERPROC CompileShader;
+   PFNGLGETSHADERIVPROC GetShaderiv;
+   PFNGLGETSHADERINFOLOGPROC GetShaderInfoLog;
+   PFNGLATTACHSHADERPROC AttachShader;
+   PFNGLDELETESHADERPROC DeleteShader;
+   PFNGLCREATEPROGRAMPROC CreateProgram;
+   PFNGLPROGRAMPARAMETERIPROC ProgramParameteri;
+   PFNGLBINDATTRIBLOCATIONPROC BindAttribLocation;
+   PFNGLBINDFRAGDATALOCATIONINDEXEDPROC BindFragDataLocationIndexed;
+   PFNGLLINKPROGRAMPROC LinkProgram;
+   PFNGLGETPROGRAMIVPROC GetProgramiv;
+   PFNGLGETPROGRAMINFOLOGPROC GetProgramInfoLog;
+   PFNGLDELETEPROGRAMPROC DeleteProgram;
+} gl;
+
+struct shader_test {
+   unsigned glsl_version;
+   bool es;
+   bool sso;
+   bool arb_program;
+   bool has_api;
+   enum api api;
+
+   /* Contents of the [cache key] section, if any */
+   const char *cache_key;
+
+   unsigned num_shaders;
+   GLenum types[MAX_SHADERS];
+   const char *sources[MAX_SHADERS];
+};
+
+struct stats {
+   unsigned linked;
+   unsigned failed;
+   unsigned skipped;
+};
+
+struct worker {
+   unsigned index;
+   EGLDisplay dpy;
+   EGLContext ctx[API_COUNT];
+   bool ctx_failed[API_COUNT];
+   int current;
+};
+
+static char **files;
+static unsigned num_files;
+
+static void
+usage(const char *name)
+{
+   fprintf(stderr,
+           "Usage: %s [-j jobs] [-o cache dir] file or directory...\n\n"
+           "Compiles and links the programs in the given .shader_test files,\n"
+           "or in all .shader_test files below the given directories, to\n"
+           "populate the shader cache. A cache using MESA_GLSL_CACHE_PACK\n"
+           "is compacted afterwards.\n\n"
+           "  -j jobs        number of processes to compile with\n"
+           "  -o cache dir   cache directory to fill, instead of the one\n"
+           "                 applications use by default\n",
+           name);
+}
+
+static int
+add_file(const char *path, const struct stat *st, int type, struct FTW *ftw)
+{
+   size_t len = strlen(path);
+   static const char suffix[] = ".shader_test";
+
+   if (type != FTW_F)
+      return 0;
+
+   /* Files that were named explicitly are taken as they are */
+   if (ftw->level > 0 &&
+       (len < strlen(suffix) || strcmp(path + len - strlen(suffix), suffix)))
+      return 0;
+
+   files = realloc(files, (num_files + 1) * sizeof(*files));
+   if (!files)
+      return -1;
+
+   files[num_files++] = strdup(path);
+   return 0;
+}
+
+static int
+compare_paths(const void *a, const void *b)
+{
+   return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+static char *
+read_file(const char *path)
+{
+   struct stat st;
+   FILE *file = fopen(path, "r");
+   char *text = NULL;
+
+   if (!file)
+      return NULL;
+
+   if (fstat(fileno(file), &st) == 0) {
+      text = malloc(st.st_size + 1);
+      if (text && fread(text, 1, st.st_size, file) == (size_t) st.st_size) {
+         text[st.st_size] = '\0';
+      } else {
+         free(text);
+         text = NULL;
+      }
+   }
+
+   fclose(file);
+   return text;
+}
+
+/**
+ * Find the next section header, which starts with a '[' at the beginning of
+ * a line.
+ */
+static char *
+next_section(char *p)
+{
+   if (*p == '[')
+      return p;
+
+   p = strstr(p, "\n[");
+   return p ? p + 1 : NULL;
+}
+
+static const char *
+next_line(const char *line)
+{
+   const char *end = strchr(line, '\n');
+   return end ? end + 1 : line + strlen(line);
+}
+
+/**
+ * Split \p text into sections in place and collect what is needed to replay
+ * the program.
+ */
+static bool
+parse_shader_test(char *text, struct shader_test *t)
+{
+   char *section = next_section(text);
+
+   memset(t, 0, sizeof(*t));
+
+   while (section) {
+      char *name = section + 1;
+      char *end = strchr(name, ']');
+      char *body;
+
+      if (!end)
+         return false;
+
+      *end = '\0';
+      body = strchr(end + 1, '\n');
+      body = body ? body + 1 : end + 1 + strlen(end + 1);
+
+      /* Terminate the body where the next header starts */
+      section = next_section(body);
+      if (section)
+         *section = '\0';
+
+      if (strcmp(name, "require") == 0) {
+         for (const char *line = body; *line; line = next_line(line)) {
+            unsigned major, minor;
+
+            if (sscanf(line, "GLSL ES >= %u.%u", &major, &minor) == 2) {
+               t->es = true;
+               t->glsl_version = major * 100 + minor;
+            } else if (sscanf(line, "GLSL >= %u.%u", &major, &minor) == 2) {
+               t->glsl_version = major * 100 + minor;
+            } else if (strncmp(line, "SSO ENABLED", 11) == 0) {
+               t->sso = true;
+            }
+         }
+      } else if (strcmp(name, "cache key") == 0) {
+         t->cache_key = body;
+
+         for (const char *line = body; *line; line = next_line(line)) {
+            for (unsigned i = 0; i < API_COUNT; i++) {
+               size_t len = strlen(api_names[i]);
+
+               if (strncmp(line, "api ", 4) == 0 &&
+                   strncmp(line + 4, api_names[i], len) == 0 &&
+                   (line[4 + len] == '\n' || line[4 + len] == '\0')) {
+                  t->api = i;
+                  t->has_api = true;
+               }
+            }
+         }
+      } else if (strcmp(name, "vertex program") == 0 ||
+                 strcmp(name, "fragment program") == 0) {
+         t->arb_program = true;
+      } else {
+         for (unsigned i = 0; i < ARRAY_SIZE(stages); i++) {
+            if (strcmp(name, stages[i].name) != 0)
+               continue;
+
+            if (t->num_shaders == MAX_SHADERS)
+               return false;
+
+            t->types[t->num_shaders] = stages[i].type;
+            t->sources[t->num_shaders] = body;
+            t->num_shaders++;
+         }
+      }
+   }
+
+   /* Plain shader-db captures don't record the API.  Mesa only exposes
+    * GLSL 1.40 and later in core profile contexts.
+    */
+   if (!t->has_api) {
+      t->api = t->es ? API_ES :
+               t->glsl_version >= 140 ? API_CORE : API_COMPAT;
+   }
+
+   return true;
+}
+
+static bool
+make_current(struct worker *w, enum api api)
+{
+   static const EGLint compat_attribs[] = { EGL_NONE };
+   static const EGLint core_attribs[] = {
+      EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+      EGL_CONTEXT_MINOR_VERSION_KHR, 2,
+      EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR,
+      EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+      EGL_NONE
+   };
+   static const EGLint es3_attribs[] = {
+      EGL_CONTEXT_CLIENT_VERSION, 3,
+      EGL_NONE
+   };
+   static const EGLint es2_attribs[] = {
+      EGL_CONTEXT_CLIENT_VERSION, 2,
+      EGL_NONE
+   };
+
+   if (w->current == (int) api)
+      return true;
+
+   if (w->ctx_failed[api])
+      return false;
+
+   /* Contexts of the two client APIs are tracked separately by EGL, so drop
+    * the current one explicitly before switching.
+    */
+   if (w->current >= 0) {
+      egl.BindAPI(w->current == API_ES ? EGL_OPENGL_ES_API : EGL_OPENGL_API);
+      egl.MakeCurrent(w->dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+      w->current = -1;
+   }
+
+   egl.BindAPI(api == API_ES ? EGL_OPENGL_ES_API : EGL_OPENGL_API);
+
+   if (w->ctx[api] == EGL_NO_CONTEXT) {
+      const EGLint *attribs = api == API_CORE ? core_attribs :
+                              api == API_ES ? es3_attribs : compat_attribs;
+
+      w->ctx[api] = egl.CreateContext(w->dpy, EGL_NO_CONFIG_KHR,
+                                      EGL_NO_CONTEXT, attribs);
+      if (w->ctx[api] == EGL_NO_CONTEXT && api == API_ES) {
+         w->ctx[api] = egl.CreateContext(w->dpy, EGL_NO_CONFIG_KHR,
+                                         EGL_NO_CONTEXT, es2_attribs);
+      }
+
+      if (w->ctx[api] == EGL_NO_CONTEXT) {
+         fprintf(stderr, "Failed to create a %s context (0x%x), skipping "
+                 "its programs\n", api_names[api], egl.GetError());
+         w->ctx_failed[api] = true;
+         return false;
+      }
+   }
+
+   if (!egl.MakeCurrent(w->dpy, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                        w->ctx[api])) {
+      fprintf(stderr, "Failed to make the %s context current (0x%x)\n",
+              api_names[api], egl.GetError());
+      w->ctx_failed[api] = true;
+      return false;
+   }
+
+   w->current = api;
+   return true;
+}
+
+static bool
+compile_and_link(const char *path, const struct shader_test *t)
+{
+   GLuint prog = gl.CreateProgram();
+   GLint status;
+   char log[4096];
+
+   for (unsigned i = 0; i < t->num_shaders; i++) {
+      GLuint shader = gl.CreateShader(t->types[i]);
+
+      gl.ShaderSource(shader, 1, &t->sources[i], NULL);
+      gl.CompileShader(shader);
+      gl.GetShaderiv(shader, GL_COMPILE_STATUS, &status);
+      if (!status) {
+         gl.GetShaderInfoLog(shader, sizeof(log), NULL, log);
+         fprintf(stderr, "%s: failed to compile:\n%s\n", path, log);
+      }
+
+      gl.AttachShader(prog, shader);
+      gl.DeleteShader(shader);
+   }
+
+   if (t->sso)
+      gl.ProgramParameteri(prog, GL_PROGRAM_SEPARABLE, GL_TRUE);
+
+   /* The bindings are part of the program's cache key */
+   if (t->cache_key) {
+      for (const char *line = t->cache_key; *line; line = next_line(line)) {
+         char name[MAX_NAME_LENGTH];
+         unsigned location, index;
+
+         if (sscanf(line, "attribute location %u %1023s",
+                    &location, name) == 2) {
+            gl.BindAttribLocation(prog, location, name);
+         } else if (sscanf(line, "frag data location %u %u %1023s",
+                           &location, &index, name) == 3) {
+            gl.BindFragDataLocationIndexed(prog, location, index, name);
+         }
+      }
+   }
+
+   gl.LinkProgram(prog);
+   gl.GetProgramiv(prog, GL_LINK_STATUS, &status);
+   if (!status) {
+      gl.GetProgramInfoLog(prog, sizeof(log), NULL, log);
+      fprintf(stderr, "%s: failed to link:\n%s\n", path, log);
+   }
+
+   gl.DeleteProgram(prog);
+
+   return status;
+}
+
+static void
+run_worker(struct worker *w, unsigned num_workers, struct stats *stats)
+{
+   EGLint major, minor;
+
+   w->current = -1;
+
+   w->dpy = egl.GetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA,
+                                      EGL_DEFAULT_DISPLAY, NULL);
+   if (w->dpy == EGL_NO_DISPLAY || !egl.Initialize(w->dpy, &major, &minor)) {
+      fprintf(stderr, "Failed to initialize the surfaceless EGL display "
+              "(0x%x)\n", egl.GetError());
+      stats->skipped = (num_files - w->index + num_workers - 1) / num_workers;
+      return;
+   }
+
+   for (unsigned i = w->index; i < num_files; i += num_workers) {
+      struct shader_test t;
+      char *text = read_file(files[i]);
+
+      if (!text) {
+         fprintf(stderr, "%s: failed to read\n", files[i]);
+         stats->failed++;
+         continue;
+      }
+
+      if (!parse_shader_test(text, &t)) {
+         fprintf(stderr, "%s: failed to parse\n", files[i]);
+         stats->failed++;
+      } else if (t.arb_program || t.num_shaders == 0) {
+         /* ARB programs don't go through the shader cache */
+         stats->skipped++;
+      } else if (!make_current(w, t.api)) {
+         stats->skipped++;
+      } else if (compile_and_link(files[i], &t)) {
+         stats->linked++;
+      } else {
+         stats->failed++;
+      }
+
+      free(text);
+   }
+
+   if (w->index == 0 && w->current >= 0) {
+      printf("%s, %s\n", gl.GetString(GL_RENDERER), gl.GetString(GL_VERSION));
+   }
+
+   /* Destroying the display is what makes the driver write out the cache
+    * entries it still has queued.
+    */
+   egl.MakeCurrent(w->dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+   for (unsigned i = 0; i < API_COUNT; i++) {
+      if (w->ctx[i] != EGL_NO_CONTEXT)
+         egl.DestroyContext(w->dpy, w->ctx[i]);
+   }
+   egl.Terminate(w->dpy);
+   egl.ReleaseThread();
+}
+
+static bool
+load_egl(void)
+{
+   void *handle = dlopen("libEGL.so.1", RTLD_NOW | RTLD_GLOBAL);
+
+   if (!handle) {
+      fprintf(stderr, "Failed to load libEGL.so.1: %s\n", dlerror());
+      return false;
+   }
+
+#define LOAD(table, name, prefix) \
+   (*(void **) &table.name = dlsym(handle, prefix #name))
+
+   if (!LOAD(egl, GetError, "egl") ||
+       !LOAD(egl, Initialize, "egl") ||
+       !LOAD(egl, Terminate, "egl") ||
+       !LOAD(egl, BindAPI, "egl") ||
+       !LOAD(egl, CreateContext, "egl") ||
+       !LOAD(egl, DestroyContext, "egl") ||
+       !LOAD(egl, MakeCurrent, "egl") ||
+       !LOAD(egl, ReleaseThread, "egl") ||
+       !LOAD(egl, GetProcAddress, "egl")) {
+      fprintf(stderr, "libEGL.so.1 lacks EGL 1.4 entry points\n");
+      return false;
+   }
+#undef LOAD
+
+#define LOAD(table, name, prefix) \
+   (*(void **) &table.name = (void *) egl.GetProcAddress(prefix #name))
+
+   if (!LOAD(egl, GetPlatformDisplayEXT, "egl")) {
+      fprintf(stderr, "EGL_EXT_platform_base is not supported\n");
+      return false;
+   }
+
+   /* Mesa hands out every GL entry point this way (as required by
+    * EGL_KHR_get_all_proc_addresses), whatever context is current later.
+    */
+   if (!LOAD(gl, GetString, "gl") ||
+       !LOAD(gl, CreateShader, "gl") ||
+       !LOAD(gl, ShaderSource, "gl") ||
+       !LOAD(gl, CompileShader, "gl") ||
+       !LOAD(gl, GetShaderiv, "gl") ||
+       !LOAD(gl, GetShaderInfoLog, "gl") ||
+       !LOAD(gl, AttachShader, "gl") ||
+       !LOAD(gl, DeleteShader, "gl") ||
+       !LOAD(gl, CreateProgram, "gl") ||
+       !LOAD(gl, ProgramParameteri, "gl") ||
+       !LOAD(gl, BindAttribLocation, "gl") ||
+       !LOAD(gl, BindFragDataLocationIndexed, "gl") ||
+       !LOAD(gl, LinkProgram, "gl") ||
+       !LOAD(gl, GetProgramiv, "gl") ||
+       !LOAD(gl, GetProgramInfoLog, "gl") ||
+       !LOAD(gl, DeleteProgram, "gl")) {
+      fprintf(stderr, "Failed to look up GL entry points\n");
+      return false;
+   }
+#undef LOAD
+
+   return true;
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned num_workers = 1;
+   struct stats *stats, total = { 0 };
+   bool started = true;
+   int opt;
+
+   while ((opt = getopt(argc, argv, "j:o:h")) != -1) {
+      switch (opt) {
+      case 'j':
+         num_workers = strtoul(optarg, NULL, 0);
+         if (num_workers == 0) {
+            usage(argv[0]);
+            return 1;
+         }
+         break;
+      case 'o':
+         setenv("MESA_GLSL_CACHE_DIR", optarg, 1);
+         break;
+      default:
+         usage(argv[0]);
+         return opt == 'h' ? 0 : 1;
+      }
+   }
+
+   if (optind >= argc) {
+      usage(argv[0]);
+      return 1;
+   }
+
+   for (int i = optind; i < argc; i++) {
+      if (nftw(argv[i], add_file, 16, 0) != 0) {
+         fprintf(stderr, "Failed to read %s\n", argv[i]);
+         return 1;
+      }
+   }
+
+   if (num_files == 0) {
+      fprintf(stderr, "No .shader_test files found\n");
+      return 1;
+   }
+   qsort(files, num_files, sizeof(*files), compare_paths);
+
+   /* Filling the cache is the point, and the replayed programs must not be
+    * captured a second time.
+    */
+   unsetenv("MESA_GLSL_CACHE_DISABLE");
+   unsetenv("MESA_GLSL_CACHE_CAPTURE_PATH");
+   unsetenv("MESA_SHADER_CAPTURE_PATH");
+
+   if (!load_egl())
+      return 1;
+
+   if (num_workers > num_files)
+      num_workers = num_files;
+
+   stats = mmap(NULL, num_workers * sizeof(*stats), PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   if (stats == MAP_FAILED) {
+      fprintf(stderr, "Out of memory\n");
+      return 1;
+   }
+   memset(stats, 0, num_workers * sizeof(*stats));
+
+   if (num_workers == 1) {
+      struct worker w = { 0 };
+      run_worker(&w, 1, &stats[0]);
+   } else {
+      /* Every process gets its own display, and with it its own driver
+       * screen, so programs are compiled in parallel.
+       */
+      for (unsigned i = 0; i < num_workers; i++) {
+         pid_t pid = fork();
+
+         if (pid == 0) {
+            struct worker w = { 0 };
+            w.index = i;
+            run_worker(&w, num_workers, &stats[i]);
+            exit(0);
+         } else if (pid < 0) {
+            fprintf(stderr, "Failed to start worker %u\n", i);
+            num_workers = i;
+            started = false;
+            break;
+         }
+      }
+
+      while (wait(NULL) > 0)
+         ;
+   }
+
+   for (unsigned i = 0; i < num_workers; i++) {
+      total.linked += stats[i].linked;
+      total.failed += stats[i].failed;
+      total.skipped += stats[i].skipped;
+   }
+
+   printf("%u programs linked, %u failed, %u skipped\n",
+          total.linked, total.failed, total.skipped);
+
+   /* Rewrite a pack file without its removed and evicted items. The new
+    * pack is renamed into place, so applications using the cache at the
+    * same time keep reading their old mapping. The pack is shared by all
+    * drivers, so there's no need to know which one ran.
+    */
+   struct disk_cache *cache = disk_cache_create("", "", 0);
+   if (cache) {
+      disk_cache_compact(cache);
+      disk_cache_destroy(cache);
+   }
+
+   return total.failed || !started ? 1 : 0;
+}
@@ -629,6 +629,8 @@ generate_vs(struct draw_llvm_variant *variant,
                      NULL,
                      draw_sampler,
                      &llvm->draw->vs.vertex_shader->info,
+                     NULL,
+                     NULL,
                      NULL);
 
    {
@@ -2356,7 +2358,9 @@ draw_gs_llvm_generate(struct draw_llvm *llvm,
                      NULL,
                      sampler,
                      &llvm->draw->gs.geometry_shader->info,
-                     (const struct lp_build_tgsi_gs_iface *)&gs_iface);
+                     (const struct lp_build_tgsi_gs_iface *)&gs_iface,
+                     NULL,
+                     NULL);
 
    sampler->destroy(sampler);
 
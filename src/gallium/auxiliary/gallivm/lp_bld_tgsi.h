@@ -67,6 +67,8 @@ struct lp_build_mask_context;
 struct gallivm_state;
 struct lp_derivatives;
 struct lp_build_tgsi_gs_iface;
+struct lp_build_tgsi_tess_iface;
+struct lp_build_tgsi_cs_iface;
 
 
 enum lp_build_tex_modifier {
@@ -170,6 +172,13 @@ struct lp_bld_tgsi_system_values {
    LLVMValueRef prim_id;
    LLVMValueRef basevertex;
    LLVMValueRef invocation_id;
+   LLVMValueRef vertices_in;
+   LLVMValueRef tess_coord[3];
+   LLVMValueRef tess_outer[4];
+   LLVMValueRef tess_inner[2];
+   LLVMValueRef block_id[3];
+   LLVMValueRef grid_size[3];
+   LLVMValueRef block_size[3];
 };
 
 
@@ -230,7 +239,18 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                   LLVMValueRef thread_data_ptr,
                   struct lp_build_sampler_soa *sampler,
                   const struct tgsi_shader_info *info,
-                  const struct lp_build_tgsi_gs_iface *gs_iface);
+                  const struct lp_build_tgsi_gs_iface *gs_iface,
+                  const struct lp_build_tgsi_tess_iface *tess_iface,
+                  const struct lp_build_tgsi_cs_iface *cs_iface);
+
+
+unsigned
+lp_build_tgsi_soa_spill_size(const struct tgsi_shader_info *info,
+                             struct lp_type type);
+
+
+boolean
+lp_build_tgsi_soa_barriers_supported(const struct tgsi_token *tokens);
 
 
 void
@@ -429,6 +449,83 @@ struct lp_build_tgsi_gs_iface
                        LLVMValueRef emitted_prims_vec);
 };
 
+/**
+ * Tessellation shader I/O interface.
+ *
+ * Control shader inputs and outputs, and evaluation shader inputs, live in
+ * driver-defined patch storage, so fetches and stores for those registers
+ * are delegated to the driver.  A NULL vertex_index denotes a per-patch
+ * register.  Only the callbacks relevant to the shader stage being
+ * translated need to be provided.
+ *
+ * If the invocations of a control shader patch don't all fit in one SIMD
+ * vector, the driver runs them as a loop over SIMD-wide chunks, opened and
+ * closed by loop_begin/loop_end like for compute shaders.  loop_begin
+ * returns the invocation ids of the chunk.  A BARRIER then re-enters the
+ * loop, spilling live registers to spill_ptr in between; without spill_ptr
+ * all invocations of a patch run in lock-step and BARRIER needs no code.
+ */
+struct lp_build_tgsi_tess_iface
+{
+   LLVMValueRef (*fetch_input)(const struct lp_build_tgsi_tess_iface *tess_iface,
+                               struct lp_build_tgsi_context * bld_base,
+                               boolean is_vindex_indirect,
+                               LLVMValueRef vertex_index,
+                               boolean is_aindex_indirect,
+                               LLVMValueRef attrib_index,
+                               LLVMValueRef swizzle_index);
+   LLVMValueRef (*fetch_output)(const struct lp_build_tgsi_tess_iface *tess_iface,
+                                struct lp_build_tgsi_context * bld_base,
+                                boolean is_vindex_indirect,
+                                LLVMValueRef vertex_index,
+                                boolean is_aindex_indirect,
+                                LLVMValueRef attrib_index,
+                                LLVMValueRef swizzle_index);
+   void (*store_output)(const struct lp_build_tgsi_tess_iface *tess_iface,
+                        struct lp_build_tgsi_context * bld_base,
+                        boolean is_vindex_indirect,
+                        LLVMValueRef vertex_index,
+                        boolean is_aindex_indirect,
+                        LLVMValueRef attrib_index,
+                        LLVMValueRef swizzle_index,
+                        LLVMValueRef value,
+                        LLVMValueRef mask_vec);
+   LLVMValueRef (*loop_begin)(const struct lp_build_tgsi_tess_iface *tess_iface,
+                              struct lp_build_tgsi_context * bld_base);
+   void (*loop_end)(const struct lp_build_tgsi_tess_iface *tess_iface,
+                    struct lp_build_tgsi_context * bld_base);
+   LLVMValueRef (*spill_ptr)(const struct lp_build_tgsi_tess_iface *tess_iface,
+                             struct lp_build_tgsi_context * bld_base);
+};
+
+/**
+ * Compute shader interface.
+ *
+ * A work group is executed as a driver-controlled loop over SIMD-wide
+ * chunks of invocations.  loop_begin/loop_end open and close that loop
+ * (and set up the execution mask for the chunk); the translator re-enters
+ * it around each BARRIER, spilling live registers to spill_ptr in between.
+ * memory_ptr returns the i8 base pointer and i32 byte size of a
+ * TGSI_FILE_BUFFER or shared TGSI_FILE_MEMORY binding.
+ */
+struct lp_build_tgsi_cs_iface
+{
+   void (*loop_begin)(const struct lp_build_tgsi_cs_iface *cs_iface,
+                      struct lp_build_tgsi_context * bld_base);
+   void (*loop_end)(const struct lp_build_tgsi_cs_iface *cs_iface,
+                    struct lp_build_tgsi_context * bld_base);
+   LLVMValueRef (*spill_ptr)(const struct lp_build_tgsi_cs_iface *cs_iface,
+                             struct lp_build_tgsi_context * bld_base);
+   LLVMValueRef (*fetch_thread_id)(const struct lp_build_tgsi_cs_iface *cs_iface,
+                                   struct lp_build_tgsi_context * bld_base,
+                                   unsigned chan);
+   LLVMValueRef (*memory_ptr)(const struct lp_build_tgsi_cs_iface *cs_iface,
+                              struct lp_build_tgsi_context * bld_base,
+                              unsigned file,
+                              LLVMValueRef index,
+                              LLVMValueRef *size);
+};
+
 struct lp_build_tgsi_soa_context
 {
    struct lp_build_tgsi_context bld_base;
@@ -442,6 +539,10 @@ struct lp_build_tgsi_soa_context
    LLVMValueRef emitted_vertices_vec_ptr;
    LLVMValueRef max_output_vertices_vec;
 
+   const struct lp_build_tgsi_tess_iface *tess_iface;
+
+   const struct lp_build_tgsi_cs_iface *cs_iface;
+
    LLVMValueRef consts_ptr;
    LLVMValueRef const_sizes_ptr;
    LLVMValueRef consts[LP_MAX_TGSI_CONST_BUFFERS];
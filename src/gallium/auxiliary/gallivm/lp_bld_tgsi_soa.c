@@ -1039,28 +1039,18 @@ emit_mask_scatter(struct lp_build_tgsi_soa_context *bld,
 
 
 /**
- * Read the current value of the ADDR register, convert the floats to
- * ints, add the base index and return the vector of offsets.
- * The offsets will be used to index into the constant buffer or
- * temporary register file.
+ * Read the relative address selected by an indirect register, as a vector
+ * of integers.
  */
 static LLVMValueRef
-get_indirect_index(struct lp_build_tgsi_soa_context *bld,
-                   unsigned reg_file, unsigned reg_index,
-                   const struct tgsi_ind_register *indirect_reg)
+get_indirect_rel(struct lp_build_tgsi_soa_context *bld,
+                 const struct tgsi_ind_register *indirect_reg)
 {
    LLVMBuilderRef builder = bld->bld_base.base.gallivm->builder;
    struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
    /* always use X component of address register */
    unsigned swizzle = indirect_reg->Swizzle;
-   LLVMValueRef base;
    LLVMValueRef rel;
-   LLVMValueRef max_index;
-   LLVMValueRef index;
-
-   assert(bld->indirect_files & (1 << reg_file));
-
-   base = lp_build_const_int_vec(bld->bld_base.base.gallivm, uint_bld->type, reg_index);
 
    assert(swizzle < 4);
    switch (indirect_reg->File) {
@@ -1082,6 +1072,31 @@ get_indirect_index(struct lp_build_tgsi_soa_context *bld,
       rel = uint_bld->zero;
    }
 
+   return rel;
+}
+
+/**
+ * Read the current value of the ADDR register, convert the floats to
+ * ints, add the base index and return the vector of offsets.
+ * The offsets will be used to index into the constant buffer or
+ * temporary register file.
+ */
+static LLVMValueRef
+get_indirect_index(struct lp_build_tgsi_soa_context *bld,
+                   unsigned reg_file, unsigned reg_index,
+                   const struct tgsi_ind_register *indirect_reg)
+{
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   LLVMValueRef base;
+   LLVMValueRef rel;
+   LLVMValueRef max_index;
+   LLVMValueRef index;
+
+   assert(bld->indirect_files & (1 << reg_file));
+
+   base = lp_build_const_int_vec(bld->bld_base.base.gallivm, uint_bld->type, reg_index);
+   rel = get_indirect_rel(bld, indirect_reg);
+
    index = lp_build_add(uint_bld, base, rel);
 
    /*
@@ -1105,6 +1120,24 @@ get_indirect_index(struct lp_build_tgsi_soa_context *bld,
    return index;
 }
 
+/**
+ * Like get_indirect_index(), but for the vertex dimension of tessellation
+ * registers, whose range is not bounded by the register file size.  Callers
+ * are responsible for clamping.
+ */
+static LLVMValueRef
+get_indirect_vertex_index(struct lp_build_tgsi_soa_context *bld,
+                          unsigned vertex_index,
+                          const struct tgsi_ind_register *indirect_reg)
+{
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   LLVMValueRef base =
+      lp_build_const_int_vec(bld->bld_base.base.gallivm, uint_bld->type,
+                             vertex_index);
+
+   return lp_build_add(uint_bld, base, get_indirect_rel(bld, indirect_reg));
+}
+
 static struct lp_build_context *
 stype_to_fetch(struct lp_build_tgsi_context * bld_base,
 	       enum tgsi_opcode_type stype)
@@ -1533,6 +1566,88 @@ emit_fetch_gs_input(
    return res;
 }
 
+static LLVMValueRef
+emit_fetch_tess_reg(
+   struct lp_build_tgsi_context * bld_base,
+   const struct tgsi_full_src_register * reg,
+   enum tgsi_opcode_type stype,
+   unsigned swizzle)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   const struct lp_build_tgsi_tess_iface *tess_iface = bld->tess_iface;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef attrib_index = NULL;
+   LLVMValueRef vertex_index = NULL;
+   LLVMValueRef swizzle_index = lp_build_const_int32(gallivm, swizzle);
+   LLVMValueRef res;
+
+   if (reg->Register.Indirect) {
+      attrib_index = get_indirect_index(bld,
+                                        reg->Register.File,
+                                        reg->Register.Index,
+                                        &reg->Indirect);
+   } else {
+      attrib_index = lp_build_const_int32(gallivm, reg->Register.Index);
+   }
+
+   /* Per-patch registers are one-dimensional */
+   if (reg->Register.Dimension) {
+      if (reg->Dimension.Indirect) {
+         vertex_index = get_indirect_vertex_index(bld,
+                                                  reg->Dimension.Index,
+                                                  &reg->DimIndirect);
+      } else {
+         vertex_index = lp_build_const_int32(gallivm, reg->Dimension.Index);
+      }
+   }
+
+   if (reg->Register.File == TGSI_FILE_OUTPUT) {
+      res = tess_iface->fetch_output(tess_iface, bld_base,
+                                     reg->Dimension.Indirect,
+                                     vertex_index,
+                                     reg->Register.Indirect,
+                                     attrib_index,
+                                     swizzle_index);
+   } else {
+      res = tess_iface->fetch_input(tess_iface, bld_base,
+                                    reg->Dimension.Indirect,
+                                    vertex_index,
+                                    reg->Register.Indirect,
+                                    attrib_index,
+                                    swizzle_index);
+   }
+
+   assert(res);
+   if (tgsi_type_is_64bit(stype)) {
+      LLVMValueRef swizzle_index = lp_build_const_int32(gallivm, swizzle + 1);
+      LLVMValueRef res2;
+      if (reg->Register.File == TGSI_FILE_OUTPUT) {
+         res2 = tess_iface->fetch_output(tess_iface, bld_base,
+                                         reg->Dimension.Indirect,
+                                         vertex_index,
+                                         reg->Register.Indirect,
+                                         attrib_index,
+                                         swizzle_index);
+      } else {
+         res2 = tess_iface->fetch_input(tess_iface, bld_base,
+                                        reg->Dimension.Indirect,
+                                        vertex_index,
+                                        reg->Register.Indirect,
+                                        attrib_index,
+                                        swizzle_index);
+      }
+      assert(res2);
+      res = emit_fetch_64bit(bld_base, stype, res, res2);
+   } else if (stype == TGSI_TYPE_UNSIGNED) {
+      res = LLVMBuildBitCast(builder, res, bld_base->uint_bld.vec_type, "");
+   } else if (stype == TGSI_TYPE_SIGNED) {
+      res = LLVMBuildBitCast(builder, res, bld_base->int_bld.vec_type, "");
+   }
+
+   return res;
+}
+
 static LLVMValueRef
 emit_fetch_temporary(
    struct lp_build_tgsi_context * bld_base,
@@ -1600,6 +1715,20 @@ emit_fetch_temporary(
    return res;
 }
 
+/**
+ * System values may be provided either per-lane or, when they are uniform
+ * across the SIMD vector (e.g. the primitive ID of a tessellation patch),
+ * as a single scalar which needs to be splatted.
+ */
+static LLVMValueRef
+broadcast_system_value(struct lp_build_context *bld,
+                       LLVMValueRef value)
+{
+   if (LLVMGetTypeKind(LLVMTypeOf(value)) == LLVMVectorTypeKind)
+      return value;
+   return lp_build_broadcast_scalar(bld, value);
+}
+
 static LLVMValueRef
 emit_fetch_system_value(
    struct lp_build_tgsi_context * bld_base,
@@ -1638,12 +1767,79 @@ emit_fetch_system_value(
       break;
 
    case TGSI_SEMANTIC_PRIMID:
-      res = bld->system_values.prim_id;
+      res = broadcast_system_value(&bld_base->uint_bld,
+                                   bld->system_values.prim_id);
       atype = TGSI_TYPE_UNSIGNED;
       break;
 
    case TGSI_SEMANTIC_INVOCATIONID:
-      res = lp_build_broadcast_scalar(&bld_base->uint_bld, bld->system_values.invocation_id);
+      res = broadcast_system_value(&bld_base->uint_bld,
+                                   bld->system_values.invocation_id);
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_VERTICESIN:
+      res = broadcast_system_value(&bld_base->uint_bld,
+                                   bld->system_values.vertices_in);
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_TESSCOORD:
+      if (swizzle < ARRAY_SIZE(bld->system_values.tess_coord))
+         res = broadcast_system_value(&bld_base->base,
+                                      bld->system_values.tess_coord[swizzle]);
+      else
+         res = bld_base->base.zero;
+      atype = TGSI_TYPE_FLOAT;
+      break;
+
+   case TGSI_SEMANTIC_TESSOUTER:
+      res = broadcast_system_value(&bld_base->base,
+                                   bld->system_values.tess_outer[swizzle]);
+      atype = TGSI_TYPE_FLOAT;
+      break;
+
+   case TGSI_SEMANTIC_TESSINNER:
+      if (swizzle < ARRAY_SIZE(bld->system_values.tess_inner))
+         res = broadcast_system_value(&bld_base->base,
+                                      bld->system_values.tess_inner[swizzle]);
+      else
+         res = bld_base->base.zero;
+      atype = TGSI_TYPE_FLOAT;
+      break;
+
+   case TGSI_SEMANTIC_THREAD_ID:
+      if (swizzle < 3 && bld->cs_iface)
+         res = bld->cs_iface->fetch_thread_id(bld->cs_iface, bld_base, swizzle);
+      else
+         res = bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_BLOCK_ID:
+      if (swizzle < ARRAY_SIZE(bld->system_values.block_id))
+         res = broadcast_system_value(&bld_base->uint_bld,
+                                      bld->system_values.block_id[swizzle]);
+      else
+         res = bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_GRID_SIZE:
+      if (swizzle < ARRAY_SIZE(bld->system_values.grid_size))
+         res = broadcast_system_value(&bld_base->uint_bld,
+                                      bld->system_values.grid_size[swizzle]);
+      else
+         res = bld_base->uint_bld.one;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_BLOCK_SIZE:
+      if (swizzle < ARRAY_SIZE(bld->system_values.block_size))
+         res = broadcast_system_value(&bld_base->uint_bld,
+                                      bld->system_values.block_size[swizzle]);
+      else
+         res = bld_base->uint_bld.one;
       atype = TGSI_TYPE_UNSIGNED;
       break;
 
@@ -1733,6 +1929,9 @@ emit_store_64bit_chan(struct lp_build_tgsi_context *bld_base,
    lp_exec_mask_store(&bld->exec_mask, float_bld, temp2, chan_ptr2);
 }
 
+static LLVMValueRef
+mask_vec(struct lp_build_tgsi_context *bld_base);
+
 /**
  * Register store.
  */
@@ -1789,7 +1988,36 @@ emit_store_chan(
       /* Outputs are always stored as floats */
       value = LLVMBuildBitCast(builder, value, float_bld->vec_type, "");
 
-      if (reg->Register.Indirect) {
+      if (bld->tess_iface && bld->tess_iface->store_output) {
+         LLVMValueRef vertex_index = NULL;
+         LLVMValueRef attrib_index;
+
+         if (reg->Register.Indirect)
+            attrib_index = indirect_index;
+         else
+            attrib_index = lp_build_const_int32(gallivm, reg->Register.Index);
+
+         /* Per-patch outputs are one-dimensional */
+         if (reg->Register.Dimension) {
+            if (reg->Dimension.Indirect)
+               vertex_index = get_indirect_vertex_index(bld,
+                                                        reg->Dimension.Index,
+                                                        &reg->DimIndirect);
+            else
+               vertex_index = lp_build_const_int32(gallivm,
+                                                   reg->Dimension.Index);
+         }
+
+         bld->tess_iface->store_output(bld->tess_iface, bld_base,
+                                       reg->Dimension.Indirect,
+                                       vertex_index,
+                                       reg->Register.Indirect,
+                                       attrib_index,
+                                       lp_build_const_int32(gallivm, chan_index),
+                                       value,
+                                       mask_vec(bld_base));
+      }
+      else if (reg->Register.Indirect) {
          LLVMValueRef index_vec;  /* indexes into the output registers */
          LLVMValueRef outputs_array;
          LLVMTypeRef fptr_type;
@@ -2851,7 +3079,8 @@ lp_emit_declaration_soa(
       break;
 
    case TGSI_FILE_OUTPUT:
-      if (!(bld->indirect_files & (1 << TGSI_FILE_OUTPUT))) {
+      if (!(bld->indirect_files & (1 << TGSI_FILE_OUTPUT)) &&
+          !(bld->tess_iface && bld->tess_iface->store_output)) {
          for (idx = first; idx <= last; ++idx) {
             for (i = 0; i < TGSI_NUM_CHANNELS; i++)
                bld->outputs[idx][i] = lp_build_alloca(gallivm,
@@ -3617,6 +3846,473 @@ endsub_emit(
    lp_exec_mask_endsub(&bld->exec_mask, &bld_base->pc);
 }
 
+/**
+ * Number of bytes needed to spill the registers of one SIMD chunk of
+ * compute invocations across a barrier.
+ */
+unsigned
+lp_build_tgsi_soa_spill_size(const struct tgsi_shader_info *info,
+                             struct lp_type type)
+{
+   unsigned num_regs = (info->file_max[TGSI_FILE_TEMPORARY] + 1) +
+                       (info->file_max[TGSI_FILE_ADDRESS] + 1);
+
+   return num_regs * TGSI_NUM_CHANNELS * type.length * (type.width / 8);
+}
+
+/**
+ * Whether all BARRIER instructions of a compute shader can be translated.
+ *
+ * A barrier splits the driver's chunk loop, which is only possible at the
+ * top level of the main function and before any return from within control
+ * flow.  Drivers have to reject shaders with barriers anywhere else, rather
+ * than run them without the barrier.
+ */
+boolean
+lp_build_tgsi_soa_barriers_supported(const struct tgsi_token *tokens)
+{
+   struct tgsi_parse_context parse;
+   unsigned depth = 0;
+   boolean in_sub = FALSE, ret_in_main = FALSE, supported = TRUE;
+
+   if (tgsi_parse_init(&parse, tokens) != TGSI_PARSE_OK)
+      return FALSE;
+
+   while (supported && !tgsi_parse_end_of_tokens(&parse)) {
+      tgsi_parse_token(&parse);
+      if (parse.FullToken.Token.Type != TGSI_TOKEN_TYPE_INSTRUCTION)
+         continue;
+
+      switch (parse.FullToken.FullInstruction.Instruction.Opcode) {
+      case TGSI_OPCODE_IF:
+      case TGSI_OPCODE_UIF:
+      case TGSI_OPCODE_BGNLOOP:
+      case TGSI_OPCODE_SWITCH:
+         depth++;
+         break;
+      case TGSI_OPCODE_ENDIF:
+      case TGSI_OPCODE_ENDLOOP:
+      case TGSI_OPCODE_ENDSWITCH:
+         depth--;
+         break;
+      case TGSI_OPCODE_BGNSUB:
+         in_sub = TRUE;
+         break;
+      case TGSI_OPCODE_ENDSUB:
+         in_sub = FALSE;
+         break;
+      case TGSI_OPCODE_RET:
+         if (!in_sub && depth)
+            ret_in_main = TRUE;
+         break;
+      case TGSI_OPCODE_BARRIER:
+         supported = !in_sub && !depth && !ret_in_main;
+         break;
+      default:
+         break;
+      }
+   }
+
+   tgsi_parse_free(&parse);
+   return supported;
+}
+
+static void
+spill_reg(struct lp_build_tgsi_soa_context *bld,
+          LLVMValueRef spill,
+          unsigned slot,
+          LLVMValueRef var,
+          boolean fill)
+{
+   LLVMBuilderRef builder = bld->bld_base.base.gallivm->builder;
+   LLVMValueRef index = lp_build_const_int32(bld->bld_base.base.gallivm, slot);
+   LLVMValueRef ptr = LLVMBuildGEP(builder, spill, &index, 1, "");
+
+   ptr = LLVMBuildBitCast(builder, ptr, LLVMTypeOf(var), "");
+   if (fill)
+      LLVMBuildStore(builder, LLVMBuildLoad(builder, ptr, ""), var);
+   else
+      LLVMBuildStore(builder, LLVMBuildLoad(builder, var, ""), ptr);
+}
+
+/**
+ * Save (or restore) all temporary and address registers of the current
+ * SIMD chunk to the driver-provided spill area.
+ */
+static void
+spill_registers(struct lp_build_tgsi_soa_context *bld, LLVMValueRef spill,
+                boolean fill)
+{
+   LLVMBuilderRef builder = bld->bld_base.base.gallivm->builder;
+   const struct tgsi_shader_info *info = bld->bld_base.info;
+   unsigned slot = 0;
+   int index;
+   unsigned chan;
+
+   spill = LLVMBuildBitCast(builder, spill,
+                            LLVMPointerType(bld->bld_base.base.vec_type, 0), "");
+
+   for (index = 0; index <= info->file_max[TGSI_FILE_TEMPORARY]; ++index) {
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; ++chan, ++slot) {
+         LLVMValueRef var = lp_get_temp_ptr_soa(bld, index, chan);
+         if (var)
+            spill_reg(bld, spill, slot, var, fill);
+      }
+   }
+
+   for (index = 0; index <= info->file_max[TGSI_FILE_ADDRESS]; ++index) {
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; ++chan, ++slot) {
+         LLVMValueRef var = bld->addr[index][chan];
+         if (var)
+            spill_reg(bld, spill, slot, var, fill);
+      }
+   }
+}
+
+/**
+ * Whether the barrier being translated can split the shader: the chunk
+ * loop can only be re-entered at the top level of the main function.
+ */
+static boolean
+barrier_at_top_level(struct lp_build_tgsi_soa_context *bld)
+{
+   struct lp_exec_mask *mask = &bld->exec_mask;
+
+   if (mask->function_stack_size > 1 || mask->ret_in_main ||
+       mask_has_loop(mask) || mask_has_cond(mask) || mask_has_switch(mask)) {
+      debug_printf("gallivm: BARRIER inside control flow is not supported\n");
+      return FALSE;
+   }
+   return TRUE;
+}
+
+/**
+ * Compute shader barrier.
+ *
+ * The invocations of a work group run as a driver loop over SIMD chunks,
+ * so a barrier ends that loop and starts a new one, carrying registers
+ * over through the spill area.  That is only possible at the top level
+ * of the main function, drivers reject shaders with barriers elsewhere,
+ * see lp_build_tgsi_soa_barriers_supported().
+ */
+static void
+cs_barrier_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   const struct lp_build_tgsi_cs_iface *cs_iface = bld->cs_iface;
+
+   if (!barrier_at_top_level(bld))
+      return;
+
+   spill_registers(bld, cs_iface->spill_ptr(cs_iface, bld_base), FALSE);
+   cs_iface->loop_end(cs_iface, bld_base);
+   cs_iface->loop_begin(cs_iface, bld_base);
+   spill_registers(bld, cs_iface->spill_ptr(cs_iface, bld_base), TRUE);
+}
+
+/**
+ * Tessellation control shader barrier.
+ *
+ * Same as for compute shaders when the driver loops over the invocations
+ * of a patch, nothing to do when they run in lock-step in one SIMD vector.
+ */
+static void
+tcs_barrier_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   const struct lp_build_tgsi_tess_iface *tess_iface = bld->tess_iface;
+
+   if (!tess_iface->spill_ptr || !barrier_at_top_level(bld))
+      return;
+
+   spill_registers(bld, tess_iface->spill_ptr(tess_iface, bld_base), FALSE);
+   tess_iface->loop_end(tess_iface, bld_base);
+   bld->system_values.invocation_id =
+      tess_iface->loop_begin(tess_iface, bld_base);
+   spill_registers(bld, tess_iface->spill_ptr(tess_iface, bld_base), TRUE);
+}
+
+/**
+ * Return the i8 base pointer and i32 size of a buffer or shared memory
+ * resource for a single lane.
+ */
+static LLVMValueRef
+cs_resource_ptr(struct lp_build_tgsi_soa_context *bld,
+                unsigned file,
+                unsigned reg_index,
+                boolean is_indirect,
+                const struct tgsi_ind_register *indirect,
+                LLVMValueRef lane,
+                LLVMValueRef *size)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMValueRef index;
+
+   if (file == TGSI_FILE_MEMORY) {
+      index = lp_build_const_int32(gallivm, 0);
+   } else if (is_indirect) {
+      index = get_indirect_index(bld, file, reg_index, indirect);
+      index = LLVMBuildExtractElement(gallivm->builder, index, lane, "");
+   } else {
+      index = lp_build_const_int32(gallivm, reg_index);
+   }
+
+   return bld->cs_iface->memory_ptr(bld->cs_iface, &bld->bld_base,
+                                    file, index, size);
+}
+
+#if HAVE_LLVM >= 0x0309
+static LLVMValueRef
+cs_emit_atomic(LLVMBuilderRef builder,
+               unsigned opcode,
+               LLVMValueRef ptr,
+               LLVMValueRef value,
+               LLVMValueRef cmp)
+{
+   LLVMAtomicRMWBinOp op;
+
+   switch (opcode) {
+   case TGSI_OPCODE_ATOMCAS:
+      return LLVMBuildExtractValue(builder,
+                                   LLVMBuildAtomicCmpXchg(builder, ptr, cmp, value,
+                                                          LLVMAtomicOrderingSequentiallyConsistent,
+                                                          LLVMAtomicOrderingSequentiallyConsistent,
+                                                          false), 0, "");
+   case TGSI_OPCODE_ATOMUADD:
+      op = LLVMAtomicRMWBinOpAdd;
+      break;
+   case TGSI_OPCODE_ATOMXCHG:
+      op = LLVMAtomicRMWBinOpXchg;
+      break;
+   case TGSI_OPCODE_ATOMAND:
+      op = LLVMAtomicRMWBinOpAnd;
+      break;
+   case TGSI_OPCODE_ATOMOR:
+      op = LLVMAtomicRMWBinOpOr;
+      break;
+   case TGSI_OPCODE_ATOMXOR:
+      op = LLVMAtomicRMWBinOpXor;
+      break;
+   case TGSI_OPCODE_ATOMUMIN:
+      op = LLVMAtomicRMWBinOpUMin;
+      break;
+   case TGSI_OPCODE_ATOMUMAX:
+      op = LLVMAtomicRMWBinOpUMax;
+      break;
+   case TGSI_OPCODE_ATOMIMIN:
+      op = LLVMAtomicRMWBinOpMin;
+      break;
+   case TGSI_OPCODE_ATOMIMAX:
+      op = LLVMAtomicRMWBinOpMax;
+      break;
+   default:
+      assert(0);
+      return LLVMBuildLoad(builder, ptr, "");
+   }
+
+   return LLVMBuildAtomicRMW(builder, op, ptr, value,
+                             LLVMAtomicOrderingSequentiallyConsistent, false);
+}
+#endif
+
+/**
+ * LOAD, STORE and ATOM* on buffers and shared memory.
+ *
+ * Addresses are arbitrary per lane, so the access is scalarized: each
+ * active lane checks its byte offset against the resource size and
+ * performs the access on its own.  Out of bounds loads return zero and
+ * out of bounds stores are dropped.
+ */
+static void
+cs_memory_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const unsigned opcode = inst->Instruction.Opcode;
+   const boolean is_store = opcode == TGSI_OPCODE_STORE;
+   const boolean is_load = opcode == TGSI_OPCODE_LOAD;
+   const struct tgsi_ind_register *res_ind;
+   unsigned res_file, res_index;
+   boolean res_indirect;
+   unsigned addr_src, writemask, chan;
+   LLVMValueRef exec_mask, offsets, values[4], cmp = NULL;
+   LLVMValueRef results[4] = { NULL };
+   struct lp_build_loop_state loop;
+
+   if (is_store) {
+      res_file = inst->Dst[0].Register.File;
+      res_index = inst->Dst[0].Register.Index;
+      res_indirect = inst->Dst[0].Register.Indirect;
+      res_ind = &inst->Dst[0].Indirect;
+      addr_src = 0;
+      writemask = inst->Dst[0].Register.WriteMask;
+   } else {
+      res_file = inst->Src[0].Register.File;
+      res_index = inst->Src[0].Register.Index;
+      res_indirect = inst->Src[0].Register.Indirect;
+      res_ind = &inst->Src[0].Indirect;
+      addr_src = 1;
+      writemask = is_load ? inst->Dst[0].Register.WriteMask : TGSI_WRITEMASK_X;
+   }
+
+   if (res_file != TGSI_FILE_BUFFER && res_file != TGSI_FILE_MEMORY) {
+      debug_printf("gallivm: unsupported memory file %u\n", res_file);
+      TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan)
+         emit_data->output[chan] = bld_base->base.zero;
+      return;
+   }
+
+   exec_mask = mask_vec(bld_base);
+   offsets = lp_build_emit_fetch_src(bld_base, &inst->Src[addr_src],
+                                     TGSI_TYPE_UNSIGNED, TGSI_CHAN_X);
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; ++chan) {
+      values[chan] = NULL;
+      if (!(writemask & (1 << chan)))
+         continue;
+      if (is_store)
+         values[chan] = lp_build_emit_fetch_src(bld_base, &inst->Src[1],
+                                                TGSI_TYPE_UNSIGNED, chan);
+      if (!is_load && !is_store) {
+         values[chan] = lp_build_emit_fetch_src(bld_base,
+                                                &inst->Src[opcode == TGSI_OPCODE_ATOMCAS ? 3 : 2],
+                                                TGSI_TYPE_UNSIGNED, chan);
+         if (opcode == TGSI_OPCODE_ATOMCAS)
+            cmp = lp_build_emit_fetch_src(bld_base, &inst->Src[2],
+                                          TGSI_TYPE_UNSIGNED, chan);
+      }
+      if (!is_store) {
+         results[chan] = lp_build_alloca(gallivm, uint_bld->vec_type, "");
+         LLVMBuildStore(builder, uint_bld->zero, results[chan]);
+      }
+   }
+
+   lp_build_loop_begin(&loop, gallivm, lp_build_const_int32(gallivm, 0));
+   {
+      LLVMValueRef lane = loop.counter;
+      LLVMValueRef active, offset, base, size;
+
+      active = LLVMBuildICmp(builder, LLVMIntNE,
+                             LLVMBuildExtractElement(builder, exec_mask, lane, ""),
+                             lp_build_const_int32(gallivm, 0), "");
+      offset = LLVMBuildExtractElement(builder, offsets, lane, "");
+      base = cs_resource_ptr(bld, res_file, res_index, res_indirect, res_ind,
+                             lane, &size);
+
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; ++chan) {
+         struct lp_build_if_state ifthen;
+         LLVMValueRef chan_offset, end, in_bounds, ptr;
+
+         if (!(writemask & (1 << chan)))
+            continue;
+
+         chan_offset = LLVMBuildAdd(builder, offset,
+                                    lp_build_const_int32(gallivm, chan * 4), "");
+         end = LLVMBuildAdd(builder, chan_offset,
+                            lp_build_const_int32(gallivm, 4), "");
+         in_bounds = LLVMBuildAnd(builder,
+                                  LLVMBuildICmp(builder, LLVMIntULT, chan_offset, end, ""),
+                                  LLVMBuildICmp(builder, LLVMIntULE, end, size, ""), "");
+
+         lp_build_if(&ifthen, gallivm, LLVMBuildAnd(builder, active, in_bounds, ""));
+         ptr = LLVMBuildGEP(builder, base, &chan_offset, 1, "");
+         ptr = LLVMBuildBitCast(builder, ptr,
+                                LLVMPointerType(uint_bld->elem_type, 0), "");
+         if (is_store) {
+            LLVMBuildStore(builder,
+                           LLVMBuildExtractElement(builder, values[chan], lane, ""),
+                           ptr);
+         } else {
+            LLVMValueRef val;
+
+            if (is_load) {
+               val = LLVMBuildLoad(builder, ptr, "");
+            } else {
+#if HAVE_LLVM >= 0x0309
+               val = cs_emit_atomic(builder, opcode, ptr,
+                                    LLVMBuildExtractElement(builder, values[chan], lane, ""),
+                                    cmp ? LLVMBuildExtractElement(builder, cmp, lane, "") : NULL);
+#else
+               val = LLVMBuildLoad(builder, ptr, "");
+#endif
+            }
+            LLVMBuildStore(builder,
+                           LLVMBuildInsertElement(builder,
+                                                  LLVMBuildLoad(builder, results[chan], ""),
+                                                  val, lane, ""),
+                           results[chan]);
+         }
+         lp_build_endif(&ifthen);
+      }
+   }
+   lp_build_loop_end_cond(&loop,
+                          lp_build_const_int32(gallivm, uint_bld->type.length),
+                          NULL, LLVMIntUGE);
+
+   if (is_store)
+      return;
+
+   TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+      LLVMValueRef res = results[is_load ? chan : TGSI_CHAN_X];
+      emit_data->output[chan] = LLVMBuildBitCast(builder,
+                                                 LLVMBuildLoad(builder, res, ""),
+                                                 bld_base->base.vec_type, "");
+   }
+}
+
+static void
+cs_resq_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   LLVMValueRef size = NULL;
+   unsigned chan;
+
+   if (inst->Src[0].Register.File == TGSI_FILE_BUFFER) {
+      /* an indirect resource index is taken from the first lane */
+      cs_resource_ptr(bld, TGSI_FILE_BUFFER, inst->Src[0].Register.Index,
+                      inst->Src[0].Register.Indirect, &inst->Src[0].Indirect,
+                      lp_build_const_int32(gallivm, 0), &size);
+      size = lp_build_broadcast_scalar(&bld_base->uint_bld, size);
+   } else {
+      size = bld_base->uint_bld.zero;
+   }
+
+   TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+      emit_data->output[chan] =
+         LLVMBuildBitCast(gallivm->builder,
+                          chan == TGSI_CHAN_X ? size : bld_base->uint_bld.zero,
+                          bld_base->base.vec_type, "");
+   }
+}
+
+static void
+membar_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+#if HAVE_LLVM >= 0x0309
+   LLVMBuildFence(bld_base->base.gallivm->builder,
+                  LLVMAtomicOrderingSequentiallyConsistent, false, "");
+#endif
+}
+
 static void
 cont_emit(
    const struct lp_build_tgsi_action * action,
@@ -3642,7 +4338,8 @@ static void emit_prologue(struct lp_build_tgsi_context * bld_base)
                                               "temp_array");
    }
 
-   if (bld->indirect_files & (1 << TGSI_FILE_OUTPUT)) {
+   if (bld->indirect_files & (1 << TGSI_FILE_OUTPUT) &&
+       !(bld->tess_iface && bld->tess_iface->store_output)) {
       LLVMValueRef array_size =
          lp_build_const_int32(gallivm,
                             bld_base->info->file_max[TGSI_FILE_OUTPUT] * 4 + 4);
@@ -3662,7 +4359,8 @@ static void emit_prologue(struct lp_build_tgsi_context * bld_base)
 
    /* If we have indirect addressing in inputs we need to copy them into
     * our alloca array to be able to iterate over them */
-   if (bld->indirect_files & (1 << TGSI_FILE_INPUT) && !bld->gs_iface) {
+   if (bld->indirect_files & (1 << TGSI_FILE_INPUT) &&
+       !bld->gs_iface && !bld->tess_iface) {
       unsigned index, chan;
       LLVMTypeRef vec_type = bld_base->base.vec_type;
       LLVMValueRef array_size = lp_build_const_int32(gallivm,
@@ -3714,9 +4412,15 @@ static void emit_prologue(struct lp_build_tgsi_context * bld_base)
    if (DEBUG_EXECUTION) {
       lp_build_printf(gallivm, "\n");
       emit_dump_file(bld, TGSI_FILE_CONSTANT);
-      if (!bld->gs_iface)
+      if (!bld->gs_iface && !bld->tess_iface)
          emit_dump_file(bld, TGSI_FILE_INPUT);
    }
+
+   if (bld->cs_iface)
+      bld->cs_iface->loop_begin(bld->cs_iface, bld_base);
+   if (bld->tess_iface && bld->tess_iface->loop_begin)
+      bld->system_values.invocation_id =
+         bld->tess_iface->loop_begin(bld->tess_iface, bld_base);
 }
 
 static void emit_epilogue(struct lp_build_tgsi_context * bld_base)
@@ -3724,12 +4428,18 @@ static void emit_epilogue(struct lp_build_tgsi_context * bld_base)
    struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
    LLVMBuilderRef builder = bld_base->base.gallivm->builder;
 
+   if (bld->cs_iface)
+      bld->cs_iface->loop_end(bld->cs_iface, bld_base);
+   if (bld->tess_iface && bld->tess_iface->loop_end)
+      bld->tess_iface->loop_end(bld->tess_iface, bld_base);
+
    if (DEBUG_EXECUTION) {
       /* for debugging */
       if (0) {
          emit_dump_file(bld, TGSI_FILE_TEMPORARY);
       }
-      emit_dump_file(bld, TGSI_FILE_OUTPUT);
+      if (!(bld->tess_iface && bld->tess_iface->store_output))
+         emit_dump_file(bld, TGSI_FILE_OUTPUT);
       lp_build_printf(bld_base->base.gallivm, "\n");
    }
 
@@ -3752,7 +4462,7 @@ static void emit_epilogue(struct lp_build_tgsi_context * bld_base)
                                  &bld->bld_base,
                                  total_emitted_vertices_vec,
                                  emitted_prims_vec);
-   } else {
+   } else if (!(bld->tess_iface && bld->tess_iface->store_output)) {
       gather_outputs(bld);
    }
 }
@@ -3771,7 +4481,9 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                   LLVMValueRef thread_data_ptr,
                   struct lp_build_sampler_soa *sampler,
                   const struct tgsi_shader_info *info,
-                  const struct lp_build_tgsi_gs_iface *gs_iface)
+                  const struct lp_build_tgsi_gs_iface *gs_iface,
+                  const struct lp_build_tgsi_tess_iface *tess_iface,
+                  const struct lp_build_tgsi_cs_iface *cs_iface)
 {
    struct lp_build_tgsi_soa_context bld;
 
@@ -3925,6 +4637,39 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                                 max_output_vertices);
    }
 
+   if (tess_iface) {
+      /* inputs (and control shader outputs) live in patch storage */
+      bld.indirect_files |= (1 << TGSI_FILE_INPUT);
+      if (tess_iface->store_output)
+         bld.indirect_files |= (1 << TGSI_FILE_OUTPUT);
+      bld.tess_iface = tess_iface;
+      bld.bld_base.emit_fetch_funcs[TGSI_FILE_INPUT] = emit_fetch_tess_reg;
+      if (tess_iface->fetch_output)
+         bld.bld_base.emit_fetch_funcs[TGSI_FILE_OUTPUT] = emit_fetch_tess_reg;
+      bld.bld_base.op_actions[TGSI_OPCODE_BARRIER].emit = tcs_barrier_emit;
+   }
+
+   if (cs_iface) {
+      bld.cs_iface = cs_iface;
+      bld.bld_base.op_actions[TGSI_OPCODE_BARRIER].emit = cs_barrier_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_LOAD].emit = cs_memory_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_STORE].emit = cs_memory_emit;
+#if HAVE_LLVM >= 0x0309
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUADD].emit = cs_memory_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMXCHG].emit = cs_memory_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMCAS].emit = cs_memory_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMAND].emit = cs_memory_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMOR].emit = cs_memory_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMXOR].emit = cs_memory_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUMIN].emit = cs_memory_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUMAX].emit = cs_memory_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMIMIN].emit = cs_memory_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMIMAX].emit = cs_memory_emit;
+#endif
+      bld.bld_base.op_actions[TGSI_OPCODE_RESQ].emit = cs_resq_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_MEMBAR].emit = membar_emit;
+   }
+
    lp_exec_mask_init(&bld.exec_mask, &bld.bld_base.int_bld);
 
    bld.system_values = *system_values;
@@ -28,6 +28,7 @@
 
 #include "u_math.h"
 #include "u_format_other.h"
+#include "u_format_simd.h"
 #include "util/format_rgb9e5.h"
 #include "util/format_r11g11b10f.h"
 
@@ -144,7 +145,14 @@ util_format_r11g11b10_float_unpack_rgba_float(float *dst_row, unsigned dst_strid
    for(y = 0; y < height; y += 1) {
       float *dst = dst_row;
       const uint8_t *src = src_row;
-      for(x = 0; x < width; x += 1) {
+      x = 0;
+#ifdef U_FORMAT_SIMD
+      x = u_format_simd_row(u_format_simd_r11g11b10_float_unpack_rgba_float,
+                            dst, src, width);
+      src += x * 4;
+      dst += x * 4;
+#endif
+      for(; x < width; x += 1) {
          uint32_t value = util_cpu_to_le32(*(const uint32_t *)src);
          r11g11b10f_to_float3(value, dst);
          dst[3] = 1; /* a */
@@ -165,7 +173,14 @@ util_format_r11g11b10_float_pack_rgba_float(uint8_t *dst_row, unsigned dst_strid
    for(y = 0; y < height; y += 1) {
       const float *src = src_row;
       uint8_t *dst = dst_row;
-      for(x = 0; x < width; x += 1) {
+      x = 0;
+#ifdef U_FORMAT_SIMD
+      x = u_format_simd_row(u_format_simd_r11g11b10_float_pack_rgba_float,
+                            dst, src, width);
+      src += x * 4;
+      dst += x * 4;
+#endif
+      for(; x < width; x += 1) {
          uint32_t value = util_cpu_to_le32(float3_to_r11g11b10f(src));
          *(uint32_t *)dst = value;
          src += 4;
@@ -196,7 +211,14 @@ util_format_r11g11b10_float_unpack_rgba_8unorm(uint8_t *dst_row, unsigned dst_st
    for(y = 0; y < height; y += 1) {
       uint8_t *dst = dst_row;
       const uint8_t *src = src_row;
-      for(x = 0; x < width; x += 1) {
+      x = 0;
+#ifdef U_FORMAT_SIMD
+      x = u_format_simd_row(u_format_simd_r11g11b10_float_unpack_rgba_8unorm,
+                            dst, src, width);
+      src += x * 4;
+      dst += x * 4;
+#endif
+      for(; x < width; x += 1) {
          uint32_t value = util_cpu_to_le32(*(const uint32_t *)src);
          r11g11b10f_to_float3(value, p);
          dst[0] = float_to_ubyte(p[0]); /* r */
@@ -222,7 +244,14 @@ util_format_r11g11b10_float_pack_rgba_8unorm(uint8_t *dst_row, unsigned dst_stri
    for(y = 0; y < height; y += 1) {
       const uint8_t *src = src_row;
       uint8_t *dst = dst_row;
-      for(x = 0; x < width; x += 1) {
+      x = 0;
+#ifdef U_FORMAT_SIMD
+      x = u_format_simd_row(u_format_simd_r11g11b10_float_pack_rgba_8unorm,
+                            dst, src, width);
+      src += x * 4;
+      dst += x * 4;
+#endif
+      for(; x < width; x += 1) {
          uint32_t value;
          p[0] = ubyte_to_float(src[0]);
          p[1] = ubyte_to_float(src[1]);
@@ -610,11 +610,153 @@ def generate_pack_kernel(format, src_channel, src_native_type):
         print_channels(format, pack_into_union)
 
 
+def is_format_simd(format):
+    '''Whether SIMD kernels are emitted for this format, see u_format_simd.h.
+
+    Covers the 16 and 32 bit packed unorm formats with channels of at most 8
+    bits, e.g. RGBA8, BGRA8, BGRX8, 565, 5551, 4444 and L8A8.'''
+
+    if format.layout != PLAIN or format.colorspace != RGB:
+        return False
+    if format.block_width != 1 or format.block_height != 1:
+        return False
+    if format.block_size() not in (16, 32):
+        return False
+
+    nr_channels = 0
+    for channel in format.le_channels:
+        if channel.type == VOID:
+            continue
+        if channel.type != UNSIGNED or not channel.norm or channel.size > 8:
+            return False
+        nr_channels += 1
+    return nr_channels > 0
+
+
+# Instruction sets the SIMD kernels are emitted for, see u_format_simd.h:
+# (name, target attribute, pixels per iteration, integer and float vectors)
+simd_isas = [
+    ('sse2', 'U_FORMAT_SIMD_TARGET_SSE2', 4, '__m128i', '__m128'),
+    ('sse41', 'U_FORMAT_SIMD_TARGET_SSE41', 4, '__m128i', '__m128'),
+    ('avx2', 'U_FORMAT_SIMD_TARGET_AVX2', 8, '__m256i', '__m256'),
+]
+
+
+def generate_simd_kernels(format, native_type, suffix, generate_loop):
+    '''Generate one row kernel per instruction set, returning how many pixels
+    were converted. The last two are only built when the compiler can target
+    them per function.'''
+
+    name = format.short_name()
+
+    print '#ifdef U_FORMAT_SIMD'
+    for isa, target, width, int_type, float_type in simd_isas:
+        if isa == 'sse41':
+            print '#ifdef U_FORMAT_SIMD_DISPATCH'
+        print 'static inline %s unsigned' % (target,)
+        if suffix.startswith('unpack'):
+            print 'util_format_%s_%s_%s(%s *dst, const uint8_t *src, unsigned width)' % (name, suffix, isa, native_type)
+        else:
+            print 'util_format_%s_%s_%s(uint8_t *dst, const %s *src, unsigned width)' % (name, suffix, isa, native_type)
+        print '{'
+        print '   unsigned x;'
+        print '   for(x = 0; x + %u <= width; x += %u) {' % (width, width)
+        generate_loop(format, native_type, isa, width, int_type, float_type)
+        print '   }'
+        print '   return x;'
+        print '}'
+        print
+    print '#endif /* U_FORMAT_SIMD_DISPATCH */'
+    print '#endif /* U_FORMAT_SIMD */'
+    print
+
+
+def generate_simd_dispatch(format, suffix, dst_step, src_step):
+    '''Generate the call to the best row kernel for the CPU, leaving the
+    remaining pixels to the scalar loop that follows'''
+
+    print '      x = 0;'
+    print '#ifdef U_FORMAT_SIMD'
+    print '      x = u_format_simd_row(util_format_%s_%s, dst, src, width);' % (format.short_name(), suffix)
+    print '      src += x * %u;' % (src_step,)
+    print '      dst += x * %u;' % (dst_step,)
+    print '#endif'
+
+
+def generate_unpack_simd(format, dst_native_type, isa, width, int_type, float_type):
+    '''Generate the body of a loop unpacking width pixels at a time'''
+
+    channels = format.le_channels
+    swizzles = format.le_swizzles
+    is_float = dst_native_type == 'float'
+
+    print '      %s value = u_format_simd_load_%u_%s(src);' % (int_type, format.block_size(), isa)
+    for i in range(4):
+        channel = channels[i]
+        if channel.type != VOID:
+            print '      %s c%u = u_format_simd_extract_%s(value, %u, %u); /* %s */' % (int_type, i, isa, channel.shift, channel.size, channel.name)
+
+    values = []
+    for i in range(4):
+        swizzle = swizzles[i]
+        if swizzle < 4:
+            size = channels[swizzle].size
+            if is_float:
+                values.append('u_format_simd_unorm_to_float_%s(c%u, %u)' % (isa, swizzle, size))
+            else:
+                values.append('u_format_simd_unorm_to_8unorm_%s(c%u, %u)' % (isa, swizzle, size))
+        elif swizzle == SWIZZLE_1:
+            values.append(is_float and 'u_format_simd_set1_ps_%s(1.0f)' % isa or 'u_format_simd_set1_epi32_%s(0xff)' % isa)
+        else:
+            values.append(is_float and 'u_format_simd_set1_ps_%s(0.0f)' % isa or 'u_format_simd_set1_epi32_%s(0)' % isa)
+
+    if is_float:
+        print '      u_format_simd_store_rgba_float_%s(dst,' % (isa,)
+    else:
+        print '      u_format_simd_store_rgba_8unorm_%s(dst,' % (isa,)
+    for i in range(4):
+        print '         %s%s' % (values[i], i < 3 and ',' or ');')
+    print '      src += %u;' % (width * format.block_size() / 8,)
+    print '      dst += %u;' % (width * 4,)
+
+
+def generate_pack_simd(format, src_native_type, isa, width, int_type, float_type):
+    '''Generate the body of a loop packing width pixels at a time'''
+
+    channels = format.le_channels
+    inv_swizzle = inv_swizzles(format.le_swizzles)
+    is_float = src_native_type == 'float'
+
+    if is_float:
+        print '      %s rgba[4];' % (float_type,)
+        print '      %s value = u_format_simd_set1_epi32_%s(0);' % (int_type, isa)
+        print '      u_format_simd_load_rgba_float_%s(src, rgba);' % (isa,)
+    else:
+        print '      %s rgba[4];' % (int_type,)
+        print '      %s value = u_format_simd_set1_epi32_%s(0);' % (int_type, isa)
+        print '      u_format_simd_load_rgba_8unorm_%s(src, rgba);' % (isa,)
+    for i in range(4):
+        channel = channels[i]
+        if channel.type == VOID or inv_swizzle[i] is None:
+            continue
+        if is_float:
+            conv = 'u_format_simd_float_to_unorm_%s(rgba[%u], %u)' % (isa, inv_swizzle[i], channel.size)
+        else:
+            conv = 'u_format_simd_8unorm_to_unorm_%s(rgba[%u], %u)' % (isa, inv_swizzle[i], channel.size)
+        print '      value = u_format_simd_insert_%s(value, %s, %u, %u); /* %s */' % (isa, conv, channel.shift, channel.size, channel.name)
+    print '      u_format_simd_store_%u_%s(dst, value);' % (format.block_size(), isa)
+    print '      src += %u;' % (width * 4,)
+    print '      dst += %u;' % (width * format.block_size() / 8,)
+
+
 def generate_format_unpack(format, dst_channel, dst_native_type, dst_suffix):
     '''Generate the function to unpack pixels from a particular format'''
 
     name = format.short_name()
 
+    if is_format_simd(format):
+        generate_simd_kernels(format, dst_native_type, 'unpack_' + dst_suffix, generate_unpack_simd)
+
     print 'static inline void'
     print 'util_format_%s_unpack_%s(%s *dst_row, unsigned dst_stride, const uint8_t *src_row, unsigned src_stride, unsigned width, unsigned height)' % (name, dst_suffix, dst_native_type)
     print '{'
@@ -624,7 +766,11 @@ def generate_format_unpack(format, dst_channel, dst_native_type, dst_suffix):
         print '   for(y = 0; y < height; y += %u) {' % (format.block_height,)
         print '      %s *dst = dst_row;' % (dst_native_type)
         print '      const uint8_t *src = src_row;'
-        print '      for(x = 0; x < width; x += %u) {' % (format.block_width,)
+        if is_format_simd(format):
+            generate_simd_dispatch(format, 'unpack_' + dst_suffix, 4, format.block_size() / 8)
+            print '      for(; x < width; x += %u) {' % (format.block_width,)
+        else:
+            print '      for(x = 0; x < width; x += %u) {' % (format.block_width,)
         
         generate_unpack_kernel(format, dst_channel, dst_native_type)
     
@@ -644,6 +790,9 @@ def generate_format_pack(format, src_channel, src_native_type, src_suffix):
 
     name = format.short_name()
 
+    if is_format_simd(format):
+        generate_simd_kernels(format, src_native_type, 'pack_' + src_suffix, generate_pack_simd)
+
     print 'static inline void'
     print 'util_format_%s_pack_%s(uint8_t *dst_row, unsigned dst_stride, const %s *src_row, unsigned src_stride, unsigned width, unsigned height)' % (name, src_suffix, src_native_type)
     print '{'
@@ -653,7 +802,11 @@ def generate_format_pack(format, src_channel, src_native_type, src_suffix):
         print '   for(y = 0; y < height; y += %u) {' % (format.block_height,)
         print '      const %s *src = src_row;' % (src_native_type)
         print '      uint8_t *dst = dst_row;'
-        print '      for(x = 0; x < width; x += %u) {' % (format.block_width,)
+        if is_format_simd(format):
+            generate_simd_dispatch(format, 'pack_' + src_suffix, format.block_size() / 8, 4)
+            print '      for(; x < width; x += %u) {' % (format.block_width,)
+        else:
+            print '      for(x = 0; x < width; x += %u) {' % (format.block_width,)
     
         generate_pack_kernel(format, src_channel, src_native_type)
             
@@ -698,6 +851,7 @@ def generate(formats):
     print '#include "util/format_srgb.h"'
     print '#include "u_format_yuv.h"'
     print '#include "u_format_zs.h"'
+    print '#include "u_format_simd.h"'
     print
 
     for format in formats:
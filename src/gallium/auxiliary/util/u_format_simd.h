@@ -0,0 +1,373 @@
+/**************************************************************************
+ *
+ * Copyright 2017 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDERS, AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * SIMD building blocks for the pack/unpack row kernels emitted by
+ * u_format_pack.py and for the hand-written R11G11B10_FLOAT kernels.
+ *
+ * One 32-bit lane per pixel is used, with each channel extracted into its
+ * own vector. Every conversion reproduces the scalar expression bit for bit
+ * (see u_format_test.c), so the SIMD and scalar paths can be mixed freely
+ * within a row.
+ *
+ * The helpers are written once in u_format_simd_tmp.h and instantiated for
+ * SSE2, SSE4.1 and AVX2. The latter two are compiled with per-function
+ * target attributes, so they're available without raising the baseline ISA,
+ * and u_format_simd_row() picks the widest one util_cpu_caps allows.
+ *
+ * The kernels are restricted to x86-64, where util_iround() truncates
+ * f + 0.5f just like the cvttps based conversion in float_to_unorm.
+ */
+
+
+#ifndef U_FORMAT_SIMD_H_
+#define U_FORMAT_SIMD_H_
+
+
+#include "pipe/p_config.h"
+
+#if defined(PIPE_ARCH_SSE) && defined(PIPE_ARCH_X86_64) && \
+    !defined(PIPE_ARCH_BIG_ENDIAN)
+
+#define U_FORMAT_SIMD 1
+
+#include <emmintrin.h>
+#include "pipe/p_compiler.h"
+#include "u_cpu_detect.h"
+
+#if defined(__clang__) || \
+    (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#define U_FORMAT_SIMD_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+
+#define U_FORMAT_SIMD_TARGET_SSE2
+#define U_FORMAT_SIMD_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define U_FORMAT_SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+
+
+/**
+ * Convert as many pixels of a row as the widest supported kernel handles
+ * and return how many were done. The scalar code finishes the row.
+ */
+#ifdef U_FORMAT_SIMD_DISPATCH
+#define u_format_simd_row(func, dst, src, width) \
+   (util_cpu_caps.has_avx2 ? func##_avx2(dst, src, width) : \
+    util_cpu_caps.has_sse4_1 ? func##_sse41(dst, src, width) : \
+    func##_sse2(dst, src, width))
+#else
+#define u_format_simd_row(func, dst, src, width) \
+   func##_sse2(dst, src, width)
+#endif
+
+
+/*
+ * SSE2
+ */
+
+#define TAG(x) x##_sse2
+#define SIMD_TARGET U_FORMAT_SIMD_TARGET_SSE2
+#define SIMD_WIDTH 4
+#define SIMD_INT __m128i
+#define SIMD_FLOAT __m128
+#define SIMD_SET1_EPI32(a) _mm_set1_epi32(a)
+#define SIMD_AND(a, b) _mm_and_si128(a, b)
+#define SIMD_OR(a, b) _mm_or_si128(a, b)
+#define SIMD_ANDNOT(a, b) _mm_andnot_si128(a, b)
+#define SIMD_SLLI(a, n) _mm_slli_epi32(a, n)
+#define SIMD_SRLI(a, n) _mm_srli_epi32(a, n)
+#define SIMD_SRAI(a, n) _mm_srai_epi32(a, n)
+#define SIMD_ADD_EPI32(a, b) _mm_add_epi32(a, b)
+#define SIMD_CMPEQ_EPI32(a, b) _mm_cmpeq_epi32(a, b)
+#define SIMD_CMPGT_EPI32(a, b) _mm_cmpgt_epi32(a, b)
+#define SIMD_MULLO_EPI16(a, b) _mm_mullo_epi16(a, b)
+#define SIMD_MULHI_EPU16(a, b) _mm_mulhi_epu16(a, b)
+#define SIMD_SELECT(mask, a, b) \
+   _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b))
+#define SIMD_SET1_PS(a) _mm_set1_ps(a)
+#define SIMD_ADD_PS(a, b) _mm_add_ps(a, b)
+#define SIMD_MUL_PS(a, b) _mm_mul_ps(a, b)
+#define SIMD_CMPLT_PS(a, b) _mm_castps_si128(_mm_cmplt_ps(a, b))
+#define SIMD_CMPGT_PS(a, b) _mm_castps_si128(_mm_cmpgt_ps(a, b))
+#define SIMD_CVTEPI32_PS(a) _mm_cvtepi32_ps(a)
+#define SIMD_CVTTPS_EPI32(a) _mm_cvttps_epi32(a)
+#define SIMD_CASTPS_SI(a) _mm_castps_si128(a)
+#define SIMD_CASTSI_PS(a) _mm_castsi128_ps(a)
+
+
+static inline __m128i
+u_format_simd_load_32_sse2(const uint8_t *src)
+{
+   return _mm_loadu_si128((const __m128i *)src);
+}
+
+
+static inline __m128i
+u_format_simd_load_16_sse2(const uint8_t *src)
+{
+   return _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)src),
+                             _mm_setzero_si128());
+}
+
+
+static inline void
+u_format_simd_store_32_sse2(uint8_t *dst, __m128i value)
+{
+   _mm_storeu_si128((__m128i *)dst, value);
+}
+
+
+static inline void
+u_format_simd_store_16_sse2(uint8_t *dst, __m128i value)
+{
+   /* Sign extend the low halves so the saturating pack keeps them intact */
+   value = _mm_srai_epi32(_mm_slli_epi32(value, 16), 16);
+   _mm_storel_epi64((__m128i *)dst, _mm_packs_epi32(value, value));
+}
+
+
+/**
+ * Split four RGBA float pixels into one vector per channel.
+ */
+static inline void
+u_format_simd_load_rgba_float_sse2(const float *src, __m128 rgba[4])
+{
+   __m128 r = _mm_loadu_ps(src + 0);
+   __m128 g = _mm_loadu_ps(src + 4);
+   __m128 b = _mm_loadu_ps(src + 8);
+   __m128 a = _mm_loadu_ps(src + 12);
+   _MM_TRANSPOSE4_PS(r, g, b, a);
+   rgba[0] = r;
+   rgba[1] = g;
+   rgba[2] = b;
+   rgba[3] = a;
+}
+
+
+/**
+ * Interleave four float channel vectors into four RGBA float pixels.
+ */
+static inline void
+u_format_simd_store_rgba_float_sse2(float *dst,
+                                    __m128 r, __m128 g, __m128 b, __m128 a)
+{
+   _MM_TRANSPOSE4_PS(r, g, b, a);
+   _mm_storeu_ps(dst + 0, r);
+   _mm_storeu_ps(dst + 4, g);
+   _mm_storeu_ps(dst + 8, b);
+   _mm_storeu_ps(dst + 12, a);
+}
+
+
+#include "u_format_simd_tmp.h"
+
+
+#ifdef U_FORMAT_SIMD_DISPATCH
+
+/*
+ * SSE4.1: the same four pixels, with pmovzx/packus for 16-bit pixels and
+ * blends instead of and/andnot/or selects.
+ */
+
+#define TAG(x) x##_sse41
+#define SIMD_TARGET U_FORMAT_SIMD_TARGET_SSE41
+#define SIMD_WIDTH 4
+#define SIMD_INT __m128i
+#define SIMD_FLOAT __m128
+#define SIMD_SET1_EPI32(a) _mm_set1_epi32(a)
+#define SIMD_AND(a, b) _mm_and_si128(a, b)
+#define SIMD_OR(a, b) _mm_or_si128(a, b)
+#define SIMD_ANDNOT(a, b) _mm_andnot_si128(a, b)
+#define SIMD_SLLI(a, n) _mm_slli_epi32(a, n)
+#define SIMD_SRLI(a, n) _mm_srli_epi32(a, n)
+#define SIMD_SRAI(a, n) _mm_srai_epi32(a, n)
+#define SIMD_ADD_EPI32(a, b) _mm_add_epi32(a, b)
+#define SIMD_CMPEQ_EPI32(a, b) _mm_cmpeq_epi32(a, b)
+#define SIMD_CMPGT_EPI32(a, b) _mm_cmpgt_epi32(a, b)
+#define SIMD_MULLO_EPI16(a, b) _mm_mullo_epi16(a, b)
+#define SIMD_MULHI_EPU16(a, b) _mm_mulhi_epu16(a, b)
+#define SIMD_SELECT(mask, a, b) _mm_blendv_epi8(b, a, mask)
+#define SIMD_SET1_PS(a) _mm_set1_ps(a)
+#define SIMD_ADD_PS(a, b) _mm_add_ps(a, b)
+#define SIMD_MUL_PS(a, b) _mm_mul_ps(a, b)
+#define SIMD_CMPLT_PS(a, b) _mm_castps_si128(_mm_cmplt_ps(a, b))
+#define SIMD_CMPGT_PS(a, b) _mm_castps_si128(_mm_cmpgt_ps(a, b))
+#define SIMD_CVTEPI32_PS(a) _mm_cvtepi32_ps(a)
+#define SIMD_CVTTPS_EPI32(a) _mm_cvttps_epi32(a)
+#define SIMD_CASTPS_SI(a) _mm_castps_si128(a)
+#define SIMD_CASTSI_PS(a) _mm_castsi128_ps(a)
+
+#define u_format_simd_load_32_sse41 u_format_simd_load_32_sse2
+#define u_format_simd_store_32_sse41 u_format_simd_store_32_sse2
+#define u_format_simd_load_rgba_float_sse41 u_format_simd_load_rgba_float_sse2
+#define u_format_simd_store_rgba_float_sse41 u_format_simd_store_rgba_float_sse2
+
+
+static inline U_FORMAT_SIMD_TARGET_SSE41 __m128i
+u_format_simd_load_16_sse41(const uint8_t *src)
+{
+   return _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *)src));
+}
+
+
+static inline U_FORMAT_SIMD_TARGET_SSE41 void
+u_format_simd_store_16_sse41(uint8_t *dst, __m128i value)
+{
+   _mm_storel_epi64((__m128i *)dst, _mm_packus_epi32(value, value));
+}
+
+
+#include "u_format_simd_tmp.h"
+
+
+/*
+ * AVX2: eight pixels at a time.
+ */
+
+#define TAG(x) x##_avx2
+#define SIMD_TARGET U_FORMAT_SIMD_TARGET_AVX2
+#define SIMD_WIDTH 8
+#define SIMD_INT __m256i
+#define SIMD_FLOAT __m256
+#define SIMD_SET1_EPI32(a) _mm256_set1_epi32(a)
+#define SIMD_AND(a, b) _mm256_and_si256(a, b)
+#define SIMD_OR(a, b) _mm256_or_si256(a, b)
+#define SIMD_ANDNOT(a, b) _mm256_andnot_si256(a, b)
+#define SIMD_SLLI(a, n) _mm256_slli_epi32(a, n)
+#define SIMD_SRLI(a, n) _mm256_srli_epi32(a, n)
+#define SIMD_SRAI(a, n) _mm256_srai_epi32(a, n)
+#define SIMD_ADD_EPI32(a, b) _mm256_add_epi32(a, b)
+#define SIMD_CMPEQ_EPI32(a, b) _mm256_cmpeq_epi32(a, b)
+#define SIMD_CMPGT_EPI32(a, b) _mm256_cmpgt_epi32(a, b)
+#define SIMD_MULLO_EPI16(a, b) _mm256_mullo_epi16(a, b)
+#define SIMD_MULHI_EPU16(a, b) _mm256_mulhi_epu16(a, b)
+#define SIMD_SELECT(mask, a, b) _mm256_blendv_epi8(b, a, mask)
+#define SIMD_SET1_PS(a) _mm256_set1_ps(a)
+#define SIMD_ADD_PS(a, b) _mm256_add_ps(a, b)
+#define SIMD_MUL_PS(a, b) _mm256_mul_ps(a, b)
+#define SIMD_CMPLT_PS(a, b) _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_LT_OS))
+#define SIMD_CMPGT_PS(a, b) _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_GT_OS))
+#define SIMD_CVTEPI32_PS(a) _mm256_cvtepi32_ps(a)
+#define SIMD_CVTTPS_EPI32(a) _mm256_cvttps_epi32(a)
+#define SIMD_CASTPS_SI(a) _mm256_castps_si256(a)
+#define SIMD_CASTSI_PS(a) _mm256_castsi256_ps(a)
+
+
+static inline U_FORMAT_SIMD_TARGET_AVX2 __m256i
+u_format_simd_load_32_avx2(const uint8_t *src)
+{
+   return _mm256_loadu_si256((const __m256i *)src);
+}
+
+
+static inline U_FORMAT_SIMD_TARGET_AVX2 __m256i
+u_format_simd_load_16_avx2(const uint8_t *src)
+{
+   return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)src));
+}
+
+
+static inline U_FORMAT_SIMD_TARGET_AVX2 void
+u_format_simd_store_32_avx2(uint8_t *dst, __m256i value)
+{
+   _mm256_storeu_si256((__m256i *)dst, value);
+}
+
+
+static inline U_FORMAT_SIMD_TARGET_AVX2 void
+u_format_simd_store_16_avx2(uint8_t *dst, __m256i value)
+{
+   _mm_storeu_si128((__m128i *)dst,
+                    _mm_packus_epi32(_mm256_castsi256_si128(value),
+                                     _mm256_extracti128_si256(value, 1)));
+}
+
+
+/**
+ * _MM_TRANSPOSE4_PS() within each 128-bit half.
+ */
+#define U_FORMAT_SIMD_TRANSPOSE4_AVX2(r, g, b, a) \
+   do { \
+      __m256 t0 = _mm256_unpacklo_ps(r, g); \
+      __m256 t1 = _mm256_unpacklo_ps(b, a); \
+      __m256 t2 = _mm256_unpackhi_ps(r, g); \
+      __m256 t3 = _mm256_unpackhi_ps(b, a); \
+      r = _mm256_shuffle_ps(t0, t1, 0x44); \
+      g = _mm256_shuffle_ps(t0, t1, 0xee); \
+      b = _mm256_shuffle_ps(t2, t3, 0x44); \
+      a = _mm256_shuffle_ps(t2, t3, 0xee); \
+   } while (0)
+
+
+/**
+ * Split eight RGBA float pixels into one vector per channel.
+ */
+static inline U_FORMAT_SIMD_TARGET_AVX2 void
+u_format_simd_load_rgba_float_avx2(const float *src, __m256 rgba[4])
+{
+   __m256 p01 = _mm256_loadu_ps(src + 0);
+   __m256 p23 = _mm256_loadu_ps(src + 8);
+   __m256 p45 = _mm256_loadu_ps(src + 16);
+   __m256 p67 = _mm256_loadu_ps(src + 24);
+   __m256 r = _mm256_permute2f128_ps(p01, p45, 0x20);
+   __m256 g = _mm256_permute2f128_ps(p01, p45, 0x31);
+   __m256 b = _mm256_permute2f128_ps(p23, p67, 0x20);
+   __m256 a = _mm256_permute2f128_ps(p23, p67, 0x31);
+   U_FORMAT_SIMD_TRANSPOSE4_AVX2(r, g, b, a);
+   rgba[0] = r;
+   rgba[1] = g;
+   rgba[2] = b;
+   rgba[3] = a;
+}
+
+
+/**
+ * Interleave eight float channel vectors into eight RGBA float pixels.
+ */
+static inline U_FORMAT_SIMD_TARGET_AVX2 void
+u_format_simd_store_rgba_float_avx2(float *dst,
+                                    __m256 r, __m256 g, __m256 b, __m256 a)
+{
+   U_FORMAT_SIMD_TRANSPOSE4_AVX2(r, g, b, a);
+   _mm256_storeu_ps(dst + 0, _mm256_permute2f128_ps(r, g, 0x20));
+   _mm256_storeu_ps(dst + 8, _mm256_permute2f128_ps(b, a, 0x20));
+   _mm256_storeu_ps(dst + 16, _mm256_permute2f128_ps(r, g, 0x31));
+   _mm256_storeu_ps(dst + 24, _mm256_permute2f128_ps(b, a, 0x31));
+}
+
+
+#include "u_format_simd_tmp.h"
+
+#endif /* U_FORMAT_SIMD_DISPATCH */
+
+
+#endif /* PIPE_ARCH_SSE && PIPE_ARCH_X86_64 && !PIPE_ARCH_BIG_ENDIAN */
+
+#endif /* U_FORMAT_SIMD_H_ */
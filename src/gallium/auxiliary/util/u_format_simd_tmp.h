@@ -0,0 +1,359 @@
+/**************************************************************************
+ *
+ * Copyright 2017 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDERS, AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ **************************************************************************/
+
+
+/*
+ * Included by u_format_simd.h once per instruction set, with TAG(),
+ * SIMD_TARGET, SIMD_WIDTH, the SIMD_INT/SIMD_FLOAT vector types and the
+ * SIMD_* operations defined. The loads, stores and float transposes are
+ * provided by the includer as TAG(u_format_simd_load_32) etc.
+ */
+
+
+static inline SIMD_TARGET SIMD_INT
+TAG(u_format_simd_set1_epi32)(int32_t a)
+{
+   return SIMD_SET1_EPI32(a);
+}
+
+
+static inline SIMD_TARGET SIMD_FLOAT
+TAG(u_format_simd_set1_ps)(float a)
+{
+   return SIMD_SET1_PS(a);
+}
+
+
+/**
+ * (value >> shift) & ((1 << bits) - 1), per lane.
+ */
+static inline SIMD_TARGET SIMD_INT
+TAG(u_format_simd_extract)(SIMD_INT value, unsigned shift, unsigned bits)
+{
+   value = SIMD_SRLI(value, shift);
+   if (shift + bits < 32)
+      value = SIMD_AND(value, SIMD_SET1_EPI32((1 << bits) - 1));
+   return value;
+}
+
+
+/**
+ * value | ((channel & ((1 << bits) - 1)) << shift), per lane.
+ */
+static inline SIMD_TARGET SIMD_INT
+TAG(u_format_simd_insert)(SIMD_INT value, SIMD_INT channel,
+                          unsigned shift, unsigned bits)
+{
+   channel = SIMD_AND(channel, SIMD_SET1_EPI32((1 << bits) - 1));
+   return SIMD_OR(value, SIMD_SLLI(channel, shift));
+}
+
+
+/**
+ * value * 0xff / ((1 << bits) - 1) with integer division, as emitted by the
+ * scalar unpack_rgba_8unorm for channels narrower than 8 bits. The division
+ * is done with a 16-bit reciprocal multiply which is exact for the whole
+ * input range.
+ */
+static inline SIMD_TARGET SIMD_INT
+TAG(u_format_simd_unorm_to_8unorm)(SIMD_INT value, unsigned bits)
+{
+   static const uint16_t magic[8][2] = {
+      {0, 0}, {0, 0}, {21846, 0}, {9363, 0},
+      {4370, 0}, {8457, 2}, {16645, 4}, {33027, 6},
+   };
+
+   if (bits >= 8)
+      return value;
+
+   value = SIMD_MULLO_EPI16(value, SIMD_SET1_EPI32(0xff));
+   if (bits == 1)
+      return value;
+
+   value = SIMD_MULHI_EPU16(value, SIMD_SET1_EPI32(magic[bits][0]));
+   return SIMD_SRLI(value, magic[bits][1]);
+}
+
+
+/**
+ * value >> (8 - bits), as emitted by the scalar pack_rgba_8unorm.
+ */
+static inline SIMD_TARGET SIMD_INT
+TAG(u_format_simd_8unorm_to_unorm)(SIMD_INT value, unsigned bits)
+{
+   return SIMD_SRLI(value, 8 - bits);
+}
+
+
+/**
+ * value * (1.0f/((1 << bits) - 1)), matching both ubyte_to_float() and the
+ * scalar unpack_rgba_float expression.
+ */
+static inline SIMD_TARGET SIMD_FLOAT
+TAG(u_format_simd_unorm_to_float)(SIMD_INT value, unsigned bits)
+{
+   return SIMD_MUL_PS(SIMD_CVTEPI32_PS(value),
+                      SIMD_SET1_PS(1.0f / (float)((1 << bits) - 1)));
+}
+
+
+/**
+ * float_to_ubyte() for 8-bit channels, util_iround(CLAMP(f, 0, 1) * max)
+ * for narrower ones. Both handle NaN, -0.0f and out of range values the
+ * same way as the scalar code.
+ */
+static inline SIMD_TARGET SIMD_INT
+TAG(u_format_simd_float_to_unorm)(SIMD_FLOAT value, unsigned bits)
+{
+   if (bits == 8) {
+      SIMD_INT i = SIMD_CASTPS_SI(value);
+      SIMD_INT neg = SIMD_SRAI(i, 31);
+      SIMD_INT big = SIMD_CMPGT_EPI32(i, SIMD_SET1_EPI32(0x3f7fffff));
+      SIMD_FLOAT t = SIMD_ADD_PS(SIMD_MUL_PS(value,
+                                             SIMD_SET1_PS(255.0f/256.0f)),
+                                 SIMD_SET1_PS(32768.0f));
+      SIMD_INT r = SIMD_AND(SIMD_CASTPS_SI(t), SIMD_SET1_EPI32(0xff));
+      r = SIMD_ANDNOT(neg, r);
+      return SIMD_SELECT(big, SIMD_SET1_EPI32(0xff), r);
+   }
+   else {
+      SIMD_FLOAT one = SIMD_SET1_PS(1.0f);
+      SIMD_INT lt = SIMD_CMPLT_PS(value, SIMD_SET1_PS(0.0f));
+      SIMD_INT gt = SIMD_CMPGT_PS(value, one);
+      SIMD_INT i = SIMD_ANDNOT(lt, SIMD_CASTPS_SI(value));
+      SIMD_FLOAT t = SIMD_CASTSI_PS(SIMD_SELECT(gt, SIMD_CASTPS_SI(one), i));
+      t = SIMD_MUL_PS(t, SIMD_SET1_PS((float)((1 << bits) - 1)));
+      return SIMD_CVTTPS_EPI32(SIMD_ADD_PS(t, SIMD_SET1_PS(0.5f)));
+   }
+}
+
+
+/**
+ * uf11_to_f32()/uf10_to_f32() of the 5 bit exponent, mantissa_bits wide
+ * unsigned float in each lane. Everything but denormals is plain integer
+ * arithmetic on the float bits.
+ */
+static inline SIMD_TARGET SIMD_FLOAT
+TAG(u_format_simd_ufloat_to_float)(SIMD_INT value, unsigned mantissa_bits)
+{
+   SIMD_INT exponent = SIMD_SRLI(value, mantissa_bits);
+   SIMD_INT mantissa = SIMD_AND(value,
+                                SIMD_SET1_EPI32((1 << mantissa_bits) - 1));
+   SIMD_INT normal = SIMD_ADD_EPI32(SIMD_SLLI(value, 23 - mantissa_bits),
+                                    SIMD_SET1_EPI32((127 - 15) << 23));
+   SIMD_FLOAT denorm = SIMD_MUL_PS(SIMD_CVTEPI32_PS(mantissa),
+                                   SIMD_SET1_PS(1.0f / (1 << (14 + mantissa_bits))));
+   SIMD_INT special = SIMD_OR(mantissa, SIMD_SET1_EPI32(0x7f800000));
+   SIMD_INT r;
+
+   r = SIMD_SELECT(SIMD_CMPEQ_EPI32(exponent, SIMD_SET1_EPI32(0)),
+                   SIMD_CASTPS_SI(denorm), normal);
+   r = SIMD_SELECT(SIMD_CMPEQ_EPI32(exponent, SIMD_SET1_EPI32(31)),
+                   special, r);
+   return SIMD_CASTSI_PS(r);
+}
+
+
+/**
+ * f32_to_uf11()/f32_to_uf10(): negative values and denormals become 0,
+ * finite values are truncated and clamped to the largest finite value, and
+ * NaN and +Inf are kept.
+ */
+static inline SIMD_TARGET SIMD_INT
+TAG(u_format_simd_float_to_ufloat)(SIMD_FLOAT value, unsigned mantissa_bits)
+{
+   const int32_t max = (30 << mantissa_bits) | ((1 << mantissa_bits) - 1);
+   /* The float bits of max, i.e. 65024.0f or 64512.0f */
+   const int32_t max_f32 = ((127 + 15) << 23) |
+                           (((1 << mantissa_bits) - 1) << (23 - mantissa_bits));
+   SIMD_INT i = SIMD_CASTPS_SI(value);
+   SIMD_INT abs = SIMD_AND(i, SIMD_SET1_EPI32(0x7fffffff));
+   SIMD_INT normal = SIMD_ADD_EPI32(SIMD_SRLI(i, 23 - mantissa_bits),
+                                    SIMD_SET1_EPI32(-((127 - 15) << mantissa_bits)));
+   SIMD_INT r;
+
+   /* Signed compares, so negative values fail them all */
+   r = SIMD_AND(SIMD_CMPGT_EPI32(i, SIMD_SET1_EPI32(((127 - 15) << 23) | 0x7fffff)),
+                normal);
+   r = SIMD_SELECT(SIMD_CMPGT_EPI32(i, SIMD_SET1_EPI32(max_f32)),
+                   SIMD_SET1_EPI32(max), r);
+   r = SIMD_SELECT(SIMD_CMPEQ_EPI32(i, SIMD_SET1_EPI32(0x7f800000)),
+                   SIMD_SET1_EPI32(31 << mantissa_bits), r);
+   r = SIMD_SELECT(SIMD_CMPGT_EPI32(abs, SIMD_SET1_EPI32(0x7f800000)),
+                   SIMD_SET1_EPI32((31 << mantissa_bits) | 1), r);
+   return r;
+}
+
+
+/**
+ * Split RGBA8 pixels into one vector per channel.
+ */
+static inline SIMD_TARGET void
+TAG(u_format_simd_load_rgba_8unorm)(const uint8_t *src, SIMD_INT rgba[4])
+{
+   SIMD_INT value = TAG(u_format_simd_load_32)(src);
+   rgba[0] = TAG(u_format_simd_extract)(value, 0, 8);
+   rgba[1] = TAG(u_format_simd_extract)(value, 8, 8);
+   rgba[2] = TAG(u_format_simd_extract)(value, 16, 8);
+   rgba[3] = TAG(u_format_simd_extract)(value, 24, 8);
+}
+
+
+/**
+ * Interleave four 8-bit channel vectors into RGBA8 pixels.
+ */
+static inline SIMD_TARGET void
+TAG(u_format_simd_store_rgba_8unorm)(uint8_t *dst, SIMD_INT r, SIMD_INT g,
+                                     SIMD_INT b, SIMD_INT a)
+{
+   SIMD_INT rg = SIMD_OR(r, SIMD_SLLI(g, 8));
+   SIMD_INT ba = SIMD_OR(SIMD_SLLI(b, 16), SIMD_SLLI(a, 24));
+   TAG(u_format_simd_store_32)(dst, SIMD_OR(rg, ba));
+}
+
+
+/*
+ * R11G11B10_FLOAT row kernels, used by u_format_other.c.
+ */
+
+static inline SIMD_TARGET unsigned
+TAG(u_format_simd_r11g11b10_float_unpack_rgba_float)(float *dst,
+                                                     const uint8_t *src,
+                                                     unsigned width)
+{
+   unsigned x;
+   for (x = 0; x + SIMD_WIDTH <= width; x += SIMD_WIDTH) {
+      SIMD_INT value = TAG(u_format_simd_load_32)(src);
+      TAG(u_format_simd_store_rgba_float)(dst,
+         TAG(u_format_simd_ufloat_to_float)(TAG(u_format_simd_extract)(value, 0, 11), 6),
+         TAG(u_format_simd_ufloat_to_float)(TAG(u_format_simd_extract)(value, 11, 11), 6),
+         TAG(u_format_simd_ufloat_to_float)(TAG(u_format_simd_extract)(value, 22, 10), 5),
+         SIMD_SET1_PS(1.0f));
+      src += 4 * SIMD_WIDTH;
+      dst += 4 * SIMD_WIDTH;
+   }
+   return x;
+}
+
+
+static inline SIMD_TARGET unsigned
+TAG(u_format_simd_r11g11b10_float_unpack_rgba_8unorm)(uint8_t *dst,
+                                                      const uint8_t *src,
+                                                      unsigned width)
+{
+   unsigned x;
+   for (x = 0; x + SIMD_WIDTH <= width; x += SIMD_WIDTH) {
+      SIMD_INT value = TAG(u_format_simd_load_32)(src);
+      SIMD_FLOAT r = TAG(u_format_simd_ufloat_to_float)(TAG(u_format_simd_extract)(value, 0, 11), 6);
+      SIMD_FLOAT g = TAG(u_format_simd_ufloat_to_float)(TAG(u_format_simd_extract)(value, 11, 11), 6);
+      SIMD_FLOAT b = TAG(u_format_simd_ufloat_to_float)(TAG(u_format_simd_extract)(value, 22, 10), 5);
+      TAG(u_format_simd_store_rgba_8unorm)(dst,
+                                           TAG(u_format_simd_float_to_unorm)(r, 8),
+                                           TAG(u_format_simd_float_to_unorm)(g, 8),
+                                           TAG(u_format_simd_float_to_unorm)(b, 8),
+                                           SIMD_SET1_EPI32(0xff));
+      src += 4 * SIMD_WIDTH;
+      dst += 4 * SIMD_WIDTH;
+   }
+   return x;
+}
+
+
+static inline SIMD_TARGET SIMD_INT
+TAG(u_format_simd_float3_to_r11g11b10f)(const SIMD_FLOAT rgb[3])
+{
+   SIMD_INT value = TAG(u_format_simd_float_to_ufloat)(rgb[0], 6);
+   value = SIMD_OR(value, SIMD_SLLI(TAG(u_format_simd_float_to_ufloat)(rgb[1], 6), 11));
+   return SIMD_OR(value, SIMD_SLLI(TAG(u_format_simd_float_to_ufloat)(rgb[2], 5), 22));
+}
+
+
+static inline SIMD_TARGET unsigned
+TAG(u_format_simd_r11g11b10_float_pack_rgba_float)(uint8_t *dst,
+                                                   const float *src,
+                                                   unsigned width)
+{
+   unsigned x;
+   for (x = 0; x + SIMD_WIDTH <= width; x += SIMD_WIDTH) {
+      SIMD_FLOAT rgba[4];
+      TAG(u_format_simd_load_rgba_float)(src, rgba);
+      TAG(u_format_simd_store_32)(dst, TAG(u_format_simd_float3_to_r11g11b10f)(rgba));
+      src += 4 * SIMD_WIDTH;
+      dst += 4 * SIMD_WIDTH;
+   }
+   return x;
+}
+
+
+static inline SIMD_TARGET unsigned
+TAG(u_format_simd_r11g11b10_float_pack_rgba_8unorm)(uint8_t *dst,
+                                                    const uint8_t *src,
+                                                    unsigned width)
+{
+   unsigned x;
+   for (x = 0; x + SIMD_WIDTH <= width; x += SIMD_WIDTH) {
+      SIMD_INT rgba[4];
+      SIMD_FLOAT rgb[3];
+      TAG(u_format_simd_load_rgba_8unorm)(src, rgba);
+      rgb[0] = TAG(u_format_simd_unorm_to_float)(rgba[0], 8);
+      rgb[1] = TAG(u_format_simd_unorm_to_float)(rgba[1], 8);
+      rgb[2] = TAG(u_format_simd_unorm_to_float)(rgba[2], 8);
+      TAG(u_format_simd_store_32)(dst, TAG(u_format_simd_float3_to_r11g11b10f)(rgb));
+      src += 4 * SIMD_WIDTH;
+      dst += 4 * SIMD_WIDTH;
+   }
+   return x;
+}
+
+
+#undef TAG
+#undef SIMD_TARGET
+#undef SIMD_WIDTH
+#undef SIMD_INT
+#undef SIMD_FLOAT
+#undef SIMD_SET1_EPI32
+#undef SIMD_AND
+#undef SIMD_OR
+#undef SIMD_ANDNOT
+#undef SIMD_SLLI
+#undef SIMD_SRLI
+#undef SIMD_SRAI
+#undef SIMD_ADD_EPI32
+#undef SIMD_CMPEQ_EPI32
+#undef SIMD_CMPGT_EPI32
+#undef SIMD_MULLO_EPI16
+#undef SIMD_MULHI_EPU16
+#undef SIMD_SELECT
+#undef SIMD_SET1_PS
+#undef SIMD_ADD_PS
+#undef SIMD_MUL_PS
+#undef SIMD_CMPLT_PS
+#undef SIMD_CMPGT_PS
+#undef SIMD_CVTEPI32_PS
+#undef SIMD_CVTTPS_EPI32
+#undef SIMD_CASTPS_SI
+#undef SIMD_CASTSI_PS
@@ -991,6 +991,10 @@ struct pipe_screen *radeonsi_screen_create(struct radeon_winsys *ws,
 
 	/* Only enable as many threads as we have target machines, but at most
 	 * the number of CPUs - 1 if there is more than one.
+	 *
+	 * The main compiler queue runs on the shared pool, where draw calls
+	 * waiting for it go first. Optimized variants keep their own
+	 * SCHED_IDLE threads, which pool threads can't provide.
 	 */
 	num_threads = sysconf(_SC_NPROCESSORS_ONLN);
 	num_threads = MAX2(1, num_threads - 1);
@@ -1000,7 +1004,9 @@ struct pipe_screen *radeonsi_screen_create(struct radeon_winsys *ws,
 
 	if (!util_queue_init(&sscreen->shader_compiler_queue, "si_shader",
 			     32, num_compiler_threads,
-			     UTIL_QUEUE_INIT_RESIZE_IF_FULL)) {
+			     UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+			     UTIL_QUEUE_INIT_SHARED_THREADS |
+			     UTIL_QUEUE_INIT_HIGH_PRIORITY)) {
 		si_destroy_shader_cache(sscreen);
 		FREE(sscreen);
 		return NULL;
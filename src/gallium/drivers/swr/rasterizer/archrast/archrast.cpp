@@ -25,6 +25,7 @@
 * @brief Implementation for archrast.
 *
 ******************************************************************************/
+#include <algorithm>
 #include <atomic>
 
 #include "common/os.h"
@@ -53,6 +54,11 @@ namespace ArchRast
         uint32_t clippedVerts = 0;
     };
 
+    struct CullStats
+    {
+        uint32_t culledPrims = 0;
+    };
+
     struct TEStats
     {
         uint32_t inputPrims = 0;
@@ -208,6 +214,9 @@ namespace ArchRast
             //Clipper
             EventHandlerFile::Handle(VertsClipped(event.data.drawId, mClipper.clippedVerts));
 
+            //Culling
+            EventHandlerFile::Handle(CulledPrims(event.data.drawId, mCull.culledPrims));
+
             //Tesselator
             EventHandlerFile::Handle(TessPrims(event.data.drawId, mTS.inputPrims));
 
@@ -218,6 +227,7 @@ namespace ArchRast
 
             //Reset Internal Counters
             mClipper = {};
+            mCull = {};
             mTS = {};
             mGS = {};
         }
@@ -234,6 +244,11 @@ namespace ArchRast
             mClipper.clippedVerts += (_mm_popcnt_u32(event.data.primMask) * event.data.vertsPerPrim);
         }
 
+        virtual void Handle(const CullInfoEvent& event)
+        {
+            mCull.culledPrims += _mm_popcnt_u64(event.data.culledPrimsMask);
+        }
+
         virtual void Handle(const TessPrimCount& event)
         {
             mTS.inputPrims += event.data.primCount;
@@ -248,14 +263,121 @@ namespace ArchRast
         DepthStencilStats mDSNullPS = {};
         DepthStencilStats mDSOmZ = {};
         CStats mClipper = {};
+        CullStats mCull = {};
         TEStats mTS = {};
         GSStats mGS = {};
 
     };
 
-    static EventManager* FromHandle(HANDLE hThreadContext)
+    //////////////////////////////////////////////////////////////////////////
+    /// @brief Event handler that folds events into running counters which
+    ///        can be read from other threads. Counts accumulate privately
+    ///        and are published once per draw in FlushDraw.
+    class EventHandlerCounters : public EventHandler
     {
-        return reinterpret_cast<EventManager*>(hThreadContext);
+    public:
+        EventHandlerCounters() {}
+
+        virtual void Handle(const Start& event)
+        {
+            uint32_t* pDepth = GroupDepth(event.data.type);
+            if (pDepth && (*pDepth)++ == 0)
+            {
+                mGroupStart[pDepth == &mDepthBE] = __rdtsc();
+            }
+        }
+
+        virtual void Handle(const End& event)
+        {
+            uint32_t* pDepth = GroupDepth(event.data.type);
+            if (pDepth && *pDepth && --(*pDepth) == 0)
+            {
+                bool isBE = pDepth == &mDepthBE;
+                uint64_t elapsed = __rdtsc() - mGroupStart[isBE];
+                (isBE ? mLocal.BackendCycles : mLocal.FrontendCycles) += elapsed;
+            }
+        }
+
+        virtual void Handle(const CullInfoEvent& event)
+        {
+            mLocal.CulledPrimitives += _mm_popcnt_u64(event.data.culledPrimsMask);
+        }
+
+        virtual void Handle(const EarlyDepthStencilInfoSingleSample& event)
+        {
+            EarlyDepth(event.data.depthPassMask, event.data.coverageMask);
+        }
+
+        virtual void Handle(const EarlyDepthStencilInfoSampleRate& event)
+        {
+            EarlyDepth(event.data.depthPassMask, event.data.coverageMask);
+        }
+
+        virtual void Handle(const EarlyDepthStencilInfoNullPS& event)
+        {
+            EarlyDepth(event.data.depthPassMask, event.data.coverageMask);
+        }
+
+        virtual void Handle(const EarlyDepthInfoPixelRate& event)
+        {
+            uint64_t active = _mm_popcnt_u64(event.data.activeLanes);
+            mLocal.EarlyZPassCount += event.data.depthPassCount;
+            mLocal.EarlyZFailCount += active - std::min(active, event.data.depthPassCount);
+        }
+
+        virtual void FlushDraw(uint32_t drawId)
+        {
+            mPublished[0].fetch_add(mLocal.CulledPrimitives, std::memory_order_relaxed);
+            mPublished[1].fetch_add(mLocal.EarlyZPassCount, std::memory_order_relaxed);
+            mPublished[2].fetch_add(mLocal.EarlyZFailCount, std::memory_order_relaxed);
+            mPublished[3].fetch_add(mLocal.FrontendCycles, std::memory_order_relaxed);
+            mPublished[4].fetch_add(mLocal.BackendCycles, std::memory_order_relaxed);
+            mLocal = {};
+        }
+
+        void Accumulate(SWR_ARCHRAST_COUNTERS& counters) const
+        {
+            counters.CulledPrimitives += mPublished[0].load(std::memory_order_relaxed);
+            counters.EarlyZPassCount += mPublished[1].load(std::memory_order_relaxed);
+            counters.EarlyZFailCount += mPublished[2].load(std::memory_order_relaxed);
+            counters.FrontendCycles += mPublished[3].load(std::memory_order_relaxed);
+            counters.BackendCycles += mPublished[4].load(std::memory_order_relaxed);
+        }
+
+    private:
+        void EarlyDepth(uint64_t depthPassMask, uint64_t coverageMask)
+        {
+            mLocal.EarlyZPassCount += _mm_popcnt_u64(depthPassMask & coverageMask);
+            mLocal.EarlyZFailCount += _mm_popcnt_u64(~depthPassMask & coverageMask);
+        }
+
+        // Only the outermost FE or BE bucket is timed so nested buckets
+        // aren't counted twice.
+        uint32_t* GroupDepth(GroupType type)
+        {
+            if (type >= FEProcessDraw && type <= FEProcessInvalidateTiles) return &mDepthFE;
+            if (type >= BELoadTiles && type <= BEEndTile) return &mDepthBE;
+            return nullptr;
+        }
+
+        uint32_t mDepthFE = 0;
+        uint32_t mDepthBE = 0;
+        uint64_t mGroupStart[2] = {};
+        SWR_ARCHRAST_COUNTERS mLocal = {};
+        std::atomic<uint64_t> mPublished[5] = {};
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @brief Per-thread state behind an ArchRast thread context handle.
+    struct ThreadContext
+    {
+        EventManager manager;
+        EventHandlerCounters* pCounters = nullptr;
+    };
+
+    static ThreadContext* FromHandle(HANDLE hThreadContext)
+    {
+        return reinterpret_cast<ThreadContext*>(hThreadContext);
     }
 
     // Construct an event manager and associate a handler with it.
@@ -265,24 +387,31 @@ namespace ArchRast
         static std::atomic<uint32_t> counter(0);
         uint32_t id = counter.fetch_add(1);
 
-        EventManager* pManager = new EventManager();
-        EventHandlerFile* pHandler = new EventHandlerStatsFile(id);
+        ThreadContext* pThreadContext = new ThreadContext();
+        EventHandlerCounters* pCounters = new EventHandlerCounters();
 
-        if (pManager && pHandler)
+        if (pThreadContext && pCounters)
         {
-            pManager->Attach(pHandler);
+            pThreadContext->manager.Attach(pCounters);
+            pThreadContext->pCounters = pCounters;
 
-            if (type == AR_THREAD::API)
-            {
-                pHandler->Handle(ThreadStartApiEvent());
-            }
-            else
+            if (KNOB_AR_EVENT_FILES)
             {
-                pHandler->Handle(ThreadStartWorkerEvent());
+                EventHandlerFile* pHandler = new EventHandlerStatsFile(id);
+                pThreadContext->manager.Attach(pHandler);
+
+                if (type == AR_THREAD::API)
+                {
+                    pHandler->Handle(ThreadStartApiEvent());
+                }
+                else
+                {
+                    pHandler->Handle(ThreadStartWorkerEvent());
+                }
+                pHandler->MarkHeader();
             }
-            pHandler->MarkHeader();
 
-            return pManager;
+            return pThreadContext;
         }
 
         SWR_INVALID("Failed to register thread.");
@@ -291,27 +420,36 @@ namespace ArchRast
 
     void DestroyThreadContext(HANDLE hThreadContext)
     {
-        EventManager* pManager = FromHandle(hThreadContext);
-        SWR_ASSERT(pManager != nullptr);
+        ThreadContext* pThreadContext = FromHandle(hThreadContext);
+        SWR_ASSERT(pThreadContext != nullptr);
 
-        delete pManager;
+        delete pThreadContext;
     }
 
     // Dispatch event for this thread.
     void Dispatch(HANDLE hThreadContext, const Event& event)
     {
-        EventManager* pManager = FromHandle(hThreadContext);
-        SWR_ASSERT(pManager != nullptr);
+        ThreadContext* pThreadContext = FromHandle(hThreadContext);
+        SWR_ASSERT(pThreadContext != nullptr);
 
-        pManager->Dispatch(event);
+        pThreadContext->manager.Dispatch(event);
     }
 
     // Flush for this thread.
     void FlushDraw(HANDLE hThreadContext, uint32_t drawId)
     {
-        EventManager* pManager = FromHandle(hThreadContext);
-        SWR_ASSERT(pManager != nullptr);
+        ThreadContext* pThreadContext = FromHandle(hThreadContext);
+        SWR_ASSERT(pThreadContext != nullptr);
+
+        pThreadContext->manager.FlushDraw(drawId);
+    }
+
+    // Add this thread's published counters into counters.
+    void AccumulateCounters(HANDLE hThreadContext, SWR_ARCHRAST_COUNTERS& counters)
+    {
+        ThreadContext* pThreadContext = FromHandle(hThreadContext);
+        SWR_ASSERT(pThreadContext != nullptr);
 
-        pManager->FlushDraw(drawId);
+        pThreadContext->pCounters->Accumulate(counters);
     }
 }
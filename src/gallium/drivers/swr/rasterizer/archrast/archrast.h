@@ -28,6 +28,7 @@
 #pragma once
 
 #include "common/os.h"
+#include "core/state.h"
 #include "gen_ar_event.hpp"
 
 namespace ArchRast
@@ -44,5 +45,8 @@ namespace ArchRast
     // Dispatch event for this thread.
     void Dispatch(HANDLE hThreadContext, const Event& event);
     void FlushDraw(HANDLE hThreadContext, uint32_t drawId);
+
+    // Add counters published by this thread into counters.
+    void AccumulateCounters(HANDLE hThreadContext, SWR_ARCHRAST_COUNTERS& counters);
 };
 
@@ -46,6 +46,17 @@ KNOBS = [
         'category'  : 'debug',
     }],
 
+    ['AR_EVENT_FILES', {
+        'type'      : 'bool',
+        'default'   : 'true',
+        'desc'      : ['Write ArchRast event streams to per-thread files for offline tools.',
+                       'When disabled only the in-process counters backing the driver',
+                       'queries are gathered.',
+                       '',
+                       'NOTE: Requires KNOB_ENABLE_AR to be defined at build time'],
+        'category'  : 'perf',
+    }],
+
     ['USE_GENERIC_STORETILE', {
         'type'      : 'bool',
         'default'   : 'false',
@@ -1473,6 +1473,7 @@ void SwrDispatch(
     AR_API_BEGIN(APIDispatch, pDC->drawId);
     AR_API_EVENT(DispatchEvent(pDC->drawId, threadGroupCountX, threadGroupCountY, threadGroupCountZ));
     pDC->isCompute = true;      // This is a compute context.
+    pDC->dependent = true;      // Thread groups may read anything earlier draws wrote.
 
     COMPUTE_DESC* pTaskData = (COMPUTE_DESC*)pDC->pArena->AllocAligned(sizeof(COMPUTE_DESC), 64);
 
@@ -1483,7 +1484,7 @@ void SwrDispatch(
     uint32_t totalThreadGroups = threadGroupCountX * threadGroupCountY * threadGroupCountZ;
     uint32_t dcIndex = pDC->drawId % KNOB_MAX_DRAWS_IN_FLIGHT;
     pDC->pDispatch = &pContext->pDispatchQueueArray[dcIndex];
-    pDC->pDispatch->initialize(totalThreadGroups, pTaskData, &ProcessComputeBE);
+    pDC->pDispatch->initialize(totalThreadGroups, pTaskData, &ProcessComputeBE, pContext->threadPool.numaMask);
 
     QueueDispatch(pContext);
     AR_API_END(APIDispatch, threadGroupCountX * threadGroupCountY * threadGroupCountZ);
@@ -1653,6 +1654,35 @@ void SWR_API SwrEndFrame(
     pContext->frameCount++;
 }
 
+//////////////////////////////////////////////////////////////////////////
+/// @brief Reads the running ArchRast counters summed over all threads.
+/// @param hContext - Handle passed back from SwrCreateContext, or nullptr
+/// @param pCounters - Output counters, may be nullptr.
+bool SWR_API SwrGetArchRastCounters(
+    HANDLE hContext,
+    SWR_ARCHRAST_COUNTERS* pCounters)
+{
+#if defined(KNOB_ENABLE_AR)
+    if (hContext && pCounters)
+    {
+        SWR_CONTEXT *pContext = GetContext(hContext);
+
+        memset(pCounters, 0, sizeof(*pCounters));
+        for (uint32_t i = 0; i < pContext->NumWorkerThreads + 1; ++i)
+        {
+            ArchRast::AccumulateCounters(pContext->pArContext[i], *pCounters);
+        }
+    }
+    return true;
+#else
+    if (pCounters)
+    {
+        memset(pCounters, 0, sizeof(*pCounters));
+    }
+    return false;
+#endif
+}
+
 void InitSimLoadTilesTable();
 void InitSimStoreTilesTable();
 void InitSimClearTilesTable();
@@ -1720,6 +1750,7 @@ void SwrGetInterface(SWR_INTERFACE &out_funcs)
     out_funcs.pfnSwrEnableStatsFE = SwrEnableStatsFE;
     out_funcs.pfnSwrEnableStatsBE = SwrEnableStatsBE;
     out_funcs.pfnSwrEndFrame = SwrEndFrame;
+    out_funcs.pfnSwrGetArchRastCounters = SwrGetArchRastCounters;
     out_funcs.pfnSwrInit = SwrInit;
     out_funcs.pfnSwrLoadHotTile = SwrLoadHotTile;
     out_funcs.pfnSwrStoreHotTileToSurface = SwrStoreHotTileToSurface;
@@ -662,6 +662,18 @@ SWR_FUNC(void, SwrEnableStatsBE,
 SWR_FUNC(void, SwrEndFrame,
     HANDLE hContext);
 
+//////////////////////////////////////////////////////////////////////////
+/// @brief Reads the running ArchRast counters summed over all threads.
+///        Counters are only as current as the last draw each worker
+///        completed; use SwrSync to read them at a known point.
+/// @param hContext - Handle passed back from SwrCreateContext, or nullptr
+///        to only check whether ArchRast is available.
+/// @param pCounters - Output counters, may be nullptr.
+/// @return false if ArchRast was not compiled in.
+SWR_FUNC(bool, SwrGetArchRastCounters,
+    HANDLE hContext,
+    SWR_ARCHRAST_COUNTERS* pCounters);
+
 //////////////////////////////////////////////////////////////////////////
 /// @brief Initialize swr backend and memory internal tables
 SWR_FUNC(void, SwrInit);
@@ -756,6 +768,7 @@ struct SWR_INTERFACE
     PFNSwrEnableStatsFE pfnSwrEnableStatsFE;
     PFNSwrEnableStatsBE pfnSwrEnableStatsBE;
     PFNSwrEndFrame pfnSwrEndFrame;
+    PFNSwrGetArchRastCounters pfnSwrGetArchRastCounters;
     PFNSwrInit pfnSwrInit;
     PFNSwrLoadHotTile pfnSwrLoadHotTile;
     PFNSwrStoreHotTileToSurface pfnSwrStoreHotTileToSurface;
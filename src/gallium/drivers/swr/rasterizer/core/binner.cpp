@@ -574,6 +574,7 @@ void SIMDCALL BinTrianglesImpl(
     if (origTriMask ^ triMask)
     {
         RDTSC_EVENT(FECullZeroAreaAndBackface, _mm_popcnt_u32(origTriMask ^ triMask), 0);
+        AR_EVENT(CullInfoEvent(pDC->drawId, origTriMask ^ triMask));
     }
 
     /// Note: these variable initializations must stay above any 'goto endBenTriangles'
@@ -677,6 +678,7 @@ void SIMDCALL BinTrianglesImpl(
         if (origTriMask ^ triMask)
         {
             RDTSC_EVENT(FECullBetweenCenters, _mm_popcnt_u32(origTriMask ^ triMask), 0);
+            AR_EVENT(CullInfoEvent(pDC->drawId, origTriMask ^ triMask));
         }
     }
 
@@ -631,6 +631,21 @@ OSALIGNLINE(struct) SWR_STATS_FE
     uint64_t SoNumPrimsWritten[4];
 };
 
+//////////////////////////////////////////////////////////////////////////
+/// SWR_ARCHRAST_COUNTERS
+///
+/// @brief Running totals aggregated in-process from the ArchRast event
+///        stream. Only populated when ArchRast is compiled in.
+/////////////////////////////////////////////////////////////////////////
+struct SWR_ARCHRAST_COUNTERS
+{
+    uint64_t CulledPrimitives;  // Prims rejected by zero area, backface and between-centers culling
+    uint64_t EarlyZPassCount;   // Samples passing early depth test
+    uint64_t EarlyZFailCount;   // Covered samples rejected by early depth test
+    uint64_t FrontendCycles;    // rdtsc cycles spent in frontend work
+    uint64_t BackendCycles;     // rdtsc cycles spent in backend work
+};
+
 //////////////////////////////////////////////////////////////////////////
 /// STREAMOUT_BUFFERS
 /////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,631 @@
+/****************************************************************************
+* Copyright (C) 2014-2017 Intel Corporation.   All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice (including the next
+* paragraph) shall be included in all copies or substantial portions of the
+* Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* @file tessellator.cpp
+*
+* @brief Tessellator fixed function unit implementation.
+*
+*        Domains are subdivided into concentric rings: the outermost ring
+*        is split according to the outer tessellation factors, all inner
+*        rings according to the inner factor(s).  Adjacent rings are
+*        stitched together with triangles.  Edge subdivisions are symmetric
+*        so that patches sharing an edge with the same factor produce
+*        identical vertices along it.
+*
+******************************************************************************/
+
+#include <cmath>
+#include <algorithm>
+
+#include "common/os.h"
+#include "core/state.h"
+#include "core/utils.h"
+#include "core/tessellator.h"
+
+namespace
+{
+    const uint32_t TS_MAX_FACTOR = 64;
+
+    // Upper bounds on the output of a single patch, padded so that
+    // SIMD16 loads past the end of valid data stay inside the buffers.
+    const uint32_t TS_MAX_DOMAIN_POINTS = 4368;     // >= (64 + 2)^2
+    const uint32_t TS_MAX_PRIMITIVES = 8720;        // >= 2 * (64 + 2)^2
+    const uint32_t TS_PADDING = 16;
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @brief Subdivision of a [0, 1] edge for a single tessellation factor
+    struct TsPartition
+    {
+        uint32_t numSegments;
+        float t[TS_MAX_FACTOR + 1];
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @brief Ordered list of domain points along one side of a ring.
+    ///        param[] is the normalized position of each point along the side.
+    struct TsEdge
+    {
+        uint32_t numPoints;
+        uint32_t idx[TS_MAX_FACTOR + 1];
+        float param[TS_MAX_FACTOR + 1];
+    };
+
+    struct TsRing
+    {
+        TsEdge edge[4];
+    };
+
+    struct TessellationCtx
+    {
+        SWR_TS_DOMAIN domain;
+        SWR_TS_PARTITIONING partitioning;
+        SWR_TS_OUTPUT_TOPOLOGY outputTopology;
+
+        uint32_t numDomainPoints;
+        uint32_t numPrimitives;
+
+        OSALIGNLINE(float) domainPointsU[TS_MAX_DOMAIN_POINTS];
+        OSALIGNLINE(float) domainPointsV[TS_MAX_DOMAIN_POINTS];
+        OSALIGNLINE(uint32_t) indices[3][TS_MAX_PRIMITIVES];
+
+        // Inner grid point lookup for the quad domain
+        uint16_t grid[TS_MAX_FACTOR + 1][TS_MAX_FACTOR + 1];
+    };
+
+    INLINE bool IsCulled(float factor)
+    {
+        // NaN or non-positive outer factors discard the patch
+        return !(factor > 0.0f);
+    }
+
+    INLINE float ClampFactor(float factor, SWR_TS_PARTITIONING partitioning)
+    {
+        const float maxFactor = (float)TS_MAX_FACTOR;
+
+        switch (partitioning)
+        {
+        case SWR_TS_ODD_FRACTIONAL:  return std::min(std::max(factor, 1.0f), maxFactor - 1.0f);
+        case SWR_TS_EVEN_FRACTIONAL: return std::min(std::max(factor, 2.0f), maxFactor);
+        default:                     return std::min(std::max(factor, 1.0f), maxFactor);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @brief Split [0, 1] into segments for the given factor.
+    ///        Fractional modes produce n - 2 segments of length 1 / factor
+    ///        and two shorter ones placed symmetrically around the middle.
+    void ComputePartition(float factor, SWR_TS_PARTITIONING partitioning, TsPartition& part)
+    {
+        float f = ClampFactor(factor, partitioning);
+        uint32_t n = (uint32_t)std::ceil(f);
+
+        if (partitioning == SWR_TS_ODD_FRACTIONAL && (n % 2) == 0)
+        {
+            n++;
+        }
+        else if (partitioning == SWR_TS_EVEN_FRACTIONAL && (n % 2) == 1)
+        {
+            n++;
+        }
+
+        part.numSegments = n;
+        part.t[0] = 0.0f;
+
+        if (partitioning == SWR_TS_INTEGER || n < 3 || (float)n == f)
+        {
+            for (uint32_t i = 1; i < n; ++i)
+            {
+                part.t[i] = (float)i / (float)n;
+            }
+        }
+        else
+        {
+            const float longSeg = 1.0f / f;
+            const float shortSeg = (f - (float)(n - 2)) / (2.0f * f);
+            const uint32_t shortA = (n % 2) ? (n - 3) / 2 : n / 2 - 1;
+            const uint32_t shortB = n - 1 - shortA;
+
+            for (uint32_t i = 0; i < n - 1; ++i)
+            {
+                part.t[i + 1] = part.t[i] + ((i == shortA || i == shortB) ? shortSeg : longSeg);
+            }
+        }
+
+        part.t[n] = 1.0f;
+
+        // Enforce exact symmetry so shared edges match bit for bit
+        for (uint32_t i = 0; i <= n / 2; ++i)
+        {
+            part.t[n - i] = 1.0f - part.t[i];
+        }
+        if ((n % 2) == 0)
+        {
+            part.t[n / 2] = 0.5f;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @brief An inner factor that rounds to a single segment while the
+    ///        outer ring is subdivided is treated as 1 + epsilon.
+    INLINE void ComputeInnerPartition(float factor, SWR_TS_PARTITIONING partitioning, TsPartition& part)
+    {
+        ComputePartition(factor, partitioning, part);
+        if (part.numSegments == 1)
+        {
+            ComputePartition(std::nextafter(1.0f, 2.0f), partitioning, part);
+        }
+    }
+
+    INLINE uint32_t AddPoint(TessellationCtx& ctx, float u, float v)
+    {
+        SWR_ASSERT(ctx.numDomainPoints < TS_MAX_DOMAIN_POINTS - TS_PADDING);
+        ctx.domainPointsU[ctx.numDomainPoints] = u;
+        ctx.domainPointsV[ctx.numDomainPoints] = v;
+        return ctx.numDomainPoints++;
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @brief Emit a triangle, fixing up the winding to match the requested
+    ///        output topology.  Winding is measured in (u, v) space.
+    void AddTriangle(TessellationCtx& ctx, uint32_t i0, uint32_t i1, uint32_t i2)
+    {
+        SWR_ASSERT(ctx.numPrimitives < TS_MAX_PRIMITIVES - TS_PADDING);
+
+        const float* u = ctx.domainPointsU;
+        const float* v = ctx.domainPointsV;
+        float area = (u[i1] - u[i0]) * (v[i2] - v[i0]) - (u[i2] - u[i0]) * (v[i1] - v[i0]);
+
+        if (area != 0.0f && ((area > 0.0f) != (ctx.outputTopology == SWR_TS_OUTPUT_TRI_CCW)))
+        {
+            std::swap(i1, i2);
+        }
+
+        ctx.indices[0][ctx.numPrimitives] = i0;
+        ctx.indices[1][ctx.numPrimitives] = i1;
+        ctx.indices[2][ctx.numPrimitives] = i2;
+        ctx.numPrimitives++;
+    }
+
+    INLINE void AddLine(TessellationCtx& ctx, uint32_t i0, uint32_t i1)
+    {
+        SWR_ASSERT(ctx.numPrimitives < TS_MAX_PRIMITIVES - TS_PADDING);
+        ctx.indices[0][ctx.numPrimitives] = i0;
+        ctx.indices[1][ctx.numPrimitives] = i1;
+        ctx.indices[2][ctx.numPrimitives] = i1;
+        ctx.numPrimitives++;
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @brief Generate an outer ring edge from corner i0 to corner i1
+    void BuildOuterEdge(TessellationCtx& ctx, const TsPartition& part,
+        uint32_t i0, uint32_t i1, TsEdge& edge)
+    {
+        const float u0 = ctx.domainPointsU[i0], v0 = ctx.domainPointsV[i0];
+        const float u1 = ctx.domainPointsU[i1], v1 = ctx.domainPointsV[i1];
+        const uint32_t n = part.numSegments;
+
+        edge.numPoints = n + 1;
+        edge.idx[0] = i0;
+        edge.param[0] = 0.0f;
+        for (uint32_t j = 1; j < n; ++j)
+        {
+            float t = part.t[j];
+            edge.idx[j] = AddPoint(ctx, u0 + t * (u1 - u0), v0 + t * (v1 - v0));
+            edge.param[j] = t;
+        }
+        edge.idx[n] = i1;
+        edge.param[n] = 1.0f;
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @brief Fill the strip between two concentric ring edges.
+    ///        Both edges run in the same direction.
+    void StitchEdges(TessellationCtx& ctx, const TsEdge& outer, const TsEdge& inner)
+    {
+        const uint32_t a = outer.numPoints - 1;
+        const uint32_t b = inner.numPoints - 1;
+        uint32_t i = 0, j = 0;
+
+        while (i < a || j < b)
+        {
+            bool advanceOuter;
+            if (j == b)
+            {
+                advanceOuter = true;
+            }
+            else if (i == a)
+            {
+                advanceOuter = false;
+            }
+            else
+            {
+                advanceOuter = (outer.param[i] + outer.param[i + 1]) <=
+                               (inner.param[j] + inner.param[j + 1]);
+            }
+
+            if (advanceOuter)
+            {
+                AddTriangle(ctx, outer.idx[i], outer.idx[i + 1], inner.idx[j]);
+                i++;
+            }
+            else
+            {
+                AddTriangle(ctx, outer.idx[i], inner.idx[j + 1], inner.idx[j]);
+                j++;
+            }
+        }
+    }
+
+    void TessellateTri(TessellationCtx& ctx, const SWR_TESSELLATION_FACTORS& tf)
+    {
+        const float* outerTF = tf.OuterTessFactors;
+        if (IsCulled(outerTF[SWR_QUAD_U_EQ0_TRI_U_LINE_DETAIL]) ||
+            IsCulled(outerTF[SWR_QUAD_V_EQ0_TRI_V_LINE_DENSITY]) ||
+            IsCulled(outerTF[SWR_QUAD_U_EQ1_TRI_W]))
+        {
+            return;
+        }
+
+        TsPartition outer[3], inner;
+        for (uint32_t e = 0; e < 3; ++e)
+        {
+            ComputePartition(outerTF[e], ctx.partitioning, outer[e]);
+        }
+        ComputePartition(tf.InnerTessFactors[SWR_QUAD_U_TRI_INSIDE], ctx.partitioning, inner);
+
+        uint32_t cU = AddPoint(ctx, 1.0f, 0.0f);
+        uint32_t cV = AddPoint(ctx, 0.0f, 1.0f);
+        uint32_t cW = AddPoint(ctx, 0.0f, 0.0f);
+
+        if (inner.numSegments == 1 && outer[0].numSegments == 1 &&
+            outer[1].numSegments == 1 && outer[2].numSegments == 1)
+        {
+            AddTriangle(ctx, cU, cV, cW);
+            return;
+        }
+
+        if (inner.numSegments == 1)
+        {
+            ComputeInnerPartition(tf.InnerTessFactors[SWR_QUAD_U_TRI_INSIDE], ctx.partitioning, inner);
+        }
+
+        // Edges run U->V (w == 0), V->W (u == 0), W->U (v == 0)
+        TsRing rings[2];
+        TsRing* pPrev = &rings[0];
+        TsRing* pCur = &rings[1];
+        BuildOuterEdge(ctx, outer[SWR_QUAD_U_EQ1_TRI_W], cU, cV, pPrev->edge[0]);
+        BuildOuterEdge(ctx, outer[SWR_QUAD_U_EQ0_TRI_U_LINE_DETAIL], cV, cW, pPrev->edge[1]);
+        BuildOuterEdge(ctx, outer[SWR_QUAD_V_EQ0_TRI_V_LINE_DENSITY], cW, cU, pPrev->edge[2]);
+
+        const uint32_t n = inner.numSegments;
+        for (uint32_t k = 1; 2 * k <= n; ++k)
+        {
+            const uint32_t m = n - 2 * k;
+
+            if (m == 0)
+            {
+                uint32_t center = AddPoint(ctx, 1.0f / 3.0f, 1.0f / 3.0f);
+                for (uint32_t e = 0; e < 3; ++e)
+                {
+                    pCur->edge[e].numPoints = 1;
+                    pCur->edge[e].idx[0] = center;
+                    pCur->edge[e].param[0] = 0.0f;
+                    StitchEdges(ctx, pPrev->edge[e], pCur->edge[e]);
+                }
+                break;
+            }
+
+            // Ring corners are inset along the bisectors, 2/3 of the way
+            // to the centroid for each full step of the inner subdivision.
+            const float d = inner.t[k];
+            const float cornerU[3] = { 1.0f - 4.0f * d / 3.0f, 2.0f * d / 3.0f, 2.0f * d / 3.0f };
+            const float cornerV[3] = { 2.0f * d / 3.0f, 1.0f - 4.0f * d / 3.0f, 2.0f * d / 3.0f };
+            uint32_t corner[3];
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                corner[c] = AddPoint(ctx, cornerU[c], cornerV[c]);
+            }
+
+            const float range = inner.t[n - k] - inner.t[k];
+            for (uint32_t e = 0; e < 3; ++e)
+            {
+                const uint32_t c0 = e, c1 = (e + 1) % 3;
+                TsEdge& edge = pCur->edge[e];
+
+                edge.numPoints = m + 1;
+                for (uint32_t j = 0; j <= m; ++j)
+                {
+                    float s = (inner.t[k + j] - inner.t[k]) / range;
+                    edge.param[j] = s;
+                    if (j == 0)
+                    {
+                        edge.idx[j] = corner[c0];
+                    }
+                    else if (j == m)
+                    {
+                        edge.idx[j] = corner[c1];
+                    }
+                    else
+                    {
+                        edge.idx[j] = AddPoint(ctx,
+                            cornerU[c0] + s * (cornerU[c1] - cornerU[c0]),
+                            cornerV[c0] + s * (cornerV[c1] - cornerV[c0]));
+                    }
+                }
+
+                StitchEdges(ctx, pPrev->edge[e], edge);
+            }
+
+            if (m == 1)
+            {
+                AddTriangle(ctx, corner[0], corner[1], corner[2]);
+                break;
+            }
+
+            std::swap(pPrev, pCur);
+        }
+    }
+
+    INLINE uint32_t GetGridPoint(TessellationCtx& ctx, const TsPartition& innerU,
+        const TsPartition& innerV, uint32_t iu, uint32_t iv)
+    {
+        if (ctx.grid[iu][iv] == UINT16_MAX)
+        {
+            ctx.grid[iu][iv] = (uint16_t)AddPoint(ctx, innerU.t[iu], innerV.t[iv]);
+        }
+        return ctx.grid[iu][iv];
+    }
+
+    void TessellateQuad(TessellationCtx& ctx, const SWR_TESSELLATION_FACTORS& tf)
+    {
+        const float* outerTF = tf.OuterTessFactors;
+        for (uint32_t e = 0; e < 4; ++e)
+        {
+            if (IsCulled(outerTF[e]))
+            {
+                return;
+            }
+        }
+
+        TsPartition outer[4], innerU, innerV;
+        bool allOnes = true;
+        for (uint32_t e = 0; e < 4; ++e)
+        {
+            ComputePartition(outerTF[e], ctx.partitioning, outer[e]);
+            allOnes &= outer[e].numSegments == 1;
+        }
+        ComputePartition(tf.InnerTessFactors[SWR_QUAD_U_TRI_INSIDE], ctx.partitioning, innerU);
+        ComputePartition(tf.InnerTessFactors[SWR_QUAD_V_INSIDE], ctx.partitioning, innerV);
+        allOnes &= innerU.numSegments == 1 && innerV.numSegments == 1;
+
+        uint32_t c00 = AddPoint(ctx, 0.0f, 0.0f);
+        uint32_t c10 = AddPoint(ctx, 1.0f, 0.0f);
+        uint32_t c11 = AddPoint(ctx, 1.0f, 1.0f);
+        uint32_t c01 = AddPoint(ctx, 0.0f, 1.0f);
+
+        if (allOnes)
+        {
+            AddTriangle(ctx, c00, c10, c11);
+            AddTriangle(ctx, c00, c11, c01);
+            return;
+        }
+
+        if (innerU.numSegments == 1)
+        {
+            ComputeInnerPartition(tf.InnerTessFactors[SWR_QUAD_U_TRI_INSIDE], ctx.partitioning, innerU);
+        }
+        if (innerV.numSegments == 1)
+        {
+            ComputeInnerPartition(tf.InnerTessFactors[SWR_QUAD_V_INSIDE], ctx.partitioning, innerV);
+        }
+
+        const uint32_t nu = innerU.numSegments;
+        const uint32_t nv = innerV.numSegments;
+        for (uint32_t iu = 0; iu <= nu; ++iu)
+        {
+            std::fill_n(ctx.grid[iu], nv + 1, UINT16_MAX);
+        }
+
+        // Edges run v == 0, u == 1, v == 1, u == 0 (counter-clockwise in (u, v))
+        TsRing rings[2];
+        TsRing* pPrev = &rings[0];
+        TsRing* pCur = &rings[1];
+        BuildOuterEdge(ctx, outer[SWR_QUAD_V_EQ0_TRI_V_LINE_DENSITY], c00, c10, pPrev->edge[0]);
+        BuildOuterEdge(ctx, outer[SWR_QUAD_U_EQ1_TRI_W], c10, c11, pPrev->edge[1]);
+        BuildOuterEdge(ctx, outer[SWR_QUAD_V_EQ1], c11, c01, pPrev->edge[2]);
+        BuildOuterEdge(ctx, outer[SWR_QUAD_U_EQ0_TRI_U_LINE_DETAIL], c01, c00, pPrev->edge[3]);
+
+        for (uint32_t k = 1; 2 * k <= nu && 2 * k <= nv; ++k)
+        {
+            const uint32_t a = nu - 2 * k;
+            const uint32_t b = nv - 2 * k;
+            const float rangeU = innerU.t[nu - k] - innerU.t[k];
+            const float rangeV = innerV.t[nv - k] - innerV.t[k];
+
+            TsEdge& bottom = pCur->edge[0];
+            TsEdge& right = pCur->edge[1];
+            TsEdge& top = pCur->edge[2];
+            TsEdge& left = pCur->edge[3];
+
+            bottom.numPoints = top.numPoints = a + 1;
+            for (uint32_t j = 0; j <= a; ++j)
+            {
+                float s = a ? (innerU.t[k + j] - innerU.t[k]) / rangeU : 0.0f;
+                bottom.idx[j] = GetGridPoint(ctx, innerU, innerV, k + j, k);
+                bottom.param[j] = s;
+                top.idx[j] = GetGridPoint(ctx, innerU, innerV, nu - k - j, nv - k);
+                top.param[j] = s;
+            }
+
+            right.numPoints = left.numPoints = b + 1;
+            for (uint32_t j = 0; j <= b; ++j)
+            {
+                float s = b ? (innerV.t[k + j] - innerV.t[k]) / rangeV : 0.0f;
+                right.idx[j] = GetGridPoint(ctx, innerU, innerV, nu - k, k + j);
+                right.param[j] = s;
+                left.idx[j] = GetGridPoint(ctx, innerU, innerV, k, nv - k - j);
+                left.param[j] = s;
+            }
+
+            for (uint32_t e = 0; e < 4; ++e)
+            {
+                StitchEdges(ctx, pPrev->edge[e], pCur->edge[e]);
+            }
+
+            if (a == 0 || b == 0)
+            {
+                break;
+            }
+
+            if (a == 1 || b == 1)
+            {
+                // No further ring fits, fill the remaining rectangle
+                for (uint32_t iu = k; iu < nu - k; ++iu)
+                {
+                    for (uint32_t iv = k; iv < nv - k; ++iv)
+                    {
+                        uint32_t p00 = GetGridPoint(ctx, innerU, innerV, iu, iv);
+                        uint32_t p10 = GetGridPoint(ctx, innerU, innerV, iu + 1, iv);
+                        uint32_t p11 = GetGridPoint(ctx, innerU, innerV, iu + 1, iv + 1);
+                        uint32_t p01 = GetGridPoint(ctx, innerU, innerV, iu, iv + 1);
+                        AddTriangle(ctx, p00, p10, p11);
+                        AddTriangle(ctx, p00, p11, p01);
+                    }
+                }
+                break;
+            }
+
+            std::swap(pPrev, pCur);
+        }
+    }
+
+    void TessellateIsoline(TessellationCtx& ctx, const SWR_TESSELLATION_FACTORS& tf)
+    {
+        const float detailTF = tf.OuterTessFactors[SWR_QUAD_U_EQ0_TRI_U_LINE_DETAIL];
+        const float densityTF = tf.OuterTessFactors[SWR_QUAD_V_EQ0_TRI_V_LINE_DENSITY];
+        if (IsCulled(detailTF) || IsCulled(densityTF))
+        {
+            return;
+        }
+
+        // Line density always uses integer partitioning
+        TsPartition density, detail;
+        ComputePartition(densityTF, SWR_TS_INTEGER, density);
+        ComputePartition(detailTF, ctx.partitioning, detail);
+
+        for (uint32_t line = 0; line < density.numSegments; ++line)
+        {
+            float v = density.t[line];
+            uint32_t prev = AddPoint(ctx, 0.0f, v);
+            for (uint32_t j = 1; j <= detail.numSegments; ++j)
+            {
+                uint32_t cur = AddPoint(ctx, detail.t[j], v);
+                AddLine(ctx, prev, cur);
+                prev = cur;
+            }
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// @brief Initialize a tessellation context in caller provided memory.
+///        Returns NULL and the required size in memSize if pContextMem is
+///        missing or too small.
+HANDLE SWR_API TSInitCtx(
+    SWR_TS_DOMAIN tsDomain,
+    SWR_TS_PARTITIONING tsPartitioning,
+    SWR_TS_OUTPUT_TOPOLOGY tsOutputTopology,
+    void* pContextMem,
+    size_t& memSize)
+{
+    if (pContextMem == nullptr || memSize < sizeof(TessellationCtx))
+    {
+        memSize = sizeof(TessellationCtx);
+        return NULL;
+    }
+
+    SWR_ASSERT(((uintptr_t)pContextMem & 63) == 0);
+
+    TessellationCtx* pCtx = (TessellationCtx*)pContextMem;
+    pCtx->domain = tsDomain;
+    pCtx->partitioning = tsPartitioning;
+    pCtx->outputTopology = tsOutputTopology;
+    pCtx->numDomainPoints = 0;
+    pCtx->numPrimitives = 0;
+
+    return pCtx;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// @brief Context memory is owned by the caller, nothing to release.
+void SWR_API TSDestroyCtx(HANDLE tsCtx)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// @brief Tessellate a single patch.  Output arrays are owned by the
+///        context and remain valid until the next call.
+void SWR_API TSTessellate(
+    HANDLE tsCtx,
+    const SWR_TESSELLATION_FACTORS& tsTessFactors,
+    SWR_TS_TESSELLATED_DATA& tsTessellatedData)
+{
+    TessellationCtx& ctx = *(TessellationCtx*)tsCtx;
+
+    ctx.numDomainPoints = 0;
+    ctx.numPrimitives = 0;
+
+    switch (ctx.domain)
+    {
+    case SWR_TS_TRI:     TessellateTri(ctx, tsTessFactors); break;
+    case SWR_TS_QUAD:    TessellateQuad(ctx, tsTessFactors); break;
+    case SWR_TS_ISOLINE: TessellateIsoline(ctx, tsTessFactors); break;
+    default: SWR_INVALID("Invalid tessellation domain: %d", ctx.domain);
+    }
+
+    if (ctx.outputTopology == SWR_TS_OUTPUT_POINT && ctx.numPrimitives)
+    {
+        ctx.numPrimitives = ctx.numDomainPoints;
+        for (uint32_t i = 0; i < ctx.numDomainPoints; ++i)
+        {
+            ctx.indices[0][i] = ctx.indices[1][i] = ctx.indices[2][i] = i;
+        }
+    }
+
+    // Zero the tail so SIMD loads of partial vectors read valid indices
+    for (uint32_t i = ctx.numPrimitives; i < AlignUp(ctx.numPrimitives, TS_PADDING); ++i)
+    {
+        ctx.indices[0][i] = ctx.indices[1][i] = ctx.indices[2][i] = 0;
+    }
+    for (uint32_t i = ctx.numDomainPoints; i < AlignUp(ctx.numDomainPoints, TS_PADDING); ++i)
+    {
+        ctx.domainPointsU[i] = ctx.domainPointsV[i] = 0.0f;
+    }
+
+    tsTessellatedData.NumPrimitives = ctx.numPrimitives;
+    tsTessellatedData.NumDomainPoints = ctx.numDomainPoints;
+    tsTessellatedData.ppIndices[0] = ctx.indices[0];
+    tsTessellatedData.ppIndices[1] = ctx.indices[1];
+    tsTessellatedData.ppIndices[2] = ctx.indices[2];
+    tsTessellatedData.pDomainPointsU = ctx.domainPointsU;
+    tsTessellatedData.pDomainPointsV = ctx.domainPointsV;
+}
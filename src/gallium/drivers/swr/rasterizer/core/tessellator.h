@@ -55,34 +55,3 @@ void SWR_API TSTessellate(
     HANDLE tsCtx,                                   ///< [IN] Tessellation Context
     const SWR_TESSELLATION_FACTORS& tsTessFactors,  ///< [IN] Tessellation Factors
     SWR_TS_TESSELLATED_DATA& tsTessellatedData);    ///< [OUT] Tessellated Data
-
-
-
-/// @TODO - Implement OSS tessellator
-
-INLINE HANDLE SWR_API TSInitCtx(
-    SWR_TS_DOMAIN tsDomain,
-    SWR_TS_PARTITIONING tsPartitioning,
-    SWR_TS_OUTPUT_TOPOLOGY tsOutputTopology,
-    void* pContextMem,
-    size_t& memSize)
-{
-    SWR_NOT_IMPL;
-    return NULL;
-}
-
-
-INLINE void SWR_API TSDestroyCtx(HANDLE tsCtx)
-{
-    SWR_NOT_IMPL;
-}
-
-
-INLINE void SWR_API TSTessellate(
-    HANDLE tsCtx,
-    const SWR_TESSELLATION_FACTORS& tsTessFactors,
-    SWR_TS_TESSELLATED_DATA& tsTessellatedData)
-{
-    SWR_NOT_IMPL;
-}
-
@@ -379,11 +379,14 @@ INLINE void ExecuteCallbacks(SWR_CONTEXT* pContext, uint32_t workerId, DRAW_CONT
 // inlined-only version
 INLINE int32_t CompleteDrawContextInl(SWR_CONTEXT* pContext, uint32_t workerId, DRAW_CONTEXT* pDC)
 {
+    // Publish this thread's ArchRast counts before the draw can retire, so
+    // the retire callback (and the SwrSync the driver queries wait on)
+    // sees them.
+    AR_FLUSH(pDC->drawId);
+
     int32_t result = static_cast<int32_t>(InterlockedDecrement(&pDC->threadsDone));
     SWR_ASSERT(result >= 0);
 
-    AR_FLUSH(pDC->drawId);
-
     if (result == 0)
     {
         ExecuteCallbacks(pContext, workerId, pDC);
@@ -444,7 +447,8 @@ INLINE bool FindFirstIncompleteDraw(SWR_CONTEXT* pContext, uint32_t workerId, ui
 }
 
 //////////////////////////////////////////////////////////////////////////
-/// @brief If there is any BE work then go work on it.
+/// @brief One pass over the pending draws, working on any available macrotiles
+///        that pass the NUMA filter.
 /// @param pContext - pointer to SWR context.
 /// @param workerId - The unique worker ID that is assigned to this thread.
 /// @param curDrawBE - This tracks the draw contexts that this thread has processed. Each worker thread
@@ -457,14 +461,18 @@ INLINE bool FindFirstIncompleteDraw(SWR_CONTEXT* pContext, uint32_t workerId, ui
 ///                      still have work pending in a previous draw. Additionally, the lockedTiles is
 ///                      hueristic that can steer a worker back to the same macrotile that it had been
 ///                      working on in a previous draw.
+/// @param numaNode - Only macrotiles owned by this NUMA node are considered.
+/// @param numaMask - Mask used to map macrotiles to NUMA nodes, 0 to consider all macrotiles.
+/// @param bFoundWork - Set to true if any macrotile was worked on.
 /// @returns        true if worker thread should shutdown
-bool WorkOnFifoBE(
+static bool WorkOnFifoBEPass(
     SWR_CONTEXT *pContext,
     uint32_t workerId,
     uint32_t &curDrawBE,
     TileSet& lockedTiles,
     uint32_t numaNode,
-    uint32_t numaMask)
+    uint32_t numaMask,
+    bool &bFoundWork)
 {
     bool bShutdown = false;
 
@@ -505,9 +513,16 @@ bool WorkOnFifoBE(
 
         // Grab the list of all dirty macrotiles. A tile is dirty if it has work queued to it.
         auto &macroTiles = pDC->pTileMgr->getDirtyTiles();
+        uint32_t numTiles = (uint32_t)macroTiles.size();
 
-        for (auto tile : macroTiles)
+        // Each worker starts its walk at a different macrotile. This spreads the workers
+        // over the render target instead of having them all contend for the first tiles,
+        // and tends to hand a worker the same macrotiles from draw to draw.
+        uint32_t firstTile = numTiles ? workerId % numTiles : 0;
+
+        for (uint32_t t = 0; t < numTiles; ++t)
         {
+            auto tile = macroTiles[(firstTile + t) % numTiles];
             uint32_t tileID = tile->mId;
 
             // Only work on tiles for this numa node
@@ -534,6 +549,7 @@ bool WorkOnFifoBE(
                 BE_WORK *pWork;
 
                 AR_BEGIN(WorkerFoundWork, pDC->drawId);
+                bFoundWork = true;
 
                 uint32_t numWorkItems = tile->getNumQueued();
                 SWR_ASSERT(numWorkItems);
@@ -590,6 +606,33 @@ bool WorkOnFifoBE(
     return bShutdown;
 }
 
+//////////////////////////////////////////////////////////////////////////
+/// @brief If there is any BE work then go work on it. Macrotiles owned by
+///        this worker's NUMA node are preferred; once those are drained the
+///        worker steals macrotiles from the other nodes rather than idling.
+///        See WorkOnFifoBEPass for parameters.
+/// @returns        true if worker thread should shutdown
+bool WorkOnFifoBE(
+    SWR_CONTEXT *pContext,
+    uint32_t workerId,
+    uint32_t &curDrawBE,
+    TileSet& lockedTiles,
+    uint32_t numaNode,
+    uint32_t numaMask)
+{
+    bool bFoundWork = false;
+    bool bShutdown = WorkOnFifoBEPass(pContext, workerId, curDrawBE, lockedTiles, numaNode, numaMask, bFoundWork);
+
+    // Small render targets may only have macrotiles on a few nodes. The NUMA filter
+    // is applied uniformly within a pass, so draw ordering is still maintained.
+    if (!bShutdown && !bFoundWork && numaMask)
+    {
+        bShutdown = WorkOnFifoBEPass(pContext, workerId, curDrawBE, lockedTiles, 0, 0, bFoundWork);
+    }
+
+    return bShutdown;
+}
+
 //////////////////////////////////////////////////////////////////////////
 /// @brief Called when FE work is complete for this DC.
 INLINE void CompleteDrawFE(SWR_CONTEXT* pContext, uint32_t workerId, DRAW_CONTEXT* pDC)
@@ -681,10 +724,12 @@ void WorkOnFifoFE(SWR_CONTEXT *pContext, uint32_t workerId, uint32_t &curDrawFE)
 /// @param curDrawBE - This tracks the draw contexts that this thread has processed. Each worker thread
 ///                    has its own curDrawBE counter and this ensures that each worker processes all the
 ///                    draws in order.
+/// @param numaNode - NUMA node of this worker; thread groups owned by this node are preferred.
 void WorkOnCompute(
     SWR_CONTEXT *pContext,
     uint32_t workerId,
-    uint32_t& curDrawBE)
+    uint32_t& curDrawBE,
+    uint32_t numaNode)
 {
     uint32_t drawEnqueued = 0;
     if (FindFirstIncompleteDraw(pContext, workerId, curDrawBE, drawEnqueued) == false)
@@ -714,7 +759,7 @@ void WorkOnCompute(
             void* pSpillFillBuffer = nullptr;
             void* pScratchSpace = nullptr;
             uint32_t threadGroupId = 0;
-            while (queue.getWork(threadGroupId))
+            while (queue.getWork(threadGroupId, numaNode))
             {
                 queue.dispatch(pDC, workerId, threadGroupId, pSpillFillBuffer, pScratchSpace);
                 queue.finishedWork();
@@ -821,7 +866,7 @@ DWORD workerThreadMain(LPVOID pData)
             bShutdown |= WorkOnFifoBE(pContext, workerId, curDrawBE, lockedTiles, numaNode, numaMask);
             AR_END(WorkerWorkOnFifoBE, 0);
 
-            WorkOnCompute(pContext, workerId, curDrawBE);
+            WorkOnCompute(pContext, workerId, curDrawBE, numaNode);
         }
 
         if (IsFEThread)
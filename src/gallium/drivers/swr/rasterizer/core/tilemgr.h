@@ -163,7 +163,10 @@ public:
 
     //////////////////////////////////////////////////////////////////////////
     /// @brief Setup the producer consumer counts.
-    void initialize(uint32_t totalTasks, void* pTaskData, PFN_DISPATCH pfnDispatch)
+    /// @param numaMask - Thread pool NUMA mask. Thread groups are split into
+    ///                   one contiguous range per NUMA node so workers mostly
+    ///                   touch groups next to the ones their node already ran.
+    void initialize(uint32_t totalTasks, void* pTaskData, PFN_DISPATCH pfnDispatch, uint32_t numaMask = 0)
     {
         // The available and outstanding counts start with total tasks.
         // At the start there are N tasks available and outstanding.
@@ -174,6 +177,13 @@ public:
         mTasksAvailable = totalTasks;
         mTasksOutstanding = totalTasks;
 
+        mNumNodes = std::min(numaMask + 1, (uint32_t)MAX_NODES);
+        for (uint32_t n = 0; n < mNumNodes; ++n)
+        {
+            mNodes[n].next = (long)(((uint64_t)totalTasks * n) / mNumNodes);
+            mNodes[n].end = (long)(((uint64_t)totalTasks * (n + 1)) / mNumNodes);
+        }
+
         mpTaskData = pTaskData;
         mPfnDispatch = pfnDispatch;
     }
@@ -186,17 +196,26 @@ public:
     }
 
     //////////////////////////////////////////////////////////////////////////
-    /// @brief Atomically decrement the work available count. If the result
-    //         is greater than 0 then we can on the associated thread group.
-    //         Otherwise, there is no more work to do.
-    bool getWork(uint32_t& groupId)
+    /// @brief Grab the next thread group. Workers drain the range owned by
+    ///        their own NUMA node first and then steal from the other nodes.
+    ///        Returns false once there is no more work to do.
+    bool getWork(uint32_t& groupId, uint32_t numaNode = 0)
     {
-        long result = InterlockedDecrement(&mTasksAvailable);
-
-        if (result >= 0)
+        for (uint32_t i = 0; i < mNumNodes; ++i)
         {
-            groupId = result;
-            return true;
+            NodeRange& node = mNodes[(numaNode + i) % mNumNodes];
+            if (node.next >= node.end)
+            {
+                continue;
+            }
+
+            long result = InterlockedIncrement(&node.next) - 1;
+            if (result < node.end)
+            {
+                InterlockedDecrement(&mTasksAvailable);
+                groupId = result;
+                return true;
+            }
         }
 
         return false;
@@ -242,6 +261,17 @@ public:
 
     OSALIGNLINE(volatile long) mTasksAvailable{ 0 };
     OSALIGNLINE(volatile long) mTasksOutstanding{ 0 };
+
+    static const uint32_t MAX_NODES = 8;
+
+    struct NodeRange
+    {
+        OSALIGNLINE(volatile long) next;    // Next thread group to hand out on this node
+        long end;                           // One past the last thread group owned by this node
+    };
+
+    NodeRange mNodes[MAX_NODES];
+    uint32_t mNumNodes{ 1 };
 };
 
 
@@ -319,6 +319,8 @@ swr_blit(struct pipe_context *pipe, const struct pipe_blit_info *blit_info)
    util_blitter_save_vertex_elements(ctx->blitter, (void *)ctx->velems);
    util_blitter_save_vertex_shader(ctx->blitter, (void *)ctx->vs);
    util_blitter_save_geometry_shader(ctx->blitter, (void*)ctx->gs);
+   util_blitter_save_tessctrl_shader(ctx->blitter, (void*)ctx->tcs);
+   util_blitter_save_tesseval_shader(ctx->blitter, (void*)ctx->tes);
    util_blitter_save_so_targets(
       ctx->blitter,
       ctx->num_so_targets,
@@ -378,6 +380,10 @@ swr_destroy(struct pipe_context *pipe)
       pipe_sampler_view_reference(&ctx->sampler_views[PIPE_SHADER_VERTEX][i], NULL);
    }
 
+   for (unsigned i = 0; i < ARRAY_SIZE(ctx->ssbos[0]); i++) {
+      pipe_resource_reference(&ctx->ssbos[PIPE_SHADER_COMPUTE][i].buffer, NULL);
+   }
+
    if (ctx->pipe.stream_uploader)
       u_upload_destroy(ctx->pipe.stream_uploader);
 
@@ -473,6 +479,11 @@ swr_create_context(struct pipe_screen *p_screen, void *priv, unsigned flags)
    ctx->blendJIT =
       new std::unordered_map<BLEND_COMPILE_STATE, PFN_BLEND_JIT_FUNC>;
 
+   for (unsigned i = 0; i < ARRAY_SIZE(ctx->default_outer_level); i++)
+      ctx->default_outer_level[i] = 1.0f;
+   for (unsigned i = 0; i < ARRAY_SIZE(ctx->default_inner_level); i++)
+      ctx->default_inner_level[i] = 1.0f;
+
    SWR_CREATECONTEXT_INFO createInfo;
    memset(&createInfo, 0, sizeof(createInfo));
    createInfo.privateStateSize = sizeof(swr_draw_context);
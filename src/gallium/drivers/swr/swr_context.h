@@ -52,6 +52,11 @@
 #define SWR_NEW_CLIP (1 << 16)
 #define SWR_NEW_SO (1 << 17)
 #define SWR_LARGE_CLIENT_DRAW (1<<18) // Indicates client draw will block
+#define SWR_NEW_TCS (1 << 19)
+#define SWR_NEW_TES (1 << 20)
+#define SWR_NEW_TCSCONSTANTS (1 << 21)
+#define SWR_NEW_TESCONSTANTS (1 << 22)
+#define SWR_NEW_TS (1 << 23)
 
 namespace std
 {
@@ -89,6 +94,12 @@ struct swr_draw_context {
    uint32_t num_constantsFS[PIPE_MAX_CONSTANT_BUFFERS];
    const float *constantGS[PIPE_MAX_CONSTANT_BUFFERS];
    uint32_t num_constantsGS[PIPE_MAX_CONSTANT_BUFFERS];
+   const float *constantTCS[PIPE_MAX_CONSTANT_BUFFERS];
+   uint32_t num_constantsTCS[PIPE_MAX_CONSTANT_BUFFERS];
+   const float *constantTES[PIPE_MAX_CONSTANT_BUFFERS];
+   uint32_t num_constantsTES[PIPE_MAX_CONSTANT_BUFFERS];
+   const float *constantCS[PIPE_MAX_CONSTANT_BUFFERS];
+   uint32_t num_constantsCS[PIPE_MAX_CONSTANT_BUFFERS];
 
    swr_jit_texture texturesVS[PIPE_MAX_SHADER_SAMPLER_VIEWS];
    swr_jit_sampler samplersVS[PIPE_MAX_SAMPLERS];
@@ -96,11 +107,27 @@ struct swr_draw_context {
    swr_jit_sampler samplersFS[PIPE_MAX_SAMPLERS];
    swr_jit_texture texturesGS[PIPE_MAX_SHADER_SAMPLER_VIEWS];
    swr_jit_sampler samplersGS[PIPE_MAX_SAMPLERS];
+   swr_jit_texture texturesTCS[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+   swr_jit_sampler samplersTCS[PIPE_MAX_SAMPLERS];
+   swr_jit_texture texturesTES[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+   swr_jit_sampler samplersTES[PIPE_MAX_SAMPLERS];
+   swr_jit_texture texturesCS[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+   swr_jit_sampler samplersCS[PIPE_MAX_SAMPLERS];
+
+   /* compute shader storage buffers */
+   uint8_t *ssboCS[PIPE_MAX_SHADER_BUFFERS];
+   uint32_t num_ssboCS[PIPE_MAX_SHADER_BUFFERS];
 
    float userClipPlanes[PIPE_MAX_CLIP_PLANES][4];
 
    uint32_t polyStipple[32];
 
+   /* tessellation levels used when no control shader is bound */
+   float tessLevelOuter[4];
+   float tessLevelInner[2];
+   uint32_t patchVertices;
+   uint32_t numPatchAttribs;
+
    SWR_SURFACE_STATE renderTargets[SWR_NUM_ATTACHMENTS];
    struct swr_query_result *pStats; // @llvm_struct
    SWR_INTERFACE *pAPI; // @llvm_struct - Needed for the swr_memory callbacks
@@ -122,6 +149,9 @@ struct swr_context {
    struct swr_vertex_shader *vs;
    struct swr_fragment_shader *fs;
    struct swr_geometry_shader *gs;
+   struct swr_tess_control_shader *tcs;
+   struct swr_tess_evaluation_shader *tes;
+   struct swr_compute_shader *cs;
    struct swr_vertex_element_state *velems;
 
    /** Other rendering state */
@@ -136,6 +166,8 @@ struct swr_context {
    SWR_RECT swr_scissor;
    struct pipe_sampler_view *
       sampler_views[PIPE_SHADER_TYPES][PIPE_MAX_SHADER_SAMPLER_VIEWS];
+   struct pipe_shader_buffer
+      ssbos[PIPE_SHADER_TYPES][PIPE_MAX_SHADER_BUFFERS];
 
    struct pipe_viewport_state viewport;
    struct pipe_vertex_buffer vertex_buffer[PIPE_MAX_ATTRIBS];
@@ -154,6 +186,10 @@ struct swr_context {
 
    unsigned sample_mask;
 
+   /* tessellation */
+   float default_outer_level[4];
+   float default_inner_level[2];
+
    // streamout
    pipe_stream_output_target *so_targets[MAX_SO_STREAMS];
    uint32_t num_so_targets;
@@ -29,6 +29,7 @@
 #include "jit_api.h"
 
 #include "util/u_draw.h"
+#include "util/u_inlines.h"
 #include "util/u_prim.h"
 
 /*
@@ -139,12 +140,16 @@ swr_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
    // between all the shader stages, so it has to be large enough to
    // incorporate all interfaces between stages
 
-   // max of gs and vs num_outputs
+   // max of gs, tes and vs num_outputs
    feState.vsVertexSize = ctx->vs->info.base.num_outputs;
    if (ctx->gs &&
        ctx->gs->info.base.num_outputs > feState.vsVertexSize) {
       feState.vsVertexSize = ctx->gs->info.base.num_outputs;
    }
+   if (ctx->tes &&
+       ctx->tes->info.base.num_outputs > feState.vsVertexSize) {
+      feState.vsVertexSize = ctx->tes->info.base.num_outputs;
+   }
 
    if (ctx->vs->info.base.num_outputs) {
       // gs does not adjust for position in SGV slot at input from vs
@@ -175,7 +180,15 @@ swr_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
    enum pipe_prim_type topology;
    if (ctx->gs)
       topology = (pipe_prim_type)ctx->gs->info.base.properties[TGSI_PROPERTY_GS_OUTPUT_PRIM];
-   else
+   else if (ctx->tes) {
+      struct tgsi_shader_info *tes_info = &ctx->tes->info.base;
+      if (tes_info->properties[TGSI_PROPERTY_TES_POINT_MODE])
+         topology = PIPE_PRIM_POINTS;
+      else if (tes_info->properties[TGSI_PROPERTY_TES_PRIM_MODE] == PIPE_PRIM_LINES)
+         topology = PIPE_PRIM_LINES;
+      else
+         topology = PIPE_PRIM_TRIANGLES;
+   } else
       topology = info->mode;
 
    switch (topology) {
@@ -207,7 +220,8 @@ swr_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
 
    if (info->index_size)
       ctx->api.pfnSwrDrawIndexedInstanced(ctx->swrContext,
-                                          swr_convert_prim_topology(info->mode),
+                                          swr_convert_prim_topology(info->mode,
+                                                                    info->vertices_per_patch),
                                           info->count,
                                           info->instance_count,
                                           info->start,
@@ -215,7 +229,8 @@ swr_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
                                           info->start_instance);
    else
       ctx->api.pfnSwrDrawInstanced(ctx->swrContext,
-                                   swr_convert_prim_topology(info->mode),
+                                   swr_convert_prim_topology(info->mode,
+                                                             info->vertices_per_patch),
                                    info->count,
                                    info->instance_count,
                                    info->start,
@@ -343,9 +358,48 @@ swr_store_dirty_resource(struct pipe_context *pipe,
    }
 }
 
+/*
+ * Dispatch a compute grid.  Work groups are spread over the SWR worker
+ * threads; each worker runs the invocations of a group SIMD width at a time.
+ */
+static void
+swr_launch_grid(struct pipe_context *pipe, const struct pipe_grid_info *info)
+{
+   struct swr_context *ctx = swr_context(pipe);
+   uint32_t grid[3] = {info->grid[0], info->grid[1], info->grid[2]};
+
+   if (!ctx->cs)
+      return;
+
+   if (info->indirect) {
+      pipe_buffer_read(pipe, info->indirect, info->indirect_offset,
+                       sizeof(grid), grid);
+   }
+
+   if (!grid[0] || !grid[1] || !grid[2])
+      return;
+
+   swr_update_compute_state(ctx, info);
+
+   swr_update_draw_context(ctx);
+
+   ctx->api.pfnSwrDispatch(ctx->swrContext, grid[0], grid[1], grid[2]);
+}
+
+static void
+swr_memory_barrier(struct pipe_context *pipe, unsigned flags)
+{
+   struct swr_context *ctx = swr_context(pipe);
+
+   /* compute results must land before anything else reads them */
+   ctx->api.pfnSwrWaitForIdle(ctx->swrContext);
+}
+
 void
 swr_draw_init(struct pipe_context *pipe)
 {
    pipe->draw_vbo = swr_draw_vbo;
+   pipe->launch_grid = swr_launch_grid;
+   pipe->memory_barrier = swr_memory_barrier;
    pipe->flush = swr_flush;
 }
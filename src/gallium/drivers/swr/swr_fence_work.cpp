@@ -105,6 +105,24 @@ swr_delete_gs_cb(struct swr_fence_work *work)
    delete work->free.swr_gs;
 }
 
+static void
+swr_delete_tcs_cb(struct swr_fence_work *work)
+{
+   delete work->free.swr_tcs;
+}
+
+static void
+swr_delete_tes_cb(struct swr_fence_work *work)
+{
+   delete work->free.swr_tes;
+}
+
+static void
+swr_delete_cs_cb(struct swr_fence_work *work)
+{
+   delete work->free.swr_cs;
+}
+
 bool
 swr_fence_work_free(struct pipe_fence_handle *fence, void *data,
                     bool aligned_free)
@@ -167,3 +185,48 @@ swr_fence_work_delete_gs(struct pipe_fence_handle *fence,
 
    return true;
 }
+
+bool
+swr_fence_work_delete_tcs(struct pipe_fence_handle *fence,
+                          struct swr_tess_control_shader *swr_tcs)
+{
+   struct swr_fence_work *work = CALLOC_STRUCT(swr_fence_work);
+   if (!work)
+      return false;
+   work->callback = swr_delete_tcs_cb;
+   work->free.swr_tcs = swr_tcs;
+
+   swr_add_fence_work(fence, work);
+
+   return true;
+}
+
+bool
+swr_fence_work_delete_tes(struct pipe_fence_handle *fence,
+                          struct swr_tess_evaluation_shader *swr_tes)
+{
+   struct swr_fence_work *work = CALLOC_STRUCT(swr_fence_work);
+   if (!work)
+      return false;
+   work->callback = swr_delete_tes_cb;
+   work->free.swr_tes = swr_tes;
+
+   swr_add_fence_work(fence, work);
+
+   return true;
+}
+
+bool
+swr_fence_work_delete_cs(struct pipe_fence_handle *fence,
+                         struct swr_compute_shader *swr_cs)
+{
+   struct swr_fence_work *work = CALLOC_STRUCT(swr_fence_work);
+   if (!work)
+      return false;
+   work->callback = swr_delete_cs_cb;
+   work->free.swr_cs = swr_cs;
+
+   swr_add_fence_work(fence, work);
+
+   return true;
+}
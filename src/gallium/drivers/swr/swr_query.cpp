@@ -42,7 +42,8 @@ swr_create_query(struct pipe_context *pipe, unsigned type, unsigned index)
 {
    struct swr_query *pq;
 
-   assert(type < PIPE_QUERY_TYPES);
+   assert(type < PIPE_QUERY_TYPES ||
+          (type >= SWR_QUERY_AR_CULLED_PRIMS && type <= SWR_QUERY_AR_BE_TIME));
    assert(index < MAX_SO_STREAMS);
 
    pq = (struct swr_query *) AlignedMalloc(sizeof(struct swr_query), 64);
@@ -72,6 +73,50 @@ swr_destroy_query(struct pipe_context *pipe, struct pipe_query *q)
 }
 
 
+/*
+ * SwrSync callback, snapshots the ArchRast counters once all previously
+ * queued work has retired.
+ */
+static void
+swr_ar_snapshot_cb(uint64_t userData, uint64_t userData2, uint64_t userData3)
+{
+   struct swr_context *ctx = (struct swr_context *)userData;
+   struct swr_ar_snapshot *snap = (struct swr_ar_snapshot *)userData2;
+
+   ctx->api.pfnSwrGetArchRastCounters(ctx->swrContext, &snap->counters);
+   snap->tsc = __rdtsc();
+   snap->nano = os_time_get_nano();
+}
+
+static void
+swr_ar_snapshot_submit(struct swr_context *ctx,
+                       struct swr_query *pq,
+                       struct swr_ar_snapshot *snap)
+{
+   ctx->api.pfnSwrSync(ctx->swrContext, swr_ar_snapshot_cb,
+                       (uint64_t)ctx, (uint64_t)snap, 0);
+
+   /* Fence follows the snapshot so waiting on it covers the callback */
+   if (!pq->fence) {
+      struct swr_screen *screen = swr_screen(ctx->pipe.screen);
+      swr_fence_reference(ctx->pipe.screen, &pq->fence, screen->flush_fence);
+   }
+   swr_fence_submit(ctx, pq->fence);
+}
+
+/* Converts summed worker rdtsc cycles to microseconds, using the query
+ * interval itself to calibrate the tsc rate. */
+static uint64_t
+swr_ar_cycles_to_usecs(const struct swr_query_result *r, uint64_t cycles)
+{
+   uint64_t tsc = r->ar_end.tsc - r->ar_start.tsc;
+   uint64_t nano = r->ar_end.nano - r->ar_start.nano;
+
+   if (!tsc)
+      return 0;
+   return (uint64_t)((double)cycles * nano / tsc / 1000.0);
+}
+
 static boolean
 swr_get_query_result(struct pipe_context *pipe,
                      struct pipe_query *q,
@@ -150,6 +195,25 @@ swr_get_query_result(struct pipe_context *pipe,
       result->b = num_primitives_written > primitives_storage_needed;
    }
       break;
+   /* ArchRast counters */
+   case SWR_QUERY_AR_CULLED_PRIMS:
+      result->u64 = pq->result.ar_end.counters.CulledPrimitives -
+         pq->result.ar_start.counters.CulledPrimitives;
+      break;
+   case SWR_QUERY_AR_EARLY_Z_REJECTS:
+      result->u64 = pq->result.ar_end.counters.EarlyZFailCount -
+         pq->result.ar_start.counters.EarlyZFailCount;
+      break;
+   case SWR_QUERY_AR_FE_TIME:
+      result->u64 = swr_ar_cycles_to_usecs(&pq->result,
+         pq->result.ar_end.counters.FrontendCycles -
+         pq->result.ar_start.counters.FrontendCycles);
+      break;
+   case SWR_QUERY_AR_BE_TIME:
+      result->u64 = swr_ar_cycles_to_usecs(&pq->result,
+         pq->result.ar_end.counters.BackendCycles -
+         pq->result.ar_start.counters.BackendCycles);
+      break;
    default:
       assert(0 && "Unsupported query");
       break;
@@ -174,6 +238,12 @@ swr_begin_query(struct pipe_context *pipe, struct pipe_query *q)
    case PIPE_QUERY_TIME_ELAPSED:
       pq->result.timestamp_start = swr_get_timestamp(pipe->screen);
       break;
+   case SWR_QUERY_AR_CULLED_PRIMS:
+   case SWR_QUERY_AR_EARLY_Z_REJECTS:
+   case SWR_QUERY_AR_FE_TIME:
+   case SWR_QUERY_AR_BE_TIME:
+      swr_ar_snapshot_submit(ctx, pq, &pq->result.ar_start);
+      break;
    default:
       /* Core counters required.  Update draw context with location to
        * store results. */
@@ -206,6 +276,12 @@ swr_end_query(struct pipe_context *pipe, struct pipe_query *q)
    case PIPE_QUERY_TIME_ELAPSED:
       pq->result.timestamp_end = swr_get_timestamp(pipe->screen);
       break;
+   case SWR_QUERY_AR_CULLED_PRIMS:
+   case SWR_QUERY_AR_EARLY_Z_REJECTS:
+   case SWR_QUERY_AR_FE_TIME:
+   case SWR_QUERY_AR_BE_TIME:
+      swr_ar_snapshot_submit(ctx, pq, &pq->result.ar_end);
+      break;
    default:
       /* Stats are updated asynchronously, a fence is used to signal
        * completion. */
@@ -251,6 +327,39 @@ swr_check_render_cond(struct pipe_context *pipe)
 }
 
 
+int
+swr_get_driver_query_info(struct pipe_screen *screen,
+                          unsigned index,
+                          struct pipe_driver_query_info *info)
+{
+   static const struct pipe_driver_query_info list[] = {
+      {"swr-culled-prims", SWR_QUERY_AR_CULLED_PRIMS, {0},
+       PIPE_DRIVER_QUERY_TYPE_UINT64},
+      {"swr-early-z-rejects", SWR_QUERY_AR_EARLY_Z_REJECTS, {0},
+       PIPE_DRIVER_QUERY_TYPE_UINT64},
+      {"swr-fe-time", SWR_QUERY_AR_FE_TIME, {0},
+       PIPE_DRIVER_QUERY_TYPE_MICROSECONDS},
+      {"swr-be-time", SWR_QUERY_AR_BE_TIME, {0},
+       PIPE_DRIVER_QUERY_TYPE_MICROSECONDS},
+   };
+   SWR_INTERFACE api;
+
+   /* Counters only exist when the core was built with ArchRast */
+   swr_screen(screen)->pfnSwrGetInterface(api);
+   if (!api.pfnSwrGetArchRastCounters(NULL, NULL))
+      return 0;
+
+   if (!info)
+      return ARRAY_SIZE(list);
+
+   if (index >= ARRAY_SIZE(list))
+      return 0;
+
+   *info = list[index];
+   return 1;
+}
+
+
 static void
 swr_set_active_query_state(struct pipe_context *pipe, boolean enable)
 {
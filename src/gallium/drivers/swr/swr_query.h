@@ -27,11 +27,28 @@
 
 #include <limits.h>
 
+/* Driver specific queries backed by ArchRast counters */
+enum swr_query_type {
+   SWR_QUERY_AR_CULLED_PRIMS = PIPE_QUERY_DRIVER_SPECIFIC,
+   SWR_QUERY_AR_EARLY_Z_REJECTS,
+   SWR_QUERY_AR_FE_TIME,
+   SWR_QUERY_AR_BE_TIME,
+};
+
+/* Counters snapshot, taken in-order with rendering via SwrSync */
+struct swr_ar_snapshot {
+   SWR_ARCHRAST_COUNTERS counters;
+   uint64_t tsc;
+   uint64_t nano;
+};
+
 struct swr_query_result {
    SWR_STATS core;
    SWR_STATS_FE coreFE;
    uint64_t timestamp_start;
    uint64_t timestamp_end;
+   struct swr_ar_snapshot ar_start;
+   struct swr_ar_snapshot ar_end;
 };
 
 OSALIGNLINE(struct) swr_query {
@@ -44,5 +61,9 @@ OSALIGNLINE(struct) swr_query {
 
 extern void swr_query_init(struct pipe_context *pipe);
 
+extern int swr_get_driver_query_info(struct pipe_screen *screen,
+                                     unsigned index,
+                                     struct pipe_driver_query_info *info);
+
 extern boolean swr_check_render_cond(struct pipe_context *pipe);
 #endif
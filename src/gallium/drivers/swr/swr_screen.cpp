@@ -26,6 +26,7 @@
 #include "swr_screen.h"
 #include "swr_resource.h"
 #include "swr_fence.h"
+#include "swr_query.h"
 #include "gen_knobs.h"
 
 #include "pipe/p_screen.h"
@@ -177,6 +178,8 @@ swr_get_param(struct pipe_screen *screen, enum pipe_cap param)
       return 1024;
    case PIPE_CAP_MAX_VERTEX_STREAMS:
       return 1;
+   case PIPE_CAP_MAX_SHADER_PATCH_VARYINGS:
+      return 30;
    case PIPE_CAP_MAX_VERTEX_ATTRIB_STRIDE:
       return 2048;
    case PIPE_CAP_MAX_TEXTURE_ARRAY_LAYERS:
@@ -269,6 +272,13 @@ swr_get_param(struct pipe_screen *screen, enum pipe_cap param)
    case PIPE_CAP_VERTEX_ELEMENT_SRC_OFFSET_4BYTE_ALIGNED_ONLY:
       return 1;
 
+   /* Compute states work, but without shader images the GL state tracker
+    * can't expose ARB_compute_shader with them.  Don't claim support until
+    * it can.
+    */
+   case PIPE_CAP_COMPUTE:
+      return 0;
+
       /* unsupported features */
    case PIPE_CAP_ANISOTROPIC_FILTER:
    case PIPE_CAP_TEXTURE_BORDER_COLOR_QUIRK:
@@ -277,7 +287,6 @@ swr_get_param(struct pipe_screen *screen, enum pipe_cap param)
    case PIPE_CAP_TEXTURE_BARRIER:
    case PIPE_CAP_FRAGMENT_COLOR_CLAMPED:
    case PIPE_CAP_VERTEX_COLOR_CLAMPED:
-   case PIPE_CAP_COMPUTE:
    case PIPE_CAP_TGSI_VS_LAYER_VIEWPORT:
    case PIPE_CAP_TGSI_CAN_COMPACT_CONSTANTS:
    case PIPE_CAP_TGSI_TEXCOORD:
@@ -293,7 +302,6 @@ swr_get_param(struct pipe_screen *screen, enum pipe_cap param)
    case PIPE_CAP_VERTEXID_NOBASE:
    case PIPE_CAP_RESOURCE_FROM_USER_MEMORY:
    case PIPE_CAP_DEVICE_RESET_STATUS_QUERY:
-   case PIPE_CAP_MAX_SHADER_PATCH_VARYINGS:
    case PIPE_CAP_TGSI_TXQS:
    case PIPE_CAP_FORCE_PERSAMPLE_INTERP:
    case PIPE_CAP_SHAREABLE_SHADERS:
@@ -377,10 +385,76 @@ swr_get_shader_param(struct pipe_screen *screen,
 {
    if (shader == PIPE_SHADER_VERTEX ||
        shader == PIPE_SHADER_FRAGMENT ||
-       shader == PIPE_SHADER_GEOMETRY)
+       shader == PIPE_SHADER_GEOMETRY ||
+       shader == PIPE_SHADER_TESS_CTRL ||
+       shader == PIPE_SHADER_TESS_EVAL)
+      return gallivm_get_shader_param(param);
+
+   if (shader == PIPE_SHADER_COMPUTE) {
+      if (param == PIPE_SHADER_CAP_MAX_SHADER_BUFFERS)
+         return PIPE_MAX_SHADER_BUFFERS;
       return gallivm_get_shader_param(param);
+   }
 
-   // Todo: tesselation, compute
+   return 0;
+}
+
+static int
+swr_get_compute_param(struct pipe_screen *screen,
+                      enum pipe_shader_ir ir_type,
+                      enum pipe_compute_cap param,
+                      void *ret)
+{
+   switch (param) {
+   case PIPE_COMPUTE_CAP_IR_TARGET:
+      return 0;
+   case PIPE_COMPUTE_CAP_MAX_GRID_SIZE:
+      if (ret) {
+         uint64_t *grid_size = (uint64_t *)ret;
+         grid_size[0] = 65535;
+         grid_size[1] = 65535;
+         grid_size[2] = 65535;
+      }
+      return 3 * sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_BLOCK_SIZE:
+      if (ret) {
+         uint64_t *block_size = (uint64_t *)ret;
+         block_size[0] = 1024;
+         block_size[1] = 1024;
+         block_size[2] = 64;
+      }
+      return 3 * sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_THREADS_PER_BLOCK:
+      if (ret) {
+         uint64_t *max_threads_per_block = (uint64_t *)ret;
+         *max_threads_per_block = 1024;
+      }
+      return sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_LOCAL_SIZE:
+      /* shared memory lives in the core's per-worker scratch area */
+      if (ret) {
+         uint64_t *max_local_size = (uint64_t *)ret;
+         *max_local_size = 32768;
+      }
+      return sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_GRID_DIMENSION:
+      if (ret) {
+         uint64_t *grid_dimension = (uint64_t *)ret;
+         *grid_dimension = 3;
+      }
+      return sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_GLOBAL_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_PRIVATE_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_INPUT_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_MEM_ALLOC_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_CLOCK_FREQUENCY:
+   case PIPE_COMPUTE_CAP_MAX_COMPUTE_UNITS:
+   case PIPE_COMPUTE_CAP_IMAGES_SUPPORTED:
+   case PIPE_COMPUTE_CAP_SUBGROUP_SIZE:
+   case PIPE_COMPUTE_CAP_ADDRESS_BITS:
+   case PIPE_COMPUTE_CAP_MAX_VARIABLE_THREADS_PER_BLOCK:
+      break;
+   }
    return 0;
 }
 
@@ -1134,7 +1208,9 @@ swr_create_screen_internal(struct sw_winsys *winsys)
    screen->base.destroy = swr_destroy_screen;
    screen->base.get_param = swr_get_param;
    screen->base.get_shader_param = swr_get_shader_param;
+   screen->base.get_compute_param = swr_get_compute_param;
    screen->base.get_paramf = swr_get_paramf;
+   screen->base.get_driver_query_info = swr_get_driver_query_info;
 
    screen->base.resource_create = swr_resource_create;
    screen->base.resource_destroy = swr_resource_destroy;
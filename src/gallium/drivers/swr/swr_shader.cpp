@@ -37,6 +37,7 @@
 #include "util/u_format.h"
 #include "util/u_prim.h"
 #include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_const.h"
 #include "gallivm/lp_bld_flow.h"
 #include "gallivm/lp_bld_struct.h"
 #include "gallivm/lp_bld_tgsi.h"
@@ -73,6 +74,21 @@ bool operator==(const swr_jit_gs_key &lhs, const swr_jit_gs_key &rhs)
    return !memcmp(&lhs, &rhs, sizeof(lhs));
 }
 
+bool operator==(const swr_jit_tcs_key &lhs, const swr_jit_tcs_key &rhs)
+{
+   return !memcmp(&lhs, &rhs, sizeof(lhs));
+}
+
+bool operator==(const swr_jit_tes_key &lhs, const swr_jit_tes_key &rhs)
+{
+   return !memcmp(&lhs, &rhs, sizeof(lhs));
+}
+
+bool operator==(const swr_jit_cs_key &lhs, const swr_jit_cs_key &rhs)
+{
+   return !memcmp(&lhs, &rhs, sizeof(lhs));
+}
+
 static void
 swr_generate_sampler_key(const struct lp_tgsi_info &info,
                          struct swr_context *ctx,
@@ -148,6 +164,8 @@ swr_generate_fs_key(struct swr_jit_fs_key &key,
    struct tgsi_shader_info *pPrevShader;
    if (ctx->gs)
       pPrevShader = &ctx->gs->info.base;
+   else if (ctx->tes)
+      pPrevShader = &ctx->tes->info.base;
    else
       pPrevShader = &ctx->vs->info.base;
 
@@ -195,7 +213,11 @@ swr_generate_gs_key(struct swr_jit_gs_key &key,
 {
    memset(&key, 0, sizeof(key));
 
-   struct tgsi_shader_info *pPrevShader = &ctx->vs->info.base;
+   struct tgsi_shader_info *pPrevShader;
+   if (ctx->tes)
+      pPrevShader = &ctx->tes->info.base;
+   else
+      pPrevShader = &ctx->vs->info.base;
 
    memcpy(&key.vs_output_semantic_name,
           &pPrevShader->output_semantic_name,
@@ -207,6 +229,74 @@ swr_generate_gs_key(struct swr_jit_gs_key &key,
    swr_generate_sampler_key(swr_gs->info, ctx, PIPE_SHADER_GEOMETRY, key);
 }
 
+void
+swr_generate_tcs_key(struct swr_jit_tcs_key &key,
+                     struct swr_context *ctx,
+                     swr_tess_control_shader *swr_tcs)
+{
+   memset(&key, 0, sizeof(key));
+
+   struct tgsi_shader_info *pPrevShader = &ctx->vs->info.base;
+
+   memcpy(&key.vs_output_semantic_name,
+          &pPrevShader->output_semantic_name,
+          sizeof(key.vs_output_semantic_name));
+   memcpy(&key.vs_output_semantic_idx,
+          &pPrevShader->output_semantic_index,
+          sizeof(key.vs_output_semantic_idx));
+
+   key.tes_prim_mode =
+      ctx->tes->info.base.properties[TGSI_PROPERTY_TES_PRIM_MODE];
+
+   swr_generate_sampler_key(swr_tcs->info, ctx, PIPE_SHADER_TESS_CTRL, key);
+}
+
+void
+swr_generate_tes_key(struct swr_jit_tes_key &key,
+                     struct swr_context *ctx,
+                     swr_tess_evaluation_shader *swr_tes)
+{
+   memset(&key, 0, sizeof(key));
+
+   struct tgsi_shader_info *pPrevShader;
+   if (ctx->tcs) {
+      pPrevShader = &ctx->tcs->info.base;
+      key.tcs_vertices_out =
+         pPrevShader->properties[TGSI_PROPERTY_TCS_VERTICES_OUT];
+   } else {
+      pPrevShader = &ctx->vs->info.base;
+   }
+
+   memcpy(&key.prev_output_semantic_name,
+          &pPrevShader->output_semantic_name,
+          sizeof(key.prev_output_semantic_name));
+   memcpy(&key.prev_output_semantic_idx,
+          &pPrevShader->output_semantic_index,
+          sizeof(key.prev_output_semantic_idx));
+
+   key.clip_plane_mask =
+      swr_tes->info.base.clipdist_writemask ?
+      swr_tes->info.base.clipdist_writemask & ctx->rasterizer->clip_plane_enable :
+      ctx->rasterizer->clip_plane_enable;
+
+   swr_generate_sampler_key(swr_tes->info, ctx, PIPE_SHADER_TESS_EVAL, key);
+}
+
+void
+swr_generate_cs_key(struct swr_jit_cs_key &key,
+                    struct swr_context *ctx,
+                    swr_compute_shader *swr_cs,
+                    const unsigned block[3])
+{
+   memset(&key, 0, sizeof(key));
+
+   key.block[0] = block[0];
+   key.block[1] = block[1];
+   key.block[2] = block[2];
+
+   swr_generate_sampler_key(swr_cs->info, ctx, PIPE_SHADER_COMPUTE, key);
+}
+
 struct BuilderSWR : public Builder {
    BuilderSWR(JitManager *pJitMgr, const char *pName)
       : Builder(pJitMgr)
@@ -222,11 +312,20 @@ struct BuilderSWR : public Builder {
 
    void WriteVS(Value *pVal, Value *pVsContext, Value *pVtxOutput,
                 unsigned slot, unsigned channel);
+   void WriteDS(Value *pVal, Value *pDsContext, unsigned slot,
+                unsigned channel);
+   void ComputeClipDistances(struct tgsi_shader_info *info,
+                             LLVMValueRef (*outputs)[TGSI_NUM_CHANNELS],
+                             Value *hPrivateData, unsigned clip_mask,
+                             Value *dist[PIPE_MAX_CLIP_PLANES]);
 
    struct gallivm_state *gallivm;
    PFN_VERTEX_FUNC CompileVS(struct swr_context *ctx, swr_jit_vs_key &key);
    PFN_PIXEL_KERNEL CompileFS(struct swr_context *ctx, swr_jit_fs_key &key);
    PFN_GS_FUNC CompileGS(struct swr_context *ctx, swr_jit_gs_key &key);
+   PFN_HS_FUNC CompileTCS(struct swr_context *ctx, swr_jit_tcs_key &key);
+   PFN_DS_FUNC CompileTES(struct swr_context *ctx, swr_jit_tes_key &key);
+   PFN_CS_FUNC CompileCS(struct swr_context *ctx, swr_jit_cs_key &key);
 
    LLVMValueRef
    swr_gs_llvm_fetch_input(const struct lp_build_tgsi_gs_iface *gs_iface,
@@ -254,6 +353,116 @@ struct BuilderSWR : public Builder {
                         LLVMValueRef total_emitted_vertices_vec,
                         LLVMValueRef emitted_prims_vec);
 
+   // Fetch a scalar per lane through fetch(vertex, attrib).  Without any
+   // indirection all lanes share the same value, which is broadcast.
+   template <typename FetchFunc>
+   Value *
+   swr_tess_gather(boolean is_vindex_indirect,
+                   LLVMValueRef vertex_index,
+                   boolean is_aindex_indirect,
+                   LLVMValueRef attrib_index,
+                   FetchFunc fetch)
+   {
+      Value *vertex = vertex_index ? unwrap(vertex_index) : nullptr;
+      Value *attrib = unwrap(attrib_index);
+
+      if (!is_vindex_indirect && !is_aindex_indirect)
+         return VBROADCAST(fetch(vertex, attrib));
+
+      Value *res = VUNDEF_F();
+      for (uint32_t lane = 0; lane < mVWidth; ++lane) {
+         Value *v = vertex;
+         if (vertex && is_vindex_indirect) {
+            v = VEXTRACT(vertex, C(lane));
+            v = SELECT(ICMP_ULT(v, C(MAX_NUM_VERTS_PER_PRIM)), v, C(0));
+         }
+         Value *a = is_aindex_indirect ? VEXTRACT(attrib, C(lane)) : attrib;
+         res = VINSERT(res, fetch(v, a), C(lane));
+      }
+      return res;
+   }
+
+   Value *
+   swr_tcs_output_ptr(const struct lp_build_tgsi_tess_iface *tess_iface,
+                      Value *vertex,
+                      boolean is_aindex_indirect,
+                      Value *attrib,
+                      unsigned swizzle,
+                      Value *pDummy);
+
+   LLVMValueRef
+   swr_tcs_llvm_fetch_input(const struct lp_build_tgsi_tess_iface *tess_iface,
+                            struct lp_build_tgsi_context * bld_base,
+                            boolean is_vindex_indirect,
+                            LLVMValueRef vertex_index,
+                            boolean is_aindex_indirect,
+                            LLVMValueRef attrib_index,
+                            LLVMValueRef swizzle_index);
+
+   LLVMValueRef
+   swr_tcs_llvm_fetch_output(const struct lp_build_tgsi_tess_iface *tess_iface,
+                             struct lp_build_tgsi_context * bld_base,
+                             boolean is_vindex_indirect,
+                             LLVMValueRef vertex_index,
+                             boolean is_aindex_indirect,
+                             LLVMValueRef attrib_index,
+                             LLVMValueRef swizzle_index);
+
+   void
+   swr_tcs_llvm_store_output(const struct lp_build_tgsi_tess_iface *tess_iface,
+                             struct lp_build_tgsi_context * bld_base,
+                             boolean is_vindex_indirect,
+                             LLVMValueRef vertex_index,
+                             boolean is_aindex_indirect,
+                             LLVMValueRef attrib_index,
+                             LLVMValueRef swizzle_index,
+                             LLVMValueRef value,
+                             LLVMValueRef mask_vec);
+
+   LLVMValueRef
+   swr_tes_llvm_fetch_input(const struct lp_build_tgsi_tess_iface *tess_iface,
+                            struct lp_build_tgsi_context * bld_base,
+                            boolean is_vindex_indirect,
+                            LLVMValueRef vertex_index,
+                            boolean is_aindex_indirect,
+                            LLVMValueRef attrib_index,
+                            LLVMValueRef swizzle_index);
+
+   LLVMValueRef
+   swr_tcs_llvm_loop_begin(const struct lp_build_tgsi_tess_iface *tess_iface,
+                           struct lp_build_tgsi_context * bld_base);
+
+   void
+   swr_tcs_llvm_loop_end(const struct lp_build_tgsi_tess_iface *tess_iface,
+                         struct lp_build_tgsi_context * bld_base);
+
+   LLVMValueRef
+   swr_tcs_llvm_spill_ptr(const struct lp_build_tgsi_tess_iface *tess_iface,
+                          struct lp_build_tgsi_context * bld_base);
+
+   void
+   swr_cs_llvm_loop_begin(const struct lp_build_tgsi_cs_iface *cs_iface,
+                          struct lp_build_tgsi_context * bld_base);
+
+   void
+   swr_cs_llvm_loop_end(const struct lp_build_tgsi_cs_iface *cs_iface,
+                        struct lp_build_tgsi_context * bld_base);
+
+   LLVMValueRef
+   swr_cs_llvm_spill_ptr(const struct lp_build_tgsi_cs_iface *cs_iface,
+                         struct lp_build_tgsi_context * bld_base);
+
+   LLVMValueRef
+   swr_cs_llvm_fetch_thread_id(const struct lp_build_tgsi_cs_iface *cs_iface,
+                               struct lp_build_tgsi_context * bld_base,
+                               unsigned chan);
+
+   LLVMValueRef
+   swr_cs_llvm_memory_ptr(const struct lp_build_tgsi_cs_iface *cs_iface,
+                          struct lp_build_tgsi_context * bld_base,
+                          unsigned file,
+                          LLVMValueRef index,
+                          LLVMValueRef *size);
 };
 
 struct swr_gs_llvm_iface {
@@ -595,17 +804,23 @@ BuilderSWR::CompileGS(struct swr_context *ctx, swr_jit_gs_key &key)
    system_values.prim_id = wrap(LOAD(pGsCtx, {0, SWR_GS_CONTEXT_PrimitiveID}));
    system_values.instance_id = wrap(LOAD(pGsCtx, {0, SWR_GS_CONTEXT_InstanceID}));
 
+   struct tgsi_shader_info *pPrevShader;
+   if (ctx->tes)
+      pPrevShader = &ctx->tes->info.base;
+   else
+      pPrevShader = &ctx->vs->info.base;
+
    std::vector<Constant*> mapConstants;
    Value *vtxAttribMap = ALLOCA(ArrayType::get(mInt32Ty, PIPE_MAX_SHADER_INPUTS));
    for (unsigned slot = 0; slot < info->num_inputs; slot++) {
       ubyte semantic_name = info->input_semantic_name[slot];
       ubyte semantic_idx = info->input_semantic_index[slot];
 
-      unsigned vs_slot = locate_linkage(semantic_name, semantic_idx, &ctx->vs->info.base);
+      unsigned vs_slot = locate_linkage(semantic_name, semantic_idx, pPrevShader);
 
       vs_slot += VERTEX_ATTRIB_START_SLOT;
 
-      if (ctx->vs->info.base.output_semantic_name[0] == TGSI_SEMANTIC_POSITION)
+      if (pPrevShader->output_semantic_name[0] == TGSI_SEMANTIC_POSITION)
          vs_slot--;
 
       if (semantic_name == TGSI_SEMANTIC_POSITION)
@@ -654,7 +869,9 @@ BuilderSWR::CompileGS(struct swr_context *ctx, swr_jit_gs_key &key)
                      NULL, // thread data
                      sampler,
                      &gs->info.base,
-                     &gs_iface.base);
+                     &gs_iface.base,
+                     NULL, // tessellation shader iface
+                     NULL); // compute shader iface
 
    lp_build_mask_end(&mask);
 
@@ -690,194 +907,1386 @@ swr_compile_gs(struct swr_context *ctx, swr_jit_gs_key &key)
    return func;
 }
 
-void
-BuilderSWR::WriteVS(Value *pVal, Value *pVsContext, Value *pVtxOutput, unsigned slot, unsigned channel)
+/*
+ * Tessellation control shader outputs are packed, in declaration order, into
+ * the ScalarPatch control points (per-vertex outputs) and patch data (patch
+ * outputs).  The tessellation levels have dedicated storage in tessFactors
+ * but keep their place in the patch data numbering for simplicity.
+ */
+static bool
+swr_is_patch_semantic(ubyte semantic_name)
 {
-#if USE_SIMD16_FRONTEND
-   // interleave the simdvertex components into the dest simd16vertex
-   //   slot16offset = slot8offset * 2
-   //   comp16offset = comp8offset * 2 + alternateOffset
+   return semantic_name == TGSI_SEMANTIC_PATCH ||
+          semantic_name == TGSI_SEMANTIC_TESSOUTER ||
+          semantic_name == TGSI_SEMANTIC_TESSINNER;
+}
 
-   Value *offset = LOAD(pVsContext, { 0, SWR_VS_CONTEXT_AlternateOffset });
-   Value *pOut = GEP(pVtxOutput, { C(0), C(0), C(slot * 2), offset } );
-   STORE(pVal, pOut, {channel * 2});
-#else
-   Value *pOut = GEP(pVtxOutput, {0, 0, slot});
-   STORE(pVal, pOut, {0, channel});
-#endif
+static unsigned
+swr_tcs_output_slot(const ubyte *semantic_name, unsigned output)
+{
+   bool patch = swr_is_patch_semantic(semantic_name[output]);
+   unsigned slot = 0;
+
+   for (unsigned i = 0; i < output; i++) {
+      if (swr_is_patch_semantic(semantic_name[i]) == patch)
+         slot++;
+   }
+
+   return slot;
 }
 
-PFN_VERTEX_FUNC
-BuilderSWR::CompileVS(struct swr_context *ctx, swr_jit_vs_key &key)
+/*
+ * Locate a vertex shader output in the control points handed to the HS.  The
+ * frontend copies the VS slots starting at VERTEX_POSITION_SLOT into the
+ * attributes starting at VERTEX_ATTRIB_START_SLOT.  Point size lives in the
+ * SGV slot which isn't forwarded.
+ */
+static unsigned
+swr_hs_input_slot(ubyte semantic_name, ubyte semantic_idx,
+                  struct tgsi_shader_info *vs_info)
 {
-   struct swr_vertex_shader *swr_vs = ctx->vs;
+   unsigned output = locate_linkage(semantic_name, semantic_idx, vs_info);
 
-   LLVMValueRef inputs[PIPE_MAX_SHADER_INPUTS][TGSI_NUM_CHANNELS];
-   LLVMValueRef outputs[PIPE_MAX_SHADER_OUTPUTS][TGSI_NUM_CHANNELS];
+   if (output == 0xFFFFFFFF || semantic_name == TGSI_SEMANTIC_PSIZE)
+      return 0xFFFFFFFF;
 
-   memset(outputs, 0, sizeof(outputs));
+   unsigned slot;
+   if (semantic_name == TGSI_SEMANTIC_POSITION) {
+      slot = VERTEX_POSITION_SLOT;
+   } else {
+      slot = VERTEX_ATTRIB_START_SLOT + output;
+      if (vs_info->output_semantic_name[0] == TGSI_SEMANTIC_POSITION)
+         slot--;
+   }
 
-   AttrBuilder attrBuilder;
-   attrBuilder.addStackAlignmentAttr(JM()->mVWidth * sizeof(float));
+   slot += VERTEX_ATTRIB_START_SLOT - VERTEX_POSITION_SLOT;
 
-   std::vector<Type *> vsArgs{PointerType::get(Gen_swr_draw_context(JM()), 0),
-                              PointerType::get(Gen_SWR_VS_CONTEXT(JM()), 0)};
-   FunctionType *vsFuncType =
-      FunctionType::get(Type::getVoidTy(JM()->mContext), vsArgs, false);
+   return slot < SWR_VTX_NUM_SLOTS ? slot : 0xFFFFFFFF;
+}
 
-   // create new vertex shader function
-   auto pFunction = Function::Create(vsFuncType,
-                                     GlobalValue::ExternalLinkage,
-                                     "VS",
-                                     JM()->mpCurrentModule);
-#if HAVE_LLVM < 0x0500
-   AttributeSet attrSet = AttributeSet::get(
-      JM()->mContext, AttributeSet::FunctionIndex, attrBuilder);
-   pFunction->addAttributes(AttributeSet::FunctionIndex, attrSet);
-#else
-   pFunction->addAttributes(AttributeList::FunctionIndex, attrBuilder);
-#endif
+/*
+ * Fixed function control stage, used when a TES is bound without a TCS:
+ * pass the input control points through and use the default levels.
+ */
+void
+swr_passthrough_tcs(HANDLE hPrivateData, SWR_HS_CONTEXT *pHsContext)
+{
+   const swr_draw_context *pDC = (const swr_draw_context *)hPrivateData;
+   const uint32_t *pMask = (const uint32_t *)&pHsContext->mask;
+   const uint32_t numAttribs = pDC->numPatchAttribs;
 
-   BasicBlock *block = BasicBlock::Create(JM()->mContext, "entry", pFunction);
-   IRB()->SetInsertPoint(block);
-   LLVMPositionBuilderAtEnd(gallivm->builder, wrap(block));
+   for (uint32_t lane = 0; lane < KNOB_SIMD_WIDTH; ++lane) {
+      if (!pMask[lane])
+         continue;
 
-   auto argitr = pFunction->arg_begin();
-   Value *hPrivateData = &*argitr++;
-   hPrivateData->setName("hPrivateData");
-   Value *pVsCtx = &*argitr++;
-   pVsCtx->setName("vsCtx");
-   
-   Value *consts_ptr = GEP(hPrivateData, {C(0), C(swr_draw_context_constantVS)});
+      ScalarPatch *pPatch = &pHsContext->pCPout[lane];
 
-   consts_ptr->setName("vs_constants");
-   Value *const_sizes_ptr =
-      GEP(hPrivateData, {0, swr_draw_context_num_constantsVS});
-   const_sizes_ptr->setName("num_vs_constants");
+      memcpy(pPatch->tessFactors.OuterTessFactors, pDC->tessLevelOuter,
+             sizeof(pDC->tessLevelOuter));
+      memcpy(pPatch->tessFactors.InnerTessFactors, pDC->tessLevelInner,
+             sizeof(pDC->tessLevelInner));
 
-   Value *vtxInput = LOAD(pVsCtx, {0, SWR_VS_CONTEXT_pVin});
+      for (uint32_t v = 0; v < pDC->patchVertices; ++v) {
+         for (uint32_t slot = VERTEX_ATTRIB_START_SLOT;
+              slot < VERTEX_ATTRIB_START_SLOT + numAttribs; ++slot) {
+            const float *pIn = (const float *)&pHsContext->vert[v].attrib[slot];
+            ScalarAttrib &out = pPatch->cp[v].attrib[slot];
 
-   for (uint32_t attrib = 0; attrib < PIPE_MAX_SHADER_INPUTS; attrib++) {
-      const unsigned mask = swr_vs->info.base.input_usage_mask[attrib];
-      for (uint32_t channel = 0; channel < TGSI_NUM_CHANNELS; channel++) {
-         if (mask & (1 << channel)) {
-            inputs[attrib][channel] =
-               wrap(LOAD(vtxInput, {0, 0, attrib, channel}));
+            out.x = pIn[0 * KNOB_SIMD_WIDTH + lane];
+            out.y = pIn[1 * KNOB_SIMD_WIDTH + lane];
+            out.z = pIn[2 * KNOB_SIMD_WIDTH + lane];
+            out.w = pIn[3 * KNOB_SIMD_WIDTH + lane];
          }
       }
    }
+}
 
-   struct lp_build_sampler_soa *sampler =
-      swr_sampler_soa_create(key.sampler, PIPE_SHADER_VERTEX);
+struct swr_tcs_llvm_iface {
+   struct lp_build_tgsi_tess_iface base;
+   struct tgsi_shader_info *info;
 
-   struct lp_bld_tgsi_system_values system_values;
-   memset(&system_values, 0, sizeof(system_values));
-   system_values.instance_id = wrap(LOAD(pVsCtx, {0, SWR_VS_CONTEXT_InstanceID}));
-   system_values.vertex_id = wrap(LOAD(pVsCtx, {0, SWR_VS_CONTEXT_VertexID}));
+   BuilderSWR *pBuilder;
 
-   lp_build_tgsi_soa(gallivm,
-                     swr_vs->pipe.tokens,
-                     lp_type_float_vec(32, 32 * 8),
-                     NULL, // mask
-                     wrap(consts_ptr),
-                     wrap(const_sizes_ptr),
-                     &system_values,
-                     inputs,
-                     outputs,
-                     wrap(hPrivateData), // (sampler context)
-                     NULL, // thread data
-                     sampler, // sampler
-                     &swr_vs->info.base,
-                     NULL); // geometry shader face
+   Value *pHsCtx;
+   Value *pPatch; // output patch of the SIMD lane being processed
+   Value *lane;
+   bool isolines;
 
-   sampler->destroy(sampler);
+   Value *pVtxAttribMap;
+   Value *pOutputMap;
+
+   // Output control points of a patch are processed SIMD width at a time;
+   // a barrier restarts this loop when there is more than one group.
+   struct lp_build_loop_state loop;
+   struct lp_build_mask_context *mask;
+   Value *vPatchMask;
+   unsigned vertices_out;
+   unsigned num_groups;
+   unsigned spill_size; // per group
+   Value *pSpill;
+};
 
-   IRB()->SetInsertPoint(unwrap(LLVMGetInsertBlock(gallivm->builder)));
+struct swr_tes_llvm_iface {
+   struct lp_build_tgsi_tess_iface base;
+   struct tgsi_shader_info *info;
 
-   Value *vtxOutput = LOAD(pVsCtx, {0, SWR_VS_CONTEXT_pVout});
+   BuilderSWR *pBuilder;
 
-   for (uint32_t channel = 0; channel < TGSI_NUM_CHANNELS; channel++) {
-      for (uint32_t attrib = 0; attrib < PIPE_MAX_SHADER_OUTPUTS; attrib++) {
-         if (!outputs[attrib][channel])
-            continue;
+   Value *pCpIn;
 
-         Value *val;
-         uint32_t outSlot;
+   Value *pVtxAttribMap;
+};
 
-         if (swr_vs->info.base.output_semantic_name[attrib] == TGSI_SEMANTIC_PSIZE) {
-            if (channel != VERTEX_SGV_POINT_SIZE_COMP)
-               continue;
-            val = LOAD(unwrap(outputs[attrib][0]));
-            outSlot = VERTEX_SGV_SLOT;
-         } else if (swr_vs->info.base.output_semantic_name[attrib] == TGSI_SEMANTIC_POSITION) {
-            val = LOAD(unwrap(outputs[attrib][channel]));
-            outSlot = VERTEX_POSITION_SLOT;
-         } else {
-            val = LOAD(unwrap(outputs[attrib][channel]));
-            outSlot = VERTEX_ATTRIB_START_SLOT + attrib;
-            if (swr_vs->info.base.output_semantic_name[0] == TGSI_SEMANTIC_POSITION)
-               outSlot--;
-         }
+// trampoline functions so we can use the builder llvm construction methods
+static LLVMValueRef
+swr_tcs_llvm_fetch_input(const struct lp_build_tgsi_tess_iface *tess_iface,
+                         struct lp_build_tgsi_context * bld_base,
+                         boolean is_vindex_indirect,
+                         LLVMValueRef vertex_index,
+                         boolean is_aindex_indirect,
+                         LLVMValueRef attrib_index,
+                         LLVMValueRef swizzle_index)
+{
+    swr_tcs_llvm_iface *iface = (swr_tcs_llvm_iface*)tess_iface;
+
+    return iface->pBuilder->swr_tcs_llvm_fetch_input(tess_iface, bld_base,
+                                                    is_vindex_indirect,
+                                                    vertex_index,
+                                                    is_aindex_indirect,
+                                                    attrib_index,
+                                                    swizzle_index);
+}
 
-         WriteVS(val, pVsCtx, vtxOutput, outSlot, channel);
-      }
-   }
+static LLVMValueRef
+swr_tcs_llvm_fetch_output(const struct lp_build_tgsi_tess_iface *tess_iface,
+                          struct lp_build_tgsi_context * bld_base,
+                          boolean is_vindex_indirect,
+                          LLVMValueRef vertex_index,
+                          boolean is_aindex_indirect,
+                          LLVMValueRef attrib_index,
+                          LLVMValueRef swizzle_index)
+{
+    swr_tcs_llvm_iface *iface = (swr_tcs_llvm_iface*)tess_iface;
+
+    return iface->pBuilder->swr_tcs_llvm_fetch_output(tess_iface, bld_base,
+                                                     is_vindex_indirect,
+                                                     vertex_index,
+                                                     is_aindex_indirect,
+                                                     attrib_index,
+                                                     swizzle_index);
+}
 
-   if (ctx->rasterizer->clip_plane_enable ||
-       swr_vs->info.base.culldist_writemask) {
-      unsigned clip_mask = ctx->rasterizer->clip_plane_enable;
+static void
+swr_tcs_llvm_store_output(const struct lp_build_tgsi_tess_iface *tess_iface,
+                          struct lp_build_tgsi_context * bld_base,
+                          boolean is_vindex_indirect,
+                          LLVMValueRef vertex_index,
+                          boolean is_aindex_indirect,
+                          LLVMValueRef attrib_index,
+                          LLVMValueRef swizzle_index,
+                          LLVMValueRef value,
+                          LLVMValueRef mask_vec)
+{
+    swr_tcs_llvm_iface *iface = (swr_tcs_llvm_iface*)tess_iface;
+
+    iface->pBuilder->swr_tcs_llvm_store_output(tess_iface, bld_base,
+                                              is_vindex_indirect,
+                                              vertex_index,
+                                              is_aindex_indirect,
+                                              attrib_index,
+                                              swizzle_index,
+                                              value,
+                                              mask_vec);
+}
 
-      unsigned cv = 0;
-      if (swr_vs->info.base.writes_clipvertex) {
-         cv = locate_linkage(TGSI_SEMANTIC_CLIPVERTEX, 0,
-                             &swr_vs->info.base);
-      } else {
-         for (int i = 0; i < PIPE_MAX_SHADER_OUTPUTS; i++) {
-            if (swr_vs->info.base.output_semantic_name[i] == TGSI_SEMANTIC_POSITION &&
-                swr_vs->info.base.output_semantic_index[i] == 0) {
-               cv = i;
-               break;
-            }
-         }
-      }
-      LLVMValueRef cx = LLVMBuildLoad(gallivm->builder, outputs[cv][0], "");
-      LLVMValueRef cy = LLVMBuildLoad(gallivm->builder, outputs[cv][1], "");
-      LLVMValueRef cz = LLVMBuildLoad(gallivm->builder, outputs[cv][2], "");
-      LLVMValueRef cw = LLVMBuildLoad(gallivm->builder, outputs[cv][3], "");
-
-      for (unsigned val = 0; val < PIPE_MAX_CLIP_PLANES; val++) {
-         // clip distance overrides user clip planes
-         if ((swr_vs->info.base.clipdist_writemask & clip_mask & (1 << val)) ||
-             ((swr_vs->info.base.culldist_writemask << swr_vs->info.base.num_written_clipdistance) & (1 << val))) {
-            unsigned cv = locate_linkage(TGSI_SEMANTIC_CLIPDIST, val < 4 ? 0 : 1,
-                                         &swr_vs->info.base);
-            if (val < 4) {
-               LLVMValueRef dist = LLVMBuildLoad(gallivm->builder, outputs[cv][val], "");
-               WriteVS(unwrap(dist), pVsCtx, vtxOutput, VERTEX_CLIPCULL_DIST_LO_SLOT, val);
-            } else {
-               LLVMValueRef dist = LLVMBuildLoad(gallivm->builder, outputs[cv][val - 4], "");
-               WriteVS(unwrap(dist), pVsCtx, vtxOutput, VERTEX_CLIPCULL_DIST_HI_SLOT, val - 4);
-            }
-            continue;
-         }
+static LLVMValueRef
+swr_tes_llvm_fetch_input(const struct lp_build_tgsi_tess_iface *tess_iface,
+                         struct lp_build_tgsi_context * bld_base,
+                         boolean is_vindex_indirect,
+                         LLVMValueRef vertex_index,
+                         boolean is_aindex_indirect,
+                         LLVMValueRef attrib_index,
+                         LLVMValueRef swizzle_index)
+{
+    swr_tes_llvm_iface *iface = (swr_tes_llvm_iface*)tess_iface;
+
+    return iface->pBuilder->swr_tes_llvm_fetch_input(tess_iface, bld_base,
+                                                    is_vindex_indirect,
+                                                    vertex_index,
+                                                    is_aindex_indirect,
+                                                    attrib_index,
+                                                    swizzle_index);
+}
 
-         if (!(clip_mask & (1 << val)))
-            continue;
+static LLVMValueRef
+swr_tcs_llvm_loop_begin(const struct lp_build_tgsi_tess_iface *tess_iface,
+                        struct lp_build_tgsi_context * bld_base)
+{
+    swr_tcs_llvm_iface *iface = (swr_tcs_llvm_iface*)tess_iface;
 
-         Value *px = LOAD(GEP(hPrivateData, {0, swr_draw_context_userClipPlanes, val, 0}));
-         Value *py = LOAD(GEP(hPrivateData, {0, swr_draw_context_userClipPlanes, val, 1}));
-         Value *pz = LOAD(GEP(hPrivateData, {0, swr_draw_context_userClipPlanes, val, 2}));
-         Value *pw = LOAD(GEP(hPrivateData, {0, swr_draw_context_userClipPlanes, val, 3}));
-         Value *dist = FADD(FMUL(unwrap(cx), VBROADCAST(px)),
-                            FADD(FMUL(unwrap(cy), VBROADCAST(py)),
-                                 FADD(FMUL(unwrap(cz), VBROADCAST(pz)),
-                                      FMUL(unwrap(cw), VBROADCAST(pw)))));
-
-         if (val < 4)
-            WriteVS(dist, pVsCtx, vtxOutput, VERTEX_CLIPCULL_DIST_LO_SLOT, val);
-         else
-            WriteVS(dist, pVsCtx, vtxOutput, VERTEX_CLIPCULL_DIST_HI_SLOT, val - 4);
-      }
+    return iface->pBuilder->swr_tcs_llvm_loop_begin(tess_iface, bld_base);
+}
+
+static void
+swr_tcs_llvm_loop_end(const struct lp_build_tgsi_tess_iface *tess_iface,
+                      struct lp_build_tgsi_context * bld_base)
+{
+    swr_tcs_llvm_iface *iface = (swr_tcs_llvm_iface*)tess_iface;
+
+    iface->pBuilder->swr_tcs_llvm_loop_end(tess_iface, bld_base);
+}
+
+static LLVMValueRef
+swr_tcs_llvm_spill_ptr(const struct lp_build_tgsi_tess_iface *tess_iface,
+                       struct lp_build_tgsi_context * bld_base)
+{
+    swr_tcs_llvm_iface *iface = (swr_tcs_llvm_iface*)tess_iface;
+
+    return iface->pBuilder->swr_tcs_llvm_spill_ptr(tess_iface, bld_base);
+}
+
+LLVMValueRef
+BuilderSWR::swr_tcs_llvm_fetch_input(const struct lp_build_tgsi_tess_iface *tess_iface,
+                                     struct lp_build_tgsi_context * bld_base,
+                                     boolean is_vindex_indirect,
+                                     LLVMValueRef vertex_index,
+                                     boolean is_aindex_indirect,
+                                     LLVMValueRef attrib_index,
+                                     LLVMValueRef swizzle_index)
+{
+    swr_tcs_llvm_iface *iface = (swr_tcs_llvm_iface*)tess_iface;
+
+    IRB()->SetInsertPoint(unwrap(LLVMGetInsertBlock(gallivm->builder)));
+
+    Value *swizzle = unwrap(swizzle_index);
+
+    Value *res = swr_tess_gather(is_vindex_indirect, vertex_index,
+                                 is_aindex_indirect, attrib_index,
+                                 [&](Value *vertex, Value *attrib) {
+       Value *slot = LOAD(GEP(iface->pVtxAttribMap, {C(0), attrib}));
+       Value *pAttrib = GEP(iface->pHsCtx, {C(0), C(SWR_HS_CONTEXT_vert),
+                                            vertex, C(simdvertex_attrib),
+                                            slot, swizzle});
+       return VEXTRACT(LOAD(pAttrib), iface->lane);
+    });
+
+    return wrap(res);
+}
+
+Value *
+BuilderSWR::swr_tcs_output_ptr(const struct lp_build_tgsi_tess_iface *tess_iface,
+                               Value *vertex,
+                               boolean is_aindex_indirect,
+                               Value *attrib,
+                               unsigned swizzle,
+                               Value *pDummy)
+{
+    swr_tcs_llvm_iface *iface = (swr_tcs_llvm_iface*)tess_iface;
+
+    if (vertex) {
+       Value *slot = LOAD(GEP(iface->pOutputMap, {C(0), attrib}));
+       return GEP(iface->pPatch, {C(0), C(ScalarPatch_cp), vertex,
+                                  C(ScalarCPoint_attrib), slot, C(swizzle)});
+    }
+
+    if (!is_aindex_indirect) {
+       unsigned output = cast<ConstantInt>(attrib)->getZExtValue();
+       ubyte semantic_name = iface->info->output_semantic_name[output];
+
+       if (semantic_name == TGSI_SEMANTIC_TESSOUTER) {
+          // swr expects the isoline detail factor first
+          if (iface->isolines && swizzle < 2)
+             swizzle ^= 1;
+          return GEP(iface->pPatch, {C(0), C(ScalarPatch_tessFactors),
+                                     C(SWR_TESSELLATION_FACTORS_OuterTessFactors),
+                                     C(swizzle)});
+       } else if (semantic_name == TGSI_SEMANTIC_TESSINNER) {
+          if (swizzle >= 2)
+             return pDummy;
+          return GEP(iface->pPatch, {C(0), C(ScalarPatch_tessFactors),
+                                     C(SWR_TESSELLATION_FACTORS_InnerTessFactors),
+                                     C(swizzle)});
+       }
+    }
+
+    Value *slot = LOAD(GEP(iface->pOutputMap, {C(0), attrib}));
+    return GEP(iface->pPatch, {C(0), C(ScalarPatch_patchData),
+                               C(ScalarCPoint_attrib), slot, C(swizzle)});
+}
+
+LLVMValueRef
+BuilderSWR::swr_tcs_llvm_fetch_output(const struct lp_build_tgsi_tess_iface *tess_iface,
+                                      struct lp_build_tgsi_context * bld_base,
+                                      boolean is_vindex_indirect,
+                                      LLVMValueRef vertex_index,
+                                      boolean is_aindex_indirect,
+                                      LLVMValueRef attrib_index,
+                                      LLVMValueRef swizzle_index)
+{
+    IRB()->SetInsertPoint(unwrap(LLVMGetInsertBlock(gallivm->builder)));
+
+    unsigned swizzle =
+       cast<ConstantInt>(unwrap(swizzle_index))->getZExtValue();
+
+    Value *pStack = STACKSAVE();
+    Value *pZero = ALLOCA(mFP32Ty); // reads of unbacked components
+    STORE(C(0.0f), pZero);
+
+    Value *res = swr_tess_gather(is_vindex_indirect, vertex_index,
+                                 is_aindex_indirect, attrib_index,
+                                 [&](Value *vertex, Value *attrib) {
+       return LOAD(swr_tcs_output_ptr(tess_iface, vertex, is_aindex_indirect,
+                                      attrib, swizzle, pZero));
+    });
+
+    STACKRESTORE(pStack);
+
+    return wrap(res);
+}
+
+void
+BuilderSWR::swr_tcs_llvm_store_output(const struct lp_build_tgsi_tess_iface *tess_iface,
+                                      struct lp_build_tgsi_context * bld_base,
+                                      boolean is_vindex_indirect,
+                                      LLVMValueRef vertex_index,
+                                      boolean is_aindex_indirect,
+                                      LLVMValueRef attrib_index,
+                                      LLVMValueRef swizzle_index,
+                                      LLVMValueRef value,
+                                      LLVMValueRef mask_vec)
+{
+    IRB()->SetInsertPoint(unwrap(LLVMGetInsertBlock(gallivm->builder)));
+
+    unsigned swizzle =
+       cast<ConstantInt>(unwrap(swizzle_index))->getZExtValue();
+
+    Value *vertex = vertex_index ? unwrap(vertex_index) : nullptr;
+    Value *attrib = unwrap(attrib_index);
+    Value *vMask1 = TRUNC(unwrap(mask_vec), VectorType::get(mInt1Ty, mVWidth));
+
+    Value *pStack = STACKSAVE();
+    Value *pTmpPtr = ALLOCA(mFP32Ty); // used for dummy write for lane masking
+
+    for (uint32_t lane = 0; lane < mVWidth; ++lane) {
+       Value *v = vertex;
+       if (vertex && is_vindex_indirect) {
+          v = VEXTRACT(vertex, C(lane));
+          v = SELECT(ICMP_ULT(v, C(MAX_NUM_VERTS_PER_PRIM)), v, C(0));
+       }
+       Value *a = is_aindex_indirect ? VEXTRACT(attrib, C(lane)) : attrib;
+
+       Value *pOut = swr_tcs_output_ptr(tess_iface, v, is_aindex_indirect,
+                                        a, swizzle, pTmpPtr);
+       pOut = SELECT(VEXTRACT(vMask1, C(lane)), pOut, pTmpPtr);
+
+       STORE(VEXTRACT(unwrap(value), C(lane)), pOut);
+    }
+
+    STACKRESTORE(pStack);
+}
+
+LLVMValueRef
+BuilderSWR::swr_tes_llvm_fetch_input(const struct lp_build_tgsi_tess_iface *tess_iface,
+                                     struct lp_build_tgsi_context * bld_base,
+                                     boolean is_vindex_indirect,
+                                     LLVMValueRef vertex_index,
+                                     boolean is_aindex_indirect,
+                                     LLVMValueRef attrib_index,
+                                     LLVMValueRef swizzle_index)
+{
+    swr_tes_llvm_iface *iface = (swr_tes_llvm_iface*)tess_iface;
+
+    IRB()->SetInsertPoint(unwrap(LLVMGetInsertBlock(gallivm->builder)));
+
+    Value *swizzle = unwrap(swizzle_index);
+
+    Value *res = swr_tess_gather(is_vindex_indirect, vertex_index,
+                                 is_aindex_indirect, attrib_index,
+                                 [&](Value *vertex, Value *attrib) {
+       Value *slot = LOAD(GEP(iface->pVtxAttribMap, {C(0), attrib}));
+       Value *pAttrib;
+       if (vertex)
+          pAttrib = GEP(iface->pCpIn, {C(0), C(ScalarPatch_cp), vertex,
+                                       C(ScalarCPoint_attrib), slot, swizzle});
+       else
+          pAttrib = GEP(iface->pCpIn, {C(0), C(ScalarPatch_patchData),
+                                       C(ScalarCPoint_attrib), slot, swizzle});
+       return LOAD(pAttrib);
+    });
+
+    return wrap(res);
+}
+
+LLVMValueRef
+BuilderSWR::swr_tcs_llvm_loop_begin(const struct lp_build_tgsi_tess_iface *tess_iface,
+                                    struct lp_build_tgsi_context * bld_base)
+{
+    swr_tcs_llvm_iface *iface = (swr_tcs_llvm_iface*)tess_iface;
+
+    lp_build_loop_begin(&iface->loop, gallivm,
+                        lp_build_const_int32(gallivm, 0));
+
+    IRB()->SetInsertPoint(unwrap(LLVMGetInsertBlock(gallivm->builder)));
+
+    Value *vInvocationId =
+       ADD(VBROADCAST(MUL(unwrap(iface->loop.counter), C(mVWidth))),
+           C({0, 1, 2, 3, 4, 5, 6, 7}));
+    Value *mask_val =
+       AND(VBROADCAST(VEXTRACT(iface->vPatchMask, iface->lane)),
+           VMASK(ICMP_ULT(vInvocationId, VIMMED1(iface->vertices_out))));
+    STORE(mask_val, unwrap(iface->mask->var));
+
+    return wrap(vInvocationId);
+}
+
+void
+BuilderSWR::swr_tcs_llvm_loop_end(const struct lp_build_tgsi_tess_iface *tess_iface,
+                                  struct lp_build_tgsi_context * bld_base)
+{
+    swr_tcs_llvm_iface *iface = (swr_tcs_llvm_iface*)tess_iface;
+
+    lp_build_loop_end_cond(&iface->loop,
+                           lp_build_const_int32(gallivm, iface->num_groups),
+                           NULL, LLVMIntUGE);
+}
+
+LLVMValueRef
+BuilderSWR::swr_tcs_llvm_spill_ptr(const struct lp_build_tgsi_tess_iface *tess_iface,
+                                   struct lp_build_tgsi_context * bld_base)
+{
+    swr_tcs_llvm_iface *iface = (swr_tcs_llvm_iface*)tess_iface;
+
+    IRB()->SetInsertPoint(unwrap(LLVMGetInsertBlock(gallivm->builder)));
+
+    Value *offset = MUL(unwrap(iface->loop.counter), C(iface->spill_size));
+
+    return wrap(GEP(iface->pSpill, {offset}));
+}
+
+PFN_HS_FUNC
+BuilderSWR::CompileTCS(struct swr_context *ctx, swr_jit_tcs_key &key)
+{
+   struct swr_tess_control_shader *tcs = ctx->tcs;
+   struct tgsi_shader_info *info = &tcs->info.base;
+
+   // Output control points are mapped across the SIMD lanes, in groups of
+   // SIMD width, while the input patches are processed one at a time.
+   unsigned vertices_out = info->properties[TGSI_PROPERTY_TCS_VERTICES_OUT];
+   unsigned num_groups = (vertices_out + mVWidth - 1) / mVWidth;
+
+   LLVMValueRef inputs[PIPE_MAX_SHADER_INPUTS][TGSI_NUM_CHANNELS];
+   LLVMValueRef outputs[PIPE_MAX_SHADER_OUTPUTS][TGSI_NUM_CHANNELS];
+
+   memset(outputs, 0, sizeof(outputs));
+
+   AttrBuilder attrBuilder;
+   attrBuilder.addStackAlignmentAttr(JM()->mVWidth * sizeof(float));
+
+   std::vector<Type *> tcsArgs{PointerType::get(Gen_swr_draw_context(JM()), 0),
+                               PointerType::get(Gen_SWR_HS_CONTEXT(JM()), 0)};
+   FunctionType *tcsFuncType =
+      FunctionType::get(Type::getVoidTy(JM()->mContext), tcsArgs, false);
+
+   // create new tessellation control shader function
+   auto pFunction = Function::Create(tcsFuncType,
+                                     GlobalValue::ExternalLinkage,
+                                     "TCS",
+                                     JM()->mpCurrentModule);
+#if HAVE_LLVM < 0x0500
+   AttributeSet attrSet = AttributeSet::get(
+      JM()->mContext, AttributeSet::FunctionIndex, attrBuilder);
+   pFunction->addAttributes(AttributeSet::FunctionIndex, attrSet);
+#else
+   pFunction->addAttributes(AttributeList::FunctionIndex, attrBuilder);
+#endif
+
+   BasicBlock *block = BasicBlock::Create(JM()->mContext, "entry", pFunction);
+   IRB()->SetInsertPoint(block);
+   LLVMPositionBuilderAtEnd(gallivm->builder, wrap(block));
+
+   auto argitr = pFunction->arg_begin();
+   Value *hPrivateData = &*argitr++;
+   hPrivateData->setName("hPrivateData");
+   Value *pHsCtx = &*argitr++;
+   pHsCtx->setName("hsCtx");
+
+   Value *consts_ptr =
+      GEP(hPrivateData, {C(0), C(swr_draw_context_constantTCS)});
+   consts_ptr->setName("tcs_constants");
+   Value *const_sizes_ptr =
+      GEP(hPrivateData, {0, swr_draw_context_num_constantsTCS});
+   const_sizes_ptr->setName("num_tcs_constants");
+
+   struct lp_build_sampler_soa *sampler =
+      swr_sampler_soa_create(key.sampler, PIPE_SHADER_TESS_CTRL);
+
+   Value *vtxAttribMap = ALLOCA(ArrayType::get(mInt32Ty, PIPE_MAX_SHADER_INPUTS));
+   for (unsigned slot = 0; slot < info->num_inputs; slot++) {
+      unsigned hs_slot = swr_hs_input_slot(info->input_semantic_name[slot],
+                                           info->input_semantic_index[slot],
+                                           &ctx->vs->info.base);
+      if (hs_slot == 0xFFFFFFFF)
+         hs_slot = 0;
+
+      STORE(C(hs_slot), vtxAttribMap, {0, slot});
+   }
+
+   Value *outputMap = ALLOCA(ArrayType::get(mInt32Ty, PIPE_MAX_SHADER_OUTPUTS));
+   for (unsigned slot = 0; slot < info->num_outputs; slot++) {
+      STORE(C(swr_tcs_output_slot(info->output_semantic_name, slot)),
+            outputMap, {0, slot});
+   }
+
+   // Registers of every group of a patch are kept across a barrier
+   unsigned spill_size = 0;
+   Value *pSpill = NULL;
+   if (num_groups > 1) {
+      spill_size = lp_build_tgsi_soa_spill_size(info,
+                                                lp_type_float_vec(32, 32 * 8));
+      pSpill = ALLOCA(ArrayType::get(mSimdFP32Ty,
+                                     num_groups * spill_size /
+                                     (mVWidth * sizeof(float))));
+      pSpill = BITCAST(pSpill, mInt8PtrTy);
+   }
+
+   Value *pCPout = LOAD(pHsCtx, {0, SWR_HS_CONTEXT_pCPout});
+   Value *vPatchMask = LOAD(pHsCtx, {0, SWR_HS_CONTEXT_mask}, "hsMask");
+   Value *vPrimId = LOAD(pHsCtx, {0, SWR_HS_CONTEXT_PrimitiveID});
+   Value *patchVertices =
+      LOAD(hPrivateData, {0, swr_draw_context_patchVertices});
+
+   // Input patches are processed one at a time, the groups of output
+   // control points of a patch by a loop that lp_build_tgsi_soa() opens
+   // through tcs_iface.
+   struct lp_build_loop_state loop_state;
+   lp_build_loop_begin(&loop_state, gallivm, lp_build_const_int32(gallivm, 0));
+
+   IRB()->SetInsertPoint(unwrap(LLVMGetInsertBlock(gallivm->builder)));
+
+   Value *lane = unwrap(loop_state.counter);
+
+   struct lp_build_mask_context mask;
+   lp_build_mask_begin(&mask, gallivm,
+                       lp_type_float_vec(32, 32 * 8), wrap(VIMMED1(0)));
+
+   struct lp_bld_tgsi_system_values system_values;
+   memset(&system_values, 0, sizeof(system_values));
+   system_values.prim_id = wrap(VEXTRACT(vPrimId, lane));
+   system_values.vertices_in = wrap(patchVertices);
+
+   struct swr_tcs_llvm_iface tcs_iface;
+   tcs_iface.base.fetch_input = ::swr_tcs_llvm_fetch_input;
+   tcs_iface.base.fetch_output = ::swr_tcs_llvm_fetch_output;
+   tcs_iface.base.store_output = ::swr_tcs_llvm_store_output;
+   tcs_iface.base.loop_begin = ::swr_tcs_llvm_loop_begin;
+   tcs_iface.base.loop_end = ::swr_tcs_llvm_loop_end;
+   tcs_iface.base.spill_ptr = pSpill ? ::swr_tcs_llvm_spill_ptr : NULL;
+   tcs_iface.info = info;
+   tcs_iface.pBuilder = this;
+   tcs_iface.pHsCtx = pHsCtx;
+   tcs_iface.pPatch = GEP(pCPout, {lane});
+   tcs_iface.lane = lane;
+   tcs_iface.isolines = key.tes_prim_mode == PIPE_PRIM_LINES;
+   tcs_iface.pVtxAttribMap = vtxAttribMap;
+   tcs_iface.pOutputMap = outputMap;
+   tcs_iface.mask = &mask;
+   tcs_iface.vPatchMask = vPatchMask;
+   tcs_iface.vertices_out = vertices_out;
+   tcs_iface.num_groups = num_groups;
+   tcs_iface.spill_size = spill_size;
+   tcs_iface.pSpill = pSpill;
+
+   lp_build_tgsi_soa(gallivm,
+                     tcs->pipe.tokens,
+                     lp_type_float_vec(32, 32 * 8),
+                     &mask,
+                     wrap(consts_ptr),
+                     wrap(const_sizes_ptr),
+                     &system_values,
+                     inputs,
+                     outputs,
+                     wrap(hPrivateData), // (sampler context)
+                     NULL, // thread data
+                     sampler,
+                     info,
+                     NULL, // geometry shader face
+                     &tcs_iface.base,
+                     NULL); // compute shader iface
+
+   lp_build_mask_end(&mask);
+
+   lp_build_loop_end_cond(&loop_state,
+                          lp_build_const_int32(gallivm, mVWidth),
+                          NULL, LLVMIntUGE);
+
+   sampler->destroy(sampler);
+
+   IRB()->SetInsertPoint(unwrap(LLVMGetInsertBlock(gallivm->builder)));
+
+   RET_VOID();
+
+   gallivm_verify_function(gallivm, wrap(pFunction));
+   gallivm_compile_module(gallivm);
+
+   PFN_HS_FUNC pFunc =
+      (PFN_HS_FUNC)gallivm_jit_function(gallivm, wrap(pFunction));
+
+   debug_printf("tess control shader  %p\n", pFunc);
+   assert(pFunc && "Error: TessControlShader = NULL");
+
+   JM()->mIsModuleFinalized = true;
+
+   return pFunc;
+}
+
+PFN_HS_FUNC
+swr_compile_tcs(struct swr_context *ctx, swr_jit_tcs_key &key)
+{
+   BuilderSWR builder(
+      reinterpret_cast<JitManager *>(swr_screen(ctx->pipe.screen)->hJitMgr),
+      "TCS");
+   PFN_HS_FUNC func = builder.CompileTCS(ctx, key);
+
+   ctx->tcs->map.insert(std::make_pair(key, make_unique<VariantTCS>(builder.gallivm, func)));
+   return func;
+}
+
+void
+BuilderSWR::WriteDS(Value *pVal, Value *pDsContext, unsigned slot, unsigned channel)
+{
+   // DS output is laid out as simd vectors per attribute component,
+   // vectorStride apart
+   Value *vectorOffset = LOAD(pDsContext, {0, SWR_DS_CONTEXT_vectorOffset});
+   Value *vectorStride = LOAD(pDsContext, {0, SWR_DS_CONTEXT_vectorStride});
+   Value *pOutput = LOAD(pDsContext, {0, SWR_DS_CONTEXT_pOutputData});
+
+   Value *offset = ADD(MUL(C(slot * 4 + channel), vectorStride), vectorOffset);
+   STORE(pVal, GEP(pOutput, {offset}));
+}
+
+PFN_DS_FUNC
+BuilderSWR::CompileTES(struct swr_context *ctx, swr_jit_tes_key &key)
+{
+   struct swr_tess_evaluation_shader *tes = ctx->tes;
+   struct tgsi_shader_info *info = &tes->info.base;
+
+   LLVMValueRef inputs[PIPE_MAX_SHADER_INPUTS][TGSI_NUM_CHANNELS];
+   LLVMValueRef outputs[PIPE_MAX_SHADER_OUTPUTS][TGSI_NUM_CHANNELS];
+
+   memset(outputs, 0, sizeof(outputs));
+
+   AttrBuilder attrBuilder;
+   attrBuilder.addStackAlignmentAttr(JM()->mVWidth * sizeof(float));
+
+   std::vector<Type *> tesArgs{PointerType::get(Gen_swr_draw_context(JM()), 0),
+                               PointerType::get(Gen_SWR_DS_CONTEXT(JM()), 0)};
+   FunctionType *tesFuncType =
+      FunctionType::get(Type::getVoidTy(JM()->mContext), tesArgs, false);
+
+   // create new tessellation evaluation shader function
+   auto pFunction = Function::Create(tesFuncType,
+                                     GlobalValue::ExternalLinkage,
+                                     "TES",
+                                     JM()->mpCurrentModule);
+#if HAVE_LLVM < 0x0500
+   AttributeSet attrSet = AttributeSet::get(
+      JM()->mContext, AttributeSet::FunctionIndex, attrBuilder);
+   pFunction->addAttributes(AttributeSet::FunctionIndex, attrSet);
+#else
+   pFunction->addAttributes(AttributeList::FunctionIndex, attrBuilder);
+#endif
+
+   BasicBlock *block = BasicBlock::Create(JM()->mContext, "entry", pFunction);
+   IRB()->SetInsertPoint(block);
+   LLVMPositionBuilderAtEnd(gallivm->builder, wrap(block));
+
+   auto argitr = pFunction->arg_begin();
+   Value *hPrivateData = &*argitr++;
+   hPrivateData->setName("hPrivateData");
+   Value *pDsCtx = &*argitr++;
+   pDsCtx->setName("dsCtx");
+
+   Value *consts_ptr =
+      GEP(hPrivateData, {C(0), C(swr_draw_context_constantTES)});
+   consts_ptr->setName("tes_constants");
+   Value *const_sizes_ptr =
+      GEP(hPrivateData, {0, swr_draw_context_num_constantsTES});
+   const_sizes_ptr->setName("num_tes_constants");
+
+   struct lp_build_sampler_soa *sampler =
+      swr_sampler_soa_create(key.sampler, PIPE_SHADER_TESS_EVAL);
+
+   Value *vtxAttribMap = ALLOCA(ArrayType::get(mInt32Ty, PIPE_MAX_SHADER_INPUTS));
+   for (unsigned slot = 0; slot < info->num_inputs; slot++) {
+      ubyte semantic_name = info->input_semantic_name[slot];
+      ubyte semantic_idx = info->input_semantic_index[slot];
+      unsigned cp_slot;
+
+      if (ctx->tcs) {
+         struct tgsi_shader_info *tcs_info = &ctx->tcs->info.base;
+         cp_slot = locate_linkage(semantic_name, semantic_idx, tcs_info);
+         if (cp_slot != 0xFFFFFFFF)
+            cp_slot = swr_tcs_output_slot(tcs_info->output_semantic_name,
+                                          cp_slot);
+      } else {
+         // the passthrough control stage copies the HS input slots
+         cp_slot = swr_hs_input_slot(semantic_name, semantic_idx,
+                                     &ctx->vs->info.base);
+      }
+      if (cp_slot == 0xFFFFFFFF)
+         cp_slot = 0;
+
+      STORE(C(cp_slot), vtxAttribMap, {0, slot});
+   }
+
+   Value *pCpIn = LOAD(pDsCtx, {0, SWR_DS_CONTEXT_pCpIn});
+   Value *vectorOffset = LOAD(pDsCtx, {0, SWR_DS_CONTEXT_vectorOffset});
+
+   struct lp_bld_tgsi_system_values system_values;
+   memset(&system_values, 0, sizeof(system_values));
+
+   Value *vU = LOAD(GEP(LOAD(pDsCtx, {0, SWR_DS_CONTEXT_pDomainU}), {vectorOffset}));
+   Value *vV = LOAD(GEP(LOAD(pDsCtx, {0, SWR_DS_CONTEXT_pDomainV}), {vectorOffset}));
+   system_values.tess_coord[0] = wrap(vU);
+   system_values.tess_coord[1] = wrap(vV);
+   if (info->properties[TGSI_PROPERTY_TES_PRIM_MODE] == PIPE_PRIM_TRIANGLES)
+      system_values.tess_coord[2] = wrap(FSUB(FSUB(VIMMED1(1.0f), vU), vV));
+   else
+      system_values.tess_coord[2] = wrap(VIMMED1(0.0f));
+
+   bool isolines =
+      info->properties[TGSI_PROPERTY_TES_PRIM_MODE] == PIPE_PRIM_LINES;
+   for (unsigned i = 0; i < 4; i++) {
+      // swr stores the isoline detail factor first
+      unsigned factor = (isolines && i < 2) ? i ^ 1 : i;
+      system_values.tess_outer[i] =
+         wrap(LOAD(pCpIn, {0, ScalarPatch_tessFactors,
+                           SWR_TESSELLATION_FACTORS_OuterTessFactors,
+                           factor}));
+   }
+   for (unsigned i = 0; i < 2; i++) {
+      system_values.tess_inner[i] =
+         wrap(LOAD(pCpIn, {0, ScalarPatch_tessFactors,
+                           SWR_TESSELLATION_FACTORS_InnerTessFactors, i}));
+   }
+
+   system_values.prim_id = wrap(LOAD(pDsCtx, {0, SWR_DS_CONTEXT_PrimitiveID}));
+   if (key.tcs_vertices_out)
+      system_values.vertices_in = wrap(C(key.tcs_vertices_out));
+   else
+      system_values.vertices_in =
+         wrap(LOAD(hPrivateData, {0, swr_draw_context_patchVertices}));
+
+   struct lp_build_mask_context mask;
+   Value *mask_val = LOAD(pDsCtx, {0, SWR_DS_CONTEXT_mask}, "dsMask");
+   lp_build_mask_begin(&mask, gallivm,
+                       lp_type_float_vec(32, 32 * 8), wrap(mask_val));
+
+   struct swr_tes_llvm_iface tes_iface;
+   tes_iface.base.fetch_input = ::swr_tes_llvm_fetch_input;
+   tes_iface.base.fetch_output = NULL;
+   tes_iface.base.store_output = NULL;
+   tes_iface.info = info;
+   tes_iface.pBuilder = this;
+   tes_iface.pCpIn = pCpIn;
+   tes_iface.pVtxAttribMap = vtxAttribMap;
+
+   lp_build_tgsi_soa(gallivm,
+                     tes->pipe.tokens,
+                     lp_type_float_vec(32, 32 * 8),
+                     &mask,
+                     wrap(consts_ptr),
+                     wrap(const_sizes_ptr),
+                     &system_values,
+                     inputs,
+                     outputs,
+                     wrap(hPrivateData), // (sampler context)
+                     NULL, // thread data
+                     sampler,
+                     info,
+                     NULL, // geometry shader face
+                     &tes_iface.base,
+                     NULL); // compute shader iface
+
+   lp_build_mask_end(&mask);
+
+   sampler->destroy(sampler);
+
+   IRB()->SetInsertPoint(unwrap(LLVMGetInsertBlock(gallivm->builder)));
+
+   for (uint32_t channel = 0; channel < TGSI_NUM_CHANNELS; channel++) {
+      for (uint32_t attrib = 0; attrib < PIPE_MAX_SHADER_OUTPUTS; attrib++) {
+         if (!outputs[attrib][channel])
+            continue;
+
+         Value *val;
+         uint32_t outSlot;
+
+         if (info->output_semantic_name[attrib] == TGSI_SEMANTIC_PSIZE) {
+            if (channel != VERTEX_SGV_POINT_SIZE_COMP)
+               continue;
+            val = LOAD(unwrap(outputs[attrib][0]));
+            outSlot = VERTEX_SGV_SLOT;
+         } else if (info->output_semantic_name[attrib] == TGSI_SEMANTIC_POSITION) {
+            val = LOAD(unwrap(outputs[attrib][channel]));
+            outSlot = VERTEX_POSITION_SLOT;
+         } else {
+            val = LOAD(unwrap(outputs[attrib][channel]));
+            outSlot = VERTEX_ATTRIB_START_SLOT + attrib;
+            if (info->output_semantic_name[0] == TGSI_SEMANTIC_POSITION)
+               outSlot--;
+         }
+
+         WriteDS(val, pDsCtx, outSlot, channel);
+      }
+   }
+
+   Value *dist[PIPE_MAX_CLIP_PLANES];
+   ComputeClipDistances(info, outputs, hPrivateData,
+                        ctx->rasterizer->clip_plane_enable, dist);
+
+   for (unsigned val = 0; val < PIPE_MAX_CLIP_PLANES; val++) {
+      if (!dist[val])
+         continue;
+
+      if (val < 4)
+         WriteDS(dist[val], pDsCtx, VERTEX_CLIPCULL_DIST_LO_SLOT, val);
+      else
+         WriteDS(dist[val], pDsCtx, VERTEX_CLIPCULL_DIST_HI_SLOT, val - 4);
+   }
+
+   RET_VOID();
+
+   gallivm_verify_function(gallivm, wrap(pFunction));
+   gallivm_compile_module(gallivm);
+
+   PFN_DS_FUNC pFunc =
+      (PFN_DS_FUNC)gallivm_jit_function(gallivm, wrap(pFunction));
+
+   debug_printf("tess eval shader  %p\n", pFunc);
+   assert(pFunc && "Error: TessEvalShader = NULL");
+
+   JM()->mIsModuleFinalized = true;
+
+   return pFunc;
+}
+
+PFN_DS_FUNC
+swr_compile_tes(struct swr_context *ctx, swr_jit_tes_key &key)
+{
+   BuilderSWR builder(
+      reinterpret_cast<JitManager *>(swr_screen(ctx->pipe.screen)->hJitMgr),
+      "TES");
+   PFN_DS_FUNC func = builder.CompileTES(ctx, key);
+
+   ctx->tes->map.insert(std::make_pair(key, make_unique<VariantTES>(builder.gallivm, func)));
+   return func;
+}
+
+struct swr_cs_llvm_iface {
+   struct lp_build_tgsi_cs_iface base;
+   struct tgsi_shader_info *info;
+
+   BuilderSWR *pBuilder;
+
+   Value *hPrivateData;
+   Value *pCsCtx;
+   struct lp_build_mask_context *mask;
+
+   // Invocations of the work group are processed SIMD width at a time;
+   // a barrier restarts this loop.
+   struct lp_build_loop_state loop;
+   unsigned block[3];
+   unsigned num_chunks;
+   unsigned spill_size;
+   unsigned shared_size;
+};
+
+// trampoline functions so we can use the builder llvm construction methods
+static void
+swr_cs_llvm_loop_begin(const struct lp_build_tgsi_cs_iface *cs_iface,
+                       struct lp_build_tgsi_context * bld_base)
+{
+    swr_cs_llvm_iface *iface = (swr_cs_llvm_iface*)cs_iface;
+
+    iface->pBuilder->swr_cs_llvm_loop_begin(cs_iface, bld_base);
+}
+
+static void
+swr_cs_llvm_loop_end(const struct lp_build_tgsi_cs_iface *cs_iface,
+                     struct lp_build_tgsi_context * bld_base)
+{
+    swr_cs_llvm_iface *iface = (swr_cs_llvm_iface*)cs_iface;
+
+    iface->pBuilder->swr_cs_llvm_loop_end(cs_iface, bld_base);
+}
+
+static LLVMValueRef
+swr_cs_llvm_spill_ptr(const struct lp_build_tgsi_cs_iface *cs_iface,
+                      struct lp_build_tgsi_context * bld_base)
+{
+    swr_cs_llvm_iface *iface = (swr_cs_llvm_iface*)cs_iface;
+
+    return iface->pBuilder->swr_cs_llvm_spill_ptr(cs_iface, bld_base);
+}
+
+static LLVMValueRef
+swr_cs_llvm_fetch_thread_id(const struct lp_build_tgsi_cs_iface *cs_iface,
+                            struct lp_build_tgsi_context * bld_base,
+                            unsigned chan)
+{
+    swr_cs_llvm_iface *iface = (swr_cs_llvm_iface*)cs_iface;
+
+    return iface->pBuilder->swr_cs_llvm_fetch_thread_id(cs_iface, bld_base,
+                                                        chan);
+}
+
+static LLVMValueRef
+swr_cs_llvm_memory_ptr(const struct lp_build_tgsi_cs_iface *cs_iface,
+                       struct lp_build_tgsi_context * bld_base,
+                       unsigned file,
+                       LLVMValueRef index,
+                       LLVMValueRef *size)
+{
+    swr_cs_llvm_iface *iface = (swr_cs_llvm_iface*)cs_iface;
+
+    return iface->pBuilder->swr_cs_llvm_memory_ptr(cs_iface, bld_base,
+                                                   file, index, size);
+}
+
+void
+BuilderSWR::swr_cs_llvm_loop_begin(const struct lp_build_tgsi_cs_iface *cs_iface,
+                                   struct lp_build_tgsi_context * bld_base)
+{
+    swr_cs_llvm_iface *iface = (swr_cs_llvm_iface*)cs_iface;
+    unsigned num_threads = iface->block[0] * iface->block[1] * iface->block[2];
+
+    lp_build_loop_begin(&iface->loop, gallivm,
+                        lp_build_const_int32(gallivm, 0));
+
+    IRB()->SetInsertPoint(unwrap(LLVMGetInsertBlock(gallivm->builder)));
+
+    // the last chunk of a work group may be partially populated
+    Value *vIndex = ADD(VBROADCAST(MUL(unwrap(iface->loop.counter), C(mVWidth))),
+                        C({0, 1, 2, 3, 4, 5, 6, 7}));
+    Value *mask_val = VMASK(ICMP_ULT(vIndex, VIMMED1(num_threads)));
+    STORE(mask_val, unwrap(iface->mask->var));
+}
+
+void
+BuilderSWR::swr_cs_llvm_loop_end(const struct lp_build_tgsi_cs_iface *cs_iface,
+                                 struct lp_build_tgsi_context * bld_base)
+{
+    swr_cs_llvm_iface *iface = (swr_cs_llvm_iface*)cs_iface;
+
+    lp_build_loop_end_cond(&iface->loop,
+                           lp_build_const_int32(gallivm, iface->num_chunks),
+                           NULL, LLVMIntUGE);
+}
+
+LLVMValueRef
+BuilderSWR::swr_cs_llvm_spill_ptr(const struct lp_build_tgsi_cs_iface *cs_iface,
+                                  struct lp_build_tgsi_context * bld_base)
+{
+    swr_cs_llvm_iface *iface = (swr_cs_llvm_iface*)cs_iface;
+
+    IRB()->SetInsertPoint(unwrap(LLVMGetInsertBlock(gallivm->builder)));
+
+    Value *pSpill = LOAD(iface->pCsCtx, {0, SWR_CS_CONTEXT_pSpillFillBuffer});
+    Value *offset = MUL(unwrap(iface->loop.counter), C(iface->spill_size));
+
+    return wrap(GEP(pSpill, {offset}));
+}
+
+LLVMValueRef
+BuilderSWR::swr_cs_llvm_fetch_thread_id(const struct lp_build_tgsi_cs_iface *cs_iface,
+                                        struct lp_build_tgsi_context * bld_base,
+                                        unsigned chan)
+{
+    swr_cs_llvm_iface *iface = (swr_cs_llvm_iface*)cs_iface;
+
+    IRB()->SetInsertPoint(unwrap(LLVMGetInsertBlock(gallivm->builder)));
+
+    // invocations are numbered x fastest within the work group
+    Value *vIndex = ADD(VBROADCAST(MUL(unwrap(iface->loop.counter), C(mVWidth))),
+                        C({0, 1, 2, 3, 4, 5, 6, 7}));
+    switch (chan) {
+    case 0:
+       return wrap(UREM(vIndex, VIMMED1(iface->block[0])));
+    case 1:
+       return wrap(UREM(UDIV(vIndex, VIMMED1(iface->block[0])),
+                        VIMMED1(iface->block[1])));
+    default:
+       return wrap(UDIV(vIndex, VIMMED1(iface->block[0] * iface->block[1])));
+    }
+}
+
+LLVMValueRef
+BuilderSWR::swr_cs_llvm_memory_ptr(const struct lp_build_tgsi_cs_iface *cs_iface,
+                                   struct lp_build_tgsi_context * bld_base,
+                                   unsigned file,
+                                   LLVMValueRef index,
+                                   LLVMValueRef *size)
+{
+    swr_cs_llvm_iface *iface = (swr_cs_llvm_iface*)cs_iface;
+
+    IRB()->SetInsertPoint(unwrap(LLVMGetInsertBlock(gallivm->builder)));
+
+    if (file == TGSI_FILE_MEMORY) {
+       *size = wrap(C(iface->shared_size));
+       return wrap(LOAD(iface->pCsCtx, {0, SWR_CS_CONTEXT_pTGSM}));
+    }
+
+    Value *idx = unwrap(index);
+    *size = wrap(LOAD(GEP(iface->hPrivateData,
+                          {C(0), C(swr_draw_context_num_ssboCS), idx})));
+    return wrap(LOAD(GEP(iface->hPrivateData,
+                         {C(0), C(swr_draw_context_ssboCS), idx})));
+}
+
+PFN_CS_FUNC
+BuilderSWR::CompileCS(struct swr_context *ctx, swr_jit_cs_key &key)
+{
+   struct swr_compute_shader *cs = ctx->cs;
+   struct tgsi_shader_info *info = &cs->info.base;
+
+   unsigned num_threads = key.block[0] * key.block[1] * key.block[2];
+
+   AttrBuilder attrBuilder;
+   attrBuilder.addStackAlignmentAttr(JM()->mVWidth * sizeof(float));
+
+   std::vector<Type *> csArgs{PointerType::get(Gen_swr_draw_context(JM()), 0),
+                              PointerType::get(Gen_SWR_CS_CONTEXT(JM()), 0)};
+   FunctionType *csFuncType =
+      FunctionType::get(Type::getVoidTy(JM()->mContext), csArgs, false);
+
+   // create new compute shader function
+   auto pFunction = Function::Create(csFuncType,
+                                     GlobalValue::ExternalLinkage,
+                                     "CS",
+                                     JM()->mpCurrentModule);
+#if HAVE_LLVM < 0x0500
+   AttributeSet attrSet = AttributeSet::get(
+      JM()->mContext, AttributeSet::FunctionIndex, attrBuilder);
+   pFunction->addAttributes(AttributeSet::FunctionIndex, attrSet);
+#else
+   pFunction->addAttributes(AttributeList::FunctionIndex, attrBuilder);
+#endif
+
+   BasicBlock *block = BasicBlock::Create(JM()->mContext, "entry", pFunction);
+   IRB()->SetInsertPoint(block);
+   LLVMPositionBuilderAtEnd(gallivm->builder, wrap(block));
+
+   auto argitr = pFunction->arg_begin();
+   Value *hPrivateData = &*argitr++;
+   hPrivateData->setName("hPrivateData");
+   Value *pCsCtx = &*argitr++;
+   pCsCtx->setName("csCtx");
+
+   Value *consts_ptr =
+      GEP(hPrivateData, {C(0), C(swr_draw_context_constantCS)});
+   consts_ptr->setName("cs_constants");
+   Value *const_sizes_ptr =
+      GEP(hPrivateData, {0, swr_draw_context_num_constantsCS});
+   const_sizes_ptr->setName("num_cs_constants");
+
+   struct lp_build_sampler_soa *sampler =
+      swr_sampler_soa_create(key.sampler, PIPE_SHADER_COMPUTE);
+
+   // the core hands out linear work group ids
+   Value *groupId = LOAD(pCsCtx, {0, SWR_CS_CONTEXT_tileCounter});
+   Value *gridX = LOAD(pCsCtx, {0, SWR_CS_CONTEXT_dispatchDims, 0});
+   Value *gridY = LOAD(pCsCtx, {0, SWR_CS_CONTEXT_dispatchDims, 1});
+   Value *gridZ = LOAD(pCsCtx, {0, SWR_CS_CONTEXT_dispatchDims, 2});
+
+   struct lp_bld_tgsi_system_values system_values;
+   memset(&system_values, 0, sizeof(system_values));
+   system_values.block_id[0] = wrap(UREM(groupId, gridX));
+   system_values.block_id[1] = wrap(UREM(UDIV(groupId, gridX), gridY));
+   system_values.block_id[2] = wrap(UDIV(groupId, MUL(gridX, gridY)));
+   system_values.grid_size[0] = wrap(gridX);
+   system_values.grid_size[1] = wrap(gridY);
+   system_values.grid_size[2] = wrap(gridZ);
+   for (unsigned i = 0; i < 3; i++)
+      system_values.block_size[i] = wrap(C(key.block[i]));
+
+   struct lp_build_mask_context mask;
+   lp_build_mask_begin(&mask, gallivm,
+                       lp_type_float_vec(32, 32 * 8), wrap(VIMMED1(-1)));
+
+   struct swr_cs_llvm_iface cs_iface;
+   cs_iface.base.loop_begin = ::swr_cs_llvm_loop_begin;
+   cs_iface.base.loop_end = ::swr_cs_llvm_loop_end;
+   cs_iface.base.spill_ptr = ::swr_cs_llvm_spill_ptr;
+   cs_iface.base.fetch_thread_id = ::swr_cs_llvm_fetch_thread_id;
+   cs_iface.base.memory_ptr = ::swr_cs_llvm_memory_ptr;
+   cs_iface.info = info;
+   cs_iface.pBuilder = this;
+   cs_iface.hPrivateData = hPrivateData;
+   cs_iface.pCsCtx = pCsCtx;
+   cs_iface.mask = &mask;
+   memcpy(cs_iface.block, key.block, sizeof(cs_iface.block));
+   cs_iface.num_chunks = (num_threads + mVWidth - 1) / mVWidth;
+   cs_iface.spill_size = cs->spill_size;
+   cs_iface.shared_size = cs->pipe.req_local_mem;
+
+   lp_build_tgsi_soa(gallivm,
+                     (const struct tgsi_token *)cs->pipe.prog,
+                     lp_type_float_vec(32, 32 * 8),
+                     &mask,
+                     wrap(consts_ptr),
+                     wrap(const_sizes_ptr),
+                     &system_values,
+                     NULL, // no inputs
+                     NULL, // no outputs
+                     wrap(hPrivateData), // (sampler context)
+                     NULL, // thread data
+                     sampler,
+                     info,
+                     NULL, // geometry shader face
+                     NULL, // tessellation shader iface
+                     &cs_iface.base);
+
+   lp_build_mask_end(&mask);
+
+   sampler->destroy(sampler);
+
+   IRB()->SetInsertPoint(unwrap(LLVMGetInsertBlock(gallivm->builder)));
+
+   RET_VOID();
+
+   gallivm_verify_function(gallivm, wrap(pFunction));
+   gallivm_compile_module(gallivm);
+
+   PFN_CS_FUNC pFunc =
+      (PFN_CS_FUNC)gallivm_jit_function(gallivm, wrap(pFunction));
+
+   debug_printf("compute shader  %p\n", pFunc);
+   assert(pFunc && "Error: ComputeShader = NULL");
+
+   JM()->mIsModuleFinalized = true;
+
+   return pFunc;
+}
+
+PFN_CS_FUNC
+swr_compile_cs(struct swr_context *ctx, swr_jit_cs_key &key)
+{
+   BuilderSWR builder(
+      reinterpret_cast<JitManager *>(swr_screen(ctx->pipe.screen)->hJitMgr),
+      "CS");
+   PFN_CS_FUNC func = builder.CompileCS(ctx, key);
+
+   ctx->cs->map.insert(std::make_pair(key, make_unique<VariantCS>(builder.gallivm, func)));
+   return func;
+}
+
+void
+BuilderSWR::WriteVS(Value *pVal, Value *pVsContext, Value *pVtxOutput, unsigned slot, unsigned channel)
+{
+#if USE_SIMD16_FRONTEND
+   // interleave the simdvertex components into the dest simd16vertex
+   //   slot16offset = slot8offset * 2
+   //   comp16offset = comp8offset * 2 + alternateOffset
+
+   Value *offset = LOAD(pVsContext, { 0, SWR_VS_CONTEXT_AlternateOffset });
+   Value *pOut = GEP(pVtxOutput, { C(0), C(0), C(slot * 2), offset } );
+   STORE(pVal, pOut, {channel * 2});
+#else
+   Value *pOut = GEP(pVtxOutput, {0, 0, slot});
+   STORE(pVal, pOut, {0, channel});
+#endif
+}
+
+/*
+ * Compute the clip/cull distances of the last vertex processing stage.
+ * Distances written by the shader override the user clip planes; entries
+ * for disabled planes are left NULL.
+ */
+void
+BuilderSWR::ComputeClipDistances(struct tgsi_shader_info *info,
+                                 LLVMValueRef (*outputs)[TGSI_NUM_CHANNELS],
+                                 Value *hPrivateData, unsigned clip_mask,
+                                 Value *dist[PIPE_MAX_CLIP_PLANES])
+{
+   for (unsigned val = 0; val < PIPE_MAX_CLIP_PLANES; val++)
+      dist[val] = NULL;
+
+   if (!clip_mask && !info->culldist_writemask)
+      return;
+
+   unsigned cv = 0;
+   if (info->writes_clipvertex) {
+      cv = locate_linkage(TGSI_SEMANTIC_CLIPVERTEX, 0, info);
+   } else {
+      for (int i = 0; i < PIPE_MAX_SHADER_OUTPUTS; i++) {
+         if (info->output_semantic_name[i] == TGSI_SEMANTIC_POSITION &&
+             info->output_semantic_index[i] == 0) {
+            cv = i;
+            break;
+         }
+      }
+   }
+   LLVMValueRef cx = LLVMBuildLoad(gallivm->builder, outputs[cv][0], "");
+   LLVMValueRef cy = LLVMBuildLoad(gallivm->builder, outputs[cv][1], "");
+   LLVMValueRef cz = LLVMBuildLoad(gallivm->builder, outputs[cv][2], "");
+   LLVMValueRef cw = LLVMBuildLoad(gallivm->builder, outputs[cv][3], "");
+
+   for (unsigned val = 0; val < PIPE_MAX_CLIP_PLANES; val++) {
+      // clip distance overrides user clip planes
+      if ((info->clipdist_writemask & clip_mask & (1 << val)) ||
+          ((info->culldist_writemask << info->num_written_clipdistance) & (1 << val))) {
+         unsigned cv = locate_linkage(TGSI_SEMANTIC_CLIPDIST, val < 4 ? 0 : 1,
+                                      info);
+         dist[val] =
+            unwrap(LLVMBuildLoad(gallivm->builder, outputs[cv][val % 4], ""));
+         continue;
+      }
+
+      if (!(clip_mask & (1 << val)))
+         continue;
+
+      Value *px = LOAD(GEP(hPrivateData, {0, swr_draw_context_userClipPlanes, val, 0}));
+      Value *py = LOAD(GEP(hPrivateData, {0, swr_draw_context_userClipPlanes, val, 1}));
+      Value *pz = LOAD(GEP(hPrivateData, {0, swr_draw_context_userClipPlanes, val, 2}));
+      Value *pw = LOAD(GEP(hPrivateData, {0, swr_draw_context_userClipPlanes, val, 3}));
+      dist[val] = FADD(FMUL(unwrap(cx), VBROADCAST(px)),
+                       FADD(FMUL(unwrap(cy), VBROADCAST(py)),
+                            FADD(FMUL(unwrap(cz), VBROADCAST(pz)),
+                                 FMUL(unwrap(cw), VBROADCAST(pw)))));
+   }
+}
+
+PFN_VERTEX_FUNC
+BuilderSWR::CompileVS(struct swr_context *ctx, swr_jit_vs_key &key)
+{
+   struct swr_vertex_shader *swr_vs = ctx->vs;
+
+   LLVMValueRef inputs[PIPE_MAX_SHADER_INPUTS][TGSI_NUM_CHANNELS];
+   LLVMValueRef outputs[PIPE_MAX_SHADER_OUTPUTS][TGSI_NUM_CHANNELS];
+
+   memset(outputs, 0, sizeof(outputs));
+
+   AttrBuilder attrBuilder;
+   attrBuilder.addStackAlignmentAttr(JM()->mVWidth * sizeof(float));
+
+   std::vector<Type *> vsArgs{PointerType::get(Gen_swr_draw_context(JM()), 0),
+                              PointerType::get(Gen_SWR_VS_CONTEXT(JM()), 0)};
+   FunctionType *vsFuncType =
+      FunctionType::get(Type::getVoidTy(JM()->mContext), vsArgs, false);
+
+   // create new vertex shader function
+   auto pFunction = Function::Create(vsFuncType,
+                                     GlobalValue::ExternalLinkage,
+                                     "VS",
+                                     JM()->mpCurrentModule);
+#if HAVE_LLVM < 0x0500
+   AttributeSet attrSet = AttributeSet::get(
+      JM()->mContext, AttributeSet::FunctionIndex, attrBuilder);
+   pFunction->addAttributes(AttributeSet::FunctionIndex, attrSet);
+#else
+   pFunction->addAttributes(AttributeList::FunctionIndex, attrBuilder);
+#endif
+
+   BasicBlock *block = BasicBlock::Create(JM()->mContext, "entry", pFunction);
+   IRB()->SetInsertPoint(block);
+   LLVMPositionBuilderAtEnd(gallivm->builder, wrap(block));
+
+   auto argitr = pFunction->arg_begin();
+   Value *hPrivateData = &*argitr++;
+   hPrivateData->setName("hPrivateData");
+   Value *pVsCtx = &*argitr++;
+   pVsCtx->setName("vsCtx");
+   
+   Value *consts_ptr = GEP(hPrivateData, {C(0), C(swr_draw_context_constantVS)});
+
+   consts_ptr->setName("vs_constants");
+   Value *const_sizes_ptr =
+      GEP(hPrivateData, {0, swr_draw_context_num_constantsVS});
+   const_sizes_ptr->setName("num_vs_constants");
+
+   Value *vtxInput = LOAD(pVsCtx, {0, SWR_VS_CONTEXT_pVin});
+
+   for (uint32_t attrib = 0; attrib < PIPE_MAX_SHADER_INPUTS; attrib++) {
+      const unsigned mask = swr_vs->info.base.input_usage_mask[attrib];
+      for (uint32_t channel = 0; channel < TGSI_NUM_CHANNELS; channel++) {
+         if (mask & (1 << channel)) {
+            inputs[attrib][channel] =
+               wrap(LOAD(vtxInput, {0, 0, attrib, channel}));
+         }
+      }
+   }
+
+   struct lp_build_sampler_soa *sampler =
+      swr_sampler_soa_create(key.sampler, PIPE_SHADER_VERTEX);
+
+   struct lp_bld_tgsi_system_values system_values;
+   memset(&system_values, 0, sizeof(system_values));
+   system_values.instance_id = wrap(LOAD(pVsCtx, {0, SWR_VS_CONTEXT_InstanceID}));
+   system_values.vertex_id = wrap(LOAD(pVsCtx, {0, SWR_VS_CONTEXT_VertexID}));
+
+   lp_build_tgsi_soa(gallivm,
+                     swr_vs->pipe.tokens,
+                     lp_type_float_vec(32, 32 * 8),
+                     NULL, // mask
+                     wrap(consts_ptr),
+                     wrap(const_sizes_ptr),
+                     &system_values,
+                     inputs,
+                     outputs,
+                     wrap(hPrivateData), // (sampler context)
+                     NULL, // thread data
+                     sampler, // sampler
+                     &swr_vs->info.base,
+                     NULL, // geometry shader face
+                     NULL, // tessellation shader iface
+                     NULL); // compute shader iface
+
+   sampler->destroy(sampler);
+
+   IRB()->SetInsertPoint(unwrap(LLVMGetInsertBlock(gallivm->builder)));
+
+   Value *vtxOutput = LOAD(pVsCtx, {0, SWR_VS_CONTEXT_pVout});
+
+   for (uint32_t channel = 0; channel < TGSI_NUM_CHANNELS; channel++) {
+      for (uint32_t attrib = 0; attrib < PIPE_MAX_SHADER_OUTPUTS; attrib++) {
+         if (!outputs[attrib][channel])
+            continue;
+
+         Value *val;
+         uint32_t outSlot;
+
+         if (swr_vs->info.base.output_semantic_name[attrib] == TGSI_SEMANTIC_PSIZE) {
+            if (channel != VERTEX_SGV_POINT_SIZE_COMP)
+               continue;
+            val = LOAD(unwrap(outputs[attrib][0]));
+            outSlot = VERTEX_SGV_SLOT;
+         } else if (swr_vs->info.base.output_semantic_name[attrib] == TGSI_SEMANTIC_POSITION) {
+            val = LOAD(unwrap(outputs[attrib][channel]));
+            outSlot = VERTEX_POSITION_SLOT;
+         } else {
+            val = LOAD(unwrap(outputs[attrib][channel]));
+            outSlot = VERTEX_ATTRIB_START_SLOT + attrib;
+            if (swr_vs->info.base.output_semantic_name[0] == TGSI_SEMANTIC_POSITION)
+               outSlot--;
+         }
+
+         WriteVS(val, pVsCtx, vtxOutput, outSlot, channel);
+      }
+   }
+
+   Value *dist[PIPE_MAX_CLIP_PLANES];
+   ComputeClipDistances(&swr_vs->info.base, outputs, hPrivateData,
+                        ctx->rasterizer->clip_plane_enable, dist);
+
+   for (unsigned val = 0; val < PIPE_MAX_CLIP_PLANES; val++) {
+      if (!dist[val])
+         continue;
+
+      if (val < 4)
+         WriteVS(dist[val], pVsCtx, vtxOutput, VERTEX_CLIPCULL_DIST_LO_SLOT, val);
+      else
+         WriteVS(dist[val], pVsCtx, vtxOutput, VERTEX_CLIPCULL_DIST_HI_SLOT, val - 4);
    }
 
    RET_VOID();
@@ -961,6 +2370,8 @@ BuilderSWR::CompileFS(struct swr_context *ctx, swr_jit_fs_key &key)
    struct tgsi_shader_info *pPrevShader;
    if (ctx->gs)
       pPrevShader = &ctx->gs->info.base;
+   else if (ctx->tes)
+      pPrevShader = &ctx->tes->info.base;
    else
       pPrevShader = &ctx->vs->info.base;
 
@@ -1261,7 +2672,9 @@ BuilderSWR::CompileFS(struct swr_context *ctx, swr_jit_fs_key &key)
                      NULL, // thread data
                      sampler, // sampler
                      &swr_fs->info.base,
-                     NULL); // geometry shader face
+                     NULL, // geometry shader face
+                     NULL, // tessellation shader iface
+                     NULL); // compute shader iface
 
    sampler->destroy(sampler);
 
@@ -26,9 +26,15 @@
 struct swr_vertex_shader;
 struct swr_fragment_shader;
 struct swr_geometry_shader;
+struct swr_tess_control_shader;
+struct swr_tess_evaluation_shader;
+struct swr_compute_shader;
 struct swr_jit_fs_key;
 struct swr_jit_vs_key;
 struct swr_jit_gs_key;
+struct swr_jit_tcs_key;
+struct swr_jit_tes_key;
+struct swr_jit_cs_key;
 
 unsigned swr_so_adjust_attrib(unsigned in_attrib,
                               swr_vertex_shader *swr_vs);
@@ -42,6 +48,17 @@ swr_compile_fs(struct swr_context *ctx, swr_jit_fs_key &key);
 PFN_GS_FUNC
 swr_compile_gs(struct swr_context *ctx, swr_jit_gs_key &key);
 
+PFN_HS_FUNC
+swr_compile_tcs(struct swr_context *ctx, swr_jit_tcs_key &key);
+
+PFN_DS_FUNC
+swr_compile_tes(struct swr_context *ctx, swr_jit_tes_key &key);
+
+PFN_CS_FUNC
+swr_compile_cs(struct swr_context *ctx, swr_jit_cs_key &key);
+
+void swr_passthrough_tcs(HANDLE hPrivateData, SWR_HS_CONTEXT *pHsContext);
+
 void swr_generate_fs_key(struct swr_jit_fs_key &key,
                          struct swr_context *ctx,
                          swr_fragment_shader *swr_fs);
@@ -57,6 +74,19 @@ void swr_generate_gs_key(struct swr_jit_gs_key &key,
                          struct swr_context *ctx,
                          swr_geometry_shader *swr_gs);
 
+void swr_generate_tcs_key(struct swr_jit_tcs_key &key,
+                          struct swr_context *ctx,
+                          swr_tess_control_shader *swr_tcs);
+
+void swr_generate_tes_key(struct swr_jit_tes_key &key,
+                          struct swr_context *ctx,
+                          swr_tess_evaluation_shader *swr_tes);
+
+void swr_generate_cs_key(struct swr_jit_cs_key &key,
+                         struct swr_context *ctx,
+                         swr_compute_shader *swr_cs,
+                         const unsigned block[3]);
+
 struct swr_jit_sampler_key {
    unsigned nr_samplers;
    unsigned nr_sampler_views;
@@ -85,6 +115,23 @@ struct swr_jit_gs_key : swr_jit_sampler_key {
    ubyte vs_output_semantic_idx[PIPE_MAX_SHADER_OUTPUTS];
 };
 
+struct swr_jit_tcs_key : swr_jit_sampler_key {
+   ubyte vs_output_semantic_name[PIPE_MAX_SHADER_OUTPUTS];
+   ubyte vs_output_semantic_idx[PIPE_MAX_SHADER_OUTPUTS];
+   unsigned tes_prim_mode; // isolines store their outer levels swapped
+};
+
+struct swr_jit_tes_key : swr_jit_sampler_key {
+   ubyte prev_output_semantic_name[PIPE_MAX_SHADER_OUTPUTS];
+   ubyte prev_output_semantic_idx[PIPE_MAX_SHADER_OUTPUTS];
+   unsigned tcs_vertices_out; // 0 when no control shader is bound
+   unsigned clip_plane_mask;
+};
+
+struct swr_jit_cs_key : swr_jit_sampler_key {
+   unsigned block[3]; // work group size, baked into the chunk loop
+};
+
 namespace std
 {
 template <> struct hash<swr_jit_fs_key> {
@@ -114,9 +161,33 @@ template <> struct hash<swr_jit_gs_key> {
       return util_hash_crc32(&k, sizeof(k));
    }
 };
+
+template <> struct hash<swr_jit_tcs_key> {
+   std::size_t operator()(const swr_jit_tcs_key &k) const
+   {
+      return util_hash_crc32(&k, sizeof(k));
+   }
+};
+
+template <> struct hash<swr_jit_tes_key> {
+   std::size_t operator()(const swr_jit_tes_key &k) const
+   {
+      return util_hash_crc32(&k, sizeof(k));
+   }
+};
+
+template <> struct hash<swr_jit_cs_key> {
+   std::size_t operator()(const swr_jit_cs_key &k) const
+   {
+      return util_hash_crc32(&k, sizeof(k));
+   }
+};
 };
 
 bool operator==(const swr_jit_fs_key &lhs, const swr_jit_fs_key &rhs);
 bool operator==(const swr_jit_vs_key &lhs, const swr_jit_vs_key &rhs);
 bool operator==(const swr_jit_fetch_key &lhs, const swr_jit_fetch_key &rhs);
 bool operator==(const swr_jit_gs_key &lhs, const swr_jit_gs_key &rhs);
+bool operator==(const swr_jit_tcs_key &lhs, const swr_jit_tcs_key &rhs);
+bool operator==(const swr_jit_tes_key &lhs, const swr_jit_tes_key &rhs);
+bool operator==(const swr_jit_cs_key &lhs, const swr_jit_cs_key &rhs);
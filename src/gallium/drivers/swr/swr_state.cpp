@@ -460,6 +460,173 @@ swr_delete_gs_state(struct pipe_context *pipe, void *gs)
    swr_fence_work_delete_gs(screen->flush_fence, swr_gs);
 }
 
+static void *
+swr_create_tcs_state(struct pipe_context *pipe,
+                     const struct pipe_shader_state *tcs)
+{
+   struct swr_tess_control_shader *swr_tcs = new swr_tess_control_shader;
+   if (!swr_tcs)
+      return NULL;
+
+   swr_tcs->pipe.tokens = tgsi_dup_tokens(tcs->tokens);
+
+   lp_build_tgsi_info(tcs->tokens, &swr_tcs->info);
+
+   return swr_tcs;
+}
+
+static void
+swr_bind_tcs_state(struct pipe_context *pipe, void *tcs)
+{
+   struct swr_context *ctx = swr_context(pipe);
+
+   if (ctx->tcs == tcs)
+      return;
+
+   ctx->tcs = (swr_tess_control_shader *)tcs;
+   ctx->dirty |= SWR_NEW_TCS;
+}
+
+static void
+swr_delete_tcs_state(struct pipe_context *pipe, void *tcs)
+{
+   struct swr_tess_control_shader *swr_tcs = (swr_tess_control_shader *)tcs;
+   FREE((void *)swr_tcs->pipe.tokens);
+   struct swr_screen *screen = swr_screen(pipe->screen);
+
+   /* Defer deletion of tcs state */
+   swr_fence_work_delete_tcs(screen->flush_fence, swr_tcs);
+}
+
+static void *
+swr_create_tes_state(struct pipe_context *pipe,
+                     const struct pipe_shader_state *tes)
+{
+   struct swr_tess_evaluation_shader *swr_tes = new swr_tess_evaluation_shader;
+   if (!swr_tes)
+      return NULL;
+
+   swr_tes->pipe.tokens = tgsi_dup_tokens(tes->tokens);
+
+   lp_build_tgsi_info(tes->tokens, &swr_tes->info);
+
+   return swr_tes;
+}
+
+static void
+swr_bind_tes_state(struct pipe_context *pipe, void *tes)
+{
+   struct swr_context *ctx = swr_context(pipe);
+
+   if (ctx->tes == tes)
+      return;
+
+   ctx->tes = (swr_tess_evaluation_shader *)tes;
+   ctx->dirty |= SWR_NEW_TES;
+}
+
+static void
+swr_delete_tes_state(struct pipe_context *pipe, void *tes)
+{
+   struct swr_tess_evaluation_shader *swr_tes = (swr_tess_evaluation_shader *)tes;
+   FREE((void *)swr_tes->pipe.tokens);
+   struct swr_screen *screen = swr_screen(pipe->screen);
+
+   /* Defer deletion of tes state */
+   swr_fence_work_delete_tes(screen->flush_fence, swr_tes);
+}
+
+static void *
+swr_create_compute_state(struct pipe_context *pipe,
+                         const struct pipe_compute_state *cs)
+{
+   if (cs->ir_type != PIPE_SHADER_IR_TGSI)
+      return NULL;
+
+   /* Failing is better than running without the barrier */
+   if (!lp_build_tgsi_soa_barriers_supported(
+          (const struct tgsi_token *)cs->prog)) {
+      debug_printf("swr: compute shader with BARRIER in control flow\n");
+      return NULL;
+   }
+
+   struct swr_compute_shader *swr_cs = new swr_compute_shader;
+   if (!swr_cs)
+      return NULL;
+
+   swr_cs->pipe = *cs;
+   swr_cs->pipe.prog = tgsi_dup_tokens((const struct tgsi_token *)cs->prog);
+
+   lp_build_tgsi_info((const struct tgsi_token *)cs->prog, &swr_cs->info);
+
+   /* registers only need to be carried across barriers */
+   swr_cs->spill_size =
+      swr_cs->info.base.opcode_count[TGSI_OPCODE_BARRIER] ?
+      lp_build_tgsi_soa_spill_size(&swr_cs->info.base,
+                                   lp_type_float_vec(32, 32 * 8)) : 0;
+
+   return swr_cs;
+}
+
+static void
+swr_bind_compute_state(struct pipe_context *pipe, void *cs)
+{
+   struct swr_context *ctx = swr_context(pipe);
+
+   ctx->cs = (swr_compute_shader *)cs;
+}
+
+static void
+swr_delete_compute_state(struct pipe_context *pipe, void *cs)
+{
+   struct swr_compute_shader *swr_cs = (swr_compute_shader *)cs;
+   FREE((void *)swr_cs->pipe.prog);
+   struct swr_screen *screen = swr_screen(pipe->screen);
+
+   /* Defer deletion of cs state */
+   swr_fence_work_delete_cs(screen->flush_fence, swr_cs);
+}
+
+static void
+swr_set_shader_buffers(struct pipe_context *pipe,
+                       enum pipe_shader_type shader,
+                       unsigned start_slot, unsigned count,
+                       const struct pipe_shader_buffer *buffers)
+{
+   struct swr_context *ctx = swr_context(pipe);
+
+   assert(shader < PIPE_SHADER_TYPES);
+   assert(start_slot + count <= ARRAY_SIZE(ctx->ssbos[shader]));
+
+   for (unsigned i = 0; i < count; i++) {
+      struct pipe_shader_buffer *dst = &ctx->ssbos[shader][start_slot + i];
+
+      if (buffers) {
+         pipe_resource_reference(&dst->buffer, buffers[i].buffer);
+         dst->buffer_offset = buffers[i].buffer_offset;
+         dst->buffer_size = buffers[i].buffer_size;
+      } else {
+         pipe_resource_reference(&dst->buffer, NULL);
+         dst->buffer_offset = 0;
+         dst->buffer_size = 0;
+      }
+   }
+}
+
+static void
+swr_set_tess_state(struct pipe_context *pipe,
+                   const float default_outer_level[4],
+                   const float default_inner_level[2])
+{
+   struct swr_context *ctx = swr_context(pipe);
+
+   memcpy(ctx->default_outer_level, default_outer_level,
+          sizeof(ctx->default_outer_level));
+   memcpy(ctx->default_inner_level, default_inner_level,
+          sizeof(ctx->default_inner_level));
+   ctx->dirty |= SWR_NEW_TS;
+}
+
 static void
 swr_set_constant_buffer(struct pipe_context *pipe,
                         enum pipe_shader_type shader,
@@ -481,6 +648,10 @@ swr_set_constant_buffer(struct pipe_context *pipe,
       ctx->dirty |= SWR_NEW_FSCONSTANTS;
    } else if (shader == PIPE_SHADER_GEOMETRY) {
       ctx->dirty |= SWR_NEW_GSCONSTANTS;
+   } else if (shader == PIPE_SHADER_TESS_CTRL) {
+      ctx->dirty |= SWR_NEW_TCSCONSTANTS;
+   } else if (shader == PIPE_SHADER_TESS_EVAL) {
+      ctx->dirty |= SWR_NEW_TESCONSTANTS;
    }
 
    if (cb && cb->user_buffer) {
@@ -868,6 +1039,21 @@ swr_update_constants(struct swr_context *ctx, enum pipe_shader_type shaderType)
       num_constants = pDC->num_constantsGS;
       scratch = &ctx->scratch->gs_constants;
       break;
+   case PIPE_SHADER_TESS_CTRL:
+      constant = pDC->constantTCS;
+      num_constants = pDC->num_constantsTCS;
+      scratch = &ctx->scratch->tcs_constants;
+      break;
+   case PIPE_SHADER_TESS_EVAL:
+      constant = pDC->constantTES;
+      num_constants = pDC->num_constantsTES;
+      scratch = &ctx->scratch->tes_constants;
+      break;
+   case PIPE_SHADER_COMPUTE:
+      constant = pDC->constantCS;
+      num_constants = pDC->num_constantsCS;
+      scratch = &ctx->scratch->cs_constants;
+      break;
    default:
       debug_printf("Unsupported shader type constants\n");
       return;
@@ -1342,9 +1528,155 @@ swr_update_derived(struct pipe_context *pipe,
       }
    }
 
+   /* Tessellation */
+   if (p_draw_info)
+      ctx->swrDC.patchVertices = p_draw_info->vertices_per_patch;
+
+   if (ctx->dirty & (SWR_NEW_TCS |
+                     SWR_NEW_TES |
+                     SWR_NEW_VS |
+                     SWR_NEW_TS |
+                     SWR_NEW_RASTERIZER | // for clip planes
+                     SWR_NEW_SAMPLER |
+                     SWR_NEW_SAMPLER_VIEW |
+                     SWR_NEW_FRAMEBUFFER)) {
+      if (ctx->tes) {
+         struct tgsi_shader_info *tes_info = &ctx->tes->info.base;
+         bool isolines =
+            tes_info->properties[TGSI_PROPERTY_TES_PRIM_MODE] == PIPE_PRIM_LINES;
+
+         if (ctx->tcs) {
+            swr_jit_tcs_key key;
+            swr_generate_tcs_key(key, ctx, ctx->tcs);
+            auto search = ctx->tcs->map.find(key);
+            PFN_HS_FUNC func;
+            if (search != ctx->tcs->map.end()) {
+               func = search->second->shader;
+            } else {
+               func = swr_compile_tcs(ctx, key);
+            }
+            ctx->api.pfnSwrSetHsFunc(ctx->swrContext, func);
+
+            /* JIT sampler state */
+            if (ctx->dirty & SWR_NEW_SAMPLER) {
+               swr_update_sampler_state(ctx,
+                                        PIPE_SHADER_TESS_CTRL,
+                                        key.nr_samplers,
+                                        ctx->swrDC.samplersTCS);
+            }
+
+            /* JIT sampler view state */
+            if (ctx->dirty & (SWR_NEW_SAMPLER_VIEW | SWR_NEW_FRAMEBUFFER)) {
+               swr_update_texture_state(ctx,
+                                        PIPE_SHADER_TESS_CTRL,
+                                        key.nr_sampler_views,
+                                        ctx->swrDC.texturesTCS);
+            }
+         } else {
+            ctx->api.pfnSwrSetHsFunc(ctx->swrContext, swr_passthrough_tcs);
+         }
+
+         swr_jit_tes_key key;
+         swr_generate_tes_key(key, ctx, ctx->tes);
+         auto search = ctx->tes->map.find(key);
+         PFN_DS_FUNC func;
+         if (search != ctx->tes->map.end()) {
+            func = search->second->shader;
+         } else {
+            func = swr_compile_tes(ctx, key);
+         }
+         ctx->api.pfnSwrSetDsFunc(ctx->swrContext, func);
+
+         /* JIT sampler state */
+         if (ctx->dirty & SWR_NEW_SAMPLER) {
+            swr_update_sampler_state(ctx,
+                                     PIPE_SHADER_TESS_EVAL,
+                                     key.nr_samplers,
+                                     ctx->swrDC.samplersTES);
+         }
+
+         /* JIT sampler view state */
+         if (ctx->dirty & (SWR_NEW_SAMPLER_VIEW | SWR_NEW_FRAMEBUFFER)) {
+            swr_update_texture_state(ctx,
+                                     PIPE_SHADER_TESS_EVAL,
+                                     key.nr_sampler_views,
+                                     ctx->swrDC.texturesTES);
+         }
+
+         /* Default levels, in swr factor order (isoline detail first) */
+         memcpy(ctx->swrDC.tessLevelOuter, ctx->default_outer_level,
+                sizeof(ctx->swrDC.tessLevelOuter));
+         memcpy(ctx->swrDC.tessLevelInner, ctx->default_inner_level,
+                sizeof(ctx->swrDC.tessLevelInner));
+         if (isolines)
+            std::swap(ctx->swrDC.tessLevelOuter[0],
+                      ctx->swrDC.tessLevelOuter[1]);
+
+         SWR_TS_STATE *tsState = &ctx->tes->tsState;
+         memset(tsState, 0, sizeof(*tsState));
+         tsState->tsEnable = true;
+
+         switch (tes_info->properties[TGSI_PROPERTY_TES_PRIM_MODE]) {
+         case PIPE_PRIM_LINES:
+            tsState->domain = SWR_TS_ISOLINE;
+            tsState->tsOutputTopology = SWR_TS_OUTPUT_LINE;
+            tsState->postDSTopology = TOP_LINE_LIST;
+            break;
+         case PIPE_PRIM_QUADS:
+            tsState->domain = SWR_TS_QUAD;
+            break;
+         default:
+            tsState->domain = SWR_TS_TRI;
+            break;
+         }
+         if (tsState->domain != SWR_TS_ISOLINE) {
+            tsState->tsOutputTopology =
+               tes_info->properties[TGSI_PROPERTY_TES_VERTEX_ORDER_CW] ?
+               SWR_TS_OUTPUT_TRI_CW : SWR_TS_OUTPUT_TRI_CCW;
+            tsState->postDSTopology = TOP_TRIANGLE_LIST;
+         }
+         if (tes_info->properties[TGSI_PROPERTY_TES_POINT_MODE]) {
+            tsState->tsOutputTopology = SWR_TS_OUTPUT_POINT;
+            tsState->postDSTopology = TOP_POINT_LIST;
+         }
+
+         switch (tes_info->properties[TGSI_PROPERTY_TES_SPACING]) {
+         case PIPE_TESS_SPACING_FRACTIONAL_ODD:
+            tsState->partitioning = SWR_TS_ODD_FRACTIONAL;
+            break;
+         case PIPE_TESS_SPACING_FRACTIONAL_EVEN:
+            tsState->partitioning = SWR_TS_EVEN_FRACTIONAL;
+            break;
+         default:
+            tsState->partitioning = SWR_TS_INTEGER;
+            break;
+         }
+
+         /* VS slots from the position on are handed to the control stage */
+         tsState->vertexAttribOffset = VERTEX_POSITION_SLOT;
+         tsState->numHsInputAttribs =
+            MIN2(ctx->vs->info.base.num_outputs + 2,
+                 SWR_VTX_NUM_SLOTS - VERTEX_ATTRIB_START_SLOT);
+         tsState->numHsOutputAttribs = ctx->tcs ?
+            ctx->tcs->info.base.num_outputs : tsState->numHsInputAttribs;
+         tsState->numDsOutputAttribs =
+            MIN2(VERTEX_ATTRIB_START_SLOT + tes_info->num_outputs + 2,
+                 SWR_VTX_NUM_SLOTS);
+         ctx->swrDC.numPatchAttribs = tsState->numHsInputAttribs;
+
+         ctx->api.pfnSwrSetTsState(ctx->swrContext, tsState);
+      } else {
+         SWR_TS_STATE state = { 0 };
+         ctx->api.pfnSwrSetTsState(ctx->swrContext, &state);
+         ctx->api.pfnSwrSetHsFunc(ctx->swrContext, NULL);
+         ctx->api.pfnSwrSetDsFunc(ctx->swrContext, NULL);
+      }
+   }
+
    /* GeometryShader */
    if (ctx->dirty & (SWR_NEW_GS |
                      SWR_NEW_VS |
+                     SWR_NEW_TES |
                      SWR_NEW_SAMPLER |
                      SWR_NEW_SAMPLER_VIEW)) {
       if (ctx->gs) {
@@ -1434,6 +1766,7 @@ swr_update_derived(struct pipe_context *pipe,
    if (ctx->dirty & (SWR_NEW_FS |
                      SWR_NEW_VS |
                      SWR_NEW_GS |
+                     SWR_NEW_TES |
                      SWR_NEW_RASTERIZER |
                      SWR_NEW_SAMPLER |
                      SWR_NEW_SAMPLER_VIEW |
@@ -1524,6 +1857,15 @@ swr_update_derived(struct pipe_context *pipe,
       swr_update_constants(ctx, PIPE_SHADER_GEOMETRY);
    }
 
+   /* Tessellation Shader Constants */
+   if (ctx->dirty & SWR_NEW_TCSCONSTANTS) {
+      swr_update_constants(ctx, PIPE_SHADER_TESS_CTRL);
+   }
+
+   if (ctx->dirty & SWR_NEW_TESCONSTANTS) {
+      swr_update_constants(ctx, PIPE_SHADER_TESS_EVAL);
+   }
+
    /* Depth/stencil state */
    if (ctx->dirty & (SWR_NEW_DEPTH_STENCIL_ALPHA | SWR_NEW_FRAMEBUFFER)) {
       struct pipe_depth_state *depth = &(ctx->depth_stencil->depth);
@@ -1710,10 +2052,17 @@ swr_update_derived(struct pipe_context *pipe,
       }
    }
 
-   if (ctx->dirty & (SWR_NEW_CLIP | SWR_NEW_RASTERIZER | SWR_NEW_VS)) {
+   /* Clip distances come from the last stage before the GS */
+   struct tgsi_shader_info *pClipFE =
+      ctx->tes ?
+      &ctx->tes->info.base :
+      &ctx->vs->info.base;
+
+   if (ctx->dirty & (SWR_NEW_CLIP | SWR_NEW_RASTERIZER | SWR_NEW_VS |
+                     SWR_NEW_TES)) {
       // shader exporting clip distances overrides all user clip planes
       if (ctx->rasterizer->clip_plane_enable &&
-          !ctx->vs->info.base.num_written_clipdistance)
+          !pClipFE->num_written_clipdistance)
       {
          swr_draw_context *pDC = &ctx->swrDC;
          memcpy(pDC->userClipPlanes,
@@ -1727,16 +2076,16 @@ swr_update_derived(struct pipe_context *pipe,
    if (ctx->gs) {
       backendState.numAttributes = ctx->gs->info.base.num_outputs - 1;
    } else {
-      backendState.numAttributes = ctx->vs->info.base.num_outputs - 1;
+      backendState.numAttributes = pClipFE->num_outputs - 1;
       if (ctx->fs->info.base.uses_primid) {
          backendState.numAttributes++;
          backendState.swizzleEnable = true;
          for (unsigned i = 0; i < sizeof(backendState.numComponents); i++) {
             backendState.swizzleMap[i].sourceAttrib = i;
          }
-         backendState.swizzleMap[ctx->vs->info.base.num_outputs - 1].constantSource =
+         backendState.swizzleMap[pClipFE->num_outputs - 1].constantSource =
             SWR_CONSTANT_SOURCE_PRIM_ID;
-         backendState.swizzleMap[ctx->vs->info.base.num_outputs - 1].componentOverrideMask = 1;
+         backendState.swizzleMap[pClipFE->num_outputs - 1].componentOverrideMask = 1;
       }
    }
    if (ctx->rasterizer->sprite_coord_enable)
@@ -1753,18 +2102,18 @@ swr_update_derived(struct pipe_context *pipe,
    struct tgsi_shader_info *pLastFE =
       ctx->gs ?
       &ctx->gs->info.base :
-      &ctx->vs->info.base;
+      pClipFE;
    backendState.readRenderTargetArrayIndex = pLastFE->writes_layer;
    backendState.readViewportArrayIndex = pLastFE->writes_viewport_index;
    backendState.vertexAttribOffset = VERTEX_ATTRIB_START_SLOT; // TODO: optimize
 
    backendState.clipDistanceMask =
-      ctx->vs->info.base.num_written_clipdistance ?
-      ctx->vs->info.base.clipdist_writemask & ctx->rasterizer->clip_plane_enable :
+      pClipFE->num_written_clipdistance ?
+      pClipFE->clipdist_writemask & ctx->rasterizer->clip_plane_enable :
       ctx->rasterizer->clip_plane_enable;
 
    backendState.cullDistanceMask =
-      ctx->vs->info.base.culldist_writemask << ctx->vs->info.base.num_written_clipdistance;
+      pClipFE->culldist_writemask << pClipFE->num_written_clipdistance;
 
    // Assume old layout of SGV, POSITION, CLIPCULL, ATTRIB
    backendState.vertexClipCullOffset = backendState.vertexAttribOffset - 2;
@@ -1838,6 +2187,64 @@ swr_set_so_targets(struct pipe_context *pipe,
 }
 
 
+/*
+ * Compute has no dirty tracking of its own: swr_update_derived() clears
+ * all dirty bits on every draw, so everything the compute shader reads is
+ * re-derived on each launch.
+ */
+void
+swr_update_compute_state(struct swr_context *ctx,
+                         const struct pipe_grid_info *info)
+{
+   struct swr_draw_context *pDC = &ctx->swrDC;
+
+   swr_jit_cs_key key;
+   swr_generate_cs_key(key, ctx, ctx->cs, info->block);
+   auto search = ctx->cs->map.find(key);
+   PFN_CS_FUNC func;
+   if (search != ctx->cs->map.end()) {
+      func = search->second->shader;
+   } else {
+      func = swr_compile_cs(ctx, key);
+   }
+
+   unsigned num_threads = info->block[0] * info->block[1] * info->block[2];
+   unsigned num_chunks = (num_threads + KNOB_SIMD_WIDTH - 1) / KNOB_SIMD_WIDTH;
+   ctx->api.pfnSwrSetCsFunc(ctx->swrContext, func, num_threads,
+                            num_chunks * ctx->cs->spill_size, 0, 0);
+
+   swr_update_constants(ctx, PIPE_SHADER_COMPUTE);
+   swr_update_sampler_state(ctx, PIPE_SHADER_COMPUTE,
+                            key.nr_samplers, pDC->samplersCS);
+   swr_update_texture_state(ctx, PIPE_SHADER_COMPUTE,
+                            key.nr_sampler_views, pDC->texturesCS);
+
+   for (unsigned i = 0; i < PIPE_MAX_SHADER_BUFFERS; i++) {
+      struct pipe_shader_buffer *sb = &ctx->ssbos[PIPE_SHADER_COMPUTE][i];
+      if (sb->buffer) {
+         pDC->ssboCS[i] = swr_resource_data(sb->buffer) + sb->buffer_offset;
+         pDC->num_ssboCS[i] = sb->buffer_size;
+         swr_resource_write(sb->buffer);
+      } else {
+         pDC->ssboCS[i] = NULL;
+         pDC->num_ssboCS[i] = 0;
+      }
+   }
+
+   for (unsigned i = 0; i < ctx->num_sampler_views[PIPE_SHADER_COMPUTE]; i++) {
+      struct pipe_sampler_view *view = ctx->sampler_views[PIPE_SHADER_COMPUTE][i];
+      if (view)
+         swr_resource_read(view->texture);
+   }
+
+   for (unsigned i = 0; i < PIPE_MAX_CONSTANT_BUFFERS; i++) {
+      struct pipe_constant_buffer *cb = &ctx->constants[PIPE_SHADER_COMPUTE][i];
+      if (cb->buffer)
+         swr_resource_read(cb->buffer);
+   }
+}
+
+
 void
 swr_state_init(struct pipe_context *pipe)
 {
@@ -1873,6 +2280,22 @@ swr_state_init(struct pipe_context *pipe)
    pipe->bind_gs_state = swr_bind_gs_state;
    pipe->delete_gs_state = swr_delete_gs_state;
 
+   pipe->create_tcs_state = swr_create_tcs_state;
+   pipe->bind_tcs_state = swr_bind_tcs_state;
+   pipe->delete_tcs_state = swr_delete_tcs_state;
+
+   pipe->create_tes_state = swr_create_tes_state;
+   pipe->bind_tes_state = swr_bind_tes_state;
+   pipe->delete_tes_state = swr_delete_tes_state;
+
+   pipe->set_tess_state = swr_set_tess_state;
+
+   pipe->create_compute_state = swr_create_compute_state;
+   pipe->bind_compute_state = swr_bind_compute_state;
+   pipe->delete_compute_state = swr_delete_compute_state;
+
+   pipe->set_shader_buffers = swr_set_shader_buffers;
+
    pipe->set_constant_buffer = swr_set_constant_buffer;
 
    pipe->create_vertex_elements_state = swr_create_vertex_elements_state;
@@ -49,6 +49,9 @@ struct ShaderVariant {
 typedef ShaderVariant<PFN_VERTEX_FUNC> VariantVS;
 typedef ShaderVariant<PFN_PIXEL_KERNEL> VariantFS;
 typedef ShaderVariant<PFN_GS_FUNC> VariantGS;
+typedef ShaderVariant<PFN_HS_FUNC> VariantTCS;
+typedef ShaderVariant<PFN_DS_FUNC> VariantTES;
+typedef ShaderVariant<PFN_CS_FUNC> VariantCS;
 
 /* skeleton */
 struct swr_vertex_shader {
@@ -76,6 +79,29 @@ struct swr_geometry_shader {
    std::unordered_map<swr_jit_gs_key, std::unique_ptr<VariantGS>> map;
 };
 
+struct swr_tess_control_shader {
+   struct pipe_shader_state pipe;
+   struct lp_tgsi_info info;
+
+   std::unordered_map<swr_jit_tcs_key, std::unique_ptr<VariantTCS>> map;
+};
+
+struct swr_tess_evaluation_shader {
+   struct pipe_shader_state pipe;
+   struct lp_tgsi_info info;
+   SWR_TS_STATE tsState;
+
+   std::unordered_map<swr_jit_tes_key, std::unique_ptr<VariantTES>> map;
+};
+
+struct swr_compute_shader {
+   struct pipe_compute_state pipe;
+   struct lp_tgsi_info info;
+   unsigned spill_size; // per SIMD chunk of invocations
+
+   std::unordered_map<swr_jit_cs_key, std::unique_ptr<VariantCS>> map;
+};
+
 /* Vertex element state */
 struct swr_vertex_element_state {
    FETCH_COMPILE_STATE fsState;
@@ -110,6 +136,9 @@ struct swr_derived_state {
 void swr_update_derived(struct pipe_context *,
                         const struct pipe_draw_info * = nullptr);
 
+void swr_update_compute_state(struct swr_context *ctx,
+                              const struct pipe_grid_info *info);
+
 /*
  * Conversion functions: Convert mesa state defines to SWR.
  */
@@ -340,7 +369,8 @@ swr_convert_target_type(const enum pipe_texture_target target)
  * Convert mesa PIPE_PRIM_X to SWR enum PRIMITIVE_TOPOLOGY
  */
 static INLINE enum PRIMITIVE_TOPOLOGY
-swr_convert_prim_topology(const unsigned mode)
+swr_convert_prim_topology(const unsigned mode,
+                          const unsigned vertices_per_patch = 0)
 {
    switch (mode) {
    case PIPE_PRIM_POINTS:
@@ -371,6 +401,10 @@ swr_convert_prim_topology(const unsigned mode)
       return TOP_TRI_LIST_ADJ;
    case PIPE_PRIM_TRIANGLE_STRIP_ADJACENCY:
       return TOP_TRI_STRIP_ADJ;
+   case PIPE_PRIM_PATCHES:
+      assert(vertices_per_patch > 0 &&
+             vertices_per_patch <= MAX_NUM_VERTS_PER_PRIM);
+      return (enum PRIMITIVE_TOPOLOGY)(TOP_PATCHLIST_BASE + vertices_per_patch);
    default:
       assert(0 && "Unknown topology");
       return TOP_UNKNOWN;
@@ -28,9 +28,12 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 #include <float.h>
 
 #include "util/u_half.h"
+#include "util/u_cpu_detect.h"
 #include "util/u_format.h"
 #include "util/u_format_tests.h"
 #include "util/u_format_s3tc.h"
@@ -704,6 +707,177 @@ test_one_func(const struct util_format_description *format_desc,
 }
 
 
+/*
+ * Row tests.
+ *
+ * Unpack and pack whole rows at once, which exercises the vectorized paths
+ * in the generated code and in the R11G11B10_FLOAT code, and check the
+ * results are bit for bit identical to converting one pixel at a time. Rows
+ * are tested once for each instruction set the CPU has, see u_format_simd.h.
+ */
+
+#define ROW_WIDTH 35
+
+
+static uint32_t
+row_random(uint32_t *seed)
+{
+   *seed = *seed * 1103515245 + 12345;
+   return *seed >> 8;
+}
+
+
+static void
+fill_row_float(float *row, unsigned count, uint32_t *seed)
+{
+   static const float special[] = {
+      -1.0f, -0.0f, 0.0f, 0.5f, 0.999f, 1.0f, 2.0f, NAN, -NAN, INFINITY,
+      -INFINITY, 1.0f/255.0f, 127.5f/255.0f, 254.5f/255.0f, FLT_MIN, -FLT_MIN,
+      FLT_MAX, 1e-30f, 1.0f/16384.0f, 1.0f/32768.0f, 64512.0f, 64513.0f,
+      65024.0f, 65025.0f, 1e6f
+   };
+   unsigned i;
+
+   for (i = 0; i < count; ++i) {
+      /* Each special value ends up in three different channels */
+      if (i < 3 * ARRAY_SIZE(special))
+         row[i] = special[i % ARRAY_SIZE(special)];
+      else if (i % 2)
+         row[i] = uif(row_random(seed) << 8);
+      else
+         row[i] = (float)(row_random(seed) & 0xffff) / 43690.0f - 0.25f;
+   }
+}
+
+
+static boolean
+test_format_rows_isa(const struct util_format_description *format_desc)
+{
+   const unsigned bytes = format_desc->block.bits / 8;
+   uint8_t packed[ROW_WIDTH * UTIL_FORMAT_MAX_PACKED_BYTES];
+   uint8_t packed_ref[ROW_WIDTH * UTIL_FORMAT_MAX_PACKED_BYTES];
+   float rgba_float[ROW_WIDTH][4], rgba_float_ref[ROW_WIDTH][4];
+   uint8_t rgba_8unorm[ROW_WIDTH][4], rgba_8unorm_ref[ROW_WIDTH][4];
+   uint32_t seed = format_desc->format;
+   unsigned i, x;
+   boolean success = TRUE;
+
+   for (i = 0; i < sizeof packed; ++i) {
+      packed[i] = row_random(&seed);
+   }
+
+   if (format_desc->unpack_rgba_float) {
+      memset(rgba_float, 0, sizeof rgba_float);
+      memset(rgba_float_ref, 0, sizeof rgba_float_ref);
+      format_desc->unpack_rgba_float(&rgba_float[0][0], 0,
+                                     packed, 0, ROW_WIDTH, 1);
+      for (x = 0; x < ROW_WIDTH; ++x) {
+         format_desc->unpack_rgba_float(rgba_float_ref[x], 0,
+                                        packed + x * bytes, 0, 1, 1);
+      }
+      if (memcmp(rgba_float, rgba_float_ref, sizeof rgba_float) != 0) {
+         printf("FAILED: unpack_rgba_float row mismatch\n");
+         success = FALSE;
+      }
+   }
+
+   if (format_desc->unpack_rgba_8unorm) {
+      memset(rgba_8unorm, 0, sizeof rgba_8unorm);
+      memset(rgba_8unorm_ref, 0, sizeof rgba_8unorm_ref);
+      format_desc->unpack_rgba_8unorm(&rgba_8unorm[0][0], 0,
+                                      packed, 0, ROW_WIDTH, 1);
+      for (x = 0; x < ROW_WIDTH; ++x) {
+         format_desc->unpack_rgba_8unorm(rgba_8unorm_ref[x], 0,
+                                         packed + x * bytes, 0, 1, 1);
+      }
+      if (memcmp(rgba_8unorm, rgba_8unorm_ref, sizeof rgba_8unorm) != 0) {
+         printf("FAILED: unpack_rgba_8unorm row mismatch\n");
+         success = FALSE;
+      }
+   }
+
+   if (format_desc->pack_rgba_float) {
+      fill_row_float(&rgba_float[0][0], ROW_WIDTH * 4, &seed);
+      memset(packed, 0, sizeof packed);
+      memset(packed_ref, 0, sizeof packed_ref);
+      format_desc->pack_rgba_float(packed, 0,
+                                   &rgba_float[0][0], 0, ROW_WIDTH, 1);
+      for (x = 0; x < ROW_WIDTH; ++x) {
+         format_desc->pack_rgba_float(packed_ref + x * bytes, 0,
+                                      rgba_float[x], 0, 1, 1);
+      }
+      if (memcmp(packed, packed_ref, ROW_WIDTH * bytes) != 0) {
+         printf("FAILED: pack_rgba_float row mismatch\n");
+         success = FALSE;
+      }
+   }
+
+   if (format_desc->pack_rgba_8unorm) {
+      for (i = 0; i < sizeof rgba_8unorm; ++i) {
+         (&rgba_8unorm[0][0])[i] = row_random(&seed);
+      }
+      memset(packed, 0, sizeof packed);
+      memset(packed_ref, 0, sizeof packed_ref);
+      format_desc->pack_rgba_8unorm(packed, 0,
+                                    &rgba_8unorm[0][0], 0, ROW_WIDTH, 1);
+      for (x = 0; x < ROW_WIDTH; ++x) {
+         format_desc->pack_rgba_8unorm(packed_ref + x * bytes, 0,
+                                       rgba_8unorm[x], 0, 1, 1);
+      }
+      if (memcmp(packed, packed_ref, ROW_WIDTH * bytes) != 0) {
+         printf("FAILED: pack_rgba_8unorm row mismatch\n");
+         success = FALSE;
+      }
+   }
+
+   return success;
+}
+
+
+static boolean
+test_format_rows(const struct util_format_description *format_desc)
+{
+   static const struct {
+      const char *name;
+      boolean sse4_1;
+      boolean avx2;
+   } isas[] = {
+      { "", FALSE, FALSE },
+      { " with SSE4.1", TRUE, FALSE },
+      { " with AVX2", TRUE, TRUE },
+   };
+   const struct util_cpu_caps caps = util_cpu_caps;
+   boolean success = TRUE;
+   unsigned i;
+
+   if (format_desc->block.width != 1 || format_desc->block.height != 1 ||
+       format_desc->block.bits % 8 != 0) {
+      return TRUE;
+   }
+
+   for (i = 0; i < ARRAY_SIZE(isas); ++i) {
+      if ((isas[i].sse4_1 && !caps.has_sse4_1) ||
+          (isas[i].avx2 && !caps.has_avx2)) {
+         continue;
+      }
+
+      printf("Testing util_format_%s rows%s ...\n",
+             format_desc->short_name, isas[i].name);
+      fflush(stdout);
+
+      util_cpu_caps.has_sse4_1 = isas[i].sse4_1;
+      util_cpu_caps.has_avx2 = isas[i].avx2;
+      if (!test_format_rows_isa(format_desc)) {
+         success = FALSE;
+      }
+   }
+
+   util_cpu_caps = caps;
+
+   return success;
+}
+
+
 static boolean
 test_all(void)
 {
@@ -748,6 +922,10 @@ test_all(void)
       TEST_ONE_FUNC(pack_s_8uint);
 
 #     undef TEST_ONE_FUNC
+
+      if (!test_format_rows(format_desc)) {
+         success = FALSE;
+      }
    }
 
    return success;
@@ -758,6 +936,7 @@ int main(int argc, char **argv)
 {
    boolean success;
 
+   util_cpu_detect();
    util_format_s3tc_init();
 
    success = test_all();
@@ -521,6 +521,15 @@ brw_nir_lower_cs_shared(nir_shader *nir)
    this_progress;                                          \
 })
 
+#define LOOP_OPT(pass, ...) ({                             \
+   bool this_progress = false;                             \
+   NIR_LOOP_PASS(this_progress, skip_set, nir, pass,       \
+                 ##__VA_ARGS__);                           \
+   if (this_progress)                                      \
+      progress = true;                                     \
+   this_progress;                                          \
+})
+
 static nir_shader *
 nir_optimize(nir_shader *nir, const struct brw_compiler *compiler,
              bool is_scalar)
@@ -533,56 +542,64 @@ nir_optimize(nir_shader *nir, const struct brw_compiler *compiler,
    if (compiler->glsl_compiler_options[nir->stage].EmitNoIndirectTemp)
       indirect_mask |= nir_var_local;
 
+   /* Every pass in the loop goes through LOOP_OPT so that passes with nothing
+    * left to do are skipped until something else makes progress.
+    */
+   struct set *skip_set = _mesa_set_create(NULL, _mesa_key_hash_string,
+                                           _mesa_key_string_equal);
+
    bool progress;
    do {
       progress = false;
-      OPT(nir_lower_vars_to_ssa);
-      OPT(nir_opt_copy_prop_vars);
+      LOOP_OPT(nir_lower_vars_to_ssa);
+      LOOP_OPT(nir_opt_copy_prop_vars);
 
       if (is_scalar) {
-         OPT(nir_lower_alu_to_scalar);
+         LOOP_OPT(nir_lower_alu_to_scalar);
       }
 
-      OPT(nir_copy_prop);
+      LOOP_OPT(nir_copy_prop);
 
       if (is_scalar) {
-         OPT(nir_lower_phis_to_scalar);
+         LOOP_OPT(nir_lower_phis_to_scalar);
       }
 
-      OPT(nir_copy_prop);
-      OPT(nir_opt_dce);
-      OPT(nir_opt_cse);
-      OPT(nir_opt_peephole_select, 0);
-      OPT(nir_opt_intrinsics);
-      OPT(nir_opt_algebraic);
-      OPT(nir_opt_constant_folding);
-      OPT(nir_opt_dead_cf);
-      if (OPT(nir_opt_trivial_continues)) {
+      LOOP_OPT(nir_copy_prop);
+      LOOP_OPT(nir_opt_dce);
+      LOOP_OPT(nir_opt_cse);
+      LOOP_OPT(nir_opt_peephole_select, 0);
+      LOOP_OPT(nir_opt_intrinsics);
+      LOOP_OPT(nir_opt_algebraic);
+      LOOP_OPT(nir_opt_constant_folding);
+      LOOP_OPT(nir_opt_dead_cf);
+      if (LOOP_OPT(nir_opt_trivial_continues)) {
          /* If nir_opt_trivial_continues makes progress, then we need to clean
           * things up if we want any hope of nir_opt_if or nir_opt_loop_unroll
           * to make progress.
           */
-         OPT(nir_copy_prop);
-         OPT(nir_opt_dce);
+         LOOP_OPT(nir_copy_prop);
+         LOOP_OPT(nir_opt_dce);
       }
-      OPT(nir_opt_if);
+      LOOP_OPT(nir_opt_if);
       if (nir->options->max_unroll_iterations != 0) {
-         OPT(nir_opt_loop_unroll, indirect_mask);
+         LOOP_OPT(nir_opt_loop_unroll, indirect_mask);
       }
-      OPT(nir_opt_remove_phis);
-      OPT(nir_opt_undef);
-      OPT(nir_lower_doubles, nir_lower_drcp |
-                             nir_lower_dsqrt |
-                             nir_lower_drsq |
-                             nir_lower_dtrunc |
-                             nir_lower_dfloor |
-                             nir_lower_dceil |
-                             nir_lower_dfract |
-                             nir_lower_dround_even |
-                             nir_lower_dmod);
-      OPT(nir_lower_64bit_pack);
+      LOOP_OPT(nir_opt_remove_phis);
+      LOOP_OPT(nir_opt_undef);
+      LOOP_OPT(nir_lower_doubles, nir_lower_drcp |
+                                  nir_lower_dsqrt |
+                                  nir_lower_drsq |
+                                  nir_lower_dtrunc |
+                                  nir_lower_dfloor |
+                                  nir_lower_dceil |
+                                  nir_lower_dfract |
+                                  nir_lower_dround_even |
+                                  nir_lower_dmod);
+      LOOP_OPT(nir_lower_64bit_pack);
    } while (progress);
 
+   _mesa_set_destroy(skip_set, NULL);
+
    return nir;
 }
 
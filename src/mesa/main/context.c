@@ -121,8 +121,10 @@
 #include "remap.h"
 #include "scissor.h"
 #include "shared.h"
+#include "shaderapi.h"
 #include "shaderobj.h"
 #include "shaderimage.h"
+#include "shader_queue.h"
 #include "util/debug.h"
 #include "util/disk_cache.h"
 #include "util/strtod.h"
@@ -641,6 +643,13 @@ _mesa_init_constants(struct gl_constants *consts, gl_api api)
    consts->GLSLVersion = 120;
    _mesa_override_glsl_version(consts);
 
+   /* GLSL_OPT_LEVEL_FULL repeats the optimizations until they stop making
+    * progress.  Drivers that would rather cap it set
+    * GLSLOptimizeMaxIterations.
+    */
+   consts->GLSLOptimizeMaxIterations = 0;
+   _mesa_override_glsl_opt_level(consts);
+
 #ifdef DEBUG
    consts->GenerateTemporaryNames = true;
 #else
@@ -1311,6 +1320,9 @@ _mesa_free_context_data( struct gl_context *ctx )
       _mesa_make_current(ctx, NULL, NULL);
    }
 
+   /* Compile and link jobs still use the context */
+   _mesa_shader_queue_destroy(ctx);
+
    /* unreference WinSysDraw/Read buffers */
    _mesa_reference_framebuffer(&ctx->WinSysDrawBuffer, NULL);
    _mesa_reference_framebuffer(&ctx->WinSysReadBuffer, NULL);
@@ -1108,11 +1108,9 @@ create_new_program(struct gl_context *ctx, struct state_key *key)
       &ctx->Const.ShaderCompilerOptions[MESA_SHADER_FRAGMENT];
 
    /* Conservative approach: Don't optimize here, the linker does it too. */
-   if (!ctx->Const.GLSLOptimizeConservatively) {
-      while (do_common_optimization(p.shader->ir, false, false, options,
-                                    ctx->Const.NativeIntegers))
-         ;
-   }
+   if (ctx->Const.GLSLOptimizeLevel == GLSL_OPT_LEVEL_FULL)
+      do_common_optimization_loop(p.shader->ir, false, false, options,
+                                  &ctx->Const);
 
    reparent_ir(p.shader->ir, p.shader->ir);
 
@@ -37,6 +37,21 @@
 #include "glheader.h"
 #include "hash.h"
 #include "util/hash_table.h"
+#include "util/u_atomic.h"
+
+
+/** The array for the keys below Size, see struct _mesa_HashTable. */
+struct _mesa_HashDense {
+   GLuint Size;
+   struct _mesa_HashDense *Prev;         /**< replaced array, still readable */
+   void *Data[];
+};
+
+/** What new tables start with, so that Dense is never NULL. */
+static struct _mesa_HashDense empty_dense;
+
+#define DENSE_MIN_SIZE 256
+#define DENSE_MAX_SIZE (1u << 30)
 
 
 /**
@@ -58,7 +73,7 @@ _mesa_NewHashTable(void)
          return NULL;
       }
 
-      _mesa_hash_table_set_deleted_key(table->ht, uint_key(DELETED_KEY_VALUE));
+      table->Dense = &empty_dense;
       /*
        * Needs to be recursive, since the callback in _mesa_HashWalk()
        * is allowed to call _mesa_HashRemove().
@@ -85,14 +100,22 @@ _mesa_NewHashTable(void)
 void
 _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 {
+   struct _mesa_HashDense *dense, *prev;
+
    assert(table);
 
-   if (_mesa_hash_table_next_entry(table->ht, NULL) != NULL) {
+   if (table->DenseEntries ||
+       _mesa_hash_table_next_entry(table->ht, NULL) != NULL) {
       _mesa_problem(NULL, "In _mesa_DeleteHashTable, found non-freed data");
    }
 
    _mesa_hash_table_destroy(table->ht, NULL);
 
+   for (dense = table->Dense; dense != &empty_dense; dense = prev) {
+      prev = dense->Prev;
+      free(dense);
+   }
+
    mtx_destroy(&table->Mutex);
    free(table);
 }
@@ -106,13 +129,14 @@ _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 static inline void *
 _mesa_HashLookup_unlocked(struct _mesa_HashTable *table, GLuint key)
 {
+   const struct _mesa_HashDense *dense = table->Dense;
    const struct hash_entry *entry;
 
    assert(table);
    assert(key);
 
-   if (key == DELETED_KEY_VALUE)
-      return table->deleted_key_data;
+   if (key < dense->Size)
+      return dense->Data[key];
 
    entry = _mesa_hash_table_search_pre_hashed(table->ht,
                                               uint_hash(key),
@@ -126,6 +150,8 @@ _mesa_HashLookup_unlocked(struct _mesa_HashTable *table, GLuint key)
 
 /**
  * Lookup an entry in the hash table.
+ *
+ * Keys in the dense array are looked up without locking the mutex.
  * 
  * \param table the hash table.
  * \param key the key.
@@ -135,7 +161,19 @@ _mesa_HashLookup_unlocked(struct _mesa_HashTable *table, GLuint key)
 void *
 _mesa_HashLookup(struct _mesa_HashTable *table, GLuint key)
 {
+   const struct _mesa_HashDense *dense;
    void *res;
+
+   assert(table);
+   assert(key);
+
+   dense = p_atomic_read(&table->Dense);
+   if (key < dense->Size)
+      return p_atomic_read(&dense->Data[key]);
+
+   /* The key may have moved to a new dense array meanwhile, which the
+    * locked lookup checks again.
+    */
    _mesa_HashLockMutex(table);
    res = _mesa_HashLookup_unlocked(table, key);
    _mesa_HashUnlockMutex(table);
@@ -161,10 +199,61 @@ _mesa_HashLookupLocked(struct _mesa_HashTable *table, GLuint key)
 }
 
 
+/**
+ * Replaces the dense array by one big enough for key, if it would still be
+ * at least a quarter full, and moves the keys that fit in it over from the
+ * hash table.
+ */
+static void
+dense_grow(struct _mesa_HashTable *table, GLuint key)
+{
+   struct _mesa_HashDense *old = table->Dense, *dense;
+   GLuint entries = table->DenseEntries +
+                    _mesa_hash_table_num_entries(table->ht);
+   GLuint size = MAX2(old->Size * 2, DENSE_MIN_SIZE);
+   struct hash_entry *entry;
+
+   if (key >= DENSE_MAX_SIZE)
+      return;
+
+   while (size <= key)
+      size *= 2;
+
+   if (size > DENSE_MIN_SIZE && size / 4 > entries + 1)
+      return;
+
+   dense = malloc(sizeof(*dense) + size * sizeof(dense->Data[0]));
+   if (!dense)
+      return;
+
+   dense->Size = size;
+   dense->Prev = old;
+   memcpy(dense->Data, old->Data, old->Size * sizeof(dense->Data[0]));
+   memset(dense->Data + old->Size, 0,
+          (size - old->Size) * sizeof(dense->Data[0]));
+
+   hash_table_foreach(table->ht, entry) {
+      GLuint k = (uintptr_t)entry->key;
+
+      if (k < size) {
+         dense->Data[k] = entry->data;
+         table->DenseEntries += entry->data != NULL;
+         _mesa_hash_table_remove(table->ht, entry);
+      }
+   }
+
+   /* Readers may still be using the old array, so it is only freed with
+    * the table.
+    */
+   p_atomic_set(&table->Dense, dense);
+}
+
+
 static inline void
 _mesa_HashInsert_unlocked(struct _mesa_HashTable *table, GLuint key, void *data)
 {
    uint32_t hash = uint_hash(key);
+   struct _mesa_HashDense *dense;
    struct hash_entry *entry;
 
    assert(table);
@@ -173,8 +262,13 @@ _mesa_HashInsert_unlocked(struct _mesa_HashTable *table, GLuint key, void *data)
    if (key > table->MaxKey)
       table->MaxKey = key;
 
-   if (key == DELETED_KEY_VALUE) {
-      table->deleted_key_data = data;
+   if (key >= table->Dense->Size)
+      dense_grow(table, key);
+
+   dense = table->Dense;
+   if (key < dense->Size) {
+      table->DenseEntries += (data != NULL) - (dense->Data[key] != NULL);
+      p_atomic_set(&dense->Data[key], data);
    } else {
       entry = _mesa_hash_table_search_pre_hashed(table->ht, hash, uint_key(key));
       if (entry) {
@@ -233,6 +327,7 @@ _mesa_HashInsert(struct _mesa_HashTable *table, GLuint key, void *data)
 static inline void
 _mesa_HashRemove_unlocked(struct _mesa_HashTable *table, GLuint key)
 {
+   struct _mesa_HashDense *dense = table->Dense;
    struct hash_entry *entry;
 
    assert(table);
@@ -243,8 +338,9 @@ _mesa_HashRemove_unlocked(struct _mesa_HashTable *table, GLuint key)
     */
    assert(!table->InDeleteAll);
 
-   if (key == DELETED_KEY_VALUE) {
-      table->deleted_key_data = NULL;
+   if (key < dense->Size) {
+      table->DenseEntries -= dense->Data[key] != NULL;
+      p_atomic_set(&dense->Data[key], NULL);
    } else {
       entry = _mesa_hash_table_search_pre_hashed(table->ht,
                                                  uint_hash(key),
@@ -282,19 +378,25 @@ _mesa_HashDeleteAll(struct _mesa_HashTable *table,
                     void (*callback)(GLuint key, void *data, void *userData),
                     void *userData)
 {
+   struct _mesa_HashDense *dense;
    struct hash_entry *entry;
+   GLuint key;
 
    assert(callback);
    _mesa_HashLockMutex(table);
    table->InDeleteAll = GL_TRUE;
+   dense = table->Dense;
+   for (key = 0; key < dense->Size; key++) {
+      if (dense->Data[key]) {
+         callback(key, dense->Data[key], userData);
+         p_atomic_set(&dense->Data[key], NULL);
+      }
+   }
+   table->DenseEntries = 0;
    hash_table_foreach(table->ht, entry) {
       callback((uintptr_t)entry->key, entry->data, userData);
       _mesa_hash_table_remove(table->ht, entry);
    }
-   if (table->deleted_key_data) {
-      callback(DELETED_KEY_VALUE, table->deleted_key_data, userData);
-      table->deleted_key_data = NULL;
-   }
    table->InDeleteAll = GL_FALSE;
    _mesa_HashUnlockMutex(table);
 }
@@ -315,12 +417,17 @@ hash_walk_unlocked(const struct _mesa_HashTable *table,
    assert(table);
    assert(callback);
 
+   /* The callback may remove entries, but not insert new ones */
+   const struct _mesa_HashDense *dense = table->Dense;
+   for (GLuint key = 0; key < dense->Size; key++) {
+      if (dense->Data[key])
+         callback(key, dense->Data[key], userData);
+   }
+
    struct hash_entry *entry;
    hash_table_foreach(table->ht, entry) {
       callback((uintptr_t)entry->key, entry->data, userData);
    }
-   if (table->deleted_key_data)
-      callback(DELETED_KEY_VALUE, table->deleted_key_data, userData);
 }
 
 
@@ -359,8 +466,6 @@ debug_print_entry(GLuint key, void *data, void *userData)
 void
 _mesa_HashPrint(const struct _mesa_HashTable *table)
 {
-   if (table->deleted_key_data)
-      debug_print_entry(DELETED_KEY_VALUE, table->deleted_key_data, NULL);
    _mesa_HashWalk(table, debug_print_entry, NULL);
 }
 
@@ -417,12 +522,5 @@ _mesa_HashFindFreeKeyBlock(struct _mesa_HashTable *table, GLuint numKeys)
 GLuint
 _mesa_HashNumEntries(const struct _mesa_HashTable *table)
 {
-   GLuint count = 0;
-
-   if (table->deleted_key_data)
-      count++;
-
-   count += _mesa_hash_table_num_entries(table->ht);
-
-   return count;
+   return table->DenseEntries + _mesa_hash_table_num_entries(table->ht);
 }
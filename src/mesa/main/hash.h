@@ -36,15 +36,12 @@
 #include "imports.h"
 
 /**
- * Magic GLuint object name that gets stored outside of the struct hash_table.
+ * Magic GLuint key that _mesa_hash_table_u64 stores outside of the struct
+ * hash_table.
  *
- * The hash table needs a particular pointer to be the marker for a key that
- * was deleted from the table, along with NULL for the "never allocated in the
- * table" marker.  Legacy GL allows any GLuint to be used as a GL object name,
- * and we use a 1:1 mapping from GLuints to key pointers, so we need to be
- * able to track a GLuint that happens to match the deleted key outside of
- * struct hash_table.  We tell the hash table to use "1" as the deleted key
- * value, so that we test the deleted-key-in-the-table path as best we can.
+ * The hash table used to need a particular pointer to be the marker for a
+ * key that was deleted from the table.  It doesn't anymore, but the u64
+ * wrapper still keeps this key aside, so that the path stays tested.
  */
 #define DELETED_KEY_VALUE 1
 
@@ -55,17 +52,9 @@
  * There exist many integer hash functions, designed to avoid collisions when
  * the integers are spread across key space with some patterns.  In GL, the
  * pattern (in the case of glGen*()ed object IDs) is that the keys are unique
- * contiguous integers starting from 1.  Because of that, we just use the key
- * as the hash value, to minimize the cost of the hash function.  If objects
- * are never deleted, we will never see a collision in the table, because the
- * table resizes itself when it approaches full, and thus key % table_size ==
- * key.
- *
- * The case where we could have collisions for genned objects would be
- * something like: glGenBuffers(&a, 100); glDeleteBuffers(&a + 50, 50);
- * glGenBuffers(&b, 100), because objects 1-50 and 101-200 are allocated at
- * the end of that sequence, instead of 1-150.  So far it doesn't appear to be
- * a problem.
+ * contiguous integers starting from 1, and those normally end up in the
+ * dense array of struct _mesa_HashTable instead.  The hash table mixes the
+ * hash bits itself, so we just use the key as the hash value.
  */
 static inline bool
 uint_key_compare(const void *a, const void *b)
@@ -92,16 +81,25 @@ uint_key(GLuint id)
 }
 /** @} */
 
+struct _mesa_HashDense;
+
 /**
  * The hash table data structure.
+ *
+ * Keys below Dense->Size are stored in a plain array indexed by the key,
+ * the others in the hash table.  The array grows as long as it stays
+ * reasonably full, which is the case for glGen*()ed names.  Writers hold the
+ * mutex, but _mesa_HashLookup() reads the array without locking: the array
+ * is only ever replaced by a bigger copy and the old ones are freed with the
+ * table, so a reader can always use the one it loaded.
  */
 struct _mesa_HashTable {
-   struct hash_table *ht;
+   struct hash_table *ht;                /**< keys that don't fit in Dense */
+   struct _mesa_HashDense *Dense;        /**< data indexed by key */
+   GLuint DenseEntries;                  /**< non-NULL entries in Dense */
    GLuint MaxKey;                        /**< highest key inserted so far */
    mtx_t Mutex;                          /**< mutual exclusion lock */
    GLboolean InDeleteAll;                /**< Debug check */
-   /** Value that would be in the table for DELETED_KEY_VALUE. */
-   void *deleted_key_data;
 };
 
 extern struct _mesa_HashTable *_mesa_NewHashTable(void);
@@ -130,6 +130,21 @@ invalid_target:
    return;
 }
 
+/* GL_ARB_parallel_shader_compile */
+void GLAPIENTRY
+_mesa_MaxShaderCompilerThreadsARB(GLuint count)
+{
+   GET_CURRENT_CONTEXT(ctx);
+
+   if (MESA_VERBOSE & VERBOSE_API)
+      _mesa_debug(ctx, "glMaxShaderCompilerThreadsARB %u\n", count);
+
+   /* The compiler threads are (re)started by the next compile or link that
+    * gets queued, see _mesa_shader_queue_add_job().
+    */
+   ctx->Hint.MaxShaderCompilerThreads = count;
+}
+
 
 /**********************************************************************/
 /*****                      Initialization                        *****/
@@ -146,4 +161,5 @@ void _mesa_init_hint( struct gl_context * ctx )
    ctx->Hint.TextureCompression = GL_DONT_CARE;
    ctx->Hint.GenerateMipmap = GL_DONT_CARE;
    ctx->Hint.FragmentShaderDerivative = GL_DONT_CARE;
+   ctx->Hint.MaxShaderCompilerThreads = 0xffffffff;
 }
@@ -48,6 +48,7 @@
 #include "compiler/glsl/list.h"
 #include "util/bitscan.h"
 #include "util/u_dynarray.h"
+#include "util/u_queue.h"
 
 
 #ifdef __cplusplus
@@ -628,6 +629,7 @@ struct gl_hint_attrib
    GLenum TextureCompression;   /**< GL_ARB_texture_compression */
    GLenum GenerateMipmap;       /**< GL_SGIS_generate_mipmap */
    GLenum FragmentShaderDerivative; /**< GL_ARB_fragment_shader */
+   GLuint MaxShaderCompilerThreads; /**< GL_ARB_parallel_shader_compile */
 };
 
 
@@ -2571,6 +2573,12 @@ struct gl_shader
 
    enum gl_compile_status CompileStatus;
 
+   /**
+    * Signalled once a glCompileShader() running on a compiler thread is
+    * done.  Everything below may only be looked at after waiting for it.
+    */
+   struct util_queue_fence CompileFence;
+
 #ifdef DEBUG
    unsigned SourceChecksum;       /**< for debug/logging purposes */
 #endif
@@ -2914,6 +2922,23 @@ struct gl_shader_program
    GLuint NumShaders;          /**< number of attached shaders */
    struct gl_shader **Shaders; /**< List of attached the shaders */
 
+   /**
+    * Signalled once the GLSL linker running on a compiler thread is done.
+    *
+    * LinkFinishPending is then still set until a GL thread has run the
+    * driver's LinkShader hook, see _mesa_wait_for_link().  Contexts sharing
+    * the program take LinkMutex to do that.
+    */
+   struct util_queue_fence LinkFence;
+   bool LinkFinishPending;
+   mtx_t LinkMutex;
+
+   /**
+    * Programs created on the GL thread for the stages a compiler thread is
+    * about to link, see _mesa_new_linked_program().
+    */
+   struct gl_program *LinkPrograms[MESA_SHADER_STAGES];
+
    /**
     * User-defined attribute bindings
     *
@@ -3038,6 +3063,7 @@ struct gl_shader_program
 #define GLSL_DUMP_ON_ERROR 0x80 /**< Dump shaders to stderr on compile error */
 #define GLSL_CACHE_INFO 0x100 /**< Print debug information about shader cache */
 #define GLSL_CACHE_FALLBACK 0x200 /**< Force shader cache fallback paths */
+#define GLSL_OPT_STATS 0x400 /**< Print GLSL IR optimization iterations */
 
 
 /**
@@ -3566,6 +3592,33 @@ struct gl_program_constants
 };
 
 
+/**
+ * How much work the GLSL IR optimizer does, see gl_constants::GLSLOptimizeLevel.
+ */
+enum gl_glsl_opt_level
+{
+   /**
+    * Repeat the common optimizations until they stop making progress, or
+    * until gl_constants::GLSLOptimizeMaxIterations is reached.
+    */
+   GLSL_OPT_LEVEL_FULL = 0,
+
+   /**
+    * Run the minimum amount of GLSL optimizations to be able to link
+    * shaders optimally (eliminate dead varyings and uniforms) and just do
+    * all the necessary lowering.
+    */
+   GLSL_OPT_LEVEL_CONSERVATIVE,
+
+   /**
+    * Run a small, fixed set of passes once: inlining, dead code
+    * elimination and whatever lowering the driver needs.  Everything else
+    * is left to NIR or the backend.
+    */
+   GLSL_OPT_LEVEL_FAST,
+};
+
+
 /**
  * Constants which may be overridden by device driver during context creation
  * but are never changed after that.
@@ -3811,12 +3864,14 @@ struct gl_constants
    bool GLSLFragCoordIsSysVal;
    bool GLSLFrontFacingIsSysVal;
 
+   /** How hard the GLSL IR optimizer tries, see gl_glsl_opt_level. */
+   enum gl_glsl_opt_level GLSLOptimizeLevel;
+
    /**
-    * Run the minimum amount of GLSL optimizations to be able to link
-    * shaders optimally (eliminate dead varyings and uniforms) and just do
-    * all the necessary lowering.
+    * Upper bound on the number of times GLSL_OPT_LEVEL_FULL runs the
+    * optimization loop over a shader, 0 for no limit.
     */
-   bool GLSLOptimizeConservatively;
+   GLuint GLSLOptimizeMaxIterations;
 
    /**
     * True if gl_TessLevelInner/Outer[] in the TES should be inputs
@@ -4727,6 +4782,9 @@ struct gl_context
 
    struct glthread_state *GLThread;
 
+   /** Compiler threads for GL_ARB_parallel_shader_compile */
+   struct shader_queue *ShaderQueue;
+
    struct gl_config Visual;
    struct gl_framebuffer *DrawBuffer;	/**< buffer for writing */
    struct gl_framebuffer *ReadBuffer;	/**< buffer for reading */
@@ -474,6 +474,10 @@ bind_program_pipeline(struct gl_context *ctx, GLuint pipeline, bool no_error)
        * glIsProgramPipeline and GetProgramPipelineInfoLog
        */
       newObj->EverBound = GL_TRUE;
+
+      /* glUniform*() will use the active program without looking it up */
+      if (newObj->ActiveProgram)
+         _mesa_wait_for_link(ctx, newObj->ActiveProgram);
    }
 
    _mesa_bind_pipeline(ctx, newObj);
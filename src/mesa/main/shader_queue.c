@@ -0,0 +1,223 @@
+/*
+ * Copyright © 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file shader_queue.c
+ *
+ * Compiler threads for GL_ARB_parallel_shader_compile.
+ *
+ * glCompileShader() and the GLSL linker run as jobs on a util_queue owned by
+ * the context.  The jobs read the context's constants and extensions, so
+ * the queue has to be drained before the context goes away; every job is
+ * counted until its cleanup callback has run.
+ */
+
+#include "main/debug_output.h"
+#include "main/macros.h"
+#include "main/mtypes.h"
+#include "main/shader_queue.h"
+#include "util/u_thread.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+struct shader_queue
+{
+   struct util_queue queue;
+
+   /** Threads of the queue, 0 until it has been initialized. */
+   unsigned num_threads;
+
+   /** Jobs whose cleanup callback hasn't run yet, protected by mutex. */
+   unsigned num_pending;
+   mtx_t mutex;
+   cnd_t idle;
+};
+
+struct shader_queue_job
+{
+   struct gl_context *ctx;
+   struct shader_queue *sq;
+   shader_queue_execute_func execute;
+   GLbitfield glsl_flags;
+   void *data;
+};
+
+
+static unsigned
+get_num_cpus(void)
+{
+#if defined(_WIN32)
+   SYSTEM_INFO info;
+   GetSystemInfo(&info);
+   return info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+   long count = sysconf(_SC_NPROCESSORS_ONLN);
+   return count > 0 ? count : 1;
+#else
+   return 1;
+#endif
+}
+
+
+/**
+ * Number of threads to use for the value set with
+ * glMaxShaderCompilerThreadsARB().  The default of 0xffffffff leaves one
+ * CPU for the application thread.
+ */
+static unsigned
+num_threads_for_hint(unsigned max_threads)
+{
+   const unsigned num_cpus = get_num_cpus();
+
+   if (max_threads == 0xffffffff)
+      return MAX2(num_cpus - 1, 1);
+
+   return MIN2(max_threads, num_cpus);
+}
+
+
+static void
+wait_idle(struct shader_queue *sq)
+{
+   mtx_lock(&sq->mutex);
+   while (sq->num_pending)
+      cnd_wait(&sq->idle, &sq->mutex);
+   mtx_unlock(&sq->mutex);
+}
+
+
+static void
+shader_queue_execute(void *data, int thread_index)
+{
+   struct shader_queue_job *job = data;
+
+   job->execute(job->ctx, job->glsl_flags, job->data);
+}
+
+
+static void
+shader_queue_cleanup(void *data, int thread_index)
+{
+   struct shader_queue_job *job = data;
+   struct shader_queue *sq = job->sq;
+
+   free(job);
+
+   mtx_lock(&sq->mutex);
+   if (--sq->num_pending == 0)
+      cnd_broadcast(&sq->idle);
+   mtx_unlock(&sq->mutex);
+}
+
+
+bool
+_mesa_shader_queue_add_job(struct gl_context *ctx,
+                           struct util_queue_fence *fence,
+                           shader_queue_execute_func execute, void *data)
+{
+   const unsigned num_threads =
+      num_threads_for_hint(ctx->Hint.MaxShaderCompilerThreads);
+   struct shader_queue *sq = ctx->ShaderQueue;
+   struct shader_queue_job *job;
+
+   if (num_threads == 0)
+      return false;
+
+   /* Messages from the compiler must reach the debug callback on the
+    * application's thread.
+    */
+   if (ctx->Debug &&
+       _mesa_get_debug_state_int(ctx, GL_DEBUG_OUTPUT_SYNCHRONOUS))
+      return false;
+
+   if (!sq) {
+      sq = calloc(1, sizeof(*sq));
+      if (!sq)
+         return false;
+
+      mtx_init(&sq->mutex, mtx_plain);
+      cnd_init(&sq->idle);
+      ctx->ShaderQueue = sq;
+   }
+
+   /* util_queue can't change its number of threads, start over instead */
+   if (sq->num_threads != num_threads) {
+      if (sq->num_threads) {
+         wait_idle(sq);
+         util_queue_destroy(&sq->queue);
+         sq->num_threads = 0;
+      }
+
+      /* Not on the shared pool: link jobs wait for compiles, which can be
+       * queued in another context sharing the shaders. With pool threads,
+       * the links of a few contexts could occupy all of them, and the
+       * compiles they wait for would never run.
+       */
+      if (!util_queue_init(&sq->queue, "glsl", 32, num_threads,
+                           UTIL_QUEUE_INIT_RESIZE_IF_FULL))
+         return false;
+
+      sq->num_threads = num_threads;
+   }
+
+   job = malloc(sizeof(*job));
+   if (!job)
+      return false;
+
+   job->ctx = ctx;
+   job->sq = sq;
+   job->execute = execute;
+   job->glsl_flags = ctx->_Shader->Flags;
+   job->data = data;
+
+   mtx_lock(&sq->mutex);
+   sq->num_pending++;
+   mtx_unlock(&sq->mutex);
+
+   util_queue_add_job(&sq->queue, job, fence, shader_queue_execute,
+                      shader_queue_cleanup);
+   return true;
+}
+
+
+void
+_mesa_shader_queue_destroy(struct gl_context *ctx)
+{
+   struct shader_queue *sq = ctx->ShaderQueue;
+
+   if (!sq)
+      return;
+
+   if (sq->num_threads) {
+      wait_idle(sq);
+      util_queue_destroy(&sq->queue);
+   }
+
+   cnd_destroy(&sq->idle);
+   mtx_destroy(&sq->mutex);
+   free(sq);
+   ctx->ShaderQueue = NULL;
+}
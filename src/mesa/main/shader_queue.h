@@ -0,0 +1,70 @@
+/*
+ * Copyright © 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef SHADER_QUEUE_H
+#define SHADER_QUEUE_H
+
+#include <stdbool.h>
+#include "main/glheader.h"
+#include "util/u_queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gl_context;
+
+typedef void (*shader_queue_execute_func)(struct gl_context *ctx,
+                                          GLbitfield glsl_flags, void *data);
+
+/**
+ * Run \p execute on one of the context's shader compiler threads and signal
+ * \p fence once it is done.
+ *
+ * \p execute gets the context's GLSL_x flags as they were when the job was
+ * added, it must not look at ctx->_Shader, which the application may rebind
+ * or delete in the meantime.
+ *
+ * The threads are created on first use, their number follows
+ * glMaxShaderCompilerThreadsARB().
+ *
+ * \return false if the job should be run synchronously instead, because the
+ * application asked for no compiler threads or the threads could not be
+ * created.
+ */
+bool
+_mesa_shader_queue_add_job(struct gl_context *ctx,
+                           struct util_queue_fence *fence,
+                           shader_queue_execute_func execute, void *data);
+
+/**
+ * Wait for all the jobs of the context and destroy its compiler threads.
+ */
+void
+_mesa_shader_queue_destroy(struct gl_context *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SHADER_QUEUE_H */
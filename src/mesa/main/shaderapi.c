@@ -47,12 +47,15 @@
 #include "main/pipelineobj.h"
 #include "main/shaderapi.h"
 #include "main/shaderobj.h"
+#include "main/shader_queue.h"
 #include "main/transformfeedback.h"
 #include "main/uniforms.h"
 #include "compiler/glsl/glsl_parser_extras.h"
 #include "compiler/glsl/ir.h"
 #include "compiler/glsl/ir_uniform.h"
 #include "compiler/glsl/program.h"
+#include "compiler/glsl/shader_cache.h"
+#include "program/ir_to_mesa.h"
 #include "program/program.h"
 #include "program/prog_print.h"
 #include "program/prog_parameter.h"
@@ -60,6 +63,7 @@
 #include "util/hash_table.h"
 #include "util/mesa-sha1.h"
 #include "util/crc32.h"
+#include "util/u_atomic.h"
 
 /**
  * Return mask of GLSL_x flags by examining the MESA_GLSL env var.
@@ -91,11 +95,47 @@ _mesa_get_shader_flags(void)
          flags |= GLSL_USE_PROG;
       if (strstr(env, "errors"))
          flags |= GLSL_REPORT_ERRORS;
+      if (strstr(env, "opt_stats"))
+         flags |= GLSL_OPT_STATS;
    }
 
    return flags;
 }
 
+/**
+ * Override how hard the GLSL IR optimizer tries if the environment variables
+ * MESA_GLSL_OPT_LEVEL ("full", "conservative" or "fast") or
+ * MESA_GLSL_OPT_MAX_ITERATIONS (an integer, 0 for no limit) are set.
+ *
+ * Drivers that change gl_constants::GLSLOptimizeLevel or
+ * GLSLOptimizeMaxIterations call this again afterwards.
+ */
+void
+_mesa_override_glsl_opt_level(struct gl_constants *consts)
+{
+   const char *level = getenv("MESA_GLSL_OPT_LEVEL");
+   const char *iterations = getenv("MESA_GLSL_OPT_MAX_ITERATIONS");
+
+   if (level) {
+      if (strcmp(level, "full") == 0)
+         consts->GLSLOptimizeLevel = GLSL_OPT_LEVEL_FULL;
+      else if (strcmp(level, "conservative") == 0)
+         consts->GLSLOptimizeLevel = GLSL_OPT_LEVEL_CONSERVATIVE;
+      else if (strcmp(level, "fast") == 0)
+         consts->GLSLOptimizeLevel = GLSL_OPT_LEVEL_FAST;
+      else
+         fprintf(stderr, "error: invalid value for MESA_GLSL_OPT_LEVEL: %s\n",
+                 level);
+   }
+
+   if (iterations &&
+       sscanf(iterations, "%u", &consts->GLSLOptimizeMaxIterations) != 1) {
+      fprintf(stderr,
+              "error: invalid value for MESA_GLSL_OPT_MAX_ITERATIONS: %s\n",
+              iterations);
+   }
+}
+
 /**
  * Memoized version of getenv("MESA_SHADER_CAPTURE_PATH").
  */
@@ -113,6 +153,23 @@ _mesa_get_shader_capture_path(void)
    return path;
 }
 
+/**
+ * Memoized version of getenv("MESA_GLSL_CACHE_CAPTURE_PATH").
+ */
+static const char *
+get_shader_cache_capture_path(void)
+{
+   static bool read_env_var = false;
+   static const char *path = NULL;
+
+   if (!read_env_var) {
+      path = getenv("MESA_GLSL_CACHE_CAPTURE_PATH");
+      read_env_var = true;
+   }
+
+   return path;
+}
+
 /**
  * Initialize context's shader state.
  */
@@ -651,8 +708,15 @@ static void
 get_programiv(struct gl_context *ctx, GLuint program, GLenum pname,
               GLint *params)
 {
-   struct gl_shader_program *shProg
-      = _mesa_lookup_shader_program_err(ctx, program, "glGetProgramiv(program)");
+   struct gl_shader_program *shProg;
+
+   /* GL_COMPLETION_STATUS_ARB must not wait for the link to finish */
+   if (pname == GL_COMPLETION_STATUS_ARB)
+      shProg = _mesa_lookup_shader_program_err_no_wait(ctx, program,
+                                                       "glGetProgramiv(program)");
+   else
+      shProg = _mesa_lookup_shader_program_err(ctx, program,
+                                               "glGetProgramiv(program)");
 
    /* Is transform feedback available in this context?
     */
@@ -686,6 +750,11 @@ get_programiv(struct gl_context *ctx, GLuint program, GLenum pname,
    case GL_LINK_STATUS:
       *params = shProg->data->LinkStatus ? GL_TRUE : GL_FALSE;
       return;
+   case GL_COMPLETION_STATUS_ARB:
+      if (!_mesa_has_ARB_parallel_shader_compile(ctx))
+         break;
+      *params = util_queue_fence_is_signalled(&shProg->LinkFence);
+      return;
    case GL_VALIDATE_STATUS:
       *params = shProg->data->Validated;
       return;
@@ -943,6 +1012,9 @@ get_shaderiv(struct gl_context *ctx, GLuint name, GLenum pname, GLint *params)
       return;
    }
 
+   if (pname != GL_COMPLETION_STATUS_ARB)
+      util_queue_fence_wait(&shader->CompileFence);
+
    switch (pname) {
    case GL_SHADER_TYPE:
       *params = shader->Type;
@@ -960,6 +1032,12 @@ get_shaderiv(struct gl_context *ctx, GLuint name, GLenum pname, GLint *params)
    case GL_SHADER_SOURCE_LENGTH:
       *params = shader->Source ? strlen((char *) shader->Source) + 1 : 0;
       break;
+   case GL_COMPLETION_STATUS_ARB:
+      if (_mesa_has_ARB_parallel_shader_compile(ctx)) {
+         *params = util_queue_fence_is_signalled(&shader->CompileFence);
+         break;
+      }
+      /* fallthrough */
    default:
       _mesa_error(ctx, GL_INVALID_ENUM, "glGetShaderiv(pname)");
       return;
@@ -1016,6 +1094,8 @@ get_shader_info_log(struct gl_context *ctx, GLuint shader, GLsizei bufSize,
       return;
    }
 
+   util_queue_fence_wait(&sh->CompileFence);
+
    _mesa_copy_string(infoLog, bufSize, length, sh->InfoLog);
 }
 
@@ -1038,6 +1118,8 @@ get_shader_source(struct gl_context *ctx, GLuint shader, GLsizei maxLength,
    if (!sh) {
       return;
    }
+
+   util_queue_fence_wait(&sh->CompileFence);
    _mesa_copy_string(sourceOut, maxLength, length, sh->Source);
 }
 
@@ -1070,21 +1152,20 @@ set_shader_source(struct gl_shader *sh, const GLchar *source)
 
 
 /**
- * Compile a shader.
+ * Compile a shader with the given GLSL_x flags, which lets this run on a
+ * compiler thread without looking at ctx->_Shader.
  */
-void
-_mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
+static void
+compile_shader_with_flags(struct gl_context *ctx, struct gl_shader *sh,
+                          GLbitfield glsl_flags)
 {
-   if (!sh)
-      return;
-
    if (!sh->Source) {
       /* If the user called glCompileShader without first calling
        * glShaderSource, we should fail to compile, but not raise a GL_ERROR.
        */
       sh->CompileStatus = compile_failure;
    } else {
-      if (ctx->_Shader->Flags & GLSL_DUMP) {
+      if (glsl_flags & GLSL_DUMP) {
          _mesa_log("GLSL source for %s shader %d:\n",
                  _mesa_shader_stage_to_string(sh->Stage), sh->Name);
          _mesa_log("%s\n", sh->Source);
@@ -1093,13 +1174,13 @@ _mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
       /* this call will set the shader->CompileStatus field to indicate if
        * compilation was successful.
        */
-      _mesa_glsl_compile_shader(ctx, sh, false, false, false);
+      _mesa_glsl_compile_shader(ctx, sh, false, false, false, glsl_flags);
 
-      if (ctx->_Shader->Flags & GLSL_LOG) {
+      if (glsl_flags & GLSL_LOG) {
          _mesa_write_shader_to_file(sh);
       }
 
-      if (ctx->_Shader->Flags & GLSL_DUMP) {
+      if (glsl_flags & GLSL_DUMP) {
          if (sh->CompileStatus) {
             if (sh->ir) {
                _mesa_log("GLSL IR for shader %d:\n", sh->Name);
@@ -1120,14 +1201,14 @@ _mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
    }
 
    if (!sh->CompileStatus) {
-      if (ctx->_Shader->Flags & GLSL_DUMP_ON_ERROR) {
+      if (glsl_flags & GLSL_DUMP_ON_ERROR) {
          _mesa_log("GLSL source for %s shader %d:\n",
                  _mesa_shader_stage_to_string(sh->Stage), sh->Name);
          _mesa_log("%s\n", sh->Source);
          _mesa_log("Info Log:\n%s\n", sh->InfoLog);
       }
 
-      if (ctx->_Shader->Flags & GLSL_REPORT_ERRORS) {
+      if (glsl_flags & GLSL_REPORT_ERRORS) {
          _mesa_debug(ctx, "Error compiling shader %u:\n%s\n",
                      sh->Name, sh->InfoLog);
       }
@@ -1136,39 +1217,122 @@ _mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
 
 
 /**
- * Link a program's shaders.
+ * Compile a shader.
  */
-static ALWAYS_INLINE void
-link_program(struct gl_context *ctx, struct gl_shader_program *shProg,
-             bool no_error)
+void
+_mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
 {
-   if (!shProg)
+   if (!sh)
       return;
 
-   if (!no_error) {
-      /* From the ARB_transform_feedback2 specification:
-       * "The error INVALID_OPERATION is generated by LinkProgram if <program>
-       * is the name of a program being used by one or more transform feedback
-       * objects, even if the objects are not currently bound or are paused."
-       */
-      if (_mesa_transform_feedback_is_using_program(ctx, shProg)) {
-         _mesa_error(ctx, GL_INVALID_OPERATION,
-                     "glLinkProgram(transform feedback is using the program)");
+   compile_shader_with_flags(ctx, sh, ctx->_Shader->Flags);
+}
+
+
+/**
+ * Wait for glCompileShader() of all the shaders attached to shProg.
+ */
+static void
+wait_for_compiles(struct gl_shader_program *shProg)
+{
+   for (unsigned i = 0; i < shProg->NumShaders; i++)
+      util_queue_fence_wait(&shProg->Shaders[i]->CompileFence);
+}
+
+
+struct wait_for_links_data
+{
+   struct gl_shader *sh;
+   struct util_dynarray programs;
+};
+
+
+static void
+wait_for_links_cb(GLuint key, void *data, void *userData)
+{
+   struct gl_shader_program *shProg = (struct gl_shader_program *) data;
+   struct wait_for_links_data *wait = (struct wait_for_links_data *) userData;
+
+   if (shProg->Type != GL_SHADER_PROGRAM_MESA ||
+       !p_atomic_read(&shProg->LinkFinishPending))
+      return;
+
+   for (unsigned i = 0; i < shProg->NumShaders; i++) {
+      if (shProg->Shaders[i] == wait->sh) {
+         util_dynarray_append(&wait->programs, struct gl_shader_program *,
+                              shProg);
          return;
       }
    }
+}
 
-   unsigned programs_in_use = 0;
-   if (ctx->_Shader)
-      for (unsigned stage = 0; stage < MESA_SHADER_STAGES; stage++) {
-         if (ctx->_Shader->CurrentProgram[stage] &&
-             ctx->_Shader->CurrentProgram[stage]->Id == shProg->Name) {
-            programs_in_use |= 1 << stage;
-         }
+
+/**
+ * Wait until nothing running on a compiler thread looks at sh any more, so
+ * that its source and IR may be replaced.
+ */
+static void
+wait_for_shader(struct gl_context *ctx, struct gl_shader *sh)
+{
+   util_queue_fence_wait(&sh->CompileFence);
+
+   /* Only the shader object itself holds a reference if it isn't attached
+    * to any program.
+    */
+   if (sh->RefCount > 1) {
+      struct wait_for_links_data wait = { sh };
+
+      /* The walk holds the hash table mutex, which other contexts need for
+       * their lookups, so only collect the programs and wait afterwards.
+       */
+      util_dynarray_init(&wait.programs, NULL);
+      _mesa_HashWalk(ctx->Shared->ShaderObjects, wait_for_links_cb, &wait);
+
+      util_dynarray_foreach(&wait.programs, struct gl_shader_program *, prog)
+         util_queue_fence_wait(&(*prog)->LinkFence);
+      util_dynarray_fini(&wait.programs);
    }
+}
 
-   FLUSH_VERTICES(ctx, 0);
-   _mesa_glsl_link_shader(ctx, shProg);
+
+static void
+compile_shader_job(struct gl_context *ctx, GLbitfield glsl_flags, void *data)
+{
+   compile_shader_with_flags(ctx, (struct gl_shader *) data, glsl_flags);
+}
+
+
+/**
+ * Compile a shader on a compiler thread if there is one.
+ */
+static void
+compile_shader(struct gl_context *ctx, struct gl_shader *sh)
+{
+   if (!sh)
+      return;
+
+   wait_for_shader(ctx, sh);
+
+   if (!_mesa_shader_queue_add_job(ctx, &sh->CompileFence,
+                                   compile_shader_job, sh))
+      _mesa_compile_shader(ctx, sh);
+}
+
+
+/**
+ * The part of linking that has to happen on the thread the context is
+ * current on, after _mesa_glsl_link_shader_frontend() is done.
+ */
+static void
+finish_link(struct gl_context *ctx, struct gl_shader_program *shProg,
+            unsigned programs_in_use)
+{
+   /* Before the back end, which may have to link again after a shader
+    * cache miss.
+    */
+   _mesa_release_link_programs(ctx, shProg);
+
+   _mesa_glsl_link_shader_backend(ctx, shProg);
 
    /* From section 7.3 (Program Objects) of the OpenGL 4.5 spec:
     *
@@ -1220,6 +1384,11 @@ link_program(struct gl_context *ctx, struct gl_shader_program *shProg,
       ralloc_free(filename);
    }
 
+   /* Record programs for warming up shader caches ahead of time. */
+   const char *cache_capture_path = get_shader_cache_capture_path();
+   if (cache_capture_path != NULL)
+      shader_cache_capture_program(ctx, shProg, cache_capture_path);
+
    if (shProg->data->LinkStatus == linking_failure &&
        (ctx->_Shader->Flags & GLSL_REPORT_ERRORS)) {
       _mesa_debug(ctx, "Error linking program %u:\n%s\n",
@@ -1243,24 +1412,146 @@ link_program(struct gl_context *ctx, struct gl_shader_program *shProg,
 }
 
 
+static void
+link_program_job(struct gl_context *ctx, GLbitfield glsl_flags, void *data)
+{
+   struct gl_shader_program *shProg = (struct gl_shader_program *) data;
+
+   /* The compiles were queued before this job, in this or another
+    * context's queue, and every queue has its own threads, so this can't
+    * deadlock.
+    */
+   wait_for_compiles(shProg);
+   _mesa_glsl_link_shader_frontend(ctx, shProg, glsl_flags);
+}
+
+
+/**
+ * Make sure a glLinkProgram() of shProg that went to a compiler thread is
+ * complete, including the parts that have to run on this thread.
+ */
+void
+_mesa_wait_for_link(struct gl_context *ctx, struct gl_shader_program *shProg)
+{
+   if (!p_atomic_read(&shProg->LinkFinishPending))
+      return;
+
+   /* Contexts sharing the program may get here at the same time, only one
+    * of them may finish the link and the others must wait until it has.
+    */
+   mtx_lock(&shProg->LinkMutex);
+   if (shProg->LinkFinishPending) {
+      util_queue_fence_wait(&shProg->LinkFence);
+      finish_link(ctx, shProg, 0);
+      p_atomic_set(&shProg->LinkFinishPending, false);
+   }
+   mtx_unlock(&shProg->LinkMutex);
+}
+
+
+/**
+ * Create the programs for the stages the GLSL linker will link, so that a
+ * compiler thread doesn't have to, see _mesa_new_linked_program().
+ */
+static bool
+create_link_programs(struct gl_context *ctx, struct gl_shader_program *shProg)
+{
+   for (unsigned i = 0; i < shProg->NumShaders; i++) {
+      gl_shader_stage stage = shProg->Shaders[i]->Stage;
+
+      if (shProg->LinkPrograms[stage])
+         continue;
+
+      shProg->LinkPrograms[stage] =
+         ctx->Driver.NewProgram(ctx, _mesa_shader_stage_to_program(stage),
+                                shProg->Name, false);
+      if (!shProg->LinkPrograms[stage])
+         return false;
+   }
+
+   return true;
+}
+
+
+/**
+ * Link a program's shaders.
+ *
+ * With \p async, the GLSL linker may run on a compiler thread.  That is
+ * only done for programs that aren't part of the current rendering state,
+ * everything else gets to them through a lookup, which waits for the link.
+ */
+static ALWAYS_INLINE void
+link_program(struct gl_context *ctx, struct gl_shader_program *shProg,
+             bool no_error, bool async)
+{
+   if (!shProg)
+      return;
+
+   if (!no_error) {
+      /* From the ARB_transform_feedback2 specification:
+       * "The error INVALID_OPERATION is generated by LinkProgram if <program>
+       * is the name of a program being used by one or more transform feedback
+       * objects, even if the objects are not currently bound or are paused."
+       */
+      if (_mesa_transform_feedback_is_using_program(ctx, shProg)) {
+         _mesa_error(ctx, GL_INVALID_OPERATION,
+                     "glLinkProgram(transform feedback is using the program)");
+         return;
+      }
+   }
+
+   unsigned programs_in_use = 0;
+   if (ctx->_Shader)
+      for (unsigned stage = 0; stage < MESA_SHADER_STAGES; stage++) {
+         if (ctx->_Shader->CurrentProgram[stage] &&
+             ctx->_Shader->CurrentProgram[stage]->Id == shProg->Name) {
+            programs_in_use |= 1 << stage;
+         }
+   }
+
+   /* glUniform*() goes straight to the active program */
+   if (programs_in_use ||
+       ctx->Shader.ActiveProgram == shProg ||
+       (ctx->_Shader && ctx->_Shader->ActiveProgram == shProg))
+      async = false;
+
+   FLUSH_VERTICES(ctx, 0);
+
+   /* This may call into the driver, so it can't wait for the job */
+   _mesa_clear_shader_program_data(ctx, shProg);
+
+   if (async && create_link_programs(ctx, shProg)) {
+      p_atomic_set(&shProg->LinkFinishPending, true);
+      if (_mesa_shader_queue_add_job(ctx, &shProg->LinkFence,
+                                     link_program_job, shProg))
+         return;
+      p_atomic_set(&shProg->LinkFinishPending, false);
+   }
+
+   wait_for_compiles(shProg);
+   _mesa_glsl_link_shader_frontend(ctx, shProg, ctx->_Shader->Flags);
+   finish_link(ctx, shProg, programs_in_use);
+}
+
+
 static void
 link_program_error(struct gl_context *ctx, struct gl_shader_program *shProg)
 {
-   link_program(ctx, shProg, false);
+   link_program(ctx, shProg, false, true);
 }
 
 
 static void
 link_program_no_error(struct gl_context *ctx, struct gl_shader_program *shProg)
 {
-   link_program(ctx, shProg, true);
+   link_program(ctx, shProg, true, true);
 }
 
 
 void
 _mesa_link_program(struct gl_context *ctx, struct gl_shader_program *shProg)
 {
-   link_program_error(ctx, shProg);
+   link_program(ctx, shProg, false, false);
 }
 
 
@@ -1441,8 +1732,8 @@ _mesa_CompileShader(GLuint shaderObj)
    GET_CURRENT_CONTEXT(ctx);
    if (MESA_VERBOSE & VERBOSE_API)
       _mesa_debug(ctx, "glCompileShader %u\n", shaderObj);
-   _mesa_compile_shader(ctx, _mesa_lookup_shader_err(ctx, shaderObj,
-                                                     "glCompileShader"));
+   compile_shader(ctx, _mesa_lookup_shader_err(ctx, shaderObj,
+                                               "glCompileShader"));
 }
 
 
@@ -1943,6 +2234,7 @@ shader_source(struct gl_context *ctx, GLuint shaderObj, GLsizei count,
    }
 #endif /* ENABLE_SHADER_CACHE */
 
+   wait_for_shader(ctx, sh);
    set_shader_source(sh, source);
 
    free(offsets);
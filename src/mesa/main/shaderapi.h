@@ -37,12 +37,16 @@ extern "C" {
 
 
 struct _glapi_table;
+struct gl_constants;
 struct gl_context;
 struct gl_shader_program;
 
 extern GLbitfield
 _mesa_get_shader_flags(void);
 
+extern void
+_mesa_override_glsl_opt_level(struct gl_constants *consts);
+
 extern const char *
 _mesa_get_shader_capture_path(void);
 
@@ -64,6 +68,9 @@ _mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh);
 extern void
 _mesa_link_program(struct gl_context *ctx, struct gl_shader_program *sh_prog);
 
+extern void
+_mesa_wait_for_link(struct gl_context *ctx, struct gl_shader_program *sh_prog);
+
 extern unsigned
 _mesa_count_active_attribs(struct gl_shader_program *shProg);
 
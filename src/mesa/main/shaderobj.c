@@ -93,6 +93,7 @@ _mesa_init_shader(struct gl_shader *shader)
    shader->info.Geom.VerticesOut = -1;
    shader->info.Geom.InputType = GL_TRIANGLES;
    shader->info.Geom.OutputType = GL_TRIANGLE_STRIP;
+   util_queue_fence_init(&shader->CompileFence);
 }
 
 /**
@@ -121,6 +122,8 @@ _mesa_new_shader(GLuint name, gl_shader_stage stage)
 void
 _mesa_delete_shader(struct gl_context *ctx, struct gl_shader *sh)
 {
+   util_queue_fence_wait(&sh->CompileFence);
+   util_queue_fence_destroy(&sh->CompileFence);
    free((void *)sh->Source);
    free((void *)sh->FallbackSource);
    free(sh->Label);
@@ -140,6 +143,63 @@ _mesa_delete_linked_shader(struct gl_context *ctx,
 }
 
 
+/**
+ * Create the gl_program for a stage the GLSL linker is linking.
+ *
+ * A link running on a compiler thread must not call into the driver, so
+ * link_program() creates the programs on the GL thread before it queues
+ * the link, and the linker picks them up here.
+ */
+struct gl_program *
+_mesa_new_linked_program(struct gl_context *ctx,
+                         struct gl_shader_program *shProg,
+                         gl_shader_stage stage)
+{
+   struct gl_program *prog = shProg->LinkPrograms[stage];
+
+   if (prog) {
+      shProg->LinkPrograms[stage] = NULL;
+      return prog;
+   }
+
+   return ctx->Driver.NewProgram(ctx, _mesa_shader_stage_to_program(stage),
+                                 shProg->Name, false);
+}
+
+
+/**
+ * Free a linked shader that the GLSL linker gave up on.
+ *
+ * Its program is parked in shProg->LinkPrograms rather than deleted, for
+ * the same reason as in _mesa_new_linked_program(), and released by
+ * _mesa_release_link_programs() on the GL thread.
+ */
+void
+_mesa_discard_linked_shader(struct gl_context *ctx,
+                            struct gl_shader_program *shProg,
+                            struct gl_linked_shader *sh)
+{
+   if (!shProg->LinkPrograms[sh->Stage]) {
+      shProg->LinkPrograms[sh->Stage] = sh->Program;
+      sh->Program = NULL;
+   }
+
+   _mesa_delete_linked_shader(ctx, sh);
+}
+
+
+/**
+ * Release the programs left in shProg->LinkPrograms by the last link.
+ */
+void
+_mesa_release_link_programs(struct gl_context *ctx,
+                            struct gl_shader_program *shProg)
+{
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++)
+      _mesa_reference_program(ctx, &shProg->LinkPrograms[i], NULL);
+}
+
+
 /**
  * Lookup a GLSL shader object.
  */
@@ -287,6 +347,9 @@ init_shader_program(struct gl_shader_program *prog)
 
    exec_list_make_empty(&prog->EmptyUniformLocations);
 
+   util_queue_fence_init(&prog->LinkFence);
+   mtx_init(&prog->LinkMutex, mtx_plain);
+
    prog->data->InfoLog = ralloc_strdup(prog->data, "");
 }
 
@@ -433,6 +496,13 @@ void
 _mesa_delete_shader_program(struct gl_context *ctx,
                             struct gl_shader_program *shProg)
 {
+   /* The results of a link that was never waited for are simply dropped */
+   util_queue_fence_wait(&shProg->LinkFence);
+   util_queue_fence_destroy(&shProg->LinkFence);
+   shProg->LinkFinishPending = false;
+   mtx_destroy(&shProg->LinkMutex);
+   _mesa_release_link_programs(ctx, shProg);
+
    _mesa_free_shader_program_data(ctx, shProg);
    if (!shProg->data->cache_fallback)
       _mesa_reference_shader_program_data(ctx, &shProg->data, NULL);
@@ -457,6 +527,8 @@ _mesa_lookup_shader_program(struct gl_context *ctx, GLuint name)
       if (shProg && shProg->Type != GL_SHADER_PROGRAM_MESA) {
          return NULL;
       }
+      if (shProg)
+         _mesa_wait_for_link(ctx, shProg);
       return shProg;
    }
    return NULL;
@@ -464,11 +536,13 @@ _mesa_lookup_shader_program(struct gl_context *ctx, GLuint name)
 
 
 /**
- * As above, but record an error if program is not found.
+ * As _mesa_lookup_shader_program_err(), but don't wait for a link that is
+ * still running on a compiler thread.  Only for the callers that look at
+ * nothing but LinkFence.
  */
 struct gl_shader_program *
-_mesa_lookup_shader_program_err(struct gl_context *ctx, GLuint name,
-                                const char *caller)
+_mesa_lookup_shader_program_err_no_wait(struct gl_context *ctx, GLuint name,
+                                        const char *caller)
 {
    if (!name) {
       _mesa_error(ctx, GL_INVALID_VALUE, "%s", caller);
@@ -490,6 +564,22 @@ _mesa_lookup_shader_program_err(struct gl_context *ctx, GLuint name,
 }
 
 
+/**
+ * As above, but record an error if program is not found.
+ */
+struct gl_shader_program *
+_mesa_lookup_shader_program_err(struct gl_context *ctx, GLuint name,
+                                const char *caller)
+{
+   struct gl_shader_program *shProg =
+      _mesa_lookup_shader_program_err_no_wait(ctx, name, caller);
+
+   if (shProg)
+      _mesa_wait_for_link(ctx, shProg);
+   return shProg;
+}
+
+
 void
 _mesa_init_shader_object_functions(struct dd_function_table *driver)
 {
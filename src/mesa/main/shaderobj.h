@@ -90,6 +90,20 @@ extern void
 _mesa_delete_linked_shader(struct gl_context *ctx,
                            struct gl_linked_shader *sh);
 
+extern struct gl_program *
+_mesa_new_linked_program(struct gl_context *ctx,
+                         struct gl_shader_program *shProg,
+                         gl_shader_stage stage);
+
+extern void
+_mesa_discard_linked_shader(struct gl_context *ctx,
+                            struct gl_shader_program *shProg,
+                            struct gl_linked_shader *sh);
+
+extern void
+_mesa_release_link_programs(struct gl_context *ctx,
+                            struct gl_shader_program *shProg);
+
 extern struct gl_shader_program *
 _mesa_lookup_shader_program(struct gl_context *ctx, GLuint name);
 
@@ -97,6 +111,10 @@ extern struct gl_shader_program *
 _mesa_lookup_shader_program_err(struct gl_context *ctx, GLuint name,
                                 const char *caller);
 
+extern struct gl_shader_program *
+_mesa_lookup_shader_program_err_no_wait(struct gl_context *ctx, GLuint name,
+                                        const char *caller);
+
 extern struct gl_shader_program *
 _mesa_new_shader_program(GLuint name);
 
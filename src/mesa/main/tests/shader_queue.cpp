@@ -0,0 +1,201 @@
+/*
+ * Copyright © 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name shader_queue.cpp
+ *
+ * Link a program on a compiler thread of one context and use it from a
+ * second context sharing it, while the first one looks at it too.  Only one
+ * of them may run the part of the link that was left to the GL thread.
+ */
+
+#include <gtest/gtest.h>
+
+#include "GL/gl.h"
+#include "GL/glext.h"
+#include "main/compiler.h"
+#include "main/api_exec.h"
+#include "main/context.h"
+#include "main/hint.h"
+#include "main/shaderapi.h"
+#include "main/shaderobj.h"
+#include "main/vtxfmt.h"
+#include "program/ir_to_mesa.h"
+#include "drivers/common/driverfuncs.h"
+#include "c11/threads.h"
+#include "util/u_atomic.h"
+
+#include "vbo/vbo.h"
+
+static const char vs_source[] =
+   "#version 120\n"
+   "void main() { gl_Position = gl_Vertex; }\n";
+
+static const char fs_source[] =
+   "#version 120\n"
+   "void main() { gl_FragColor = vec4(1.0); }\n";
+
+static unsigned link_shader_calls;
+
+static GLboolean
+count_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
+{
+   p_atomic_inc(&link_shader_calls);
+   return _mesa_ir_link_shader(ctx, prog);
+}
+
+class ShaderQueue_test : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+   void SetUpCtx(struct gl_context *ctx, struct gl_context *share_list);
+   GLuint CreateShader(GLenum type, const char *source);
+
+   struct gl_config visual;
+   struct dd_function_table driver_functions;
+   struct gl_context ctx[2];
+   GLuint program;
+};
+
+void
+ShaderQueue_test::SetUp()
+{
+   memset(&visual, 0, sizeof(visual));
+   memset(&driver_functions, 0, sizeof(driver_functions));
+
+   _mesa_init_driver_functions(&driver_functions);
+   driver_functions.LinkShader = count_link_shader;
+   link_shader_calls = 0;
+
+   SetUpCtx(&ctx[0], NULL);
+   SetUpCtx(&ctx[1], &ctx[0]);
+   program = 0;
+}
+
+void
+ShaderQueue_test::SetUpCtx(struct gl_context *ctx,
+                           struct gl_context *share_list)
+{
+   memset(ctx, 0, sizeof(*ctx));
+   _mesa_initialize_context(ctx,
+                            API_OPENGL_COMPAT,
+                            &visual,
+                            share_list,
+                            &driver_functions);
+   _vbo_CreateContext(ctx);
+
+   ctx->Version = 21;
+   ctx->Extensions.ARB_vertex_shader = true;
+   ctx->Extensions.ARB_fragment_shader = true;
+
+   _mesa_initialize_dispatch_tables(ctx);
+   _mesa_initialize_vbo_vtxfmt(ctx);
+}
+
+void
+ShaderQueue_test::TearDown()
+{
+   _mesa_make_current(&ctx[0], NULL, NULL);
+   if (program)
+      _mesa_DeleteProgram(program);
+
+   for (unsigned i = 2; i-- > 0; ) {
+      _mesa_make_current(&ctx[i], NULL, NULL);
+      _mesa_free_context_data(&ctx[i]);
+   }
+   _mesa_make_current(NULL, NULL, NULL);
+}
+
+GLuint
+ShaderQueue_test::CreateShader(GLenum type, const char *source)
+{
+   GLuint shader = _mesa_CreateShader(type);
+
+   _mesa_ShaderSource(shader, 1, &source, NULL);
+   _mesa_CompileShader(shader);
+   return shader;
+}
+
+struct use_program_data {
+   struct gl_context *ctx;
+   GLuint program;
+   GLint link_status;
+   struct gl_program *vertex_program;
+};
+
+static int
+use_program(void *data)
+{
+   struct use_program_data *use = (struct use_program_data *) data;
+   struct gl_context *ctx = use->ctx;
+
+   _mesa_make_current(ctx, NULL, NULL);
+
+   _mesa_GetProgramiv(use->program, GL_LINK_STATUS, &use->link_status);
+   _mesa_UseProgram(use->program);
+   use->vertex_program = ctx->_Shader->CurrentProgram[MESA_SHADER_VERTEX];
+   _mesa_UseProgram(0);
+
+   _mesa_make_current(NULL, NULL, NULL);
+   return 0;
+}
+
+TEST_F(ShaderQueue_test, use_from_shared_context)
+{
+   _mesa_make_current(&ctx[0], NULL, NULL);
+   _mesa_MaxShaderCompilerThreadsARB(1);
+
+   GLuint vs = CreateShader(GL_VERTEX_SHADER, vs_source);
+   GLuint fs = CreateShader(GL_FRAGMENT_SHADER, fs_source);
+
+   program = _mesa_CreateProgram();
+   _mesa_AttachShader(program, vs);
+   _mesa_AttachShader(program, fs);
+   _mesa_DeleteShader(vs);
+   _mesa_DeleteShader(fs);
+   _mesa_LinkProgram(program);
+
+   /* Both contexts wait for the link at the same time. */
+   struct use_program_data use = { &ctx[1], program, GL_FALSE, NULL };
+   thrd_t thread;
+   ASSERT_EQ(thrd_success, thrd_create(&thread, use_program, &use));
+
+   GLint link_status = GL_FALSE;
+   _mesa_GetProgramiv(program, GL_LINK_STATUS, &link_status);
+   thrd_join(thread, NULL);
+
+   struct gl_shader_program *shProg =
+      _mesa_lookup_shader_program(&ctx[0], program);
+   ASSERT_NE((void *) NULL, shProg);
+   ASSERT_NE((void *) NULL, shProg->_LinkedShaders[MESA_SHADER_VERTEX]);
+
+   EXPECT_EQ(GL_TRUE, link_status);
+   EXPECT_EQ(GL_TRUE, use.link_status);
+   EXPECT_EQ(shProg->_LinkedShaders[MESA_SHADER_VERTEX]->Program,
+             use.vertex_program);
+   EXPECT_EQ(1u, link_shader_calls);
+
+   /* Nothing is left to do for either context afterwards. */
+   _mesa_GetProgramiv(program, GL_LINK_STATUS, &link_status);
+   EXPECT_EQ(1u, link_shader_calls);
+}
@@ -3088,15 +3088,23 @@ _mesa_ir_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
 }
 
 /**
- * Link a GLSL shader program.  Called via glLinkProgram().
+ * Run the GLSL linker on a program whose link results have already been
+ * cleared.
+ *
+ * Besides the program and its attached shaders, this only needs the
+ * gl_programs of the linked stages.  When those were put into
+ * prog->LinkPrograms beforehand, nothing calls into the driver and this may
+ * run on a compiler thread, see _mesa_new_linked_program().  The GLSL_x
+ * flags are passed in rather than read from ctx->_Shader, which the
+ * application may rebind or delete meanwhile.
  */
 void
-_mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
+_mesa_glsl_link_shader_frontend(struct gl_context *ctx,
+                                struct gl_shader_program *prog,
+                                GLbitfield glsl_flags)
 {
    unsigned int i;
 
-   _mesa_clear_shader_program_data(ctx, prog);
-
    prog->data->LinkStatus = linking_success;
 
    for (i = 0; i < prog->NumShaders; i++) {
@@ -3106,9 +3114,18 @@ _mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
    }
 
    if (prog->data->LinkStatus) {
-      link_shaders(ctx, prog);
+      link_shaders(ctx, prog, glsl_flags);
    }
+}
 
+/**
+ * Hand the output of _mesa_glsl_link_shader_frontend() to the driver.  This
+ * has to happen on the thread the context is current on.
+ */
+void
+_mesa_glsl_link_shader_backend(struct gl_context *ctx,
+                               struct gl_shader_program *prog)
+{
    if (prog->data->LinkStatus) {
       /* Reset sampler validated to true, validation happens via the
        * LinkShader call below.
@@ -3141,4 +3158,15 @@ _mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
 #endif
 }
 
+/**
+ * Link a GLSL shader program.  Called via glLinkProgram().
+ */
+void
+_mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
+{
+   _mesa_clear_shader_program_data(ctx, prog);
+   _mesa_glsl_link_shader_frontend(ctx, prog, ctx->_Shader->Flags);
+   _mesa_glsl_link_shader_backend(ctx, prog);
+}
+
 } /* extern "C" */
@@ -35,6 +35,8 @@ struct gl_shader;
 struct gl_shader_program;
 
 void _mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog);
+void _mesa_glsl_link_shader_frontend(struct gl_context *ctx, struct gl_shader_program *prog, GLbitfield glsl_flags);
+void _mesa_glsl_link_shader_backend(struct gl_context *ctx, struct gl_shader_program *prog);
 GLboolean _mesa_ir_link_shader(struct gl_context *ctx, struct gl_shader_program *prog);
 
 void
@@ -29,6 +29,7 @@
 #include "main/imports.h"
 #include "main/context.h"
 #include "main/macros.h"
+#include "main/shaderapi.h"
 #include "main/version.h"
 
 #include "pipe/p_context.h"
@@ -309,8 +310,10 @@ void st_init_limits(struct pipe_screen *screen,
       options->LowerBufferInterfaceBlocks = true;
    }
 
-   c->GLSLOptimizeConservatively =
-      screen->get_param(screen, PIPE_CAP_GLSL_OPTIMIZE_CONSERVATIVELY);
+   if (screen->get_param(screen, PIPE_CAP_GLSL_OPTIMIZE_CONSERVATIVELY))
+      c->GLSLOptimizeLevel = GLSL_OPT_LEVEL_CONSERVATIVE;
+   _mesa_override_glsl_opt_level(c);
+
    c->LowerTessLevel = true;
    c->LowerCsDerivedVariables = true;
    c->PrimitiveRestartForPatches =
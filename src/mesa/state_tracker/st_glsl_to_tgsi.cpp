@@ -6856,23 +6856,44 @@ st_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
          lower_discard(ir);
       }
 
-      if (ctx->Const.GLSLOptimizeConservatively) {
-         /* Do it once and repeat only if there's unsupported control flow. */
-         do {
-            do_common_optimization(ir, true, true, options,
-                                   ctx->Const.NativeIntegers);
-            lower_if_to_cond_assign((gl_shader_stage)i, ir,
-                                    options->MaxIfDepth, if_threshold);
-         } while (has_unsupported_control_flow(ir, options));
-      } else {
+      /* TGSI has no optimizer of its own to leave the work to, so
+       * GLSL_OPT_LEVEL_FAST runs the common optimizations like
+       * GLSL_OPT_LEVEL_CONSERVATIVE does.
+       */
+      const unsigned max_iterations = ctx->Const.GLSLOptimizeMaxIterations;
+      unsigned iterations = 0;
+      bool progress = false;
+
+      if (ctx->Const.GLSLOptimizeLevel == GLSL_OPT_LEVEL_FULL) {
          /* Repeat it until it stops making changes. */
-         bool progress;
          do {
             progress = do_common_optimization(ir, true, true, options,
                                               ctx->Const.NativeIntegers);
             progress |= lower_if_to_cond_assign((gl_shader_stage)i, ir,
                                                 options->MaxIfDepth, if_threshold);
-         } while (progress);
+            iterations++;
+         } while (progress &&
+                  (max_iterations == 0 || iterations < max_iterations));
+      }
+
+      /* Do it once, and repeat only if there's unsupported control flow.
+       * This also finishes the lowering if the loop above ran out of
+       * iterations.
+       */
+      if (ctx->Const.GLSLOptimizeLevel != GLSL_OPT_LEVEL_FULL || progress) {
+         do {
+            do_common_optimization(ir, true, true, options,
+                                   ctx->Const.NativeIntegers);
+            lower_if_to_cond_assign((gl_shader_stage)i, ir,
+                                    options->MaxIfDepth, if_threshold);
+            iterations++;
+         } while (has_unsupported_control_flow(ir, options));
+      }
+
+      if (ctx->_Shader->Flags & GLSL_OPT_STATS) {
+         fprintf(stderr, "GLSL IR optimization of %s shader in program %u "
+                 "for TGSI: %u iterations\n",
+                 _mesa_shader_stage_to_string(i), prog->Name, iterations);
       }
 
       validate_ir_tree(ir);
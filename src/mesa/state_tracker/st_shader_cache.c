@@ -153,13 +153,20 @@ st_load_tgsi_from_disk_cache(struct gl_context *ctx,
    char sha1_buf[41];
 
    /* Compute and store sha1 for each stage. These will be reused by the
-    * cache store pass if we fail to find the cached tgsi.
+    * cache store pass if we fail to find the cached tgsi. The keys are
+    * hashed together, which is faster than one at a time.
     */
+   void *mem_ctx = ralloc_context(NULL);
+   const void *key_data[MESA_SHADER_STAGES];
+   size_t key_sizes[MESA_SHADER_STAGES];
+   cache_key keys[MESA_SHADER_STAGES];
+   unsigned num_keys = 0;
+
    for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
       if (prog->_LinkedShaders[i] == NULL)
          continue;
 
-      char *buf = ralloc_strdup(NULL, "tgsi_tokens ");
+      char *buf = ralloc_strdup(mem_ctx, "tgsi_tokens ");
       _mesa_sha1_format(sha1_buf,
                         prog->_LinkedShaders[i]->Program->sh.data->sha1);
       ralloc_strcat(&buf, sha1_buf);
@@ -170,28 +177,24 @@ st_load_tgsi_from_disk_cache(struct gl_context *ctx,
          struct st_vertex_program *stvp = (struct st_vertex_program *) glprog;
          stage_sha1[i] = stvp->sha1;
          ralloc_strcat(&buf, " vs");
-         disk_cache_compute_key(ctx->Cache, buf, strlen(buf), stage_sha1[i]);
          break;
       }
       case MESA_SHADER_TESS_CTRL: {
          struct st_common_program *stcp = st_common_program(glprog);
          stage_sha1[i] = stcp->sha1;
          ralloc_strcat(&buf, " tcs");
-         disk_cache_compute_key(ctx->Cache, buf, strlen(buf), stage_sha1[i]);
          break;
       }
       case MESA_SHADER_TESS_EVAL: {
          struct st_common_program *step = st_common_program(glprog);
          stage_sha1[i] = step->sha1;
          ralloc_strcat(&buf, " tes");
-         disk_cache_compute_key(ctx->Cache, buf, strlen(buf), stage_sha1[i]);
          break;
       }
       case MESA_SHADER_GEOMETRY: {
          struct st_common_program *stgp = st_common_program(glprog);
          stage_sha1[i] = stgp->sha1;
          ralloc_strcat(&buf, " gs");
-         disk_cache_compute_key(ctx->Cache, buf, strlen(buf), stage_sha1[i]);
          break;
       }
       case MESA_SHADER_FRAGMENT: {
@@ -199,7 +202,6 @@ st_load_tgsi_from_disk_cache(struct gl_context *ctx,
             (struct st_fragment_program *) glprog;
          stage_sha1[i] = stfp->sha1;
          ralloc_strcat(&buf, " fs");
-         disk_cache_compute_key(ctx->Cache, buf, strlen(buf), stage_sha1[i]);
          break;
       }
       case MESA_SHADER_COMPUTE: {
@@ -207,14 +209,24 @@ st_load_tgsi_from_disk_cache(struct gl_context *ctx,
             (struct st_compute_program *) glprog;
          stage_sha1[i] = stcp->sha1;
          ralloc_strcat(&buf, " cs");
-         disk_cache_compute_key(ctx->Cache, buf, strlen(buf), stage_sha1[i]);
          break;
       }
       default:
          unreachable("Unsupported stage");
       }
 
-      ralloc_free(buf);
+      key_data[num_keys] = buf;
+      key_sizes[num_keys] = strlen(buf);
+      num_keys++;
+   }
+
+   disk_cache_compute_keys(ctx->Cache, num_keys, key_data, key_sizes, keys);
+   ralloc_free(mem_ctx);
+
+   num_keys = 0;
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (prog->_LinkedShaders[i])
+         memcpy(stage_sha1[i], keys[num_keys++], sizeof(cache_key));
    }
 
    /* Now that we have created the sha1 keys that will be used for writting to
@@ -230,6 +242,14 @@ st_load_tgsi_from_disk_cache(struct gl_context *ctx,
       goto fallback_recompile;
    }
 
+   /* Start reading all stages up front, so that the later ones are loaded
+    * on the cache thread while we deserialize the earlier ones.
+    */
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (prog->_LinkedShaders[i])
+         disk_cache_prefetch(ctx->Cache, stage_sha1[i]);
+   }
+
    struct st_context *st = st_context(ctx);
    for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
       if (prog->_LinkedShaders[i] == NULL)
@@ -392,7 +412,8 @@ fallback_recompile:
       fprintf(stderr, "TGSI cache falling back to recompile.\n");
 
    for (unsigned i = 0; i < prog->NumShaders; i++) {
-      _mesa_glsl_compile_shader(ctx, prog->Shaders[i], false, false, true);
+      _mesa_glsl_compile_shader(ctx, prog->Shaders[i], false, false, true,
+                                ctx->_Shader->Flags);
    }
 
    prog->data->skip_cache = true;
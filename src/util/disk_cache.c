@@ -39,10 +39,16 @@
 #include <dirent.h>
 #include "zlib.h"
 
+#ifdef HAVE_ZSTD
+#include "zstd.h"
+#endif
+
 #include "util/crc32.h"
 #include "util/debug.h"
+#include "util/hash_table.h"
 #include "util/rand_xor.h"
 #include "util/u_atomic.h"
+#include "util/u_dynarray.h"
 #include "util/u_queue.h"
 #include "util/mesa-sha1.h"
 #include "util/ralloc.h"
@@ -71,7 +77,17 @@
  * - There is no strict requirement that cache versions be backwards
  *   compatible but effort should be taken to limit disruption where possible.
  */
-#define CACHE_VERSION 1
+#define CACHE_VERSION 2
+
+/* Compression of the data of cache entries, as stored in cache files and
+ * pack records.
+ */
+#define CACHE_CODEC_NONE    0
+#define CACHE_CODEC_DEFLATE 1
+#define CACHE_CODEC_ZSTD    2
+
+/* Maximum amount of prefetched data waiting for disk_cache_get(). */
+#define CACHE_PREFETCH_MAX_SIZE (64 * 1024 * 1024)
 
 struct disk_cache {
    /* The path to the cache directory. */
@@ -99,6 +115,23 @@ struct disk_cache {
    /* Driver cache keys. */
    uint8_t *driver_keys_blob;
    size_t driver_keys_blob_size;
+
+   /* SHA-1 state after hashing driver_keys_blob, every key starts there. */
+   struct mesa_sha1 driver_keys_sha1;
+
+   /* Pack backend state, NULL when every entry is a file of its own. */
+   struct disk_cache_pack *pack;
+
+   /* Compression of new entries (CACHE_CODEC_*) and its level. */
+   uint32_t codec;
+   int codec_level;
+
+   /* disk_cache_prefetch() jobs by cache key, until disk_cache_get() picks
+    * them up, and the size of the data they have loaded.
+    */
+   mtx_t prefetch_mutex;
+   struct hash_table *prefetch_jobs;
+   uint64_t prefetch_size;
 };
 
 struct disk_cache_put_job {
@@ -117,6 +150,18 @@ struct disk_cache_put_job {
    struct cache_item_metadata cache_item_metadata;
 };
 
+struct disk_cache_prefetch_job {
+   struct util_queue_fence fence;
+
+   struct disk_cache *cache;
+
+   cache_key key;
+
+   /* The entry, once the fence is signalled, or NULL if it wasn't found. */
+   void *data;
+   size_t size;
+};
+
 /* Create a directory named 'path' if it does not already exist.
  *
  * Returns: 0 if path already exists as a directory or if created.
@@ -177,6 +222,685 @@ concatenate_and_mkdir(void *ctx, const char *path, const char *name)
       return NULL;
 }
 
+/* Pack backend
+ *
+ * With MESA_GLSL_CACHE_PACK set, entries are appended as records to a
+ * single pack file in the cache directory instead of being written to one
+ * file each.  Records are found through an open-addressed hash table in a
+ * second file that every process maps shared, so a lookup costs no
+ * syscalls, and the pack itself is mapped read-only, so an entry that is
+ * stored uncompressed can be handed out without reading or copying it
+ * (disk_cache_get_mapped()).
+ *
+ * The pack is only ever appended to.  Removing an entry leaves its record
+ * behind as dead space, and eviction happens by copying the live records
+ * into a new pack (disk_cache_compact()), oldest first, which a put also
+ * does when the pack would outgrow the maximum cache size.  The pack and
+ * the index are never truncated or rewritten in place, only replaced by
+ * renaming new files over them, so processes that still have the old ones
+ * mapped keep reading consistent data until their next write notices the
+ * change.  Appends and replacements are serialized across processes with an
+ * flock on a separate lock file.
+ */
+
+#define PACK_FILE_MAGIC   0x4b43504d /* "MPCK" */
+#define PACK_INDEX_MAGIC  0x5849504d /* "MPIX" */
+#define PACK_RECORD_MAGIC 0x4345524d /* "MREC" */
+#define PACK_VERSION 1
+
+/* Number of slots in the index.  The index file is sparse, so only the
+ * pages that hold entries take up room on disk.
+ */
+#define PACK_INDEX_SLOTS (1 << 20)
+#define PACK_INDEX_MASK (PACK_INDEX_SLOTS - 1)
+
+/* The pack is compacted before more slots than this are in use, counting
+ * the ones of removed entries, to keep probe sequences short.
+ */
+#define PACK_INDEX_MAX_USED (PACK_INDEX_SLOTS / 4 * 3)
+
+/* Records start after the pack header, so these offsets are free to mark
+ * slots that were never used and slots of removed entries.
+ */
+#define PACK_SLOT_EMPTY   0
+#define PACK_SLOT_REMOVED 1
+
+/* The pack is mapped up to the next multiple of this size past its end, so
+ * that most appends don't need a new mapping.
+ */
+#define PACK_MAP_ALIGN (64 * 1024 * 1024)
+
+#define PACK_ALIGN(x) (((x) + 7) & ~(uint64_t) 7)
+
+struct pack_file_header {
+   uint32_t magic;
+   uint32_t version;
+
+   /* Random id tying the index to the pack it was built from */
+   uint64_t pack_id;
+};
+
+struct pack_index_header {
+   uint32_t magic;
+   uint32_t version;
+   uint64_t pack_id;
+   uint32_t num_slots;
+
+   /* Slots holding an entry or a removed entry */
+   uint32_t num_used;
+};
+
+struct pack_index_slot {
+   cache_key key;
+
+   /* Size of the whole record */
+   uint32_t size;
+
+   /* Offset of the record in the pack, written last */
+   uint64_t offset;
+};
+
+#define PACK_INDEX_SIZE (sizeof(struct pack_index_header) + \
+                         PACK_INDEX_SLOTS * sizeof(struct pack_index_slot))
+
+/* A record is this header, meta_size bytes of driver keys and cache item
+ * metadata (as in a cache file, padded to 8 bytes), and data_size bytes of
+ * possibly compressed data, padded to 8 bytes as well.
+ */
+struct pack_record_header {
+   uint32_t magic;
+   uint32_t codec;
+   cache_key key;
+   uint32_t meta_size;
+   uint32_t data_size;
+   uint32_t crc32;
+   uint32_t uncompressed_size;
+   uint32_t pad;
+};
+
+struct pack_mapping {
+   void *ptr;
+   size_t size;
+};
+
+struct disk_cache_pack {
+   char *pack_path;
+   char *pack_tmp_path;
+   char *index_path;
+   char *index_tmp_path;
+
+   /* flock'ed around appends, removals and replacing the files */
+   int lock_fd;
+
+   /* The pack we append to and map, and its inode, to notice when another
+    * process has replaced it.
+    */
+   int fd;
+   ino_t ino;
+
+   /* Serializes appends, removals and compaction within this process,
+    * since the flock doesn't.
+    */
+   mtx_t write_mutex;
+
+   /* Protects the fields below against being replaced during a lookup. */
+   mtx_t map_mutex;
+
+   struct pack_index_header *index;
+   struct pack_index_slot *slots;
+
+   uint64_t file_size;
+   uint8_t *map;
+   size_t map_size;
+
+   /* Earlier mappings of the pack.  disk_cache_get_mapped() hands out
+    * pointers into them, so they stay around until the cache is destroyed.
+    */
+   struct util_dynarray old_maps;
+};
+
+static uint64_t
+pack_record_size(const struct pack_record_header *rh)
+{
+   return sizeof(*rh) + (uint64_t) rh->meta_size + PACK_ALIGN(rh->data_size);
+}
+
+static ssize_t
+pwrite_all(int fd, const void *buf, size_t count, off_t offset)
+{
+   const char *out = buf;
+   ssize_t written;
+   size_t done;
+
+   for (done = 0; done < count; done += written) {
+      written = pwrite(fd, out + done, count - done, offset + done);
+      if (written == -1)
+         return -1;
+   }
+   return done;
+}
+
+/* Returns the slot holding \key, or NULL.
+ *
+ * This doesn't need the flock: a slot being written concurrently either
+ * doesn't match yet or points to a record that was completely written
+ * before the slot was, and readers check the key of the record again.
+ */
+static struct pack_index_slot *
+pack_lookup(struct pack_index_slot *slots, const cache_key key)
+{
+   const uint32_t *key_chunk = (const uint32_t *) key;
+   uint32_t i = *key_chunk & PACK_INDEX_MASK;
+
+   for (unsigned n = 0; n < PACK_INDEX_SLOTS; n++) {
+      struct pack_index_slot *slot = &slots[i];
+      uint64_t offset = p_atomic_read(&slot->offset);
+
+      if (offset == PACK_SLOT_EMPTY)
+         return NULL;
+
+      if (offset != PACK_SLOT_REMOVED &&
+          memcmp(slot->key, key, CACHE_KEY_SIZE) == 0)
+         return slot;
+
+      i = (i + 1) & PACK_INDEX_MASK;
+   }
+
+   return NULL;
+}
+
+/* Adds \key, which must not be in the index yet. */
+static void
+pack_insert(struct pack_index_header *index, struct pack_index_slot *slots,
+            const cache_key key, uint64_t offset, uint32_t size)
+{
+   const uint32_t *key_chunk = (const uint32_t *) key;
+   uint32_t i = *key_chunk & PACK_INDEX_MASK;
+
+   while (slots[i].offset != PACK_SLOT_EMPTY &&
+          slots[i].offset != PACK_SLOT_REMOVED)
+      i = (i + 1) & PACK_INDEX_MASK;
+
+   if (slots[i].offset == PACK_SLOT_EMPTY)
+      index->num_used++;
+
+   memcpy(slots[i].key, key, CACHE_KEY_SIZE);
+   slots[i].size = size;
+   p_atomic_set(&slots[i].offset, offset);
+}
+
+/* Fills a new, zeroed index with the records found in the pack.  Entries
+ * that were removed from the pack come back, which only costs some space.
+ */
+static void
+pack_rebuild_index(struct pack_index_header *index,
+                   struct pack_index_slot *slots, int fd, uint64_t pack_id)
+{
+   struct pack_record_header rh;
+   uint64_t offset = sizeof(struct pack_file_header);
+   struct stat sb;
+
+   index->magic = PACK_INDEX_MAGIC;
+   index->version = PACK_VERSION;
+   index->pack_id = pack_id;
+   index->num_slots = PACK_INDEX_SLOTS;
+   index->num_used = 0;
+
+   if (fstat(fd, &sb) == -1)
+      return;
+
+   while (index->num_used < PACK_INDEX_MAX_USED &&
+          pread(fd, &rh, sizeof(rh), offset) == sizeof(rh) &&
+          rh.magic == PACK_RECORD_MAGIC &&
+          offset + pack_record_size(&rh) <= sb.st_size) {
+      uint64_t size = pack_record_size(&rh);
+      struct pack_index_slot *slot = pack_lookup(slots, rh.key);
+
+      if (slot) {
+         slot->size = size;
+         slot->offset = offset;
+      } else {
+         pack_insert(index, slots, rh.key, offset, size);
+      }
+
+      offset += size;
+   }
+}
+
+/* Creates an empty pack under its temporary name.
+ *
+ * Returns the file descriptor, or -1 on failure.
+ */
+static int
+pack_create_tmp(struct disk_cache *cache, uint64_t *pack_id)
+{
+   struct disk_cache_pack *pack = cache->pack;
+   struct pack_file_header fh;
+   int fd;
+
+   fd = open(pack->pack_tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+             0644);
+   if (fd == -1)
+      return -1;
+
+   fh.magic = PACK_FILE_MAGIC;
+   fh.version = PACK_VERSION;
+   fh.pack_id = rand_xorshift128plus(cache->seed_xorshift128plus);
+
+   if (pwrite_all(fd, &fh, sizeof(fh), 0) == -1) {
+      close(fd);
+      unlink(pack->pack_tmp_path);
+      return -1;
+   }
+
+   *pack_id = fh.pack_id;
+   return fd;
+}
+
+/* Opens the pack and its index, creates or rebuilds whichever is missing or
+ * stale, and switches this process over to them.  Must be called with the
+ * flock held.
+ */
+static bool
+pack_open_files(struct disk_cache *cache)
+{
+   struct disk_cache_pack *pack = cache->pack;
+   struct pack_file_header fh;
+   struct pack_index_header ih;
+   struct stat sb;
+   void *index = MAP_FAILED;
+   int fd, index_fd;
+
+   fd = open(pack->pack_path, O_RDWR | O_CLOEXEC);
+   if (fd != -1 &&
+       (pread(fd, &fh, sizeof(fh), 0) != sizeof(fh) ||
+        fh.magic != PACK_FILE_MAGIC || fh.version != PACK_VERSION)) {
+      close(fd);
+      fd = -1;
+   }
+
+   if (fd == -1) {
+      fd = pack_create_tmp(cache, &fh.pack_id);
+      if (fd == -1)
+         return false;
+
+      if (rename(pack->pack_tmp_path, pack->pack_path) == -1) {
+         unlink(pack->pack_tmp_path);
+         close(fd);
+         return false;
+      }
+   }
+
+   if (fstat(fd, &sb) == -1) {
+      close(fd);
+      return false;
+   }
+
+   index_fd = open(pack->index_path, O_RDWR | O_CLOEXEC);
+   if (index_fd != -1) {
+      struct stat index_sb;
+
+      if (fstat(index_fd, &index_sb) == 0 &&
+          index_sb.st_size == PACK_INDEX_SIZE &&
+          pread(index_fd, &ih, sizeof(ih), 0) == sizeof(ih) &&
+          ih.magic == PACK_INDEX_MAGIC && ih.version == PACK_VERSION &&
+          ih.pack_id == fh.pack_id && ih.num_slots == PACK_INDEX_SLOTS) {
+         index = mmap(NULL, PACK_INDEX_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, index_fd, 0);
+      }
+      close(index_fd);
+   }
+
+   /* The index is missing or belongs to another pack, build a new one. */
+   if (index == MAP_FAILED) {
+      index_fd = open(pack->index_tmp_path,
+                      O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+      if (index_fd == -1) {
+         close(fd);
+         return false;
+      }
+
+      if (ftruncate(index_fd, PACK_INDEX_SIZE) == 0) {
+         index = mmap(NULL, PACK_INDEX_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, index_fd, 0);
+      }
+      close(index_fd);
+
+      if (index != MAP_FAILED) {
+         pack_rebuild_index(index, (struct pack_index_slot *)
+                            ((struct pack_index_header *) index + 1),
+                            fd, fh.pack_id);
+
+         if (rename(pack->index_tmp_path, pack->index_path) == -1) {
+            munmap(index, PACK_INDEX_SIZE);
+            index = MAP_FAILED;
+         }
+      }
+
+      if (index == MAP_FAILED) {
+         unlink(pack->index_tmp_path);
+         close(fd);
+         return false;
+      }
+   }
+
+   mtx_lock(&pack->map_mutex);
+
+   if (pack->index)
+      munmap(pack->index, PACK_INDEX_SIZE);
+   pack->index = index;
+   pack->slots = (struct pack_index_slot *) (pack->index + 1);
+
+   if (pack->map) {
+      struct pack_mapping old = { pack->map, pack->map_size };
+      util_dynarray_append(&pack->old_maps, struct pack_mapping, old);
+   }
+   pack->map = NULL;
+   pack->map_size = 0;
+
+   if (pack->fd != -1)
+      close(pack->fd);
+   pack->fd = fd;
+   pack->ino = sb.st_ino;
+   pack->file_size = sb.st_size;
+
+   mtx_unlock(&pack->map_mutex);
+
+   return true;
+}
+
+/* Makes sure that the pack mapping covers [offset, offset + size), which
+ * must lie within the pack.  Must be called with map_mutex held.
+ */
+static bool
+pack_map_range(struct disk_cache_pack *pack, uint64_t offset, uint64_t size)
+{
+   struct stat sb;
+   size_t map_size;
+   void *map;
+
+   if (offset + size > pack->file_size) {
+      if (fstat(pack->fd, &sb) == -1)
+         return false;
+
+      pack->file_size = sb.st_size;
+      if (offset + size > pack->file_size)
+         return false;
+   }
+
+   if (offset + size <= pack->map_size)
+      return true;
+
+   map_size = (pack->file_size + PACK_MAP_ALIGN - 1) & ~(uint64_t)
+      (PACK_MAP_ALIGN - 1);
+   map = mmap(NULL, map_size, PROT_READ, MAP_SHARED, pack->fd, 0);
+   if (map == MAP_FAILED)
+      return false;
+
+   if (pack->map) {
+      struct pack_mapping old = { pack->map, pack->map_size };
+      util_dynarray_append(&pack->old_maps, struct pack_mapping, old);
+   }
+   pack->map = map;
+   pack->map_size = map_size;
+
+   return true;
+}
+
+/* Takes the pack for writing, picking up the files another process may
+ * have replaced since we opened them.
+ */
+static bool
+pack_lock(struct disk_cache *cache)
+{
+   struct disk_cache_pack *pack = cache->pack;
+   struct stat sb;
+
+   mtx_lock(&pack->write_mutex);
+
+   if (flock(pack->lock_fd, LOCK_EX) == -1) {
+      mtx_unlock(&pack->write_mutex);
+      return false;
+   }
+
+   if (stat(pack->pack_path, &sb) == -1 || sb.st_ino != pack->ino) {
+      if (!pack_open_files(cache)) {
+         flock(pack->lock_fd, LOCK_UN);
+         mtx_unlock(&pack->write_mutex);
+         return false;
+      }
+   }
+
+   return true;
+}
+
+static void
+pack_unlock(struct disk_cache *cache)
+{
+   flock(cache->pack->lock_fd, LOCK_UN);
+   mtx_unlock(&cache->pack->write_mutex);
+}
+
+struct pack_live_record {
+   uint64_t offset;
+   uint32_t size;
+};
+
+static int
+compare_live_record_offset(const void *a, const void *b)
+{
+   const struct pack_live_record *ra = a, *rb = b;
+
+   return ra->offset < rb->offset ? -1 : ra->offset > rb->offset;
+}
+
+/* Replaces the pack with one holding only its live records, dropping the
+ * oldest ones until the pack fits in \target bytes.  Must be called with
+ * the pack locked.
+ */
+static void
+pack_compact_locked(struct disk_cache *cache, uint64_t target)
+{
+   struct disk_cache_pack *pack = cache->pack;
+   struct pack_live_record *records;
+   unsigned count = 0, first = 0, i;
+   uint64_t size, end = 0, offset, pack_id;
+   const uint8_t *map;
+   bool mapped;
+   int fd;
+
+   records = malloc(MAX2(pack->index->num_used, 1) * sizeof(*records));
+   if (records == NULL)
+      return;
+
+   for (i = 0; i < PACK_INDEX_SLOTS && count < pack->index->num_used; i++) {
+      if (pack->slots[i].offset <= PACK_SLOT_REMOVED)
+         continue;
+
+      records[count].offset = pack->slots[i].offset;
+      records[count].size = pack->slots[i].size;
+      end = MAX2(end, records[count].offset + records[count].size);
+      count++;
+   }
+
+   qsort(records, count, sizeof(*records), compare_live_record_offset);
+
+   size = sizeof(struct pack_file_header);
+   for (i = 0; i < count; i++)
+      size += records[i].size;
+
+   while (first < count && size > target)
+      size -= records[first++].size;
+
+   /* The mapping stays valid after we drop map_mutex, see old_maps. */
+   mtx_lock(&pack->map_mutex);
+   mapped = pack_map_range(pack, 0, end);
+   map = pack->map;
+   mtx_unlock(&pack->map_mutex);
+
+   if (!mapped)
+      goto done;
+
+   fd = pack_create_tmp(cache, &pack_id);
+   if (fd == -1)
+      goto done;
+
+   offset = sizeof(struct pack_file_header);
+   for (i = first; i < count; i++) {
+      const struct pack_record_header *rh =
+         (const struct pack_record_header *) (map + records[i].offset);
+
+      if (rh->magic != PACK_RECORD_MAGIC ||
+          pack_record_size(rh) != records[i].size)
+         continue;
+
+      if (pwrite_all(fd, rh, records[i].size, offset) == -1) {
+         close(fd);
+         unlink(pack->pack_tmp_path);
+         goto done;
+      }
+      offset += records[i].size;
+   }
+
+   close(fd);
+
+   if (rename(pack->pack_tmp_path, pack->pack_path) == -1) {
+      unlink(pack->pack_tmp_path);
+      goto done;
+   }
+
+   /* This builds the index of the new pack. */
+   pack_open_files(cache);
+
+ done:
+   free(records);
+}
+
+static void
+pack_destroy(struct disk_cache *cache)
+{
+   struct disk_cache_pack *pack = cache->pack;
+
+   util_dynarray_foreach(&pack->old_maps, struct pack_mapping, old)
+      munmap(old->ptr, old->size);
+   if (pack->map)
+      munmap(pack->map, pack->map_size);
+   if (pack->index)
+      munmap(pack->index, PACK_INDEX_SIZE);
+   if (pack->fd != -1)
+      close(pack->fd);
+   close(pack->lock_fd);
+
+   mtx_destroy(&pack->write_mutex);
+   mtx_destroy(&pack->map_mutex);
+
+   ralloc_free(pack);
+   cache->pack = NULL;
+}
+
+static bool
+pack_init(struct disk_cache *cache)
+{
+   struct disk_cache_pack *pack;
+   char *lock_path;
+
+   pack = rzalloc(cache, struct disk_cache_pack);
+   if (pack == NULL)
+      return false;
+
+   pack->pack_path = ralloc_asprintf(pack, "%s/pack", cache->path);
+   pack->pack_tmp_path = ralloc_asprintf(pack, "%s/pack.tmp", cache->path);
+   pack->index_path = ralloc_asprintf(pack, "%s/pack.idx", cache->path);
+   pack->index_tmp_path = ralloc_asprintf(pack, "%s/pack.idx.tmp",
+                                          cache->path);
+   lock_path = ralloc_asprintf(pack, "%s/pack.lock", cache->path);
+   if (!pack->pack_path || !pack->pack_tmp_path || !pack->index_path ||
+       !pack->index_tmp_path || !lock_path) {
+      ralloc_free(pack);
+      return false;
+   }
+
+   pack->lock_fd = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+   if (pack->lock_fd == -1) {
+      ralloc_free(pack);
+      return false;
+   }
+
+   pack->fd = -1;
+   mtx_init(&pack->write_mutex, mtx_plain);
+   mtx_init(&pack->map_mutex, mtx_plain);
+   util_dynarray_init(&pack->old_maps, pack);
+   cache->pack = pack;
+
+   if (flock(pack->lock_fd, LOCK_EX) == -1) {
+      pack_destroy(cache);
+      return false;
+   }
+
+   if (!pack_open_files(cache)) {
+      flock(pack->lock_fd, LOCK_UN);
+      pack_destroy(cache);
+      return false;
+   }
+
+   flock(pack->lock_fd, LOCK_UN);
+
+   return true;
+}
+
+static uint32_t
+cache_key_hash(const void *key)
+{
+   return *(const uint32_t *) key;
+}
+
+static bool
+cache_key_equals(const void *a, const void *b)
+{
+   return memcmp(a, b, CACHE_KEY_SIZE) == 0;
+}
+
+/* Picks the compression of new entries from MESA_GLSL_CACHE_COMPRESSION,
+ * which is a codec name optionally followed by a colon and a level.
+ */
+static void
+select_codec(struct disk_cache *cache)
+{
+   const char *str = getenv("MESA_GLSL_CACHE_COMPRESSION");
+
+   /* The defaults favor speed over size */
+#ifdef HAVE_ZSTD
+   cache->codec = CACHE_CODEC_ZSTD;
+   cache->codec_level = 1;
+#else
+   cache->codec = CACHE_CODEC_DEFLATE;
+   cache->codec_level = Z_BEST_SPEED;
+#endif
+
+   if (str == NULL)
+      return;
+
+   size_t len = strcspn(str, ":");
+   if (len == 4 && strncmp(str, "none", len) == 0) {
+      cache->codec = CACHE_CODEC_NONE;
+   } else if (len == 7 && strncmp(str, "deflate", len) == 0) {
+      cache->codec = CACHE_CODEC_DEFLATE;
+      cache->codec_level = Z_BEST_SPEED;
+#ifdef HAVE_ZSTD
+   } else if (len == 4 && strncmp(str, "zstd", len) == 0) {
+      cache->codec = CACHE_CODEC_ZSTD;
+      cache->codec_level = 1;
+#endif
+   } else {
+      fprintf(stderr, "Unsupported shader cache compression \"%s\"---using "
+                      "the default.\n", str);
+      return;
+   }
+
+   if (str[len] == ':')
+      cache->codec_level = strtol(str + len + 1, NULL, 10);
+}
+
 #define DRV_KEY_CPY(_dst, _src, _src_size) \
 do {                                       \
    memcpy(_dst, _src, _src_size);          \
@@ -276,6 +1000,17 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
    if (cache == NULL)
       goto fail;
 
+   cache->pack = NULL;
+
+   cache->prefetch_jobs = _mesa_hash_table_create(cache, cache_key_hash,
+                                                  cache_key_equals);
+   if (cache->prefetch_jobs == NULL)
+      goto fail;
+   cache->prefetch_size = 0;
+   mtx_init(&cache->prefetch_mutex, mtx_plain);
+
+   select_codec(cache);
+
    cache->path = ralloc_strdup(cache, path);
    if (cache->path == NULL)
       goto fail;
@@ -360,7 +1095,9 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
    cache->max_size = max_size;
 
    /* 1 thread was chosen because we don't really care about getting things
-    * to disk quickly just that it's not blocking other tasks.
+    * to disk quickly just that it's not blocking other tasks. It's not taken
+    * from the shared pool, whose threads can't run at SCHED_IDLE, so that
+    * cache writes never compete with the application for CPU time.
     *
     * The queue will resize automatically when it's full, so adding new jobs
     * doesn't stall.
@@ -401,9 +1138,19 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
    DRV_KEY_CPY(drv_key_blob, &ptr_size, ptr_size_size)
    DRV_KEY_CPY(drv_key_blob, &driver_flags, driver_flags_size)
 
+   _mesa_sha1_init(&cache->driver_keys_sha1);
+   _mesa_sha1_update(&cache->driver_keys_sha1, cache->driver_keys_blob,
+                     cache->driver_keys_blob_size);
+
    /* Seed our rand function */
    s_rand_xorshift128plus(cache->seed_xorshift128plus, true);
 
+   /* Store entries in a pack file rather than one file each on request. */
+   if (env_var_as_boolean("MESA_GLSL_CACHE_PACK", false)) {
+      if (!pack_init(cache))
+         goto fail;
+   }
+
    ralloc_free(local);
 
    return cache;
@@ -418,12 +1165,45 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
    return NULL;
 }
 
+static void
+cache_queue_barrier(void *job, int thread_index)
+{
+}
+
 void
 disk_cache_destroy(struct disk_cache *cache)
 {
    if (cache) {
+      /* Destroying the queue drops the jobs it still holds. The queue has a
+       * single thread, so once an empty job has run, every entry queued
+       * before it has reached the disk.
+       */
+      struct util_queue_fence fence;
+      util_queue_fence_init(&fence);
+      util_queue_add_job(&cache->cache_queue, cache, &fence,
+                         cache_queue_barrier, NULL);
+      util_queue_fence_wait(&fence);
+      util_queue_fence_destroy(&fence);
+
       util_queue_destroy(&cache->cache_queue);
       munmap(cache->index_mmap, cache->index_mmap_size);
+
+      if (cache->pack)
+         pack_destroy(cache);
+
+      /* Prefetched entries nobody asked for. The queue is gone, so all the
+       * jobs have finished.
+       */
+      struct hash_entry *entry;
+      hash_table_foreach(cache->prefetch_jobs, entry) {
+         struct disk_cache_prefetch_job *pf_job =
+            (struct disk_cache_prefetch_job *) entry->data;
+
+         free(pf_job->data);
+         util_queue_fence_destroy(&pf_job->fence);
+         free(pf_job);
+      }
+      mtx_destroy(&cache->prefetch_mutex);
    }
 
    ralloc_free(cache);
@@ -655,6 +1435,17 @@ disk_cache_remove(struct disk_cache *cache, const cache_key key)
 {
    struct stat sb;
 
+   if (cache->pack) {
+      if (pack_lock(cache)) {
+         struct pack_index_slot *slot = pack_lookup(cache->pack->slots, key);
+         if (slot)
+            p_atomic_set(&slot->offset, PACK_SLOT_REMOVED);
+
+         pack_unlock(cache);
+      }
+      return;
+   }
+
    char *filename = get_cache_file(cache, key);
    if (filename == NULL) {
       return;
@@ -702,73 +1493,52 @@ write_all(int fd, const void *buf, size_t count)
    return done;
 }
 
-/* From the zlib docs:
- *    "If the memory is available, buffers sizes on the order of 128K or 256K
- *    bytes should be used."
- */
-#define BUFSIZE 256 * 1024
+/* Returns the largest size the cache's codec can compress \size bytes to. */
+static size_t
+compress_bound(struct disk_cache *cache, size_t size)
+{
+   switch (cache->codec) {
+   case CACHE_CODEC_DEFLATE:
+      return compressBound(size);
+#ifdef HAVE_ZSTD
+   case CACHE_CODEC_ZSTD:
+      return ZSTD_compressBound(size);
+#endif
+   default:
+      return size;
+   }
+}
 
 /**
- * Compresses cache entry in memory and writes it to disk. Returns the size
- * of the data written to disk.
+ * Compresses cache entry in memory with the cache's codec. \out_data must be
+ * compress_bound() bytes large. Returns true if successful.
  */
-static size_t
-deflate_and_write_to_disk(const void *in_data, size_t in_data_size, int dest,
-                          const char *filename)
+static bool
+compress_cache_data(struct disk_cache *cache, const void *in_data,
+                    size_t in_data_size, void *out_data, size_t *out_data_size)
 {
-   unsigned char out[BUFSIZE];
-
-   /* allocate deflate state */
-   z_stream strm;
-   strm.zalloc = Z_NULL;
-   strm.zfree = Z_NULL;
-   strm.opaque = Z_NULL;
-   strm.next_in = (uint8_t *) in_data;
-   strm.avail_in = in_data_size;
-
-   int ret = deflateInit(&strm, Z_BEST_COMPRESSION);
-   if (ret != Z_OK)
-       return 0;
-
-   /* compress until end of in_data */
-   size_t compressed_size = 0;
-   int flush;
-   do {
-      int remaining = in_data_size - BUFSIZE;
-      flush = remaining > 0 ? Z_NO_FLUSH : Z_FINISH;
-      in_data_size -= BUFSIZE;
-
-      /* Run deflate() on input until the output buffer is not full (which
-       * means there is no more data to deflate).
-       */
-      do {
-         strm.avail_out = BUFSIZE;
-         strm.next_out = out;
-
-         ret = deflate(&strm, flush);    /* no bad return value */
-         assert(ret != Z_STREAM_ERROR);  /* state not clobbered */
-
-         size_t have = BUFSIZE - strm.avail_out;
-         compressed_size += have;
-
-         ssize_t written = write_all(dest, out, have);
-         if (written == -1) {
-            (void)deflateEnd(&strm);
-            return 0;
-         }
-      } while (strm.avail_out == 0);
-
-      /* all input should be used */
-      assert(strm.avail_in == 0);
-
-   } while (flush != Z_FINISH);
-
-   /* stream should be complete */
-   assert(ret == Z_STREAM_END);
-
-   /* clean up and return */
-   (void)deflateEnd(&strm);
-   return compressed_size;
+   switch (cache->codec) {
+   case CACHE_CODEC_DEFLATE: {
+      uLongf size = compressBound(in_data_size);
+      if (compress2(out_data, &size, in_data, in_data_size,
+                    cache->codec_level) != Z_OK)
+         return false;
+      *out_data_size = size;
+      return true;
+   }
+#ifdef HAVE_ZSTD
+   case CACHE_CODEC_ZSTD: {
+      size_t size = ZSTD_compress(out_data, ZSTD_compressBound(in_data_size),
+                                  in_data, in_data_size, cache->codec_level);
+      if (ZSTD_isError(size))
+         return false;
+      *out_data_size = size;
+      return true;
+   }
+#endif
+   default:
+      return false;
+   }
 }
 
 static struct disk_cache_put_job *
@@ -831,8 +1601,113 @@ destroy_put_job(void *job, int thread_index)
 struct cache_entry_file_data {
    uint32_t crc32;
    uint32_t uncompressed_size;
+   uint32_t codec;
 };
 
+/* Appends the job's entry to the pack. */
+static void
+pack_put(struct disk_cache_put_job *dc_job)
+{
+   struct disk_cache *cache = dc_job->cache;
+   struct disk_cache_pack *pack = cache->pack;
+   struct cache_item_metadata *md = &dc_job->cache_item_metadata;
+   struct pack_record_header *rh;
+   uint8_t *record, *meta, *data;
+   uint64_t record_size, end;
+   size_t meta_size, compressed_size;
+   struct stat sb;
+
+   if (dc_job->size > UINT32_MAX)
+      return;
+
+   /* The same metadata as at the start of a cache file */
+   meta_size = cache->driver_keys_blob_size + sizeof(uint32_t);
+   if (md->type == CACHE_ITEM_TYPE_GLSL)
+      meta_size += sizeof(uint32_t) + md->num_keys * sizeof(cache_key);
+   meta_size = PACK_ALIGN(meta_size);
+
+   record = calloc(1, sizeof(*rh) + meta_size +
+                   PACK_ALIGN(MAX2(compress_bound(cache, dc_job->size),
+                                   dc_job->size)));
+   if (record == NULL)
+      return;
+
+   rh = (struct pack_record_header *) record;
+   rh->magic = PACK_RECORD_MAGIC;
+   memcpy(rh->key, dc_job->key, CACHE_KEY_SIZE);
+   rh->meta_size = meta_size;
+   rh->crc32 = util_hash_crc32(dc_job->data, dc_job->size);
+   rh->uncompressed_size = dc_job->size;
+
+   meta = record + sizeof(*rh);
+   memcpy(meta, cache->driver_keys_blob, cache->driver_keys_blob_size);
+   meta += cache->driver_keys_blob_size;
+   memcpy(meta, &md->type, sizeof(uint32_t));
+   meta += sizeof(uint32_t);
+   if (md->type == CACHE_ITEM_TYPE_GLSL) {
+      memcpy(meta, &md->num_keys, sizeof(uint32_t));
+      meta += sizeof(uint32_t);
+      memcpy(meta, md->keys, md->num_keys * sizeof(cache_key));
+   }
+
+   /* Entries that don't get any smaller are kept as they are, which also
+    * lets disk_cache_get_mapped() hand them out directly.
+    */
+   data = record + sizeof(*rh) + meta_size;
+   if (cache->codec != CACHE_CODEC_NONE &&
+       compress_cache_data(cache, dc_job->data, dc_job->size, data,
+                           &compressed_size) &&
+       compressed_size < dc_job->size) {
+      rh->codec = cache->codec;
+      rh->data_size = compressed_size;
+   } else {
+      rh->codec = CACHE_CODEC_NONE;
+      rh->data_size = dc_job->size;
+      memcpy(data, dc_job->data, dc_job->size);
+   }
+
+   record_size = pack_record_size(rh);
+
+   if (!pack_lock(cache))
+      goto done;
+
+   /* Another process may have stored the same entry in the meantime. */
+   if (pack_lookup(pack->slots, dc_job->key))
+      goto unlock;
+
+   if (fstat(pack->fd, &sb) == -1)
+      goto unlock;
+   end = PACK_ALIGN(sb.st_size);
+
+   if (end + record_size > cache->max_size ||
+       pack->index->num_used >= PACK_INDEX_MAX_USED) {
+      /* Free up a quarter of the cache so that this doesn't happen again on
+       * the next put.
+       */
+      uint64_t target = cache->max_size / 4 * 3;
+      pack_compact_locked(cache, target > record_size ?
+                                 target - record_size : 0);
+
+      if (fstat(pack->fd, &sb) == -1)
+         goto unlock;
+      end = PACK_ALIGN(sb.st_size);
+
+      if (end + record_size > cache->max_size ||
+          pack->index->num_used >= PACK_INDEX_MAX_USED)
+         goto unlock;
+   }
+
+   if (pwrite_all(pack->fd, record, record_size, end) == -1)
+      goto unlock;
+
+   pack_insert(pack->index, pack->slots, dc_job->key, end, record_size);
+
+ unlock:
+   pack_unlock(cache);
+ done:
+   free(record);
+}
+
 static void
 cache_put(void *job, int thread_index)
 {
@@ -841,8 +1716,14 @@ cache_put(void *job, int thread_index)
    int fd = -1, fd_final = -1, err, ret;
    unsigned i = 0;
    char *filename = NULL, *filename_tmp = NULL;
+   void *compressed = NULL;
    struct disk_cache_put_job *dc_job = (struct disk_cache_put_job *) job;
 
+   if (dc_job->cache->pack) {
+      pack_put(dc_job);
+      return;
+   }
+
    filename = get_cache_file(dc_job->cache, dc_job->key);
    if (filename == NULL)
       goto done;
@@ -946,6 +1827,20 @@ cache_put(void *job, int thread_index)
    struct cache_entry_file_data cf_data;
    cf_data.crc32 = util_hash_crc32(dc_job->data, dc_job->size);
    cf_data.uncompressed_size = dc_job->size;
+   cf_data.codec = dc_job->cache->codec;
+
+   const void *file_data = dc_job->data;
+   size_t file_data_size = dc_job->size;
+   if (cf_data.codec != CACHE_CODEC_NONE) {
+      compressed = malloc(compress_bound(dc_job->cache, dc_job->size));
+      if (compressed == NULL ||
+          !compress_cache_data(dc_job->cache, dc_job->data, dc_job->size,
+                               compressed, &file_data_size)) {
+         unlink(filename_tmp);
+         goto done;
+      }
+      file_data = compressed;
+   }
 
    size_t cf_data_size = sizeof(cf_data);
    ret = write_all(fd, &cf_data, cf_data_size);
@@ -958,9 +1853,8 @@ cache_put(void *job, int thread_index)
     * rename them atomically to the destination filename, and also
     * perform an atomic increment of the total cache size.
     */
-   size_t file_size = deflate_and_write_to_disk(dc_job->data, dc_job->size,
-                                                fd, filename_tmp);
-   if (file_size == 0) {
+   ret = write_all(fd, file_data, file_data_size);
+   if (ret == -1) {
       unlink(filename_tmp);
       goto done;
    }
@@ -991,6 +1885,7 @@ cache_put(void *job, int thread_index)
       free(filename_tmp);
    if (filename)
       free(filename);
+   free(compressed);
 }
 
 void
@@ -1047,8 +1942,116 @@ inflate_cache_data(uint8_t *in_data, size_t in_data_size,
    return true;
 }
 
-void *
-disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
+/**
+ * Decompresses cache entry stored with \codec, returns true if successful.
+ */
+static bool
+decompress_cache_data(uint32_t codec, const uint8_t *in_data,
+                      size_t in_data_size, uint8_t *out_data,
+                      size_t out_data_size)
+{
+   switch (codec) {
+   case CACHE_CODEC_NONE:
+      if (in_data_size != out_data_size)
+         return false;
+      memcpy(out_data, in_data, in_data_size);
+      return true;
+   case CACHE_CODEC_DEFLATE:
+      return inflate_cache_data((uint8_t *) in_data, in_data_size, out_data,
+                                out_data_size);
+#ifdef HAVE_ZSTD
+   case CACHE_CODEC_ZSTD:
+      return ZSTD_decompress(out_data, out_data_size, in_data,
+                             in_data_size) == out_data_size;
+#endif
+   default:
+      return false;
+   }
+}
+
+/* Finds the record of \key in the pack and checks that it was written for
+ * this driver.  Returns a pointer into the pack mapping, or NULL.
+ */
+static const struct pack_record_header *
+pack_find_record(struct disk_cache *cache, const cache_key key)
+{
+   struct disk_cache_pack *pack = cache->pack;
+   const struct pack_record_header *rh = NULL;
+   struct pack_index_slot *slot;
+
+   mtx_lock(&pack->map_mutex);
+
+   slot = pack_lookup(pack->slots, key);
+   if (slot) {
+      uint64_t offset = p_atomic_read(&slot->offset);
+      uint32_t size = slot->size;
+
+      if (offset > PACK_SLOT_REMOVED && size >= sizeof(*rh) &&
+          pack_map_range(pack, offset, size)) {
+         rh = (const struct pack_record_header *) (pack->map + offset);
+
+         /* The slot may have been reused while we were reading it */
+         if (rh->magic != PACK_RECORD_MAGIC ||
+             memcmp(rh->key, key, CACHE_KEY_SIZE) != 0 ||
+             pack_record_size(rh) != size)
+            rh = NULL;
+      }
+   }
+
+   mtx_unlock(&pack->map_mutex);
+
+   if (rh == NULL)
+      return NULL;
+
+   if (rh->meta_size < cache->driver_keys_blob_size + sizeof(uint32_t))
+      return NULL;
+
+   /* Check for extremely unlikely hash collisions */
+   if (memcmp(rh + 1, cache->driver_keys_blob,
+              cache->driver_keys_blob_size) != 0) {
+      assert(!"Mesa cache keys mismatch!");
+      return NULL;
+   }
+
+   return rh;
+}
+
+static void *
+pack_get(struct disk_cache *cache, const cache_key key, size_t *size)
+{
+   const struct pack_record_header *rh;
+   const uint8_t *stored;
+   uint8_t *data;
+
+   rh = pack_find_record(cache, key);
+   if (rh == NULL)
+      return NULL;
+
+   data = malloc(rh->uncompressed_size);
+   if (data == NULL)
+      return NULL;
+
+   stored = (const uint8_t *) (rh + 1) + rh->meta_size;
+   if (!decompress_cache_data(rh->codec, stored, rh->data_size, data,
+                              rh->uncompressed_size))
+      goto fail;
+
+   /* Check the data for corruption */
+   if (rh->crc32 != util_hash_crc32(data, rh->uncompressed_size))
+      goto fail;
+
+   if (size)
+      *size = rh->uncompressed_size;
+
+   return data;
+
+ fail:
+   free(data);
+   return NULL;
+}
+
+static void *
+read_cache_entry(struct disk_cache *cache, const cache_key key, size_t *size)
 {
    int fd = -1, ret;
    struct stat sb;
@@ -1060,6 +2063,9 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
    if (size)
       *size = 0;
 
+   if (cache->pack)
+      return pack_get(cache, key, size);
+
    filename = get_cache_file(cache, key);
    if (filename == NULL)
       goto fail;
@@ -1132,11 +2138,19 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
    if (ret == -1)
       goto fail;
 
-   /* Uncompress the cache data */
-   uncompressed_data = malloc(cf_data.uncompressed_size);
-   if (!inflate_cache_data(data, cache_data_size, uncompressed_data,
-                           cf_data.uncompressed_size))
-      goto fail;
+   /* Uncompress the cache data, or use it directly if it is stored as is */
+   if (cf_data.codec == CACHE_CODEC_NONE &&
+       cache_data_size == cf_data.uncompressed_size) {
+      uncompressed_data = data;
+      data = NULL;
+   } else {
+      uncompressed_data = malloc(cf_data.uncompressed_size);
+      if (!uncompressed_data ||
+          !decompress_cache_data(cf_data.codec, data, cache_data_size,
+                                 uncompressed_data,
+                                 cf_data.uncompressed_size))
+         goto fail;
+   }
 
    /* Check the data for corruption */
    if (cf_data.crc32 != util_hash_crc32(uncompressed_data,
@@ -1167,6 +2181,132 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
    return NULL;
 }
 
+static void
+cache_prefetch(void *job, int thread_index)
+{
+   struct disk_cache_prefetch_job *pf_job =
+      (struct disk_cache_prefetch_job *) job;
+   struct disk_cache *cache = pf_job->cache;
+
+   pf_job->data = read_cache_entry(cache, pf_job->key, &pf_job->size);
+   if (pf_job->data == NULL)
+      return;
+
+   /* Don't let entries that nobody asks for pile up */
+   mtx_lock(&cache->prefetch_mutex);
+   if (cache->prefetch_size + pf_job->size > CACHE_PREFETCH_MAX_SIZE) {
+      free(pf_job->data);
+      pf_job->data = NULL;
+   } else {
+      cache->prefetch_size += pf_job->size;
+   }
+   mtx_unlock(&cache->prefetch_mutex);
+}
+
+void
+disk_cache_prefetch(struct disk_cache *cache, const cache_key key)
+{
+   struct disk_cache_prefetch_job *pf_job;
+
+   mtx_lock(&cache->prefetch_mutex);
+
+   if (_mesa_hash_table_search(cache->prefetch_jobs, key) == NULL) {
+      pf_job = (struct disk_cache_prefetch_job *) malloc(sizeof(*pf_job));
+      if (pf_job) {
+         pf_job->cache = cache;
+         memcpy(pf_job->key, key, sizeof(cache_key));
+         pf_job->data = NULL;
+         pf_job->size = 0;
+
+         /* Queued with the lock held, so that disk_cache_get() can't wait
+          * for the fence before the job is on the queue.
+          */
+         util_queue_fence_init(&pf_job->fence);
+         _mesa_hash_table_insert(cache->prefetch_jobs, pf_job->key, pf_job);
+         util_queue_add_job(&cache->cache_queue, pf_job, &pf_job->fence,
+                            cache_prefetch, NULL);
+      }
+   }
+
+   mtx_unlock(&cache->prefetch_mutex);
+}
+
+void *
+disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
+{
+   struct disk_cache_prefetch_job *pf_job = NULL;
+   struct hash_entry *entry;
+   void *data;
+
+   mtx_lock(&cache->prefetch_mutex);
+   entry = _mesa_hash_table_search(cache->prefetch_jobs, key);
+   if (entry) {
+      pf_job = (struct disk_cache_prefetch_job *) entry->data;
+      _mesa_hash_table_remove(cache->prefetch_jobs, entry);
+   }
+   mtx_unlock(&cache->prefetch_mutex);
+
+   if (pf_job == NULL)
+      return read_cache_entry(cache, key, size);
+
+   util_queue_fence_wait(&pf_job->fence);
+   data = pf_job->data;
+   if (size)
+      *size = data ? pf_job->size : 0;
+
+   if (data) {
+      mtx_lock(&cache->prefetch_mutex);
+      cache->prefetch_size -= pf_job->size;
+      mtx_unlock(&cache->prefetch_mutex);
+   }
+
+   util_queue_fence_destroy(&pf_job->fence);
+   free(pf_job);
+
+   /* The entry may have been stored after the prefetch missed it */
+   return data ? data : read_cache_entry(cache, key, size);
+}
+
+const void *
+disk_cache_get_mapped(struct disk_cache *cache, const cache_key key,
+                      size_t *size)
+{
+   const struct pack_record_header *rh;
+   const uint8_t *data;
+
+   if (size)
+      *size = 0;
+
+   if (cache->pack == NULL)
+      return NULL;
+
+   rh = pack_find_record(cache, key);
+   if (rh == NULL || rh->codec != CACHE_CODEC_NONE ||
+       rh->data_size != rh->uncompressed_size)
+      return NULL;
+
+   /* Check the data for corruption */
+   data = (const uint8_t *) (rh + 1) + rh->meta_size;
+   if (rh->crc32 != util_hash_crc32(data, rh->data_size))
+      return NULL;
+
+   if (size)
+      *size = rh->data_size;
+
+   return data;
+}
+
+void
+disk_cache_compact(struct disk_cache *cache)
+{
+   if (cache->pack == NULL || !pack_lock(cache))
+      return;
+
+   pack_compact_locked(cache, cache->max_size);
+
+   pack_unlock(cache);
+}
+
 void
 disk_cache_put_key(struct disk_cache *cache, const cache_key key)
 {
@@ -1202,13 +2342,19 @@ void
 disk_cache_compute_key(struct disk_cache *cache, const void *data, size_t size,
                        cache_key key)
 {
-   struct mesa_sha1 ctx;
+   struct mesa_sha1 ctx = cache->driver_keys_sha1;
 
-   _mesa_sha1_init(&ctx);
-   _mesa_sha1_update(&ctx, cache->driver_keys_blob,
-                     cache->driver_keys_blob_size);
    _mesa_sha1_update(&ctx, data, size);
    _mesa_sha1_final(&ctx, key);
 }
 
+void
+disk_cache_compute_keys(struct disk_cache *cache, unsigned count,
+                        const void *const *data, const size_t *sizes,
+                        cache_key *keys)
+{
+   _mesa_sha1_compute_multi(&cache->driver_keys_sha1, count, data, sizes,
+                            keys);
+}
+
 #endif /* ENABLE_SHADER_CACHE */
@@ -120,6 +120,8 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
 
 /**
  * Destroy a cache object, (freeing all associated resources).
+ *
+ * Entries still queued by disk_cache_put() are written out first.
  */
 void
 disk_cache_destroy(struct disk_cache *cache);
@@ -160,6 +162,44 @@ disk_cache_put(struct disk_cache *cache, const cache_key key,
 void *
 disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size);
 
+/**
+ * Start loading the item stored under \key in the background.
+ *
+ * The item is read and decompressed on the cache's thread, and a later
+ * disk_cache_get() of the same key returns it from memory, waiting for the
+ * load if it hasn't finished yet. Callers can use this to warm the entries
+ * they expect to look up soon.
+ */
+void
+disk_cache_prefetch(struct disk_cache *cache, const cache_key key);
+
+/**
+ * Retrieve an item like disk_cache_get(), but without copying it out of the
+ * cache.
+ *
+ * This only works when the cache uses a pack file (MESA_GLSL_CACHE_PACK) and
+ * the item is stored uncompressed, callers should fall back to
+ * disk_cache_get() when NULL is returned.
+ *
+ * \return A pointer to the stored object within the cache's mapping of the
+ * pack, which stays valid until the cache is destroyed. It must not be
+ * written to or freed.
+ */
+const void *
+disk_cache_get_mapped(struct disk_cache *cache, const cache_key key,
+                      size_t *size);
+
+/**
+ * Rewrite the pack file of a cache using MESA_GLSL_CACHE_PACK without the
+ * space of removed items, evicting the oldest items if the cache is over its
+ * maximum size. Does nothing for caches with one file per item.
+ *
+ * This copies the whole pack while keeping other processes from storing to
+ * the cache, so it is meant to be run offline rather than by applications.
+ */
+void
+disk_cache_compact(struct disk_cache *cache);
+
 /**
  * Store the name \key within the cache, (without any associated data).
  *
@@ -192,6 +232,15 @@ void
 disk_cache_compute_key(struct disk_cache *cache, const void *data, size_t size,
                        cache_key key);
 
+/**
+ * Compute the names \keys[i] from \data[i] of given \sizes[i], like \count
+ * calls to disk_cache_compute_key() but faster.
+ */
+void
+disk_cache_compute_keys(struct disk_cache *cache, unsigned count,
+                        const void *const *data, const size_t *sizes,
+                        cache_key *keys);
+
 #else
 
 static inline struct disk_cache *
@@ -226,6 +275,25 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
    return NULL;
 }
 
+static inline void
+disk_cache_prefetch(struct disk_cache *cache, const cache_key key)
+{
+   return;
+}
+
+static inline const void *
+disk_cache_get_mapped(struct disk_cache *cache, const cache_key key,
+                      size_t *size)
+{
+   return NULL;
+}
+
+static inline void
+disk_cache_compact(struct disk_cache *cache)
+{
+   return;
+}
+
 static inline void
 disk_cache_put_key(struct disk_cache *cache, const cache_key key)
 {
@@ -245,6 +313,14 @@ disk_cache_compute_key(struct disk_cache *cache, const void *data, size_t size,
    return;
 }
 
+static inline void
+disk_cache_compute_keys(struct disk_cache *cache, unsigned count,
+                        const void *const *data, const size_t *sizes,
+                        cache_key *keys)
+{
+   return;
+}
+
 #endif /* ENABLE_SHADER_CACHE */
 
 #ifdef __cplusplus
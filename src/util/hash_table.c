@@ -33,11 +33,25 @@
  */
 
 /**
- * Implements an open-addressing, linear-reprobing hash table.
+ * Implements an open-addressing hash table in the style of Abseil's
+ * "Swiss tables".
  *
- * For more information, see:
+ * Next to the entries, there is an array of one control byte per entry,
+ * which is either CTRL_EMPTY, CTRL_DELETED or, for present entries, 7 bits
+ * of the hash. The table size is a power of two and lookups look at whole
+ * groups of GROUP_SIZE entries at a time: they compare the hash bits with
+ * all control bytes of a group at once, with SSE2 where available, and only
+ * check the entries that match. If the group has any empty entries, the
+ * search stops there, otherwise it goes on to the next group of the probe
+ * sequence.
  *
- * http://cgit.freedesktop.org/~anholt/hash_table/tree/README
+ * This needs no deleted marker among the keys. Removing an entry makes it
+ * empty right away if its group has another empty entry, because no search
+ * ever got past that group. Only entries in completely full groups become
+ * CTRL_DELETED, so churn from removals and insertions doesn't fill the
+ * table with tombstones, and it's rare to have to rehash because of them.
+ * Entries are never moved except on rehash, which keeps removing entries
+ * while iterating over the table safe.
  */
 
 #include <stdlib.h>
@@ -47,67 +61,167 @@
 #include "hash_table.h"
 #include "ralloc.h"
 #include "macros.h"
+#include "bitscan.h"
 #include "main/hash.h"
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define HASH_TABLE_SSE2
+#endif
+
 static const uint32_t deleted_key_value;
 
+#define GROUP_SIZE 16
+#define MIN_SIZE GROUP_SIZE
+#define MAX_SIZE (1u << 31)
+
+#define CTRL_EMPTY   0x80
+#define CTRL_DELETED 0xfe
+
+/**
+ * The hash functions used with the table are sometimes weak, like the
+ * identity for GL object names, so mix the bits before using them: the low
+ * bits select the first group to look at and the top 7 go into the control
+ * byte.
+ */
+static inline uint32_t
+mix_hash(uint32_t hash)
+{
+   hash ^= hash >> 16;
+   hash *= 0x85ebca6b;
+   hash ^= hash >> 13;
+   hash *= 0xc2b2ae35;
+   hash ^= hash >> 16;
+   return hash;
+}
+
+static inline uint8_t
+ctrl_hash(uint32_t mixed)
+{
+   return mixed >> 25;
+}
+
+/* Bit i of the returned masks is set if entry i of the group matches. */
+#ifdef HASH_TABLE_SSE2
+static inline uint32_t
+group_match(const uint8_t *ctrl, uint8_t h)
+{
+   __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+   return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(h)));
+}
+
+static inline uint32_t
+group_match_empty(const uint8_t *ctrl)
+{
+   return group_match(ctrl, CTRL_EMPTY);
+}
+
+/* Empty or deleted, which are the control bytes with the top bit set. */
+static inline uint32_t
+group_match_available(const uint8_t *ctrl)
+{
+   return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+}
+#else
+static inline uint32_t
+group_match(const uint8_t *ctrl, uint8_t h)
+{
+   uint32_t mask = 0;
+
+   for (unsigned i = 0; i < GROUP_SIZE; i++)
+      mask |= (uint32_t)(ctrl[i] == h) << i;
+   return mask;
+}
+
+static inline uint32_t
+group_match_empty(const uint8_t *ctrl)
+{
+   return group_match(ctrl, CTRL_EMPTY);
+}
+
+static inline uint32_t
+group_match_available(const uint8_t *ctrl)
+{
+   uint32_t mask = 0;
+
+   for (unsigned i = 0; i < GROUP_SIZE; i++)
+      mask |= (uint32_t)(ctrl[i] >> 7) << i;
+   return mask;
+}
+#endif
+
 /**
- * From Knuth -- a good choice for hash/rehash values is p, p-2 where
- * p and p-2 are both prime.  These tables are sized to have an extra 10%
- * free to avoid exponential performance degradation as the hash table fills
+ * The groups to look at for a hash. Stepping by 1, 2, 3, ... groups visits
+ * every group once, since the number of groups is a power of two.
  */
-static const struct {
-   uint32_t max_entries, size, rehash;
-} hash_sizes[] = {
-   { 2,			5,		3	  },
-   { 4,			7,		5	  },
-   { 8,			13,		11	  },
-   { 16,		19,		17	  },
-   { 32,		43,		41        },
-   { 64,		73,		71        },
-   { 128,		151,		149       },
-   { 256,		283,		281       },
-   { 512,		571,		569       },
-   { 1024,		1153,		1151      },
-   { 2048,		2269,		2267      },
-   { 4096,		4519,		4517      },
-   { 8192,		9013,		9011      },
-   { 16384,		18043,		18041     },
-   { 32768,		36109,		36107     },
-   { 65536,		72091,		72089     },
-   { 131072,		144409,		144407    },
-   { 262144,		288361,		288359    },
-   { 524288,		576883,		576881    },
-   { 1048576,		1153459,	1153457   },
-   { 2097152,		2307163,	2307161   },
-   { 4194304,		4613893,	4613891   },
-   { 8388608,		9227641,	9227639   },
-   { 16777216,		18455029,	18455027  },
-   { 33554432,		36911011,	36911009  },
-   { 67108864,		73819861,	73819859  },
-   { 134217728,		147639589,	147639587 },
-   { 268435456,		295279081,	295279079 },
-   { 536870912,		590559793,	590559791 },
-   { 1073741824,	1181116273,	1181116271},
-   { 2147483648ul,	2362232233ul,	2362232231ul}
+struct probe_seq {
+   uint32_t group;
+   uint32_t group_mask;
+   uint32_t step;
 };
 
-static int
-entry_is_free(const struct hash_entry *entry)
+static inline struct probe_seq
+probe_start(const struct hash_table *ht, uint32_t mixed)
 {
-   return entry->key == NULL;
+   struct probe_seq seq;
+
+   seq.group_mask = ht->size / GROUP_SIZE - 1;
+   seq.group = mixed & seq.group_mask;
+   seq.step = 0;
+   return seq;
 }
 
-static int
-entry_is_deleted(const struct hash_table *ht, struct hash_entry *entry)
+/* Returns false after the last group. */
+static inline bool
+probe_next(struct probe_seq *seq)
+{
+   if (seq->step == seq->group_mask)
+      return false;
+
+   seq->step++;
+   seq->group = (seq->group + seq->step) & seq->group_mask;
+   return true;
+}
+
+static inline uint32_t
+max_entries_for_size(uint32_t size)
 {
-   return entry->key == ht->deleted_key;
+   /* Keep 1/8th of the entries empty, so that searches end quickly */
+   return size - size / 8;
 }
 
 static int
 entry_is_present(const struct hash_table *ht, struct hash_entry *entry)
 {
-   return entry->key != NULL && entry->key != ht->deleted_key;
+   return !(ht->ctrl[entry - ht->table] & 0x80);
+}
+
+/* Entries are followed by the control bytes in the same allocation. */
+static struct hash_entry *
+alloc_table(struct hash_table *ht, uint32_t size)
+{
+   struct hash_entry *table;
+
+   if ((uint64_t)size * (sizeof(struct hash_entry) + 1) > SIZE_MAX)
+      return NULL;
+
+   table = ralloc_size(ht, (size_t)size * (sizeof(struct hash_entry) + 1));
+   if (table == NULL)
+      return NULL;
+
+   memset(table + size, CTRL_EMPTY, size);
+   return table;
+}
+
+static void
+set_table(struct hash_table *ht, struct hash_entry *table, uint32_t size)
+{
+   ht->table = table;
+   ht->ctrl = (uint8_t *)(table + size);
+   ht->size = size;
+   ht->max_entries = max_entries_for_size(size);
+   ht->entries = 0;
+   ht->deleted_entries = 0;
 }
 
 struct hash_table *
@@ -117,26 +231,22 @@ _mesa_hash_table_create(void *mem_ctx,
                                                     const void *b))
 {
    struct hash_table *ht;
+   struct hash_entry *table;
 
    ht = ralloc(mem_ctx, struct hash_table);
    if (ht == NULL)
       return NULL;
 
-   ht->size_index = 0;
-   ht->size = hash_sizes[ht->size_index].size;
-   ht->rehash = hash_sizes[ht->size_index].rehash;
-   ht->max_entries = hash_sizes[ht->size_index].max_entries;
    ht->key_hash_function = key_hash_function;
    ht->key_equals_function = key_equals_function;
-   ht->table = rzalloc_array(ht, struct hash_entry, ht->size);
-   ht->entries = 0;
-   ht->deleted_entries = 0;
    ht->deleted_key = &deleted_key_value;
 
-   if (ht->table == NULL) {
+   table = alloc_table(ht, MIN_SIZE);
+   if (table == NULL) {
       ralloc_free(ht);
       return NULL;
    }
+   set_table(ht, table, MIN_SIZE);
 
    return ht;
 }
@@ -174,31 +284,25 @@ void
 _mesa_hash_table_clear(struct hash_table *ht,
                        void (*delete_function)(struct hash_entry *entry))
 {
-   struct hash_entry *entry;
-
-   for (entry = ht->table; entry != ht->table + ht->size; entry++) {
-      if (entry->key == NULL)
-         continue;
+   if (delete_function != NULL) {
+      struct hash_entry *entry;
 
-      if (delete_function != NULL && entry->key != ht->deleted_key)
+      hash_table_foreach(ht, entry) {
          delete_function(entry);
-
-      entry->key = NULL;
+      }
    }
 
+   memset(ht->ctrl, CTRL_EMPTY, ht->size);
    ht->entries = 0;
    ht->deleted_entries = 0;
 }
 
 /** Sets the value of the key pointer used for deleted entries in the table.
  *
- * The assumption is that usually keys are actual pointers, so we use a
- * default value of a pointer to an arbitrary piece of storage in the library.
- * But in some cases a consumer wants to store some other sort of value in the
- * table, like a uint32_t, in which case that pointer may conflict with one of
- * their valid keys.  This lets that user select a safe value.
- *
- * This must be called before any keys are actually deleted from the table.
+ * The table keeps track of deleted entries with its control bytes, so no
+ * key value is reserved. Removed entries still get their key set to this
+ * value, and users like _mesa_hash_table_u64 that used to have to avoid it
+ * keep working.
  */
 void
 _mesa_hash_table_set_deleted_key(struct hash_table *ht, const void *deleted_key)
@@ -209,26 +313,24 @@ _mesa_hash_table_set_deleted_key(struct hash_table *ht, const void *deleted_key)
 static struct hash_entry *
 hash_table_search(struct hash_table *ht, uint32_t hash, const void *key)
 {
-   uint32_t start_hash_address = hash % ht->size;
-   uint32_t hash_address = start_hash_address;
+   const uint32_t mixed = mix_hash(hash);
+   const uint8_t h = ctrl_hash(mixed);
+   struct probe_seq seq = probe_start(ht, mixed);
 
    do {
-      uint32_t double_hash;
+      const uint32_t base = seq.group * GROUP_SIZE;
+      unsigned match = group_match(ht->ctrl + base, h);
 
-      struct hash_entry *entry = ht->table + hash_address;
+      while (match) {
+         struct hash_entry *entry = ht->table + base + u_bit_scan(&match);
 
-      if (entry_is_free(entry)) {
-         return NULL;
-      } else if (entry_is_present(ht, entry) && entry->hash == hash) {
-         if (ht->key_equals_function(key, entry->key)) {
+         if (entry->hash == hash && ht->key_equals_function(key, entry->key))
             return entry;
-         }
       }
 
-      double_hash = 1 + hash % ht->rehash;
-
-      hash_address = (hash_address + double_hash) % ht->size;
-   } while (hash_address != start_hash_address);
+      if (group_match_empty(ht->ctrl + base))
+         return NULL;
+   } while (probe_next(&seq));
 
    return NULL;
 }
@@ -254,37 +356,50 @@ _mesa_hash_table_search_pre_hashed(struct hash_table *ht, uint32_t hash,
    return hash_table_search(ht, hash, key);
 }
 
-static struct hash_entry *
-hash_table_insert(struct hash_table *ht, uint32_t hash,
-                  const void *key, void *data);
+/* Returns the first empty or deleted entry for the hash, or -1. */
+static int64_t
+find_available(struct hash_table *ht, uint32_t mixed)
+{
+   struct probe_seq seq = probe_start(ht, mixed);
+
+   do {
+      const uint32_t base = seq.group * GROUP_SIZE;
+      uint32_t available = group_match_available(ht->ctrl + base);
+
+      if (available)
+         return base + ffs(available) - 1;
+   } while (probe_next(&seq));
+
+   return -1;
+}
 
 static void
-_mesa_hash_table_rehash(struct hash_table *ht, unsigned new_size_index)
+_mesa_hash_table_rehash(struct hash_table *ht, uint32_t new_size)
 {
    struct hash_table old_ht;
    struct hash_entry *table, *entry;
 
-   if (new_size_index >= ARRAY_SIZE(hash_sizes))
+   if (new_size > MAX_SIZE)
       return;
 
-   table = rzalloc_array(ht, struct hash_entry,
-                         hash_sizes[new_size_index].size);
+   table = alloc_table(ht, new_size);
    if (table == NULL)
       return;
 
    old_ht = *ht;
+   set_table(ht, table, new_size);
 
-   ht->table = table;
-   ht->size_index = new_size_index;
-   ht->size = hash_sizes[ht->size_index].size;
-   ht->rehash = hash_sizes[ht->size_index].rehash;
-   ht->max_entries = hash_sizes[ht->size_index].max_entries;
-   ht->entries = 0;
-   ht->deleted_entries = 0;
-
+   /* The keys are known to be different, so just take the first free entry
+    * for each one.
+    */
    hash_table_foreach(&old_ht, entry) {
-      hash_table_insert(ht, entry->hash, entry->key, entry->data);
+      const uint32_t mixed = mix_hash(entry->hash);
+      const uint32_t index = find_available(ht, mixed);
+
+      ht->ctrl[index] = ctrl_hash(mixed);
+      ht->table[index] = *entry;
    }
+   ht->entries = old_ht.entries;
 
    ralloc_free(old_ht.table);
 }
@@ -293,30 +408,23 @@ static struct hash_entry *
 hash_table_insert(struct hash_table *ht, uint32_t hash,
                   const void *key, void *data)
 {
-   uint32_t start_hash_address, hash_address;
-   struct hash_entry *available_entry = NULL;
+   int64_t available_index = -1;
 
    assert(key != NULL);
 
    if (ht->entries >= ht->max_entries) {
-      _mesa_hash_table_rehash(ht, ht->size_index + 1);
+      _mesa_hash_table_rehash(ht, ht->size * 2);
    } else if (ht->deleted_entries + ht->entries >= ht->max_entries) {
-      _mesa_hash_table_rehash(ht, ht->size_index);
+      _mesa_hash_table_rehash(ht, ht->size);
    }
 
-   start_hash_address = hash % ht->size;
-   hash_address = start_hash_address;
+   const uint32_t mixed = mix_hash(hash);
+   const uint8_t h = ctrl_hash(mixed);
+   struct probe_seq seq = probe_start(ht, mixed);
+
    do {
-      struct hash_entry *entry = ht->table + hash_address;
-      uint32_t double_hash;
-
-      if (!entry_is_present(ht, entry)) {
-         /* Stash the first available entry we find */
-         if (available_entry == NULL)
-            available_entry = entry;
-         if (entry_is_free(entry))
-            break;
-      }
+      const uint32_t base = seq.group * GROUP_SIZE;
+      unsigned match = group_match(ht->ctrl + base, h);
 
       /* Implement replacement when another insert happens
        * with a matching key.  This is a relatively common
@@ -329,28 +437,39 @@ hash_table_insert(struct hash_table *ht, uint32_t hash,
        * required to avoid memory leaks, perform a search
        * before inserting.
        */
-      if (!entry_is_deleted(ht, entry) &&
-          entry->hash == hash &&
-          ht->key_equals_function(key, entry->key)) {
-         entry->key = key;
-         entry->data = data;
-         return entry;
+      while (match) {
+         struct hash_entry *entry = ht->table + base + u_bit_scan(&match);
+
+         if (entry->hash == hash && ht->key_equals_function(key, entry->key)) {
+            entry->key = key;
+            entry->data = data;
+            return entry;
+         }
       }
 
+      /* Stash the first available entry we find */
+      if (available_index < 0) {
+         uint32_t available = group_match_available(ht->ctrl + base);
+
+         if (available)
+            available_index = base + ffs(available) - 1;
+      }
 
-      double_hash = 1 + hash % ht->rehash;
+      if (group_match_empty(ht->ctrl + base))
+         break;
+   } while (probe_next(&seq));
 
-      hash_address = (hash_address + double_hash) % ht->size;
-   } while (hash_address != start_hash_address);
+   if (available_index >= 0) {
+      struct hash_entry *entry = ht->table + available_index;
 
-   if (available_entry) {
-      if (entry_is_deleted(ht, available_entry))
+      if (ht->ctrl[available_index] == CTRL_DELETED)
          ht->deleted_entries--;
-      available_entry->hash = hash;
-      available_entry->key = key;
-      available_entry->data = data;
+      ht->ctrl[available_index] = h;
+      entry->hash = hash;
+      entry->key = key;
+      entry->data = data;
       ht->entries++;
-      return available_entry;
+      return entry;
    }
 
    /* We could hit here if a required resize failed. An unchecked-malloc
@@ -390,12 +509,25 @@ void
 _mesa_hash_table_remove(struct hash_table *ht,
                         struct hash_entry *entry)
 {
+   uint32_t index;
+
    if (!entry)
       return;
 
+   index = entry - ht->table;
+
+   /* A search only goes on past a group without empty entries, so if this
+    * one has some, no search needs to get past this entry either.
+    */
+   if (group_match_empty(ht->ctrl + (index & ~(GROUP_SIZE - 1)))) {
+      ht->ctrl[index] = CTRL_EMPTY;
+   } else {
+      ht->ctrl[index] = CTRL_DELETED;
+      ht->deleted_entries++;
+   }
+
    entry->key = ht->deleted_key;
    ht->entries--;
-   ht->deleted_entries++;
 }
 
 /**
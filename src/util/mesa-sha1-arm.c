@@ -0,0 +1,97 @@
+/* Copyright © 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* SHA-1 with the ARMv8 cryptography extensions.  This file is built with
+ * the compiler flags for them, so only call it after checking HWCAP.
+ */
+
+#ifdef USE_SHA1_ARMV8
+
+#include <arm_neon.h>
+#include "mesa-sha1-blocks.h"
+
+/* Four rounds, the E value for the next ones is derived from A. */
+#define ROUNDS4(op, k, msg)                                    \
+   do {                                                        \
+      uint32_t e_next = vsha1h_u32(vgetq_lane_u32(abcd, 0));   \
+      abcd = op(abcd, e, vaddq_u32(msg, k));                   \
+      e = e_next;                                              \
+   } while (0)
+
+/* The next four message words from the previous sixteen, in m0 to m3. */
+#define SCHEDULE(m0, m1, m2, m3) \
+   m0 = vsha1su1q_u32(vsha1su0q_u32(m0, m1, m2), m3)
+
+void
+_mesa_sha1_blocks_armv8(uint32_t state[5], const uint8_t *blocks,
+                        size_t num_blocks)
+{
+   const uint32x4_t k0 = vdupq_n_u32(0x5a827999);
+   const uint32x4_t k1 = vdupq_n_u32(0x6ed9eba1);
+   const uint32x4_t k2 = vdupq_n_u32(0x8f1bbcdc);
+   const uint32x4_t k3 = vdupq_n_u32(0xca62c1d6);
+   uint32x4_t abcd = vld1q_u32(state), abcd_save;
+   uint32_t e0 = state[4], e;
+   uint32x4_t m0, m1, m2, m3;
+
+   for (; num_blocks; num_blocks--, blocks += 64) {
+      abcd_save = abcd;
+      e = e0;
+
+      m0 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks)));
+      m1 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks + 16)));
+      m2 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks + 32)));
+      m3 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks + 48)));
+
+      ROUNDS4(vsha1cq_u32, k0, m0);
+      ROUNDS4(vsha1cq_u32, k0, m1);
+      ROUNDS4(vsha1cq_u32, k0, m2);
+      ROUNDS4(vsha1cq_u32, k0, m3);
+      SCHEDULE(m0, m1, m2, m3); ROUNDS4(vsha1cq_u32, k0, m0);
+
+      SCHEDULE(m1, m2, m3, m0); ROUNDS4(vsha1pq_u32, k1, m1);
+      SCHEDULE(m2, m3, m0, m1); ROUNDS4(vsha1pq_u32, k1, m2);
+      SCHEDULE(m3, m0, m1, m2); ROUNDS4(vsha1pq_u32, k1, m3);
+      SCHEDULE(m0, m1, m2, m3); ROUNDS4(vsha1pq_u32, k1, m0);
+      SCHEDULE(m1, m2, m3, m0); ROUNDS4(vsha1pq_u32, k1, m1);
+
+      SCHEDULE(m2, m3, m0, m1); ROUNDS4(vsha1mq_u32, k2, m2);
+      SCHEDULE(m3, m0, m1, m2); ROUNDS4(vsha1mq_u32, k2, m3);
+      SCHEDULE(m0, m1, m2, m3); ROUNDS4(vsha1mq_u32, k2, m0);
+      SCHEDULE(m1, m2, m3, m0); ROUNDS4(vsha1mq_u32, k2, m1);
+      SCHEDULE(m2, m3, m0, m1); ROUNDS4(vsha1mq_u32, k2, m2);
+
+      SCHEDULE(m3, m0, m1, m2); ROUNDS4(vsha1pq_u32, k3, m3);
+      SCHEDULE(m0, m1, m2, m3); ROUNDS4(vsha1pq_u32, k3, m0);
+      SCHEDULE(m1, m2, m3, m0); ROUNDS4(vsha1pq_u32, k3, m1);
+      SCHEDULE(m2, m3, m0, m1); ROUNDS4(vsha1pq_u32, k3, m2);
+      SCHEDULE(m3, m0, m1, m2); ROUNDS4(vsha1pq_u32, k3, m3);
+
+      abcd = vaddq_u32(abcd, abcd_save);
+      e0 += e;
+   }
+
+   vst1q_u32(state, abcd);
+   state[4] = e0;
+}
+
+#endif /* USE_SHA1_ARMV8 */
@@ -0,0 +1,72 @@
+/* Copyright © 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* The block functions behind _mesa_sha1_update() and friends.  Only
+ * mesa-sha1*.c and the tests include this.
+ */
+
+#ifndef MESA_SHA1_BLOCKS_H
+#define MESA_SHA1_BLOCKS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Runs the SHA-1 compression function over num_blocks 64-byte blocks. */
+typedef void (*mesa_sha1_blocks_func)(uint32_t state[5], const uint8_t *blocks,
+                                      size_t num_blocks);
+
+enum mesa_sha1_impl {
+   MESA_SHA1_IMPL_AUTO,   /* the fastest one the CPU supports */
+   MESA_SHA1_IMPL_C,      /* portable, one message at a time */
+   MESA_SHA1_IMPL_SSE2,   /* portable, SSE2 lanes for multiple messages */
+   MESA_SHA1_IMPL_SHA_NI, /* x86 SHA extensions */
+   MESA_SHA1_IMPL_ARMV8,  /* ARMv8 cryptography extensions */
+};
+
+/* Switches the implementation, returns false if the CPU or the build doesn't
+ * support it.  For testing.
+ */
+bool
+_mesa_sha1_select_impl(enum mesa_sha1_impl impl);
+
+#ifdef USE_SHA1_NI
+void
+_mesa_sha1_blocks_ni(uint32_t state[5], const uint8_t *blocks,
+                     size_t num_blocks);
+#endif
+
+#ifdef USE_SHA1_ARMV8
+void
+_mesa_sha1_blocks_armv8(uint32_t state[5], const uint8_t *blocks,
+                        size_t num_blocks);
+#endif
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+#endif
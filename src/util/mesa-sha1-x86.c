@@ -0,0 +1,103 @@
+/* Copyright © 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* SHA-1 with the x86 SHA extensions.  This file is built with the compiler
+ * flags for them, so only call it after checking CPUID.
+ */
+
+#ifdef USE_SHA1_NI
+
+#include <immintrin.h>
+#include "mesa-sha1-blocks.h"
+
+/* Four rounds with the E value derived from the previous ABCD. */
+#define ROUNDS4(f, msg)                               \
+   do {                                               \
+      e = _mm_sha1nexte_epu32(prev, msg);             \
+      prev = abcd;                                    \
+      abcd = _mm_sha1rnds4_epu32(abcd, e, f);         \
+   } while (0)
+
+/* The next four message words from the previous sixteen, in m0 to m3. */
+#define SCHEDULE(m0, m1, m2, m3)                                              \
+   m0 = _mm_sha1msg2_epu32(_mm_xor_si128(_mm_sha1msg1_epu32(m0, m1), m2), m3)
+
+void
+_mesa_sha1_blocks_ni(uint32_t state[5], const uint8_t *blocks,
+                     size_t num_blocks)
+{
+   const __m128i bswap = _mm_set_epi64x(0x0001020304050607ull,
+                                        0x08090a0b0c0d0e0full);
+   __m128i abcd, e0, e, prev, abcd_save;
+   __m128i m0, m1, m2, m3;
+
+   /* The instructions want A and E in the top lane */
+   abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0x1b);
+   e0 = _mm_set_epi32(state[4], 0, 0, 0);
+
+   for (; num_blocks; num_blocks--, blocks += 64) {
+      abcd_save = abcd;
+
+      m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)blocks), bswap);
+      m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(blocks + 16)),
+                            bswap);
+      m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(blocks + 32)),
+                            bswap);
+      m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(blocks + 48)),
+                            bswap);
+
+      e = _mm_add_epi32(e0, m0);
+      prev = abcd;
+      abcd = _mm_sha1rnds4_epu32(abcd, e, 0);
+      ROUNDS4(0, m1);
+      ROUNDS4(0, m2);
+      ROUNDS4(0, m3);
+      SCHEDULE(m0, m1, m2, m3); ROUNDS4(0, m0);
+
+      SCHEDULE(m1, m2, m3, m0); ROUNDS4(1, m1);
+      SCHEDULE(m2, m3, m0, m1); ROUNDS4(1, m2);
+      SCHEDULE(m3, m0, m1, m2); ROUNDS4(1, m3);
+      SCHEDULE(m0, m1, m2, m3); ROUNDS4(1, m0);
+      SCHEDULE(m1, m2, m3, m0); ROUNDS4(1, m1);
+
+      SCHEDULE(m2, m3, m0, m1); ROUNDS4(2, m2);
+      SCHEDULE(m3, m0, m1, m2); ROUNDS4(2, m3);
+      SCHEDULE(m0, m1, m2, m3); ROUNDS4(2, m0);
+      SCHEDULE(m1, m2, m3, m0); ROUNDS4(2, m1);
+      SCHEDULE(m2, m3, m0, m1); ROUNDS4(2, m2);
+
+      SCHEDULE(m3, m0, m1, m2); ROUNDS4(3, m3);
+      SCHEDULE(m0, m1, m2, m3); ROUNDS4(3, m0);
+      SCHEDULE(m1, m2, m3, m0); ROUNDS4(3, m1);
+      SCHEDULE(m2, m3, m0, m1); ROUNDS4(3, m2);
+      SCHEDULE(m3, m0, m1, m2); ROUNDS4(3, m3);
+
+      /* E after the last rounds comes from the ABCD before them */
+      e0 = _mm_sha1nexte_epu32(prev, e0);
+      abcd = _mm_add_epi32(abcd, abcd_save);
+   }
+
+   _mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(abcd, 0x1b));
+   state[4] = _mm_extract_epi32(e0, 3);
+}
+
+#endif /* USE_SHA1_NI */
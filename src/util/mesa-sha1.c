@@ -24,8 +24,199 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#include <string.h>
+
+#include "c11/threads.h"
+#include "macros.h"
 #include "sha1/sha1.h"
 #include "mesa-sha1.h"
+#include "mesa-sha1-blocks.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define HAVE_SHA1_SSE2
+#endif
+
+#if defined(USE_SHA1_NI) && defined(__GNUC__)
+#include <cpuid.h>
+#endif
+
+#if defined(USE_SHA1_ARMV8) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+static void
+sha1_blocks_c(uint32_t state[5], const uint8_t *blocks, size_t num_blocks)
+{
+   for (; num_blocks; num_blocks--, blocks += 64)
+      SHA1Transform(state, blocks);
+}
+
+static struct {
+   mesa_sha1_blocks_func blocks;
+
+   /* Whether _mesa_sha1_compute_multi() should hash four messages at once
+    * with SSE2, instead of one after the other with blocks.
+    */
+   bool multi_lanes;
+} sha1_impl;
+
+static once_flag sha1_impl_once = ONCE_FLAG_INIT;
+
+static bool
+sha1_impl_supported(enum mesa_sha1_impl impl)
+{
+   switch (impl) {
+   case MESA_SHA1_IMPL_AUTO:
+   case MESA_SHA1_IMPL_C:
+      return true;
+   case MESA_SHA1_IMPL_SSE2:
+#ifdef HAVE_SHA1_SSE2
+      return true;
+#else
+      return false;
+#endif
+   case MESA_SHA1_IMPL_SHA_NI: {
+#if defined(USE_SHA1_NI) && defined(__GNUC__)
+      unsigned eax, ebx, ecx, edx;
+      const unsigned ssse3 = 1 << 9, sse4_1 = 1 << 19, sha = 1 << 29;
+
+      if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) ||
+          (ecx & (ssse3 | sse4_1)) != (ssse3 | sse4_1))
+         return false;
+      if (__get_cpuid_max(0, NULL) < 7)
+         return false;
+      __cpuid_count(7, 0, eax, ebx, ecx, edx);
+      return (ebx & sha) != 0;
+#else
+      return false;
+#endif
+   }
+   case MESA_SHA1_IMPL_ARMV8:
+#if defined(USE_SHA1_ARMV8) && defined(__linux__)
+      return (getauxval(AT_HWCAP) & HWCAP_SHA1) != 0;
+#else
+      return false;
+#endif
+   }
+   return false;
+}
+
+static void
+sha1_impl_set(enum mesa_sha1_impl impl)
+{
+   sha1_impl.blocks = sha1_blocks_c;
+   sha1_impl.multi_lanes = false;
+
+   switch (impl) {
+   case MESA_SHA1_IMPL_AUTO:
+      if (sha1_impl_supported(MESA_SHA1_IMPL_SHA_NI))
+         sha1_impl_set(MESA_SHA1_IMPL_SHA_NI);
+      else if (sha1_impl_supported(MESA_SHA1_IMPL_ARMV8))
+         sha1_impl_set(MESA_SHA1_IMPL_ARMV8);
+      else if (sha1_impl_supported(MESA_SHA1_IMPL_SSE2))
+         sha1_impl_set(MESA_SHA1_IMPL_SSE2);
+      break;
+   case MESA_SHA1_IMPL_C:
+      break;
+   case MESA_SHA1_IMPL_SSE2:
+      sha1_impl.multi_lanes = true;
+      break;
+   case MESA_SHA1_IMPL_SHA_NI:
+#ifdef USE_SHA1_NI
+      sha1_impl.blocks = _mesa_sha1_blocks_ni;
+#endif
+      break;
+   case MESA_SHA1_IMPL_ARMV8:
+#ifdef USE_SHA1_ARMV8
+      sha1_impl.blocks = _mesa_sha1_blocks_armv8;
+#endif
+      break;
+   }
+}
+
+static void
+sha1_impl_init(void)
+{
+   sha1_impl_set(MESA_SHA1_IMPL_AUTO);
+}
+
+static mesa_sha1_blocks_func
+sha1_blocks(void)
+{
+   call_once(&sha1_impl_once, sha1_impl_init);
+   return sha1_impl.blocks;
+}
+
+bool
+_mesa_sha1_select_impl(enum mesa_sha1_impl impl)
+{
+   call_once(&sha1_impl_once, sha1_impl_init);
+
+   if (!sha1_impl_supported(impl))
+      return false;
+
+   sha1_impl_set(impl);
+   return true;
+}
+
+void
+_mesa_sha1_update(struct mesa_sha1 *ctx, const void *data, size_t size)
+{
+   const mesa_sha1_blocks_func blocks = sha1_blocks();
+   const uint8_t *p = data;
+   size_t used = (ctx->count >> 3) & 63;
+
+   ctx->count += (uint64_t)size << 3;
+
+   if (used) {
+      size_t n = MIN2(size, 64 - used);
+
+      memcpy(ctx->buffer + used, p, n);
+      p += n;
+      size -= n;
+      if (used + n < 64)
+         return;
+      blocks(ctx->state, ctx->buffer, 1);
+   }
+
+   if (size >= 64) {
+      blocks(ctx->state, p, size / 64);
+      p += size & ~(size_t)63;
+      size &= 63;
+   }
+
+   memcpy(ctx->buffer, p, size);
+}
+
+static void
+sha1_store_digest(unsigned char result[20], const uint32_t state[5])
+{
+   for (unsigned i = 0; i < 20; i++)
+      result[i] = state[i >> 2] >> ((3 - (i & 3)) * 8);
+}
+
+void
+_mesa_sha1_final(struct mesa_sha1 *ctx, unsigned char result[20])
+{
+   const mesa_sha1_blocks_func blocks = sha1_blocks();
+   size_t used = (ctx->count >> 3) & 63;
+
+   ctx->buffer[used++] = 0x80;
+   if (used > 56) {
+      memset(ctx->buffer + used, 0, 64 - used);
+      blocks(ctx->state, ctx->buffer, 1);
+      used = 0;
+   }
+   memset(ctx->buffer + used, 0, 56 - used);
+   for (unsigned i = 0; i < 8; i++)
+      ctx->buffer[56 + i] = ctx->count >> ((7 - i) * 8);
+   blocks(ctx->state, ctx->buffer, 1);
+
+   sha1_store_digest(result, ctx->state);
+   memset(ctx, 0, sizeof(*ctx));
+}
 
 void
 _mesa_sha1_compute(const void *data, size_t size, unsigned char result[20])
@@ -37,6 +228,243 @@ _mesa_sha1_compute(const void *data, size_t size, unsigned char result[20])
    _mesa_sha1_final(&ctx, result);
 }
 
+#ifdef HAVE_SHA1_SSE2
+
+/* One message hashed in a lane of sha1_blocks_x4(): the bytes buffered in
+ * the prefix context, then the data, then the padding.
+ */
+struct sha1_lane {
+   const uint8_t *prefix;
+   size_t prefix_size;
+   const uint8_t *data;
+   size_t size;
+   uint64_t bits;
+   size_t offset, end;
+   unsigned index;
+   uint8_t block[64];
+};
+
+static void
+sha1_lane_start(struct sha1_lane *lane, const struct mesa_sha1 *prefix,
+                const void *data, size_t size, unsigned index)
+{
+   size_t len;
+
+   lane->prefix = prefix->buffer;
+   lane->prefix_size = (prefix->count >> 3) & 63;
+   lane->data = data;
+   lane->size = size;
+   lane->bits = prefix->count + ((uint64_t)size << 3);
+   lane->offset = 0;
+   lane->index = index;
+
+   /* Room for the 0x80 byte and the 64-bit length */
+   len = lane->prefix_size + size;
+   lane->end = ((len + 8) & ~(size_t)63) + 64;
+}
+
+static const uint8_t *
+sha1_lane_next_block(struct sha1_lane *lane)
+{
+   const size_t off = lane->offset;
+   const size_t len = lane->prefix_size + lane->size;
+   uint8_t *b = lane->block;
+   size_t pos = 0;
+
+   lane->offset += 64;
+
+   /* Most blocks of long messages are just in the data */
+   if (off >= lane->prefix_size && off + 64 <= len)
+      return lane->data + (off - lane->prefix_size);
+
+   if (off < lane->prefix_size) {
+      pos = MIN2(64, lane->prefix_size - off);
+      memcpy(b, lane->prefix + off, pos);
+   }
+   if (pos < 64 && off + pos < len) {
+      size_t data_off = off + pos - lane->prefix_size;
+      size_t n = MIN2(64 - pos, lane->size - data_off);
+
+      memcpy(b + pos, lane->data + data_off, n);
+      pos += n;
+   }
+   if (pos < 64) {
+      memset(b + pos, 0, 64 - pos);
+      if (off + pos == len)
+         b[pos] = 0x80;
+      if (lane->offset == lane->end) {
+         for (unsigned i = 0; i < 8; i++)
+            b[56 + i] = lane->bits >> ((7 - i) * 8);
+      }
+   }
+   return b;
+}
+
+static inline uint32_t
+load_be32(const uint8_t *p)
+{
+   return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+          (uint32_t)p[2] << 8 | p[3];
+}
+
+#define ROTL(x, n)    _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - (n)))
+
+/* Runs one block of each of four messages, word i of state[j] is the state
+ * of lane i.
+ */
+static void
+sha1_blocks_x4(uint32_t state[5][4], const uint8_t *blocks[4])
+{
+   __m128i w[16];
+   __m128i a = _mm_loadu_si128((const __m128i *)state[0]);
+   __m128i b = _mm_loadu_si128((const __m128i *)state[1]);
+   __m128i c = _mm_loadu_si128((const __m128i *)state[2]);
+   __m128i d = _mm_loadu_si128((const __m128i *)state[3]);
+   __m128i e = _mm_loadu_si128((const __m128i *)state[4]);
+   const __m128i a0 = a, b0 = b, c0 = c, d0 = d, e0 = e;
+
+   for (unsigned i = 0; i < 16; i++) {
+      w[i] = _mm_set_epi32(load_be32(blocks[3] + 4 * i),
+                           load_be32(blocks[2] + 4 * i),
+                           load_be32(blocks[1] + 4 * i),
+                           load_be32(blocks[0] + 4 * i));
+   }
+
+   for (unsigned i = 0; i < 80; i++) {
+      __m128i f, k, t;
+
+      if (i >= 16) {
+         t = _mm_xor_si128(_mm_xor_si128(w[(i + 13) & 15], w[(i + 8) & 15]),
+                           _mm_xor_si128(w[(i + 2) & 15], w[i & 15]));
+         w[i & 15] = ROTL(t, 1);
+      }
+
+      if (i < 20) {
+         f = _mm_xor_si128(d, _mm_and_si128(b, _mm_xor_si128(c, d)));
+         k = _mm_set1_epi32(0x5a827999);
+      } else if (i < 40) {
+         f = _mm_xor_si128(_mm_xor_si128(b, c), d);
+         k = _mm_set1_epi32(0x6ed9eba1);
+      } else if (i < 60) {
+         f = _mm_or_si128(_mm_and_si128(b, c),
+                          _mm_and_si128(d, _mm_or_si128(b, c)));
+         k = _mm_set1_epi32(0x8f1bbcdc);
+      } else {
+         f = _mm_xor_si128(_mm_xor_si128(b, c), d);
+         k = _mm_set1_epi32(0xca62c1d6);
+      }
+
+      t = _mm_add_epi32(_mm_add_epi32(ROTL(a, 5), f),
+                        _mm_add_epi32(_mm_add_epi32(e, k), w[i & 15]));
+      e = d;
+      d = c;
+      c = ROTL(b, 30);
+      b = a;
+      a = t;
+   }
+
+   _mm_storeu_si128((__m128i *)state[0], _mm_add_epi32(a, a0));
+   _mm_storeu_si128((__m128i *)state[1], _mm_add_epi32(b, b0));
+   _mm_storeu_si128((__m128i *)state[2], _mm_add_epi32(c, c0));
+   _mm_storeu_si128((__m128i *)state[3], _mm_add_epi32(d, d0));
+   _mm_storeu_si128((__m128i *)state[4], _mm_add_epi32(e, e0));
+}
+
+/* Keeps four lanes busy, starting the next message in a lane as soon as the
+ * previous one is done.
+ */
+static void
+sha1_compute_multi_sse2(const struct mesa_sha1 *prefix, unsigned count,
+                        const void *const *data, const size_t *sizes,
+                        unsigned char (*results)[20])
+{
+   static const uint8_t zero_block[64];
+   struct sha1_lane lanes[4];
+   uint32_t state[5][4];
+   bool active[4];
+   unsigned next = 0, num_active = 0;
+
+   for (unsigned l = 0; l < 4; l++) {
+      active[l] = next < count;
+      if (!active[l])
+         continue;
+
+      sha1_lane_start(&lanes[l], prefix, data[next], sizes[next], next);
+      for (unsigned j = 0; j < 5; j++)
+         state[j][l] = prefix->state[j];
+      next++;
+      num_active++;
+   }
+
+   while (num_active) {
+      const uint8_t *blocks[4];
+
+      for (unsigned l = 0; l < 4; l++)
+         blocks[l] = active[l] ? sha1_lane_next_block(&lanes[l]) : zero_block;
+
+      sha1_blocks_x4(state, blocks);
+
+      for (unsigned l = 0; l < 4; l++) {
+         uint32_t digest[5];
+
+         if (!active[l] || lanes[l].offset != lanes[l].end)
+            continue;
+
+         for (unsigned j = 0; j < 5; j++)
+            digest[j] = state[j][l];
+         sha1_store_digest(results[lanes[l].index], digest);
+
+         if (next < count) {
+            sha1_lane_start(&lanes[l], prefix, data[next], sizes[next], next);
+            for (unsigned j = 0; j < 5; j++)
+               state[j][l] = prefix->state[j];
+            next++;
+         } else {
+            active[l] = false;
+            num_active--;
+         }
+      }
+   }
+}
+
+#endif /* HAVE_SHA1_SSE2 */
+
+/**
+ * Computes the SHA-1 of count messages, each starting with what was hashed
+ * into prefix so far, or nothing if prefix is NULL.
+ *
+ * Without SHA instructions, this hashes several messages at once in SIMD
+ * lanes, which is faster than one _mesa_sha1_compute() after the other.
+ */
+void
+_mesa_sha1_compute_multi(const struct mesa_sha1 *prefix, unsigned count,
+                         const void *const *data, const size_t *sizes,
+                         unsigned char (*results)[20])
+{
+   struct mesa_sha1 init;
+
+   if (!prefix) {
+      _mesa_sha1_init(&init);
+      prefix = &init;
+   }
+
+   call_once(&sha1_impl_once, sha1_impl_init);
+
+#ifdef HAVE_SHA1_SSE2
+   if (sha1_impl.multi_lanes && count > 1) {
+      sha1_compute_multi_sse2(prefix, count, data, sizes, results);
+      return;
+   }
+#endif
+
+   for (unsigned i = 0; i < count; i++) {
+      struct mesa_sha1 ctx = *prefix;
+
+      _mesa_sha1_update(&ctx, data[i], sizes[i]);
+      _mesa_sha1_final(&ctx, results[i]);
+   }
+}
+
 void
 _mesa_sha1_format(char *buf, const unsigned char *sha1)
 {
@@ -39,17 +39,11 @@ _mesa_sha1_init(struct mesa_sha1 *ctx)
    SHA1Init(ctx);
 }
 
-static inline void
-_mesa_sha1_update(struct mesa_sha1 *ctx, const void *data, size_t size)
-{
-   SHA1Update(ctx, (const unsigned char *)data, size);
-}
+void
+_mesa_sha1_update(struct mesa_sha1 *ctx, const void *data, size_t size);
 
-static inline void
-_mesa_sha1_final(struct mesa_sha1 *ctx, unsigned char result[20])
-{
-   SHA1Final(result, ctx);
-}
+void
+_mesa_sha1_final(struct mesa_sha1 *ctx, unsigned char result[20]);
 
 void
 _mesa_sha1_format(char *buf, const unsigned char *sha1);
@@ -57,6 +51,11 @@ _mesa_sha1_format(char *buf, const unsigned char *sha1);
 void
 _mesa_sha1_compute(const void *data, size_t size, unsigned char result[20]);
 
+void
+_mesa_sha1_compute_multi(const struct mesa_sha1 *prefix, unsigned count,
+                         const void *const *data, const size_t *sizes,
+                         unsigned char (*results)[20]);
+
 #ifdef __cplusplus
 } /* extern C */
 #endif
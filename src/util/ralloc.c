@@ -66,6 +66,12 @@ struct
    unsigned canary;
 #endif
 
+   /* For blocks carved out of a ralloc_pool, the block's size class in the
+    * low bits and its offset within the pool page in the high bits.  Zero
+    * for blocks that came from malloc.
+    */
+   uint32_t pool_info;
+
    struct ralloc_header *parent;
 
    /* The first child (head of a linked list) */
@@ -82,6 +88,8 @@ typedef struct ralloc_header ralloc_header;
 
 static void unlink_block(ralloc_header *info);
 static void unsafe_free(ralloc_header *info);
+static void pool_free_block(ralloc_header *info);
+static ralloc_header *pool_realloc_block(ralloc_header *old, size_t size);
 
 static ralloc_header *
 get_header(const void *ptr)
@@ -115,21 +123,13 @@ ralloc_context(const void *ctx)
    return ralloc_size(ctx, 0);
 }
 
-void *
-ralloc_size(const void *ctx, size_t size)
+/* Initialize a freshly allocated header and link it to ctx */
+static void *
+init_block(ralloc_header *info, const void *ctx, uint32_t pool_info)
 {
-   void *block = malloc(size + sizeof(ralloc_header));
-   ralloc_header *info;
    ralloc_header *parent;
 
-   if (unlikely(block == NULL))
-      return NULL;
-
-   info = (ralloc_header *) block;
-   /* measurements have shown that calloc is slower (because of
-    * the multiplication overflow checking?), so clear things
-    * manually
-    */
+   info->pool_info = pool_info;
    info->parent = NULL;
    info->child = NULL;
    info->prev = NULL;
@@ -147,6 +147,21 @@ ralloc_size(const void *ctx, size_t size)
    return PTR_FROM_HEADER(info);
 }
 
+void *
+ralloc_size(const void *ctx, size_t size)
+{
+   void *block = malloc(size + sizeof(ralloc_header));
+
+   if (unlikely(block == NULL))
+      return NULL;
+
+   /* measurements have shown that calloc is slower (because of
+    * the multiplication overflow checking?), so clear things
+    * manually
+    */
+   return init_block((ralloc_header *) block, ctx, 0);
+}
+
 void *
 rzalloc_size(const void *ctx, size_t size)
 {
@@ -158,17 +173,13 @@ rzalloc_size(const void *ctx, size_t size)
    return ptr;
 }
 
-/* helper function - assumes ptr != NULL */
-static void *
-resize(void *ptr, size_t size)
+/* Point the parent, siblings and children of a block that moved from old to
+ * info at its new location.
+ */
+static void
+update_links(ralloc_header *info, ralloc_header *old)
 {
-   ralloc_header *child, *old, *info;
-
-   old = get_header(ptr);
-   info = realloc(old, size + sizeof(ralloc_header));
-
-   if (info == NULL)
-      return NULL;
+   ralloc_header *child;
 
    /* Update parent and sibling's links to the reallocated node. */
    if (info != old && info->parent != NULL) {
@@ -185,6 +196,24 @@ resize(void *ptr, size_t size)
    /* Update child->parent links for all children */
    for (child = info->child; child != NULL; child = child->next)
       child->parent = info;
+}
+
+/* helper function - assumes ptr != NULL */
+static void *
+resize(void *ptr, size_t size)
+{
+   ralloc_header *old, *info;
+
+   old = get_header(ptr);
+   if (old->pool_info)
+      info = pool_realloc_block(old, size);
+   else
+      info = realloc(old, size + sizeof(ralloc_header));
+
+   if (info == NULL)
+      return NULL;
+
+   update_links(info, old);
 
    return PTR_FROM_HEADER(info);
 }
@@ -273,7 +302,10 @@ unsafe_free(ralloc_header *info)
    if (info->destructor != NULL)
       info->destructor(PTR_FROM_HEADER(info));
 
-   free(info);
+   if (info->pool_info)
+      pool_free_block(info);
+   else
+      free(info);
 }
 
 void
@@ -887,3 +919,372 @@ linear_strcat(void *parent, char **dest, const char *str)
 {
    return linear_cat(parent, dest, str, strlen(str));
 }
+
+/***************************************************************************
+ * Pools for small, frequently allocated objects.
+ ***************************************************************************
+ *
+ * A pool carves small ralloc blocks out of large pages instead of calling
+ * malloc for each of them.  Pooled blocks have an ordinary ralloc header and
+ * behave like any other ralloc block: they have a parent, can have children,
+ * can be stolen and are freed with ralloc_free() or with their parent.  Only
+ * the memory behind them is different.
+ *
+ * Blocks are rounded up to a multiple of POOL_CLASS_SIZE, which gives their
+ * size class.  Freed blocks go to a free list per size class and are handed
+ * out again by later allocations of the same class.  Each page counts its
+ * live bytes so that ralloc_pool_compact() can give empty pages back to the
+ * system.  The header's pool_info stores the size class and the offset of
+ * the block within its page, which is how a block finds its page and pool
+ * when it is freed.
+ *
+ * Pages where only a few blocks survive can be evacuated: between
+ * ralloc_pool_begin_compact() and ralloc_pool_compact(), the free blocks of
+ * those pages are set aside and ralloc_pool_move() copies live blocks out of
+ * them, so that the pages end up empty and can be released.
+ */
+
+#define POOL_PAGE_SIZE (64 * 1024)
+#define POOL_CLASS_SIZE 16
+#define POOL_NUM_CLASSES 32
+#define POOL_CLASS_BITS 8
+
+struct pool_page {
+   struct ralloc_pool *pool;
+   struct pool_page *next;
+
+   /* Bytes used by blocks that were allocated from this page and not freed */
+   unsigned used;
+
+   /* Set between ralloc_pool_begin_compact() and ralloc_pool_compact() */
+   bool evacuating;
+};
+
+#define POOL_PAGE_DATA ALIGN_POT(sizeof(struct pool_page), POOL_CLASS_SIZE)
+
+struct ralloc_pool {
+   struct pool_page *pages;
+
+   /* Unused space at the end of the most recently allocated page */
+   struct pool_page *bump_page;
+   unsigned bump_offset;
+
+   ralloc_header *free_list[POOL_NUM_CLASSES];
+
+   /* Free blocks of the pages being evacuated */
+   ralloc_header *evacuated;
+
+   unsigned live;
+   bool destroyed;
+};
+
+static inline unsigned
+pool_info_class(uint32_t pool_info)
+{
+   return pool_info & ((1 << POOL_CLASS_BITS) - 1);
+}
+
+static inline struct pool_page *
+pool_info_page(ralloc_header *info)
+{
+   unsigned offset = (info->pool_info >> POOL_CLASS_BITS) * POOL_CLASS_SIZE;
+   return (struct pool_page *) ((char *) info - offset);
+}
+
+struct ralloc_pool *
+ralloc_pool_create(void)
+{
+   return calloc(1, sizeof(struct ralloc_pool));
+}
+
+static void
+pool_release(struct ralloc_pool *pool)
+{
+   struct pool_page *page, *next;
+
+   for (page = pool->pages; page != NULL; page = next) {
+      next = page->next;
+      free(page);
+   }
+
+   free(pool);
+}
+
+void
+ralloc_pool_destroy(struct ralloc_pool *pool)
+{
+   if (pool == NULL)
+      return;
+
+   /* Blocks that are still alive keep the pool around until they are freed */
+   pool->destroyed = true;
+   if (pool->live == 0)
+      pool_release(pool);
+}
+
+static bool
+pool_add_page(struct ralloc_pool *pool)
+{
+   struct pool_page *page = malloc(POOL_PAGE_SIZE);
+
+   if (unlikely(page == NULL))
+      return false;
+
+   page->pool = pool;
+   page->used = 0;
+   page->evacuating = false;
+   page->next = pool->pages;
+   pool->pages = page;
+
+   pool->bump_page = page;
+   pool->bump_offset = POOL_PAGE_DATA;
+
+   return true;
+}
+
+/* Returns an uninitialized block of the given size class */
+static ralloc_header *
+pool_alloc_block(struct ralloc_pool *pool, unsigned class)
+{
+   unsigned size = class * POOL_CLASS_SIZE;
+   struct pool_page *page;
+   ralloc_header *info;
+
+   info = pool->free_list[class - 1];
+   if (info != NULL) {
+      pool->free_list[class - 1] = info->next;
+      page = pool_info_page(info);
+   } else {
+      if (pool->bump_page == NULL ||
+          pool->bump_offset + size > POOL_PAGE_SIZE) {
+         if (!pool_add_page(pool))
+            return NULL;
+      }
+
+      page = pool->bump_page;
+      info = (ralloc_header *) ((char *) page + pool->bump_offset);
+      pool->bump_offset += size;
+   }
+
+   info->pool_info = class | ((((char *) info - (char *) page) /
+                               POOL_CLASS_SIZE) << POOL_CLASS_BITS);
+
+   page->used += size;
+   pool->live++;
+
+   return info;
+}
+
+void *
+ralloc_pool_size(struct ralloc_pool *pool, const void *ctx, size_t size)
+{
+   size_t total = ALIGN_POT(size + sizeof(ralloc_header), POOL_CLASS_SIZE);
+   unsigned class = total / POOL_CLASS_SIZE;
+   ralloc_header *info;
+
+   if (pool == NULL || class > POOL_NUM_CLASSES)
+      return ralloc_size(ctx, size);
+
+   info = pool_alloc_block(pool, class);
+   if (unlikely(info == NULL))
+      return NULL;
+
+   return init_block(info, ctx, info->pool_info);
+}
+
+void *
+rzalloc_pool_size(struct ralloc_pool *pool, const void *ctx, size_t size)
+{
+   void *ptr = ralloc_pool_size(pool, ctx, size);
+
+   if (likely(ptr))
+      memset(ptr, 0, size);
+
+   return ptr;
+}
+
+static void
+pool_free_block(ralloc_header *info)
+{
+   struct pool_page *page = pool_info_page(info);
+   struct ralloc_pool *pool = page->pool;
+   unsigned class = pool_info_class(info->pool_info);
+
+#ifdef DEBUG
+   info->canary = 0;
+#endif
+
+   if (page->evacuating) {
+      info->next = pool->evacuated;
+      pool->evacuated = info;
+   } else {
+      info->next = pool->free_list[class - 1];
+      pool->free_list[class - 1] = info;
+   }
+
+   page->used -= class * POOL_CLASS_SIZE;
+   pool->live--;
+
+   if (pool->destroyed && pool->live == 0)
+      pool_release(pool);
+}
+
+/* Pooled blocks can't be passed to realloc(), so move the block to malloc'd
+ * memory when it outgrows its size class.
+ */
+static ralloc_header *
+pool_realloc_block(ralloc_header *old, size_t size)
+{
+   size_t capacity = pool_info_class(old->pool_info) * POOL_CLASS_SIZE -
+                     sizeof(ralloc_header);
+   ralloc_header *info;
+
+   if (size <= capacity)
+      return old;
+
+   info = malloc(size + sizeof(ralloc_header));
+   if (unlikely(info == NULL))
+      return NULL;
+
+   memcpy(info, old, sizeof(ralloc_header) + capacity);
+   info->pool_info = 0;
+
+   pool_free_block(old);
+
+   return info;
+}
+
+bool
+ralloc_pool_begin_compact(struct ralloc_pool *pool)
+{
+   struct pool_page *page;
+   bool evacuate = false;
+
+   if (pool == NULL)
+      return false;
+
+   /* The page currently being filled is left alone, it is usually the
+    * youngest and the blocks moved out of the other pages end up there.
+    */
+   for (page = pool->pages; page != NULL; page = page->next) {
+      if (page != pool->bump_page && page->used < POOL_PAGE_SIZE / 2) {
+         page->evacuating = true;
+         evacuate = true;
+      }
+   }
+
+   if (!evacuate)
+      return false;
+
+   for (unsigned i = 0; i < POOL_NUM_CLASSES; i++) {
+      ralloc_header **link = &pool->free_list[i];
+      while (*link != NULL) {
+         ralloc_header *info = *link;
+
+         if (pool_info_page(info)->evacuating) {
+            *link = info->next;
+            info->next = pool->evacuated;
+            pool->evacuated = info;
+         } else {
+            link = &info->next;
+         }
+      }
+   }
+
+   return true;
+}
+
+void *
+ralloc_pool_move(struct ralloc_pool *pool, void *ptr)
+{
+   ralloc_header *old = get_header(ptr);
+   ralloc_header *info;
+   uint32_t pool_info;
+   unsigned class;
+
+   if (old->pool_info == 0 || pool_info_page(old)->pool != pool ||
+       !pool_info_page(old)->evacuating)
+      return ptr;
+
+   class = pool_info_class(old->pool_info);
+   info = pool_alloc_block(pool, class);
+   if (unlikely(info == NULL))
+      return ptr;
+
+   pool_info = info->pool_info;
+   memcpy(info, old, class * POOL_CLASS_SIZE);
+   info->pool_info = pool_info;
+   update_links(info, old);
+
+   pool_free_block(old);
+
+   return PTR_FROM_HEADER(info);
+}
+
+size_t
+ralloc_pool_compact(struct ralloc_pool *pool)
+{
+   struct pool_page **page_link;
+   struct pool_page *page;
+   ralloc_header *info, *next;
+   bool empty = false, evacuated = false;
+   size_t released = 0;
+
+   if (pool == NULL)
+      return 0;
+
+   for (page = pool->pages; page != NULL; page = page->next) {
+      if (page->evacuating)
+         evacuated = true;
+      else if (page->used == 0)
+         empty = true;
+   }
+
+   if (!empty && !evacuated)
+      return 0;
+
+   /* Drop the free blocks that live in pages about to be released */
+   if (empty) {
+      for (unsigned i = 0; i < POOL_NUM_CLASSES; i++) {
+         ralloc_header **link = &pool->free_list[i];
+         while (*link != NULL) {
+            if (pool_info_page(*link)->used == 0)
+               *link = (*link)->next;
+            else
+               link = &(*link)->next;
+         }
+      }
+   }
+
+   /* Pages that could not be emptied take their free blocks back */
+   for (info = pool->evacuated; info != NULL; info = next) {
+      unsigned class = pool_info_class(info->pool_info);
+
+      next = info->next;
+      if (pool_info_page(info)->used != 0) {
+         info->next = pool->free_list[class - 1];
+         pool->free_list[class - 1] = info;
+      }
+   }
+   pool->evacuated = NULL;
+
+   page_link = &pool->pages;
+   while (*page_link != NULL) {
+      page = *page_link;
+      page->evacuating = false;
+
+      if (page->used != 0) {
+         page_link = &page->next;
+         continue;
+      }
+
+      if (page == pool->bump_page)
+         pool->bump_page = NULL;
+
+      *page_link = page->next;
+      free(page);
+      released += POOL_PAGE_SIZE;
+   }
+
+   return released;
+}
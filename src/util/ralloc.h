@@ -251,6 +251,70 @@ void *ralloc_parent(const void *ptr);
  */
 void ralloc_set_destructor(const void *ptr, void(*destructor)(void *));
 
+/// \defgroup pool Pools @{
+/**
+ * A pool of memory for small ralloc blocks.
+ *
+ * Blocks allocated with ralloc_pool_size() are regular ralloc blocks with a
+ * parent context, children, destructors and so on.  The pool only provides
+ * the memory behind them: it is carved out of large pages and recycled
+ * through per-size free lists, which is a lot cheaper than a malloc() and
+ * free() per block when millions of small objects come and go.
+ *
+ * The pool itself is not a ralloc context.  ralloc_pool_destroy() may be
+ * called while blocks are still alive; the memory is released once the last
+ * one is freed.
+ */
+struct ralloc_pool;
+
+struct ralloc_pool *ralloc_pool_create(void);
+
+void ralloc_pool_destroy(struct ralloc_pool *pool);
+
+/**
+ * Allocate \p size bytes from \p pool, as a child of \p ctx.
+ *
+ * Falls back to ralloc_size() for a NULL pool or blocks too large to be
+ * pooled.
+ */
+void *ralloc_pool_size(struct ralloc_pool *pool, const void *ctx,
+                       size_t size) MALLOCLIKE;
+
+/**
+ * Like ralloc_pool_size(), but zeroes the memory.
+ */
+void *rzalloc_pool_size(struct ralloc_pool *pool, const void *ctx,
+                        size_t size) MALLOCLIKE;
+
+/**
+ * Start evacuating the pages of \p pool that are less than half used.
+ *
+ * Until the following ralloc_pool_compact(), nothing is allocated from
+ * those pages any more and ralloc_pool_move() moves blocks out of them.
+ *
+ * \return false if there is nothing to evacuate
+ */
+bool ralloc_pool_begin_compact(struct ralloc_pool *pool);
+
+/**
+ * Move the block \p ptr out of a page being evacuated.
+ *
+ * Its parent, siblings and children are updated like for reralloc(), every
+ * other pointer into the block is up to the caller.
+ *
+ * \return the new address of the block, or \p ptr if it was not moved
+ */
+void *ralloc_pool_move(struct ralloc_pool *pool, void *ptr);
+
+/**
+ * Give the pages without any live block back to the system, and end the
+ * evacuation started by ralloc_pool_begin_compact(), if any.
+ *
+ * \return the number of bytes released
+ */
+size_t ralloc_pool_compact(struct ralloc_pool *pool);
+/// @}
+
 /// \defgroup array String Functions @{
 /**
  * Duplicate a string, allocating the memory from the given context.
@@ -68,6 +68,13 @@
  * up front and stored in a 2-dimensional array, so that the cost of
  * coloring a node is constant with the number of registers.  We do
  * this during ra_set_finalize().
+ *
+ * Graphs with more than RA_DENSE_ADJACENCY_MAX_NODES nodes (large compute
+ * kernels can have tens of thousands of virtual registers) don't get the
+ * per-node adjacency bitsets, which would be quadratic in the node count.
+ * Interference is only recorded in the adjacency lists then, and duplicate
+ * edges are dropped right before allocation in the order they were first
+ * added, so both representations produce the same coloring.
  */
 
 #include <stdbool.h>
@@ -76,11 +83,18 @@
 #include "main/imports.h"
 #include "main/macros.h"
 #include "main/mtypes.h"
+#include "util/bitscan.h"
 #include "util/bitset.h"
 #include "register_allocate.h"
 
 #define NO_REG ~0U
 
+/**
+ * Largest graph for which the adjacency is also tracked as a bitset per
+ * node.  That's 2MB of bitsets at this size.
+ */
+#define RA_DENSE_ADJACENCY_MAX_NODES 4096
+
 struct ra_reg {
    BITSET_WORD *conflicts;
    unsigned int *conflict_list;
@@ -126,6 +140,9 @@ struct ra_node {
     *
     * List of which nodes this node interferes with.  This should be
     * symmetric with the other node.
+    *
+    * The adjacency bitset is NULL for sparse graphs, whose adjacency_list
+    * may then contain duplicates until ra_dedup_adjacency() is called.
     */
    BITSET_WORD *adjacency;
    unsigned int *adjacency_list;
@@ -175,6 +192,12 @@ struct ra_graph {
     */
    unsigned int stack_optimistic_start;
 
+   /**
+    * Set when interference was added to a sparse graph since the last
+    * ra_dedup_adjacency().
+    */
+   bool adjacency_dirty;
+
    unsigned int (*select_reg_callback)(struct ra_graph *g, BITSET_WORD *regs,
                                        void *data);
    void *select_reg_callback_data;
@@ -394,7 +417,8 @@ ra_set_finalize(struct ra_regs *regs, unsigned int **q_values)
 static void
 ra_add_node_adjacency(struct ra_graph *g, unsigned int n1, unsigned int n2)
 {
-   BITSET_SET(g->nodes[n1].adjacency, n2);
+   if (g->nodes[n1].adjacency)
+      BITSET_SET(g->nodes[n1].adjacency, n2);
 
    assert(n1 != n2);
 
@@ -428,8 +452,10 @@ ra_alloc_interference_graph(struct ra_regs *regs, unsigned int count)
    g->stack = rzalloc_array(g, unsigned int, count);
 
    for (i = 0; i < count; i++) {
-      int bitset_count = BITSET_WORDS(count);
-      g->nodes[i].adjacency = rzalloc_array(g, BITSET_WORD, bitset_count);
+      if (count <= RA_DENSE_ADJACENCY_MAX_NODES) {
+         int bitset_count = BITSET_WORDS(count);
+         g->nodes[i].adjacency = rzalloc_array(g, BITSET_WORD, bitset_count);
+      }
 
       g->nodes[i].adjacency_list_size = 4;
       g->nodes[i].adjacency_list =
@@ -464,10 +490,58 @@ void
 ra_add_node_interference(struct ra_graph *g,
                          unsigned int n1, unsigned int n2)
 {
-   if (n1 != n2 && !BITSET_TEST(g->nodes[n1].adjacency, n2)) {
-      ra_add_node_adjacency(g, n1, n2);
-      ra_add_node_adjacency(g, n2, n1);
+   if (n1 == n2)
+      return;
+
+   if (g->nodes[n1].adjacency) {
+      if (BITSET_TEST(g->nodes[n1].adjacency, n2))
+         return;
+   } else {
+      g->adjacency_dirty = true;
    }
+
+   ra_add_node_adjacency(g, n1, n2);
+   ra_add_node_adjacency(g, n2, n1);
+}
+
+/**
+ * Removes the duplicate edges of a sparse graph, keeping the first
+ * occurrence of each so that the adjacency lists end up exactly as the
+ * bitset check in ra_add_node_interference() would have left them.
+ */
+static void
+ra_dedup_adjacency(struct ra_graph *g)
+{
+   unsigned int *last_seen;
+   unsigned int n, i;
+
+   if (!g->adjacency_dirty)
+      return;
+
+   last_seen = malloc(g->count * sizeof(unsigned int));
+   memset(last_seen, 0xff, g->count * sizeof(unsigned int));
+
+   for (n = 0; n < g->count; n++) {
+      struct ra_node *node = &g->nodes[n];
+      unsigned int *q = g->regs->classes[node->class]->q;
+      unsigned int count = 0;
+
+      for (i = 0; i < node->adjacency_count; i++) {
+         unsigned int n2 = node->adjacency_list[i];
+
+         if (last_seen[n2] == n) {
+            node->q_total -= q[g->nodes[n2].class];
+            continue;
+         }
+
+         last_seen[n2] = n;
+         node->adjacency_list[count++] = n2;
+      }
+      node->adjacency_count = count;
+   }
+
+   free(last_seen);
+   g->adjacency_dirty = false;
 }
 
 static bool
@@ -478,8 +552,99 @@ pq_test(struct ra_graph *g, unsigned int n)
    return g->nodes[n].q_total < g->regs->classes[n_class]->p;
 }
 
+/**
+ * Worklists for ra_simplify().
+ *
+ * Nodes that pass the pq test are kept in a bitset so that they can be
+ * pushed in the same descending order the plain scan over all nodes would
+ * visit them.  The remaining candidates are kept in a binary heap ordered
+ * by q_total, highest node index first on ties, which is the node the
+ * optimistic step would pick.  q_total only goes down during simplify, so
+ * a node only ever moves towards the top of the heap or out of it.
+ */
+struct ra_simplify_state {
+   BITSET_WORD *colorable;
+   unsigned int *heap;
+   unsigned int *heap_index;
+   unsigned int heap_count;
+};
+
+static bool
+ra_heap_less(struct ra_graph *g, unsigned int n1, unsigned int n2)
+{
+   return g->nodes[n1].q_total < g->nodes[n2].q_total ||
+          (g->nodes[n1].q_total == g->nodes[n2].q_total && n1 > n2);
+}
+
+static void
+ra_heap_set(struct ra_simplify_state *s, unsigned int i, unsigned int n)
+{
+   s->heap[i] = n;
+   s->heap_index[n] = i;
+}
+
+static void
+ra_heap_sift_up(struct ra_graph *g, struct ra_simplify_state *s,
+                unsigned int i)
+{
+   unsigned int n = s->heap[i];
+
+   while (i > 0) {
+      unsigned int parent = (i - 1) / 2;
+
+      if (!ra_heap_less(g, n, s->heap[parent]))
+         break;
+
+      ra_heap_set(s, i, s->heap[parent]);
+      i = parent;
+   }
+   ra_heap_set(s, i, n);
+}
+
+static void
+ra_heap_sift_down(struct ra_graph *g, struct ra_simplify_state *s,
+                  unsigned int i)
+{
+   unsigned int n = s->heap[i];
+
+   for (;;) {
+      unsigned int child = 2 * i + 1;
+
+      if (child >= s->heap_count)
+         break;
+
+      if (child + 1 < s->heap_count &&
+          ra_heap_less(g, s->heap[child + 1], s->heap[child]))
+         child++;
+
+      if (!ra_heap_less(g, s->heap[child], n))
+         break;
+
+      ra_heap_set(s, i, s->heap[child]);
+      i = child;
+   }
+   ra_heap_set(s, i, n);
+}
+
 static void
-decrement_q(struct ra_graph *g, unsigned int n)
+ra_heap_remove(struct ra_graph *g, struct ra_simplify_state *s,
+               unsigned int n)
+{
+   unsigned int i = s->heap_index[n];
+   unsigned int last = s->heap[--s->heap_count];
+
+   s->heap_index[n] = NO_REG;
+
+   if (last == n)
+      return;
+
+   ra_heap_set(s, i, last);
+   ra_heap_sift_down(g, s, i);
+   ra_heap_sift_up(g, s, s->heap_index[last]);
+}
+
+static void
+decrement_q(struct ra_graph *g, struct ra_simplify_state *s, unsigned int n)
 {
    unsigned int i;
    int n_class = g->nodes[n].class;
@@ -491,10 +656,47 @@ decrement_q(struct ra_graph *g, unsigned int n)
       if (!g->nodes[n2].in_stack) {
          assert(g->nodes[n2].q_total >= g->regs->classes[n2_class]->q[n_class]);
          g->nodes[n2].q_total -= g->regs->classes[n2_class]->q[n_class];
+
+         if (s->heap_index[n2] != NO_REG) {
+            if (pq_test(g, n2)) {
+               ra_heap_remove(g, s, n2);
+               BITSET_SET(s->colorable, n2);
+            } else {
+               ra_heap_sift_up(g, s, s->heap_index[n2]);
+            }
+         }
       }
    }
 }
 
+static void
+ra_push_node(struct ra_graph *g, struct ra_simplify_state *s, unsigned int n)
+{
+   decrement_q(g, s, n);
+   g->stack[g->stack_count] = n;
+   g->stack_count++;
+   g->nodes[n].in_stack = true;
+}
+
+/**
+ * Returns the highest set bit of the bitset at or below i, or -1.
+ */
+static int
+ra_find_last_set(const BITSET_WORD *set, int i)
+{
+   while (i >= 0) {
+      unsigned int w = BITSET_BITWORD(i);
+      BITSET_WORD bits = set[w] & BITSET_MASK(i % BITSET_WORDBITS + 1);
+
+      if (bits)
+         return w * BITSET_WORDBITS + util_last_bit(bits) - 1;
+
+      i = (int)(w * BITSET_WORDBITS) - 1;
+   }
+
+   return -1;
+}
+
 /**
  * Simplifies the interference graph by pushing all
  * trivially-colorable nodes into a stack of nodes to be colored,
@@ -504,69 +706,72 @@ decrement_q(struct ra_graph *g, unsigned int n)
  * we optimistically choose a node and push it on the stack. We heuristically
  * push the node with the lowest total q value, since it has the fewest
  * neighbors and therefore is most likely to be allocated.
+ *
+ * This pushes nodes in the order of repeated downward scans over all the
+ * nodes, without doing the scans: each pass resumes below the last node it
+ * pushed, and a pass that pushed nothing ends with the optimistic choice.
  */
 static void
 ra_simplify(struct ra_graph *g)
 {
-   bool progress = true;
+   struct ra_simplify_state s;
    unsigned int stack_optimistic_start = UINT_MAX;
+   bool progress = false;
+   unsigned int n;
    int i;
 
-   while (progress) {
-      unsigned int best_optimistic_node = ~0;
-      unsigned int lowest_q_total = ~0;
+   s.colorable = calloc(BITSET_WORDS(g->count), sizeof(BITSET_WORD));
+   s.heap = malloc(g->count * sizeof(unsigned int));
+   s.heap_index = malloc(g->count * sizeof(unsigned int));
+   s.heap_count = 0;
 
-      progress = false;
-
-      for (i = g->count - 1; i >= 0; i--) {
-	 if (g->nodes[i].in_stack || g->nodes[i].reg != NO_REG)
-	    continue;
-
-	 if (pq_test(g, i)) {
-	    decrement_q(g, i);
-	    g->stack[g->stack_count] = i;
-	    g->stack_count++;
-	    g->nodes[i].in_stack = true;
-	    progress = true;
-	 } else {
-	    unsigned int new_q_total = g->nodes[i].q_total;
-	    if (new_q_total < lowest_q_total) {
-	       best_optimistic_node = i;
-	       lowest_q_total = new_q_total;
-	    }
-	 }
-      }
+   for (n = 0; n < g->count; n++) {
+      s.heap_index[n] = NO_REG;
 
-      if (!progress && best_optimistic_node != ~0U) {
-         if (stack_optimistic_start == UINT_MAX)
-            stack_optimistic_start = g->stack_count;
+      if (g->nodes[n].in_stack || g->nodes[n].reg != NO_REG)
+         continue;
 
-	 decrement_q(g, best_optimistic_node);
-	 g->stack[g->stack_count] = best_optimistic_node;
-	 g->stack_count++;
-	 g->nodes[best_optimistic_node].in_stack = true;
-	 progress = true;
-      }
+      if (pq_test(g, n))
+         BITSET_SET(s.colorable, n);
+      else
+         ra_heap_set(&s, s.heap_count++, n);
    }
 
-   g->stack_optimistic_start = stack_optimistic_start;
-}
+   for (i = s.heap_count / 2 - 1; i >= 0; i--)
+      ra_heap_sift_down(g, &s, i);
+
+   i = g->count - 1;
+   for (;;) {
+      i = ra_find_last_set(s.colorable, i);
+      if (i >= 0) {
+         BITSET_CLEAR(s.colorable, i);
+         ra_push_node(g, &s, i);
+         progress = true;
+         i--;
+         continue;
+      }
 
-static bool
-ra_any_neighbors_conflict(struct ra_graph *g, unsigned int n, unsigned int r)
-{
-   unsigned int i;
+      if (!progress) {
+         if (s.heap_count == 0)
+            break;
 
-   for (i = 0; i < g->nodes[n].adjacency_count; i++) {
-      unsigned int n2 = g->nodes[n].adjacency_list[i];
+         if (stack_optimistic_start == UINT_MAX)
+            stack_optimistic_start = g->stack_count;
 
-      if (!g->nodes[n2].in_stack &&
-          BITSET_TEST(g->regs->regs[r].conflicts, g->nodes[n2].reg)) {
-         return true;
+         n = s.heap[0];
+         ra_heap_remove(g, &s, n);
+         ra_push_node(g, &s, n);
       }
+
+      progress = false;
+      i = g->count - 1;
    }
 
-   return false;
+   free(s.colorable);
+   free(s.heap);
+   free(s.heap_index);
+
+   g->stack_optimistic_start = stack_optimistic_start;
 }
 
 /* Computes a bitfield of what regs are available for a given register
@@ -604,6 +809,35 @@ ra_compute_available_regs(struct ra_graph *g, unsigned int n, BITSET_WORD *regs)
    return false;
 }
 
+/**
+ * Returns the first register of the set at or after start, wrapping around
+ * to the start of the register file, or NO_REG if the set is empty.
+ */
+static unsigned int
+ra_find_available_reg(const BITSET_WORD *regs, unsigned int count,
+                      unsigned int start)
+{
+   unsigned int words = BITSET_WORDS(count);
+   unsigned int w, i;
+   BITSET_WORD bits;
+
+   if (start >= count)
+      start = 0;
+
+   w = BITSET_BITWORD(start);
+   bits = regs[w] & ~BITSET_MASK(start % BITSET_WORDBITS);
+
+   for (i = 0; i <= words; i++) {
+      if (bits)
+         return w * BITSET_WORDBITS + ffs(bits) - 1;
+
+      w = (w + 1) % words;
+      bits = regs[w];
+   }
+
+   return NO_REG;
+}
+
 /**
  * Pops nodes from the stack back into the graph, coloring them with
  * registers as they go.
@@ -615,44 +849,32 @@ static bool
 ra_select(struct ra_graph *g)
 {
    int start_search_reg = 0;
-   BITSET_WORD *select_regs = NULL;
+   BITSET_WORD *select_regs;
 
-   if (g->select_reg_callback)
-      select_regs = malloc(BITSET_WORDS(g->regs->count) * sizeof(BITSET_WORD));
+   select_regs = malloc(BITSET_WORDS(g->regs->count) * sizeof(BITSET_WORD));
 
    while (g->stack_count != 0) {
-      unsigned int ri;
-      unsigned int r = -1;
+      unsigned int r;
       int n = g->stack[g->stack_count - 1];
-      struct ra_class *c = g->regs->classes[g->nodes[n].class];
 
       /* set this to false even if we return here so that
        * ra_get_best_spill_node() considers this node later.
        */
       g->nodes[n].in_stack = false;
 
-      if (g->select_reg_callback) {
-         if (!ra_compute_available_regs(g, n, select_regs)) {
-            free(select_regs);
-            return false;
-         }
+      if (!ra_compute_available_regs(g, n, select_regs)) {
+         free(select_regs);
+         return false;
+      }
 
+      if (g->select_reg_callback) {
          r = g->select_reg_callback(g, select_regs, g->select_reg_callback_data);
       } else {
          /* Find the lowest-numbered reg which is not used by a member
           * of the graph adjacent to us.
           */
-         for (ri = 0; ri < g->regs->count; ri++) {
-            r = (start_search_reg + ri) % g->regs->count;
-            if (!reg_belongs_to_class(r, c))
-               continue;
-
-            if (!ra_any_neighbors_conflict(g, n, r))
-               break;
-         }
-
-         if (ri >= g->regs->count)
-            return false;
+         r = ra_find_available_reg(select_regs, g->regs->count,
+                                   start_search_reg);
       }
 
       g->nodes[n].reg = r;
@@ -680,6 +902,7 @@ ra_select(struct ra_graph *g)
 bool
 ra_allocate(struct ra_graph *g)
 {
+   ra_dedup_adjacency(g);
    ra_simplify(g);
    return ra_select(g);
 }
@@ -743,6 +966,8 @@ ra_get_best_spill_node(struct ra_graph *g)
    float best_benefit = 0.0;
    unsigned int n;
 
+   ra_dedup_adjacency(g);
+
    /* Consider any nodes that we colored successfully or the node we failed to
     * color for spilling. When we failed to color a node in ra_select(), we
     * only considered these nodes, so spilling any other ones would not result
@@ -155,6 +155,34 @@ _mesa_set_destroy(struct set *ht, void (*delete_function)(struct set_entry *entr
    ralloc_free(ht);
 }
 
+/**
+ * Deletes all entries of the given set without deleting the set itself or
+ * changing its structure.
+ *
+ * If delete_function is passed, it gets called on each entry present.
+ */
+void
+_mesa_set_clear(struct set *set, void (*delete_function)(struct set_entry *entry))
+{
+   struct set_entry *entry;
+
+   if (set->entries == 0 && set->deleted_entries == 0)
+      return;
+
+   for (entry = set->table; entry != set->table + set->size; entry++) {
+      if (entry->key == NULL)
+         continue;
+
+      if (delete_function != NULL && entry->key != deleted_key)
+         delete_function(entry);
+
+      entry->key = NULL;
+   }
+
+   set->entries = 0;
+   set->deleted_entries = 0;
+}
+
 /**
  * Finds a set entry with the given key and hash of that key.
  *
@@ -0,0 +1,271 @@
+/*
+ * Copyright © 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Checks every SHA-1 implementation the CPU supports against known digests
+ * and the reference code in sha1/, and prints how fast each one is.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "macros.h"
+#include "mesa-sha1.h"
+#include "mesa-sha1-blocks.h"
+
+static uint32_t seed = 1;
+
+static uint32_t
+next_random(void)
+{
+   seed = seed * 1103515245 + 12345;
+   return seed >> 8;
+}
+
+static double
+now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void
+reference_sha1(const struct mesa_sha1 *prefix, const void *data, size_t size,
+               unsigned char result[20])
+{
+   SHA1_CTX ctx;
+
+   if (prefix)
+      ctx = *prefix;
+   else
+      SHA1Init(&ctx);
+   SHA1Update(&ctx, data, size);
+   SHA1Final(result, &ctx);
+}
+
+static bool
+check(const char *impl, const char *what, size_t size,
+      const unsigned char result[20], const unsigned char expected[20])
+{
+   char hex[41], expected_hex[41];
+
+   if (memcmp(result, expected, 20) == 0)
+      return true;
+
+   _mesa_sha1_format(hex, result);
+   _mesa_sha1_format(expected_hex, expected);
+   fprintf(stderr, "%s: %s of %zu bytes: expected %s but got %s\n",
+           impl, what, size, expected_hex, hex);
+   return false;
+}
+
+static bool
+test_vectors(const char *impl)
+{
+   static const struct {
+      const char *data;
+      unsigned repeat;
+      const char *digest;
+   } vectors[] = {
+      { "abc", 1, "a9993e364706816aba3e25717850c26c9cd0d89d" },
+      { "", 1, "da39a3ee5e6b4b0d3255bfef95601890afd80709" },
+      { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+        "84983e441c3bd26ebaae4aa1f95129e5e54670f1" },
+      { "a", 1000000, "34aa973cd4c4daa4f61eeb2bdbad27316534016f" },
+   };
+   bool pass = true;
+
+   for (unsigned i = 0; i < ARRAY_SIZE(vectors); i++) {
+      size_t len = strlen(vectors[i].data);
+      unsigned char result[20];
+      char hex[41];
+      struct mesa_sha1 ctx;
+
+      _mesa_sha1_init(&ctx);
+      for (unsigned j = 0; j < vectors[i].repeat; j++)
+         _mesa_sha1_update(&ctx, vectors[i].data, len);
+      _mesa_sha1_final(&ctx, result);
+
+      _mesa_sha1_format(hex, result);
+      if (strcmp(hex, vectors[i].digest) != 0) {
+         fprintf(stderr, "%s: vector %u: expected %s but got %s\n",
+                 impl, i, vectors[i].digest, hex);
+         pass = false;
+      }
+   }
+
+   return pass;
+}
+
+#define MAX_SIZE 1000
+#define NUM_MESSAGES 37
+
+static bool
+test_random(const char *impl, const uint8_t *data)
+{
+   const void *messages[NUM_MESSAGES];
+   size_t sizes[NUM_MESSAGES];
+   unsigned char results[NUM_MESSAGES][20], expected[20];
+   struct mesa_sha1 prefix;
+   bool pass = true;
+
+   /* Every size around the block and padding boundaries, in pieces */
+   for (size_t size = 0; size < 300; size++) {
+      unsigned char result[20];
+      struct mesa_sha1 ctx;
+      size_t done = 0;
+
+      _mesa_sha1_init(&ctx);
+      while (done < size) {
+         size_t n = next_random() % 80;
+
+         n = MIN2(n, size - done);
+
+         _mesa_sha1_update(&ctx, data + done, n);
+         done += n;
+      }
+      _mesa_sha1_final(&ctx, result);
+
+      reference_sha1(NULL, data, size, expected);
+      pass &= check(impl, "update", size, result, expected);
+
+      _mesa_sha1_compute(data, size, result);
+      pass &= check(impl, "compute", size, result, expected);
+   }
+
+   /* Different sizes in the lanes, with and without a prefix of every
+    * length modulo the block size.
+    */
+   for (unsigned prefix_size = 0; prefix_size < 200; prefix_size += 7) {
+      for (unsigned i = 0; i < NUM_MESSAGES; i++) {
+         sizes[i] = next_random() % (i & 1 ? 100 : MAX_SIZE);
+         messages[i] = data + next_random() % MAX_SIZE;
+      }
+
+      _mesa_sha1_compute_multi(NULL, NUM_MESSAGES, messages, sizes, results);
+      for (unsigned i = 0; i < NUM_MESSAGES; i++) {
+         reference_sha1(NULL, messages[i], sizes[i], expected);
+         pass &= check(impl, "multi", sizes[i], results[i], expected);
+
+         _mesa_sha1_compute(messages[i], sizes[i], expected);
+         pass &= check(impl, "multi against compute", sizes[i], results[i],
+                       expected);
+      }
+
+      _mesa_sha1_init(&prefix);
+      _mesa_sha1_update(&prefix, data + MAX_SIZE, prefix_size);
+      _mesa_sha1_compute_multi(&prefix, NUM_MESSAGES, messages, sizes,
+                               results);
+      for (unsigned i = 0; i < NUM_MESSAGES; i++) {
+         reference_sha1(&prefix, messages[i], sizes[i], expected);
+         pass &= check(impl, "multi with prefix", sizes[i], results[i],
+                       expected);
+      }
+   }
+
+   /* Lanes that each end at a different offset from the block and padding
+    * boundaries, so every lane finishes in a different round.
+    */
+   for (unsigned first = 0; first < 160; first += NUM_MESSAGES) {
+      for (unsigned i = 0; i < NUM_MESSAGES; i++) {
+         sizes[i] = first + (i * 13) % NUM_MESSAGES;
+         messages[i] = data + i;
+      }
+
+      _mesa_sha1_compute_multi(NULL, NUM_MESSAGES, messages, sizes, results);
+      for (unsigned i = 0; i < NUM_MESSAGES; i++) {
+         _mesa_sha1_compute(messages[i], sizes[i], expected);
+         pass &= check(impl, "ragged multi against compute", sizes[i],
+                       results[i], expected);
+      }
+   }
+
+   return pass;
+}
+
+static void
+benchmark(const char *impl, const uint8_t *data)
+{
+   enum { NUM_KEYS = 4096, KEY_SIZE = 64, BIG_SIZE = 4096 };
+   static const void *keys[NUM_KEYS];
+   static size_t sizes[NUM_KEYS];
+   static unsigned char results[NUM_KEYS][20];
+   double start, ns;
+   unsigned i;
+
+   start = now_ns();
+   for (i = 0; i < 1000; i++)
+      _mesa_sha1_compute(data, BIG_SIZE, results[i]);
+   ns = now_ns() - start;
+
+   printf("%-8s %8.0f MB/s", impl, 1000.0 * BIG_SIZE / ns * 1000.0);
+
+   for (i = 0; i < NUM_KEYS; i++) {
+      keys[i] = data + i % MAX_SIZE;
+      sizes[i] = KEY_SIZE;
+   }
+
+   start = now_ns();
+   for (i = 0; i < NUM_KEYS; i++)
+      _mesa_sha1_compute(keys[i], sizes[i], results[i]);
+   printf(" %8.1f ns/key", (now_ns() - start) / NUM_KEYS);
+
+   start = now_ns();
+   _mesa_sha1_compute_multi(NULL, NUM_KEYS, keys, sizes, results);
+   printf(" %8.1f ns/key multi\n", (now_ns() - start) / NUM_KEYS);
+}
+
+int main(int argc, char *argv[])
+{
+   static const struct {
+      enum mesa_sha1_impl impl;
+      const char *name;
+   } impls[] = {
+      { MESA_SHA1_IMPL_C, "c" },
+      { MESA_SHA1_IMPL_SSE2, "sse2" },
+      { MESA_SHA1_IMPL_SHA_NI, "sha-ni" },
+      { MESA_SHA1_IMPL_ARMV8, "armv8" },
+   };
+   static uint8_t data[2 * MAX_SIZE + 4096];
+   bool failed = false;
+
+   for (unsigned i = 0; i < sizeof(data); i++)
+      data[i] = next_random();
+
+   for (unsigned i = 0; i < ARRAY_SIZE(impls); i++) {
+      if (!_mesa_sha1_select_impl(impls[i].impl)) {
+         printf("%-8s not supported\n", impls[i].name);
+         continue;
+      }
+
+      if (!test_vectors(impls[i].name) || !test_random(impls[i].name, data))
+         failed = true;
+      else
+         benchmark(impls[i].name, data + MAX_SIZE);
+   }
+
+   return failed;
+}
@@ -130,6 +130,65 @@ void slab_create_child(struct slab_child_pool *pool,
    pool->pages = NULL;
    pool->free = NULL;
    pool->migrated = NULL;
+   pool->remote = NULL;
+   pool->num_remote = 0;
+}
+
+/**
+ * Hand the elements freed in this pool back to the pools that own them.
+ * This and slab_destroy_child are the only places that need the parent mutex
+ * for remote frees, so it's taken once per batch instead of once per element.
+ *
+ * Must be called with the parent mutex held. Elements of orphaned pages are
+ * returned in *orphaned, to be freed after unlocking.
+ */
+static void
+slab_flush_remote_locked(struct slab_child_pool *pool,
+                         struct slab_element_header **orphaned)
+{
+   while (pool->remote) {
+      struct slab_element_header *elt = pool->remote;
+      intptr_t owner_int;
+
+      pool->remote = elt->next;
+
+      /* Note: we _must_ re-read elt->owner here because the owning child
+       * pool may have been destroyed by another thread in the meantime.
+       */
+      owner_int = p_atomic_read(&elt->owner);
+
+      if (!(owner_int & 1)) {
+         struct slab_child_pool *owner = (struct slab_child_pool *)owner_int;
+         elt->next = owner->migrated;
+         p_atomic_set(&owner->migrated, elt);
+      } else {
+         elt->next = *orphaned;
+         *orphaned = elt;
+      }
+   }
+   pool->num_remote = 0;
+}
+
+static void
+slab_free_orphaned_list(struct slab_element_header *elt)
+{
+   while (elt) {
+      struct slab_element_header *next = elt->next;
+      slab_free_orphaned(elt);
+      elt = next;
+   }
+}
+
+static void
+slab_flush_remote(struct slab_child_pool *pool)
+{
+   struct slab_element_header *orphaned = NULL;
+
+   mtx_lock(&pool->parent->mutex);
+   slab_flush_remote_locked(pool, &orphaned);
+   mtx_unlock(&pool->parent->mutex);
+
+   slab_free_orphaned_list(orphaned);
 }
 
 /**
@@ -140,11 +199,15 @@ void slab_create_child(struct slab_child_pool *pool,
  */
 void slab_destroy_child(struct slab_child_pool *pool)
 {
+   struct slab_element_header *orphaned = NULL;
+
    if (!pool->parent)
       return; /* the slab probably wasn't even created */
 
    mtx_lock(&pool->parent->mutex);
 
+   slab_flush_remote_locked(pool, &orphaned);
+
    while (pool->pages) {
       struct slab_page_header *page = pool->pages;
       pool->pages = page->u.next;
@@ -164,6 +227,8 @@ void slab_destroy_child(struct slab_child_pool *pool)
 
    mtx_unlock(&pool->parent->mutex);
 
+   slab_free_orphaned_list(orphaned);
+
    while (pool->free) {
       struct slab_element_header *elt = pool->free;
       pool->free = elt->next;
@@ -211,12 +276,21 @@ slab_alloc(struct slab_child_pool *pool)
 
    if (!pool->free) {
       /* First, collect elements that belong to us but were freed from a
-       * different child pool.
+       * different child pool, and give back the ones we freed for others
+       * while we hold the lock anyway. Reading migrated without the lock
+       * is only a hint to skip locking when there is nothing to do.
        */
-      mtx_lock(&pool->parent->mutex);
-      pool->free = pool->migrated;
-      pool->migrated = NULL;
-      mtx_unlock(&pool->parent->mutex);
+      if (pool->remote || p_atomic_read(&pool->migrated)) {
+         struct slab_element_header *orphaned = NULL;
+
+         mtx_lock(&pool->parent->mutex);
+         pool->free = pool->migrated;
+         p_atomic_set(&pool->migrated, NULL);
+         slab_flush_remote_locked(pool, &orphaned);
+         mtx_unlock(&pool->parent->mutex);
+
+         slab_free_orphaned_list(orphaned);
+      }
 
       /* Now allocate a new page. */
       if (!pool->free && !slab_add_new_page(pool))
@@ -258,24 +332,20 @@ void slab_free(struct slab_child_pool *pool, void *ptr)
       return;
    }
 
-   /* The slow case: migration or an orphaned page. */
-   mtx_lock(&pool->parent->mutex);
-
-   /* Note: we _must_ re-read elt->owner here because the owning child pool
-    * may have been destroyed by another thread in the meantime.
+   /* Elements of orphaned pages stay orphaned, so those can be freed right
+    * away. Others are batched up and handed back to their owner later.
     */
    owner_int = p_atomic_read(&elt->owner);
-
-   if (!(owner_int & 1)) {
-      struct slab_child_pool *owner = (struct slab_child_pool *)owner_int;
-      elt->next = owner->migrated;
-      owner->migrated = elt;
-      mtx_unlock(&pool->parent->mutex);
-   } else {
-      mtx_unlock(&pool->parent->mutex);
-
+   if (owner_int & 1) {
       slab_free_orphaned(elt);
+      return;
    }
+
+   elt->next = pool->remote;
+   pool->remote = elt;
+
+   if (++pool->num_remote >= SLAB_REMOTE_BATCH)
+      slab_flush_remote(pool);
 }
 
 /**
@@ -32,8 +32,10 @@
  *
  * Allocations obtained from one child pool should usually be freed in the
  * same child pool. Freeing an allocation in a different child pool associated
- * to the same parent is allowed (and requires no locking by the caller), but
- * it is discouraged because it implies a performance penalty.
+ * to the same parent is allowed (and requires no locking by the caller). Such
+ * frees are collected in the freeing pool and handed back to their owners in
+ * batches, so they only take the parent mutex once per SLAB_REMOTE_BATCH
+ * elements.
  *
  * For convenience and to ease the transition, there is also a set of wrapper
  * functions around a single parent-child pair.
@@ -47,6 +49,8 @@
 struct slab_element_header;
 struct slab_page_header;
 
+#define SLAB_REMOTE_BATCH 32
+
 struct slab_parent_pool {
    mtx_t mutex;
    unsigned element_size;
@@ -67,6 +71,12 @@ struct slab_child_pool {
     * This list is protected by the parent mutex.
     */
    struct slab_element_header *migrated;
+
+   /* Elements owned by other pools that were freed with this pool as the
+    * argument to slab_free, and that haven't been handed back yet.
+    */
+   struct slab_element_header *remote;
+   unsigned num_remote;
 };
 
 void slab_create_parent(struct slab_parent_pool *parent,
@@ -0,0 +1,114 @@
+/*
+ * Copyright © 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file full_groups.c
+ *
+ * Gives many keys the same hash, so that they fill whole groups of the
+ * table, then removes and reinserts them while checking that the others
+ * can still be found.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include "hash_table.h"
+
+#define NUM_KEYS 100
+
+static bool
+uint_key_equal(const void *a, const void *b)
+{
+   return a == b;
+}
+
+static void *
+make_key(uint32_t i)
+{
+   return (void *)(uintptr_t)(i + 1);
+}
+
+static void
+check(struct hash_table *ht, const bool *present)
+{
+   struct hash_entry *entry;
+   uint32_t i, count = 0;
+
+   for (i = 0; i < NUM_KEYS; i++) {
+      entry = _mesa_hash_table_search_pre_hashed(ht, 0, make_key(i));
+      assert((entry != NULL) == present[i]);
+      assert(!entry || entry->data == make_key(i));
+      count += present[i];
+   }
+   assert(_mesa_hash_table_num_entries(ht) == count);
+
+   hash_table_foreach(ht, entry)
+      count--;
+   assert(count == 0);
+}
+
+int
+main(int argc, char **argv)
+{
+   struct hash_table *ht;
+   struct hash_entry *entry;
+   bool present[NUM_KEYS] = { false };
+   uint32_t i, j;
+
+   (void) argc;
+   (void) argv;
+
+   ht = _mesa_hash_table_create(NULL, NULL, uint_key_equal);
+
+   for (i = 0; i < NUM_KEYS; i++) {
+      _mesa_hash_table_insert_pre_hashed(ht, 0, make_key(i), make_key(i));
+      present[i] = true;
+   }
+   check(ht, present);
+
+   /* Remove keys from the middle of the probe sequence and put them back */
+   for (j = 0; j < 10; j++) {
+      for (i = j; i < NUM_KEYS; i += 3) {
+         entry = _mesa_hash_table_search_pre_hashed(ht, 0, make_key(i));
+         _mesa_hash_table_remove(ht, entry);
+         present[i] = false;
+      }
+      check(ht, present);
+
+      for (i = j; i < NUM_KEYS; i += 6) {
+         _mesa_hash_table_insert_pre_hashed(ht, 0, make_key(i), make_key(i));
+         present[i] = true;
+      }
+      check(ht, present);
+   }
+
+   /* Remove everything while iterating */
+   hash_table_foreach(ht, entry) {
+      present[(uintptr_t)entry->key - 1] = false;
+      _mesa_hash_table_remove(ht, entry);
+   }
+   check(ht, present);
+
+   _mesa_hash_table_destroy(ht, NULL);
+
+   return 0;
+}
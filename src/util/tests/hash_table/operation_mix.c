@@ -0,0 +1,213 @@
+/*
+ * Copyright © 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file operation_mix.c
+ *
+ * Runs searches that hit and miss, inserts, removals and a mix of them on
+ * tables of increasing size, checks the results and prints how long each
+ * operation took on average.  Keys are small integers hashed to themselves,
+ * like GL object names, and pointers hashed with _mesa_hash_pointer(), like
+ * most compiler tables.
+ *
+ * Usage: operation_mix [max entry count]
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <assert.h>
+#include "hash_table.h"
+
+static uint32_t seed;
+
+static uint32_t
+next_random(void)
+{
+   seed = seed * 1103515245 + 12345;
+   return seed >> 8;
+}
+
+static double
+now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint32_t
+name_hash(const void *key)
+{
+   return (uintptr_t)key;
+}
+
+static bool
+key_equal(const void *a, const void *b)
+{
+   return a == b;
+}
+
+struct workload {
+   const char *name;
+   uint32_t (*hash)(const void *key);
+   const void **keys; /* 2 * count keys, the second half is never inserted */
+};
+
+static void
+report(const char *workload, const char *op, unsigned count, double ns,
+       unsigned num_ops)
+{
+   printf("%-8s %8u entries  %-14s %8.1f ns\n", workload, count, op,
+          ns / num_ops);
+}
+
+static void
+run(const struct workload *w, unsigned count)
+{
+   const void **keys = w->keys;
+   struct hash_table *ht = _mesa_hash_table_create(NULL, w->hash, key_equal);
+   unsigned num_ops = MAX2(count, 1000000 / count * count);
+   unsigned i, found = 0;
+   double start;
+
+   start = now_ns();
+   for (i = 0; i < count; i++)
+      _mesa_hash_table_insert(ht, keys[i], (void *)keys[i]);
+   report(w->name, "insert", count, now_ns() - start, count);
+   assert(_mesa_hash_table_num_entries(ht) == count);
+
+   start = now_ns();
+   for (i = 0; i < num_ops; i++) {
+      struct hash_entry *entry =
+         _mesa_hash_table_search(ht, keys[next_random() % count]);
+      found += entry != NULL;
+   }
+   report(w->name, "search hit", count, now_ns() - start, num_ops);
+   assert(found == num_ops);
+
+   start = now_ns();
+   for (i = 0; i < num_ops; i++) {
+      struct hash_entry *entry =
+         _mesa_hash_table_search(ht, keys[count + next_random() % count]);
+      found += entry != NULL;
+   }
+   report(w->name, "search miss", count, now_ns() - start, num_ops);
+   assert(found == num_ops);
+
+   /* Remove one entry and insert another one, so the table keeps its size
+    * but sees many more removals than entries.
+    */
+   start = now_ns();
+   for (i = 0; i < num_ops; i++) {
+      unsigned old = i % count, new = old + count;
+
+      if ((i / count) & 1) {
+         old += count;
+         new -= count;
+      }
+      _mesa_hash_table_remove(ht, _mesa_hash_table_search(ht, keys[old]));
+      _mesa_hash_table_insert(ht, keys[new], (void *)keys[new]);
+   }
+   report(w->name, "remove+insert", count, now_ns() - start, num_ops);
+   assert(_mesa_hash_table_num_entries(ht) == count);
+
+   /* 80% searches, half of them misses, 10% inserts and 10% removals */
+   start = now_ns();
+   for (i = 0; i < num_ops; i++) {
+      uint32_t r = next_random();
+      const void *key = keys[(r >> 4) % (2 * count)];
+      struct hash_entry *entry;
+
+      switch (r % 10) {
+      case 0:
+         _mesa_hash_table_insert(ht, key, (void *)key);
+         break;
+      case 1:
+         _mesa_hash_table_remove(ht, _mesa_hash_table_search(ht, key));
+         break;
+      default:
+         entry = _mesa_hash_table_search(ht, key);
+         found += entry && entry->data == key;
+         break;
+      }
+   }
+   report(w->name, "mixed", count, now_ns() - start, num_ops);
+
+   /* Check the contents against a search for every key */
+   found = 0;
+   for (i = 0; i < 2 * count; i++)
+      found += _mesa_hash_table_search(ht, keys[i]) != NULL;
+   assert(found == _mesa_hash_table_num_entries(ht));
+
+   struct hash_entry *entry;
+   hash_table_foreach(ht, entry)
+      found--;
+   assert(found == 0);
+
+   _mesa_hash_table_destroy(ht, NULL);
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned max_count = argc > 1 ? strtoul(argv[1], NULL, 0) : 100000;
+   const void **names = malloc(2 * max_count * sizeof(void *));
+   const void **pointers = malloc(2 * max_count * sizeof(void *));
+   char *storage = malloc(2 * max_count * 16);
+   unsigned count, i;
+
+   assert(names && pointers && storage);
+
+   /* GL names are handed out in order */
+   for (i = 0; i < 2 * max_count; i++)
+      names[i] = (void *)(uintptr_t)(i + 1);
+
+   /* Like pointers to allocations of a few different sizes, shuffled */
+   for (i = 0; i < 2 * max_count; i++)
+      pointers[i] = storage + i * 16;
+   seed = 1;
+   for (i = 2 * max_count - 1; i > 0; i--) {
+      unsigned j = next_random() % (i + 1);
+      const void *tmp = pointers[i];
+      pointers[i] = pointers[j];
+      pointers[j] = tmp;
+   }
+
+   const struct workload workloads[] = {
+      { "names", name_hash, names },
+      { "pointers", _mesa_hash_pointer, pointers },
+   };
+
+   for (count = 10; count <= max_count; count *= 10) {
+      for (i = 0; i < ARRAY_SIZE(workloads); i++)
+         run(&workloads[i], count);
+   }
+
+   free(storage);
+   free(pointers);
+   free(names);
+
+   return 0;
+}
@@ -0,0 +1,385 @@
+/*
+ * Copyright © 2017 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file job_latency.c
+ *
+ * Checks that util_queue runs jobs in order, that dropped jobs don't run and
+ * that nothing gets lost with several producers and threads, with threads of
+ * the queue's own and on the shared pool, and that the pool runs the jobs of
+ * higher priority queues first. Then prints how long adding a job, a round
+ * trip through an idle thread and waiting for a fence take.
+ *
+ * Usage: job_latency [job count]
+ */
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "u_atomic.h"
+#include "u_queue.h"
+
+struct job {
+   struct util_queue_fence fence;
+   unsigned index;
+   unsigned *counter;
+   bool ran, cleaned_up;
+};
+
+static double
+now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void
+nop_job(void *data, int thread_index)
+{
+}
+
+static void
+ordered_job(void *data, int thread_index)
+{
+   struct job *job = data;
+
+   /* With one thread, jobs run in the order they were added */
+   assert(*job->counter == job->index);
+   (*job->counter)++;
+   job->ran = true;
+}
+
+static int busy[UTIL_QUEUE_MAX_SHARED_THREADS];
+
+static void
+counting_job(void *data, int thread_index)
+{
+   struct job *job = data;
+
+   /* No two jobs run with the same thread index at the same time */
+   assert(thread_index >= 0 && thread_index < UTIL_QUEUE_MAX_SHARED_THREADS);
+   assert(p_atomic_cmpxchg(&busy[thread_index], 0, 1) == 0);
+
+   p_atomic_inc(job->counter);
+   job->ran = true;
+
+   p_atomic_set(&busy[thread_index], 0);
+}
+
+static void
+priority_job(void *data, int thread_index)
+{
+   struct job *job = data;
+
+   /* Remember which one ran when */
+   job->index = p_atomic_inc_return(job->counter);
+   job->ran = true;
+}
+
+static void
+cleanup_job(void *data, int thread_index)
+{
+   struct job *job = data;
+
+   job->cleaned_up = true;
+}
+
+static int gate, gates_entered;
+
+static void
+gate_job(void *data, int thread_index)
+{
+   int *open = data;
+
+   p_atomic_inc(&gates_entered);
+   while (!p_atomic_read(open))
+      thrd_yield();
+}
+
+static struct job *
+create_jobs(unsigned count, unsigned *counter)
+{
+   struct job *jobs = calloc(count, sizeof(*jobs));
+
+   assert(jobs);
+   for (unsigned i = 0; i < count; i++) {
+      util_queue_fence_init(&jobs[i].fence);
+      jobs[i].index = i;
+      jobs[i].counter = counter;
+   }
+   return jobs;
+}
+
+static void
+destroy_jobs(struct job *jobs, unsigned count)
+{
+   for (unsigned i = 0; i < count; i++)
+      util_queue_fence_destroy(&jobs[i].fence);
+   free(jobs);
+}
+
+static void
+test_order(unsigned count, unsigned flags)
+{
+   struct util_queue queue;
+   unsigned counter = 0;
+   struct job *jobs = create_jobs(count, &counter);
+
+   assert(util_queue_init(&queue, "test", 8, 1, flags));
+
+   for (unsigned i = 0; i < count; i++)
+      util_queue_add_job(&queue, &jobs[i], &jobs[i].fence, ordered_job, NULL);
+   for (unsigned i = 0; i < count; i++)
+      util_queue_fence_wait(&jobs[i].fence);
+
+   assert(counter == count);
+
+   util_queue_destroy(&queue);
+   destroy_jobs(jobs, count);
+}
+
+static void
+test_drop(unsigned flags)
+{
+   struct util_queue queue;
+   struct util_queue_fence gate_fence;
+   unsigned counter = 0;
+   const unsigned count = 32;
+   struct job *jobs = create_jobs(count, &counter);
+
+   assert(util_queue_init(&queue, "test", 8, 1, flags));
+
+   /* Keep the thread busy so that the jobs stay queued */
+   p_atomic_set(&gate, 0);
+   util_queue_fence_init(&gate_fence);
+   util_queue_add_job(&queue, &gate, &gate_fence, gate_job, NULL);
+
+   /* Without RESIZE_IF_FULL, only a few fit */
+   unsigned num_added = flags & UTIL_QUEUE_INIT_RESIZE_IF_FULL ? count : 7;
+   for (unsigned i = 0; i < num_added; i++) {
+      util_queue_add_job(&queue, &jobs[i], &jobs[i].fence,
+                         counting_job, cleanup_job);
+   }
+
+   for (unsigned i = 1; i < num_added; i += 2) {
+      util_queue_drop_job(&queue, &jobs[i].fence);
+      assert(util_queue_fence_is_signalled(&jobs[i].fence));
+      assert(jobs[i].cleaned_up && !jobs[i].ran);
+   }
+
+   p_atomic_set(&gate, 1);
+   for (unsigned i = 0; i < num_added; i++)
+      util_queue_fence_wait(&jobs[i].fence);
+
+   /* Cleanups run after the fence is signalled, so wait for the thread */
+   util_queue_destroy(&queue);
+
+   for (unsigned i = 0; i < num_added; i++) {
+      assert(jobs[i].ran == !(i & 1));
+      assert(jobs[i].cleaned_up);
+   }
+   assert(counter == (num_added + 1) / 2);
+
+   util_queue_fence_destroy(&gate_fence);
+   destroy_jobs(jobs, count);
+}
+
+struct producer {
+   struct util_queue *queue;
+   struct job *jobs;
+   unsigned count;
+};
+
+static int
+producer_func(void *data)
+{
+   struct producer *p = data;
+
+   for (unsigned i = 0; i < p->count; i++) {
+      util_queue_add_job(p->queue, &p->jobs[i], &p->jobs[i].fence,
+                         counting_job, NULL);
+   }
+   for (unsigned i = 0; i < p->count; i++)
+      util_queue_fence_wait(&p->jobs[i].fence);
+   return 0;
+}
+
+static void
+test_many_producers(unsigned count, unsigned flags)
+{
+   struct util_queue queue;
+   struct producer producers[4];
+   thrd_t threads[4];
+   unsigned counter = 0;
+   struct job *jobs = create_jobs(count * 4, &counter);
+
+   assert(util_queue_init(&queue, "test", 16, 4, flags));
+   assert(util_queue_is_initialized(&queue));
+
+   for (unsigned i = 0; i < 4; i++) {
+      producers[i].queue = &queue;
+      producers[i].jobs = jobs + i * count;
+      producers[i].count = count;
+      thrd_create(&threads[i], producer_func, &producers[i]);
+   }
+   for (unsigned i = 0; i < 4; i++)
+      thrd_join(threads[i], NULL);
+
+   assert(counter == count * 4);
+   for (unsigned i = 0; i < count * 4; i++)
+      assert(jobs[i].ran);
+
+   util_queue_destroy(&queue);
+   destroy_jobs(jobs, count * 4);
+}
+
+/* main() limits the pool to 2 threads. Keep one busy and the other one
+ * runs the jobs of the higher priority queues first, no matter the order
+ * they were added in.
+ */
+static void
+test_priorities(void)
+{
+   static const unsigned flags[3] = {
+      UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY,
+      0,
+      UTIL_QUEUE_INIT_HIGH_PRIORITY,
+   };
+   struct util_queue gate_queue, queues[3];
+   struct util_queue_fence gate_fences[2];
+   int gates[2] = { 0, 0 };
+   unsigned counter = 0;
+   struct job *jobs = create_jobs(3, &counter);
+
+   assert(util_queue_init(&gate_queue, "gate", 8, 2,
+                          UTIL_QUEUE_INIT_SHARED_THREADS));
+   for (unsigned i = 0; i < 3; i++) {
+      assert(util_queue_init(&queues[i], "test", 8, 1,
+                             UTIL_QUEUE_INIT_SHARED_THREADS | flags[i]));
+   }
+
+   p_atomic_set(&gates_entered, 0);
+   for (unsigned i = 0; i < 2; i++) {
+      util_queue_fence_init(&gate_fences[i]);
+      util_queue_add_job(&gate_queue, &gates[i], &gate_fences[i],
+                         gate_job, NULL);
+   }
+   while (p_atomic_read(&gates_entered) < 2)
+      thrd_yield();
+
+   for (unsigned i = 0; i < 3; i++) {
+      util_queue_add_job(&queues[i], &jobs[i], &jobs[i].fence,
+                         priority_job, NULL);
+   }
+
+   p_atomic_set(&gates[0], 1);
+   for (unsigned i = 0; i < 3; i++)
+      util_queue_fence_wait(&jobs[i].fence);
+
+   assert(jobs[2].index == 1);
+   assert(jobs[1].index == 2);
+   assert(jobs[0].index == 3);
+
+   p_atomic_set(&gates[1], 1);
+   util_queue_destroy(&gate_queue);
+   for (unsigned i = 0; i < 3; i++)
+      util_queue_destroy(&queues[i]);
+
+   util_queue_fence_destroy(&gate_fences[0]);
+   util_queue_fence_destroy(&gate_fences[1]);
+   destroy_jobs(jobs, 3);
+}
+
+static void
+bench(unsigned count, unsigned flags)
+{
+   struct util_queue queue;
+   unsigned counter = 0;
+   struct job *jobs = create_jobs(count, &counter);
+   double start, enqueue, drain, round_trip, wait;
+
+   assert(util_queue_init(&queue, "bench", 64, 1, flags));
+
+   /* Adding jobs while the thread keeps up, and the thread catching up */
+   start = now_ns();
+   for (unsigned i = 0; i < count; i++)
+      util_queue_add_job(&queue, &jobs[i], &jobs[i].fence, nop_job, NULL);
+   enqueue = now_ns() - start;
+   util_queue_fence_wait(&jobs[count - 1].fence);
+   drain = now_ns() - start;
+
+   /* Each job has to wake up the idle thread */
+   unsigned num_round_trips = count / 16;
+   start = now_ns();
+   for (unsigned i = 0; i < num_round_trips; i++) {
+      util_queue_add_job(&queue, &jobs[i], &jobs[i].fence, nop_job, NULL);
+      util_queue_fence_wait(&jobs[i].fence);
+   }
+   round_trip = now_ns() - start;
+
+   /* Waiting for a fence that is already signalled */
+   start = now_ns();
+   for (unsigned i = 0; i < count; i++)
+      util_queue_fence_wait(&jobs[i].fence);
+   wait = now_ns() - start;
+
+   printf("%s:\n", flags & UTIL_QUEUE_INIT_SHARED_THREADS ?
+          "shared pool" : "own thread");
+   printf("add job:            %8.1f ns\n", enqueue / count);
+   printf("add and execute:    %8.1f ns\n", drain / count);
+   printf("round trip:         %8.1f ns\n", round_trip / num_round_trips);
+   printf("signalled wait:     %8.1f ns\n", wait / count);
+
+   util_queue_destroy(&queue);
+   destroy_jobs(jobs, count);
+}
+
+int
+main(int argc, char **argv)
+{
+   static const unsigned flags[4] = {
+      0,
+      UTIL_QUEUE_INIT_RESIZE_IF_FULL,
+      UTIL_QUEUE_INIT_SHARED_THREADS,
+      UTIL_QUEUE_INIT_SHARED_THREADS | UTIL_QUEUE_INIT_RESIZE_IF_FULL,
+   };
+   unsigned count = argc > 1 ? strtoul(argv[1], NULL, 0) : 100000;
+
+   /* Before the first shared queue is created */
+   setenv("MESA_THREAD_POOL_SIZE", "2", 1);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(flags); i++) {
+      test_order(count, flags[i]);
+      test_drop(flags[i]);
+      test_many_producers(count / 4, flags[i]);
+   }
+   test_priorities();
+
+   bench(count, 0);
+   bench(count, UTIL_QUEUE_INIT_SHARED_THREADS);
+
+   return 0;
+}
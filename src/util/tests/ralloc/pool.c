@@ -0,0 +1,190 @@
+/*
+ * Copyright © 2017 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/** @file pool.c
+ *
+ * Allocates ralloc blocks from a pool and frees most of them again, steals
+ * blocks out of and into the pool's context, evacuates the sparse pages with
+ * ralloc_pool_move() and releases them with ralloc_pool_compact(). Checks
+ * that contents, parents and children survive every step and that each
+ * destructor runs exactly once, including for blocks that outlive
+ * ralloc_pool_destroy().
+ */
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ralloc.h"
+
+#define NUM_BLOCKS 16384
+
+struct block {
+   unsigned index;
+   char *name;
+   char payload[36];
+};
+
+static unsigned destroyed;
+
+static void
+block_destructor(void *ptr)
+{
+   struct block *b = ptr;
+
+   assert(b->payload[0] == (char) b->index);
+   destroyed++;
+}
+
+static struct block *
+block_create(struct ralloc_pool *pool, const void *ctx, unsigned index)
+{
+   struct block *b = ralloc_pool_size(pool, ctx, sizeof(*b));
+
+   assert(b);
+   b->index = index;
+   b->name = ralloc_asprintf(b, "block %u", index);
+   memset(b->payload, (char) index, sizeof(b->payload));
+   ralloc_set_destructor(b, block_destructor);
+   return b;
+}
+
+static void
+block_check(const struct block *b, const void *ctx, unsigned index)
+{
+   char name[32];
+
+   snprintf(name, sizeof(name), "block %u", index);
+   assert(b->index == index);
+   assert(ralloc_parent(b) == ctx);
+   assert(ralloc_parent(b->name) == b);
+   assert(strcmp(b->name, name) == 0);
+   for (unsigned i = 0; i < sizeof(b->payload); i++)
+      assert(b->payload[i] == (char) index);
+}
+
+int
+main(int argc, char **argv)
+{
+   struct ralloc_pool *pool = ralloc_pool_create();
+   void *ctx = ralloc_context(NULL);
+   void *other = ralloc_context(NULL);
+   struct block **blocks = calloc(NUM_BLOCKS, sizeof(*blocks));
+   unsigned created = 0, freed = 0, live = 0;
+   struct block *stolen, *grown;
+   char *adopted;
+   size_t released;
+
+   assert(pool && ctx && other && blocks);
+
+   for (unsigned i = 0; i < NUM_BLOCKS; i++)
+      blocks[i] = block_create(pool, ctx, i);
+   created = NUM_BLOCKS;
+
+   /* Leave every 16th block alive, so that all pages but the last one end
+    * up sparse and get evacuated below.
+    */
+   for (unsigned i = 0; i < NUM_BLOCKS; i++) {
+      if (i % 16 == 0)
+         continue;
+      ralloc_free(blocks[i]);
+      blocks[i] = NULL;
+      freed++;
+   }
+   assert(destroyed == freed);
+
+   /* Freed blocks are recycled. */
+   blocks[1] = block_create(pool, ctx, 1);
+   created++;
+
+   /* A pooled block moved to a context that doesn't use the pool, and a
+    * malloc'd block moved under a context whose other children are pooled.
+    */
+   ralloc_steal(other, blocks[16]);
+   stolen = blocks[16];
+   blocks[16] = NULL;
+   block_check(stolen, other, 16);
+
+   adopted = ralloc_strdup(other, "adopted");
+   ralloc_steal(ctx, adopted);
+   assert(ralloc_parent(adopted) == ctx);
+
+   /* Outgrowing its size class moves a block out of the pool. */
+   grown = block_create(pool, ctx, NUM_BLOCKS);
+   created++;
+   grown = reralloc_size(ctx, grown, 4096);
+   block_check(grown, ctx, NUM_BLOCKS);
+   memset((char *) grown + sizeof(*grown), 0xcd, 4096 - sizeof(*grown));
+
+   for (unsigned i = 0; i < NUM_BLOCKS; i++) {
+      if (blocks[i])
+         block_check(blocks[i], ctx, i);
+   }
+
+   assert(ralloc_pool_begin_compact(pool));
+   for (unsigned i = 0; i < NUM_BLOCKS; i++) {
+      if (!blocks[i])
+         continue;
+      blocks[i] = ralloc_pool_move(pool, blocks[i]);
+      blocks[i]->name = ralloc_pool_move(pool, blocks[i]->name);
+      live++;
+   }
+   stolen = ralloc_pool_move(pool, stolen);
+   released = ralloc_pool_compact(pool);
+
+   /* Moving doesn't run destructors, and the survivors fit in a fraction of
+    * the pages they started out in.
+    */
+   assert(destroyed == freed);
+   assert(released > 0);
+   printf("%u live blocks, %zu bytes released\n", live, released);
+
+   for (unsigned i = 0; i < NUM_BLOCKS; i++) {
+      if (blocks[i])
+         block_check(blocks[i], ctx, i);
+   }
+   block_check(stolen, other, 16);
+   block_check(grown, ctx, NUM_BLOCKS);
+   assert(ralloc_parent(adopted) == ctx);
+
+   /* Nothing left to evacuate. */
+   assert(!ralloc_pool_begin_compact(pool));
+   assert(ralloc_pool_compact(pool) == 0);
+
+   /* The pool goes away before its blocks do. */
+   ralloc_pool_destroy(pool);
+   ralloc_free(ctx);
+   assert(destroyed == created - 1);
+
+   block_check(stolen, other, 16);
+   ralloc_free(other);
+   assert(destroyed == created);
+
+   free(blocks);
+   return 0;
+}
@@ -0,0 +1,243 @@
+/*
+ * Copyright © 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file synthetic_graphs.c
+ *
+ * Builds interference graphs of increasing size out of random live ranges,
+ * colors them and checks the result, printing how long each allocation
+ * took.  The register file looks like a scalar backend's: 128 base
+ * registers and classes of 1 to 4 contiguous ones.
+ *
+ * Usage: synthetic_graphs [max node count]
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <assert.h>
+#include "ralloc.h"
+#include "register_allocate.h"
+
+#define BASE_REGS 128
+#define CLASS_COUNT 4
+
+struct reg_file {
+   struct ra_regs *regs;
+   unsigned int classes[CLASS_COUNT];
+   unsigned int class_start[CLASS_COUNT];
+
+   /* First base register and size of each register */
+   unsigned int *base;
+   unsigned int *size;
+};
+
+struct edge {
+   unsigned int n1, n2;
+};
+
+static uint32_t seed;
+
+static uint32_t
+next_random(void)
+{
+   seed = seed * 1103515245 + 12345;
+   return seed >> 8;
+}
+
+static double
+now_ms(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void
+create_reg_file(void *mem_ctx, struct reg_file *rf)
+{
+   unsigned int count = 0, c, i, j, r;
+
+   for (c = 0; c < CLASS_COUNT; c++)
+      count += BASE_REGS - c;
+
+   rf->regs = ra_alloc_reg_set(mem_ctx, count, true);
+   rf->base = ralloc_array(mem_ctx, unsigned int, count);
+   rf->size = ralloc_array(mem_ctx, unsigned int, count);
+
+   r = 0;
+   for (c = 0; c < CLASS_COUNT; c++) {
+      rf->classes[c] = ra_alloc_reg_class(rf->regs);
+      rf->class_start[c] = r;
+
+      for (i = 0; i < BASE_REGS - c; i++) {
+         ra_class_add_reg(rf->regs, rf->classes[c], r);
+         rf->base[r] = i;
+         rf->size[r] = c + 1;
+
+         if (c > 0) {
+            for (j = 0; j <= c; j++)
+               ra_add_transitive_reg_conflict(rf->regs, i + j, r);
+         }
+         r++;
+      }
+   }
+
+   ra_set_finalize(rf->regs, NULL);
+}
+
+/**
+ * Node i is live from i to i + length, where the length is at most
+ * max_length.  A few long-range edges are added on top, some of them
+ * twice, to get away from a pure interval graph.
+ */
+static unsigned int
+build_graph(struct ra_graph *g, struct reg_file *rf, unsigned int count,
+            unsigned int max_length, struct edge *edges)
+{
+   unsigned int edge_count = 0;
+   unsigned int i, j;
+
+   for (i = 0; i < count; i++) {
+      /* Mostly scalars, like real shaders */
+      uint32_t r = next_random() % 8;
+      unsigned int c = r < 5 ? 0 : r - 4;
+
+      ra_set_node_class(g, i, rf->classes[c]);
+      ra_set_node_spill_cost(g, i, 1.0f + next_random() % 16);
+   }
+
+   for (i = 0; i < count; i++) {
+      unsigned int length = 1 + next_random() % max_length;
+
+      for (j = i + 1; j < count && j < i + length; j++) {
+         ra_add_node_interference(g, i, j);
+         edges[edge_count].n1 = i;
+         edges[edge_count].n2 = j;
+         edge_count++;
+      }
+
+      if (next_random() % 4 == 0) {
+         j = next_random() % count;
+         ra_add_node_interference(g, i, j);
+         ra_add_node_interference(g, j, i);
+         edges[edge_count].n1 = i;
+         edges[edge_count].n2 = j;
+         edge_count++;
+      }
+   }
+
+   return edge_count;
+}
+
+static bool
+regs_overlap(struct reg_file *rf, unsigned int r1, unsigned int r2)
+{
+   return rf->base[r1] < rf->base[r2] + rf->size[r2] &&
+          rf->base[r2] < rf->base[r1] + rf->size[r1];
+}
+
+static void
+check_coloring(struct ra_graph *g, struct reg_file *rf, unsigned int count,
+               const struct edge *edges, unsigned int edge_count)
+{
+   unsigned int i;
+
+   for (i = 0; i < count; i++)
+      assert(ra_get_node_reg(g, i) != ~0U);
+
+   for (i = 0; i < edge_count; i++) {
+      unsigned int n1 = edges[i].n1, n2 = edges[i].n2;
+
+      if (n1 == n2)
+         continue;
+
+      if (regs_overlap(rf, ra_get_node_reg(g, n1), ra_get_node_reg(g, n2))) {
+         fprintf(stderr, "nodes %u and %u interfere but got regs %u and %u\n",
+                 n1, n2, ra_get_node_reg(g, n1), ra_get_node_reg(g, n2));
+         exit(1);
+      }
+   }
+}
+
+static void
+run(struct reg_file *rf, unsigned int count, unsigned int max_length,
+    const char *name)
+{
+   struct edge *edges = malloc((count * max_length + count) * sizeof(*edges));
+   struct ra_graph *g;
+   unsigned int edge_count;
+   double start, build_time, alloc_time;
+   bool success;
+
+   start = now_ms();
+   g = ra_alloc_interference_graph(rf->regs, count);
+   edge_count = build_graph(g, rf, count, max_length, edges);
+   build_time = now_ms() - start;
+
+   start = now_ms();
+   success = ra_allocate(g);
+   alloc_time = now_ms() - start;
+
+   if (success) {
+      check_coloring(g, rf, count, edges, edge_count);
+   } else {
+      /* Every node has a spill cost, so there has to be a candidate */
+      if (ra_get_best_spill_node(g) < 0) {
+         fprintf(stderr, "no spill candidate after failing to allocate\n");
+         exit(1);
+      }
+   }
+
+   printf("%-6s %8u nodes %9u edges: %-7s build %9.2f ms, allocate %9.2f ms\n",
+          name, count, edge_count, success ? "colored" : "spills",
+          build_time, alloc_time);
+
+   ralloc_free(g);
+   free(edges);
+}
+
+int
+main(int argc, char **argv)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   unsigned int max_count = argc > 1 ? strtoul(argv[1], NULL, 0) : 32768;
+   struct reg_file rf;
+   unsigned int count;
+
+   create_reg_file(mem_ctx, &rf);
+
+   seed = 1;
+   for (count = 256; count <= max_count; count *= 4) {
+      /* Low pressure, mostly trivially colorable nodes */
+      run(&rf, count, 12, "light");
+
+      /* High pressure, which needs optimistic coloring and may spill */
+      run(&rf, count, 160, "heavy");
+   }
+
+   ralloc_free(mem_ctx);
+
+   return 0;
+}
@@ -0,0 +1,285 @@
+/*
+ * Copyright © 2017 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/** @file alloc_free.c
+ *
+ * Allocates and frees slab elements from several threads, each with its own
+ * child pool: freeing in the same pool, handing the elements to another
+ * thread that frees them in its pool, and freeing them after the allocating
+ * pool was destroyed. Checks that the contents of live elements stay intact
+ * and prints how long an allocation and free pair takes.
+ *
+ * Usage: alloc_free [thread count] [element count per thread]
+ */
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "c11/threads.h"
+#include "macros.h"
+#include "slab.h"
+
+#define MAX_THREADS 16
+#define BATCH 1024
+
+struct element {
+   uintptr_t owner;
+   unsigned index;
+   char payload[40];
+};
+
+/* Elements handed from one thread to the next. */
+struct mailbox {
+   mtx_t lock;
+   cnd_t cond;
+   struct element *batch[BATCH];
+   unsigned count;
+   bool full;
+};
+
+struct worker {
+   struct slab_parent_pool *parent;
+   struct slab_child_pool pool;
+   struct slab_child_pool other_pool;
+   struct mailbox *in, *out;
+   unsigned count;
+   thrd_t thread;
+};
+
+static double
+now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static struct element *
+alloc_element(struct worker *w, unsigned index)
+{
+   struct element *e = slab_alloc(&w->pool);
+
+   assert(e);
+   e->owner = (uintptr_t)w;
+   e->index = index;
+   e->payload[index % sizeof(e->payload)] = index;
+   return e;
+}
+
+static void
+free_element(struct worker *w, struct element *e, struct worker *owner)
+{
+   assert(e->owner == (uintptr_t)owner);
+   assert(e->payload[e->index % sizeof(e->payload)] == (char)e->index);
+   e->owner = 0;
+   slab_free(&w->pool, e);
+}
+
+static void
+mailbox_send(struct mailbox *box, struct element **batch)
+{
+   mtx_lock(&box->lock);
+   while (box->full)
+      cnd_wait(&box->cond, &box->lock);
+   memcpy(box->batch, batch, sizeof(box->batch));
+   box->full = true;
+   cnd_broadcast(&box->cond);
+   mtx_unlock(&box->lock);
+}
+
+static void
+mailbox_receive(struct mailbox *box, struct element **batch)
+{
+   mtx_lock(&box->lock);
+   while (!box->full)
+      cnd_wait(&box->cond, &box->lock);
+   memcpy(batch, box->batch, sizeof(box->batch));
+   box->full = false;
+   cnd_broadcast(&box->cond);
+   mtx_unlock(&box->lock);
+}
+
+/* Allocate and free in the same pool. */
+static int
+local_thread(void *data)
+{
+   struct worker *w = data;
+   struct element *batch[BATCH];
+
+   for (unsigned n = 0; n < w->count; n += BATCH) {
+      for (unsigned i = 0; i < BATCH; i++)
+         batch[i] = alloc_element(w, n + i);
+      for (unsigned i = 0; i < BATCH; i++)
+         free_element(w, batch[BATCH - 1 - i], w);
+   }
+   return 0;
+}
+
+/* Free in a different pool without another thread involved, which is what
+ * remote frees cost apart from moving the elements between threads.
+ */
+static int
+cross_thread(void *data)
+{
+   struct worker *w = data;
+   struct slab_child_pool *pools[2] = { &w->pool, &w->other_pool };
+   struct element *batch[BATCH];
+
+   for (unsigned n = 0; n < w->count; n += BATCH) {
+      struct slab_child_pool *from = pools[(n / BATCH) & 1];
+      struct slab_child_pool *to = pools[!((n / BATCH) & 1)];
+
+      for (unsigned i = 0; i < BATCH; i++) {
+         batch[i] = slab_alloc(from);
+         assert(batch[i]);
+      }
+      for (unsigned i = 0; i < BATCH; i++)
+         slab_free(to, batch[i]);
+   }
+   return 0;
+}
+
+/* Allocate a batch, send it to the next thread and free the batch received
+ * from the previous one, like transfers that are mapped in one thread and
+ * unmapped in another.
+ */
+static int
+remote_thread(void *data)
+{
+   struct worker *w = data;
+   struct element *batch[BATCH];
+
+   for (unsigned n = 0; n < w->count; n += BATCH) {
+      for (unsigned i = 0; i < BATCH; i++)
+         batch[i] = alloc_element(w, n + i);
+      mailbox_send(w->out, batch);
+
+      mailbox_receive(w->in, batch);
+      for (unsigned i = 0; i < BATCH; i++)
+         free_element(w, batch[i], (struct worker *)batch[i]->owner);
+   }
+   return 0;
+}
+
+static void
+run(const char *name, int (*func)(void *), unsigned num_threads,
+    unsigned count)
+{
+   struct slab_parent_pool parent;
+   struct worker workers[MAX_THREADS];
+   struct mailbox boxes[MAX_THREADS];
+   double start;
+
+   slab_create_parent(&parent, sizeof(struct element), 64);
+
+   for (unsigned i = 0; i < num_threads; i++) {
+      mtx_init(&boxes[i].lock, mtx_plain);
+      cnd_init(&boxes[i].cond);
+      boxes[i].full = false;
+   }
+
+   for (unsigned i = 0; i < num_threads; i++) {
+      workers[i].parent = &parent;
+      slab_create_child(&workers[i].pool, &parent);
+      slab_create_child(&workers[i].other_pool, &parent);
+      workers[i].out = &boxes[i];
+      workers[i].in = &boxes[(i + num_threads - 1) % num_threads];
+      workers[i].count = count;
+   }
+
+   start = now_ns();
+   for (unsigned i = 0; i < num_threads; i++) {
+      int ret = thrd_create(&workers[i].thread, func, &workers[i]);
+      assert(ret == thrd_success);
+      (void)ret;
+   }
+   for (unsigned i = 0; i < num_threads; i++)
+      thrd_join(workers[i].thread, NULL);
+
+   printf("%-8s %2u threads: %6.1f ns per allocation and free\n", name,
+          num_threads, (now_ns() - start) / ((double)count * num_threads));
+
+   for (unsigned i = 0; i < num_threads; i++) {
+      slab_destroy_child(&workers[i].pool);
+      slab_destroy_child(&workers[i].other_pool);
+      mtx_destroy(&boxes[i].lock);
+      cnd_destroy(&boxes[i].cond);
+   }
+   slab_destroy_parent(&parent);
+}
+
+/* Free elements after the pool they came from is gone. */
+static void
+test_orphans(void)
+{
+   struct slab_parent_pool parent;
+   struct worker a = { .parent = &parent }, b = { .parent = &parent };
+   struct element *elements[3 * SLAB_REMOTE_BATCH];
+
+   slab_create_parent(&parent, sizeof(struct element), 64);
+   slab_create_child(&a.pool, &parent);
+   slab_create_child(&b.pool, &parent);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(elements); i++)
+      elements[i] = alloc_element(&a, i);
+
+   /* Some are still waiting in b's batch when a is destroyed */
+   for (unsigned i = 0; i < SLAB_REMOTE_BATCH + 1; i++)
+      free_element(&b, elements[i], &a);
+
+   slab_destroy_child(&a.pool);
+
+   for (unsigned i = SLAB_REMOTE_BATCH + 1; i < ARRAY_SIZE(elements); i++)
+      free_element(&b, elements[i], &a);
+
+   slab_destroy_child(&b.pool);
+   slab_destroy_parent(&parent);
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned max_threads = argc > 1 ? atoi(argv[1]) : 4;
+   unsigned count = argc > 2 ? atoi(argv[2]) : 1000000;
+
+   max_threads = MIN2(MAX2(max_threads, 1), MAX_THREADS);
+   count = MAX2(count / BATCH, 1) * BATCH;
+
+   test_orphans();
+
+   for (unsigned n = 1; n <= max_threads; n *= 2)
+      run("local", local_thread, n, count);
+   for (unsigned n = 1; n <= max_threads; n *= 2)
+      run("cross", cross_thread, n, count);
+   for (unsigned n = 2; n <= max_threads; n *= 2)
+      run("remote", remote_thread, n, count);
+
+   return 0;
+}
@@ -47,6 +47,7 @@
 #define p_atomic_add(v, i) (void) __atomic_add_fetch((v), (i), __ATOMIC_ACQ_REL)
 #define p_atomic_inc_return(v) __atomic_add_fetch((v), 1, __ATOMIC_ACQ_REL)
 #define p_atomic_dec_return(v) __atomic_sub_fetch((v), 1, __ATOMIC_ACQ_REL)
+#define p_atomic_xchg(v, i) __atomic_exchange_n((v), (i), __ATOMIC_ACQ_REL)
 
 #else
 
@@ -59,6 +60,10 @@
 #define p_atomic_inc_return(v) __sync_add_and_fetch((v), 1)
 #define p_atomic_dec_return(v) __sync_sub_and_fetch((v), 1)
 
+/* __sync_lock_test_and_set is only an acquire barrier, add the release half */
+#define p_atomic_xchg(v, i) \
+   ({ __sync_synchronize(); __sync_lock_test_and_set((v), (i)); })
+
 #endif
 
 /* There is no __atomic_* compare and exchange that returns the current value.
@@ -153,6 +158,13 @@
    sizeof *(_v) == sizeof(__int64) ? InterlockedCompareExchange64 ((__int64 *)(_v), (__int64)(_new), (__int64)(_old)) : \
                                      (assert(!"should not get here"), 0))
 
+#define p_atomic_xchg(_v, _new) (\
+   sizeof *(_v) == sizeof(char)    ? _InterlockedExchange8 ((char *)   (_v), (char)   (_new)) : \
+   sizeof *(_v) == sizeof(short)   ? _InterlockedExchange16((short *)  (_v), (short)  (_new)) : \
+   sizeof *(_v) == sizeof(long)    ? _InterlockedExchange  ((long *)   (_v), (long)   (_new)) : \
+   sizeof *(_v) == sizeof(__int64) ? InterlockedExchange64 ((__int64 *)(_v), (__int64)(_new)) : \
+                                     (assert(!"should not get here"), 0))
+
 #endif
 
 #if defined(PIPE_ATOMIC_OS_SOLARIS)
@@ -214,6 +226,13 @@
    sizeof(*v) == sizeof(uint64_t) ? atomic_cas_64((uint64_t *)(v), (uint64_t)(old), (uint64_t)(_new)) : \
                                     (assert(!"should not get here"), 0))
 
+#define p_atomic_xchg(v, i) ((__typeof(*v)) \
+   sizeof(*v) == sizeof(uint8_t)  ? atomic_swap_8 ((uint8_t  *)(v), (uint8_t )(i)) : \
+   sizeof(*v) == sizeof(uint16_t) ? atomic_swap_16((uint16_t *)(v), (uint16_t)(i)) : \
+   sizeof(*v) == sizeof(uint32_t) ? atomic_swap_32((uint32_t *)(v), (uint32_t)(i)) : \
+   sizeof(*v) == sizeof(uint64_t) ? atomic_swap_64((uint64_t *)(v), (uint64_t)(i)) : \
+                                    (assert(!"should not get here"), 0))
+
 #endif
 
 #ifndef PIPE_ATOMIC
@@ -61,6 +61,10 @@
       assert(v == 0 && "p_atomic_cmpxchg"); \
       assert(r == ones && "p_atomic_cmpxchg"); \
       \
+      r = p_atomic_xchg(&v, ones); \
+      assert(v == ones && "p_atomic_xchg"); \
+      assert(r == 0 && "p_atomic_xchg"); \
+      \
       (void) r; \
    }
 
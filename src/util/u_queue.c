@@ -25,9 +25,20 @@
  */
 
 #include "u_queue.h"
+#include "util/bitscan.h"
 #include "util/u_string.h"
 
+#include <limits.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
 static void util_queue_killall_and_wait(struct util_queue *queue);
+static void pool_shutdown(void);
 
 /****************************************************************************
  * Wait for all queues to assert idle when exit() is called.
@@ -51,6 +62,9 @@ atexit_handler(void)
       util_queue_killall_and_wait(iter);
    }
    mtx_unlock(&exit_mutex);
+
+   /* No shared queue has any jobs left to run */
+   pool_shutdown();
 }
 
 static void
@@ -89,6 +103,39 @@ remove_from_atexit_list(struct util_queue *queue)
  * util_queue_fence
  */
 
+#ifdef UTIL_QUEUE_FUTEX
+static void
+util_queue_fence_signal(struct util_queue_fence *fence)
+{
+   if (p_atomic_xchg(&fence->val, 0) == 2)
+      futex_wake(&fence->val, INT_MAX);
+}
+
+static void
+util_queue_fence_reset(struct util_queue_fence *fence)
+{
+   assert(fence->val == 0);
+   p_atomic_set(&fence->val, 1);
+}
+
+void
+_util_queue_fence_wait(struct util_queue_fence *fence)
+{
+   uint32_t v = p_atomic_read(&fence->val);
+
+   while (v != 0) {
+      /* Tell the signalling thread that it has to wake us up */
+      if (v == 1) {
+         v = p_atomic_cmpxchg(&fence->val, 1, 2);
+         if (v == 0)
+            return;
+      }
+
+      futex_wait(&fence->val, 2, NULL);
+      v = p_atomic_read(&fence->val);
+   }
+}
+#else
 static void
 util_queue_fence_signal(struct util_queue_fence *fence)
 {
@@ -98,6 +145,13 @@ util_queue_fence_signal(struct util_queue_fence *fence)
    mtx_unlock(&fence->mutex);
 }
 
+static void
+util_queue_fence_reset(struct util_queue_fence *fence)
+{
+   assert(fence->signalled);
+   fence->signalled = false;
+}
+
 void
 util_queue_fence_wait(struct util_queue_fence *fence)
 {
@@ -123,6 +177,621 @@ util_queue_fence_destroy(struct util_queue_fence *fence)
    cnd_destroy(&fence->cond);
    mtx_destroy(&fence->mutex);
 }
+#endif
+
+/****************************************************************************
+ * Sleeping and waking up
+ *
+ * Idle threads sleep on has_queued and producers waiting for a free slot on
+ * has_space. A sleeper first sets bit 0 of the counter, then checks its
+ * condition again and only sleeps if the counter is still unchanged. The
+ * other side changes the condition first, and then only has to touch the
+ * counter if bit 0 is set.
+ */
+
+static void
+event_init(struct util_queue_event *event)
+{
+   event->seq = 0;
+#ifndef UTIL_QUEUE_FUTEX
+   (void) mtx_init(&event->lock, mtx_plain);
+   cnd_init(&event->cond);
+#endif
+}
+
+static void
+event_destroy(struct util_queue_event *event)
+{
+#ifndef UTIL_QUEUE_FUTEX
+   cnd_destroy(&event->cond);
+   mtx_destroy(&event->lock);
+#endif
+}
+
+static uint32_t
+queue_prepare_sleep(struct util_queue_event *event)
+{
+   uint32_t v = p_atomic_read(&event->seq);
+
+   while (!(v & 1)) {
+      uint32_t prev = p_atomic_cmpxchg(&event->seq, v, v | 1);
+      if (prev == v)
+         break;
+      v = prev;
+   }
+   return v | 1;
+}
+
+static void
+queue_sleep(struct util_queue_event *event, uint32_t value)
+{
+#ifdef UTIL_QUEUE_FUTEX
+   futex_wait(&event->seq, value, NULL);
+#else
+   mtx_lock(&event->lock);
+   while (p_atomic_read(&event->seq) == value)
+      cnd_wait(&event->cond, &event->lock);
+   mtx_unlock(&event->lock);
+#endif
+}
+
+/* Bump the counter and wake up all sleepers, since the bit that says there
+ * are any is cleared.
+ */
+static void
+queue_wake(struct util_queue_event *event)
+{
+   uint32_t v = p_atomic_read(&event->seq);
+
+   while (true) {
+      uint32_t prev = p_atomic_cmpxchg(&event->seq, v, (v + 2) & ~1u);
+      if (prev == v)
+         break;
+      v = prev;
+   }
+
+   if (!(v & 1))
+      return;
+
+#ifdef UTIL_QUEUE_FUTEX
+   futex_wake(&event->seq, INT_MAX);
+#else
+   mtx_lock(&event->lock);
+   cnd_broadcast(&event->cond);
+   mtx_unlock(&event->lock);
+#endif
+}
+
+/* For the side that changed the condition */
+static void
+queue_wake_sleepers(struct util_queue_event *event)
+{
+   if (p_atomic_read(&event->seq) & 1)
+      queue_wake(event);
+}
+
+/****************************************************************************
+ * Job ring
+ *
+ * A bounded multi-producer, multi-consumer ring. Producers reserve room by
+ * incrementing num_queued first, which never exceeds max_jobs and thus the
+ * ring size, so a producer never finds the ring full. Threads release the
+ * slot right after copying the job out, before executing it.
+ */
+
+static bool
+ring_reserve(struct util_queue *queue)
+{
+   int n = p_atomic_read(&queue->num_queued);
+
+   while (n < queue->max_jobs) {
+      int prev = p_atomic_cmpxchg(&queue->num_queued, n, n + 1);
+      if (prev == n)
+         return true;
+      n = prev;
+   }
+   return false;
+}
+
+static void
+ring_push(struct util_queue *queue, const struct util_queue_job *job)
+{
+   struct util_queue_slot *slot;
+   unsigned pos = p_atomic_read(&queue->write_idx);
+
+   while (true) {
+      slot = &queue->slots[pos & queue->ring_mask];
+      int diff = (int) (p_atomic_read(&slot->seq) - pos);
+
+      if (diff == 0) {
+         unsigned prev = p_atomic_cmpxchg(&queue->write_idx, pos, pos + 1);
+         if (prev == pos)
+            break;
+         pos = prev;
+      } else {
+         /* Either another producer took the position, or a thread is still
+          * copying out the job of the previous round.
+          */
+         if (diff < 0)
+            thrd_yield();
+         pos = p_atomic_read(&queue->write_idx);
+      }
+   }
+
+   slot->job = *job;
+
+   /* A full barrier, which sleeping threads rely on, see above */
+   p_atomic_xchg(&slot->seq, pos + 1);
+}
+
+/* The fence of the returned job is NULL if util_queue_drop_job took it. */
+static bool
+ring_pop(struct util_queue *queue, struct util_queue_job *job)
+{
+   struct util_queue_slot *slot;
+   unsigned pos = p_atomic_read(&queue->read_idx);
+
+   while (true) {
+      slot = &queue->slots[pos & queue->ring_mask];
+      int diff = (int) (p_atomic_read(&slot->seq) - (pos + 1));
+
+      if (diff == 0) {
+         unsigned prev = p_atomic_cmpxchg(&queue->read_idx, pos, pos + 1);
+         if (prev == pos)
+            break;
+         pos = prev;
+      } else if (diff < 0) {
+         return false;
+      } else {
+         pos = p_atomic_read(&queue->read_idx);
+      }
+   }
+
+   job->job = slot->job.job;
+   job->execute = slot->job.execute;
+   job->cleanup = slot->job.cleanup;
+   job->fence = p_atomic_xchg(&slot->job.fence, NULL);
+
+   p_atomic_set(&slot->seq, pos + queue->ring_mask + 1);
+   p_atomic_dec(&queue->num_queued);
+
+   queue_wake_sleepers(&queue->has_space);
+
+   return true;
+}
+
+/* Must be called with the lock held. */
+static void
+overflow_push(struct util_queue *queue, const struct util_queue_job *job)
+{
+   unsigned num = queue->num_overflow;
+
+   if (num == queue->overflow_size) {
+      unsigned new_size = MAX2(queue->overflow_size * 2, 8);
+      struct util_queue_job *jobs =
+         (struct util_queue_job*)malloc(new_size * sizeof(*jobs));
+      assert(jobs);
+
+      for (unsigned i = 0; i < num; i++) {
+         jobs[i] = queue->overflow[(queue->overflow_read + i) %
+                                   queue->overflow_size];
+      }
+
+      free(queue->overflow);
+      queue->overflow = jobs;
+      queue->overflow_size = new_size;
+      queue->overflow_read = 0;
+   }
+
+   queue->overflow[(queue->overflow_read + num) % queue->overflow_size] = *job;
+   p_atomic_inc(&queue->num_overflow);
+}
+
+static bool
+overflow_pop(struct util_queue *queue, struct util_queue_job *job)
+{
+   bool found = false;
+
+   if (!p_atomic_read(&queue->num_overflow))
+      return false;
+
+   mtx_lock(&queue->lock);
+   if (queue->num_overflow) {
+      *job = queue->overflow[queue->overflow_read];
+      queue->overflow_read = (queue->overflow_read + 1) % queue->overflow_size;
+      p_atomic_dec(&queue->num_overflow);
+      found = true;
+   }
+   mtx_unlock(&queue->lock);
+   return found;
+}
+
+/* Jobs in the ring are older than those that overflowed, except for ones
+ * that were added concurrently.
+ */
+static bool
+queue_pop(struct util_queue *queue, struct util_queue_job *job)
+{
+   return ring_pop(queue, job) || overflow_pop(queue, job);
+}
+
+/****************************************************************************
+ * Shared thread pool
+ *
+ * Queues initialized with UTIL_QUEUE_INIT_SHARED_THREADS are kept in one list
+ * per priority. A pool thread looking for work takes the oldest job of the
+ * first queue in the highest priority list that has jobs queued and fewer
+ * than num_threads of them running, and moves that queue to the end of its
+ * list, so that queues of the same priority take turns. Everything but
+ * adding jobs happens under the pool's lock, which is fine for jobs as big
+ * as compiling a shader.
+ *
+ * Threads are started as jobs come in and find all threads busy, up to
+ * max_threads, which is at least two. Low priority jobs never occupy the
+ * last of them, so there is always a thread left for more urgent work. All
+ * pool threads run at the normal scheduling priority: Linux doesn't let a
+ * thread go back from SCHED_IDLE, so it can't be switched per job. Queues
+ * that need SCHED_IDLE keep their own threads. Unlike a queue's own threads,
+ * idle pool threads are woken up one at a time, since most of them usually
+ * wouldn't find anything to do, and only while no other one is on its way.
+ * That one wakes up the next if it leaves work behind.
+ */
+
+enum util_queue_priority {
+   UTIL_QUEUE_PRIORITY_LOW,
+   UTIL_QUEUE_PRIORITY_NORMAL,
+   UTIL_QUEUE_PRIORITY_HIGH,
+   UTIL_QUEUE_NUM_PRIORITIES
+};
+
+static struct {
+   mtx_t lock;
+   cnd_t idle_cond; /* the last job of a killed queue is done */
+   struct list_head queues[UTIL_QUEUE_NUM_PRIORITIES];
+
+   thrd_t *threads;
+   unsigned max_threads, max_low_priority;
+   unsigned num_threads; /* also read without the lock */
+   unsigned num_low_priority;
+   int num_idle; /* also read without the lock */
+   int waking; /* an idle thread is being woken up */
+   int kill_threads;
+
+   /* What idle threads sleep on */
+#ifdef UTIL_QUEUE_FUTEX
+   uint32_t work_seq;
+#else
+   cnd_t has_work_cond;
+#endif
+} pool;
+
+static once_flag pool_once_flag = ONCE_FLAG_INIT;
+
+static unsigned
+get_num_cpus(void)
+{
+#if defined(_WIN32)
+   SYSTEM_INFO info;
+   GetSystemInfo(&info);
+   return info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+   long count = sysconf(_SC_NPROCESSORS_ONLN);
+   return count > 0 ? count : 1;
+#else
+   return 1;
+#endif
+}
+
+static void
+pool_init(void)
+{
+   const char *size = getenv("MESA_THREAD_POOL_SIZE");
+   unsigned i, max_threads;
+
+   (void) mtx_init(&pool.lock, mtx_plain);
+   cnd_init(&pool.idle_cond);
+   for (i = 0; i < UTIL_QUEUE_NUM_PRIORITIES; i++)
+      LIST_INITHEAD(&pool.queues[i]);
+#ifndef UTIL_QUEUE_FUTEX
+   cnd_init(&pool.has_work_cond);
+#endif
+
+   max_threads = size ? strtoul(size, NULL, 0) : get_num_cpus();
+   max_threads = CLAMP(max_threads, 1, 256);
+
+   /* Low priority jobs leave one thread free, so a pool of one thread gets
+    * a second one for them.
+    */
+   max_threads = MAX2(max_threads, 2);
+
+   /* Shared queues fail to initialize without any threads */
+   pool.threads = (thrd_t*) calloc(max_threads, sizeof(thrd_t));
+   if (pool.threads)
+      pool.max_threads = max_threads;
+   pool.max_low_priority = max_threads - 1;
+}
+
+static int pool_thread_func(void *input);
+
+/* Producers only wake up a thread if num_idle says there is one, see
+ * pool_wait_for_job. Must be called with the lock held.
+ */
+static void
+pool_sleep(uint32_t seq)
+{
+#ifdef UTIL_QUEUE_FUTEX
+   mtx_unlock(&pool.lock);
+   futex_wait(&pool.work_seq, seq, NULL);
+   mtx_lock(&pool.lock);
+#else
+   cnd_wait(&pool.has_work_cond, &pool.lock);
+#endif
+}
+
+/* Must be called with the lock held in the non-futex case. */
+static void
+pool_wake_one(void)
+{
+   if (p_atomic_read(&pool.waking) || p_atomic_cmpxchg(&pool.waking, 0, 1))
+      return;
+
+#ifdef UTIL_QUEUE_FUTEX
+   p_atomic_inc(&pool.work_seq);
+   futex_wake(&pool.work_seq, 1);
+#else
+   cnd_signal(&pool.has_work_cond);
+#endif
+}
+
+static void
+pool_wake_all(void)
+{
+#ifdef UTIL_QUEUE_FUTEX
+   p_atomic_inc(&pool.work_seq);
+   futex_wake(&pool.work_seq, INT_MAX);
+#else
+   mtx_lock(&pool.lock);
+   cnd_broadcast(&pool.has_work_cond);
+   mtx_unlock(&pool.lock);
+#endif
+}
+
+/* Must be called with the lock held. */
+static bool
+pool_start_thread(void)
+{
+   thrd_t thread;
+
+   if (pool.kill_threads || pool.num_threads >= pool.max_threads)
+      return false;
+
+   thread = u_thread_create(pool_thread_func, NULL);
+   if (!thread)
+      return false;
+
+   pool.threads[pool.num_threads] = thread;
+   p_atomic_inc(&pool.num_threads);
+   return true;
+}
+
+/* Thread indices that a new job of the queue can use. Only exact with the
+ * lock held.
+ */
+static uint32_t
+pool_idle_indices(struct util_queue *queue)
+{
+   uint32_t idle = ~p_atomic_read(&queue->running);
+
+   if (p_atomic_read(&queue->kill_threads))
+      return 0;
+   if (queue->num_threads < 32)
+      idle &= (1u << queue->num_threads) - 1;
+   return idle;
+}
+
+/* Must be called with the lock held. */
+static bool
+pool_has_job(void)
+{
+   for (int p = UTIL_QUEUE_NUM_PRIORITIES - 1; p >= 0; p--) {
+      struct util_queue *iter;
+
+      if (p == UTIL_QUEUE_PRIORITY_LOW &&
+          pool.num_low_priority >= pool.max_low_priority)
+         break;
+
+      LIST_FOR_EACH_ENTRY(iter, &pool.queues[p], pool_link) {
+         if (pool_idle_indices(iter) &&
+             (p_atomic_read(&iter->num_queued) ||
+              p_atomic_read(&iter->num_overflow)))
+            return true;
+      }
+   }
+   return false;
+}
+
+/* Must be called with the lock held. */
+static bool
+pool_get_job(struct util_queue **queue, struct util_queue_job *job,
+             int *thread_index)
+{
+   for (int p = UTIL_QUEUE_NUM_PRIORITIES - 1; p >= 0; p--) {
+      struct util_queue *iter;
+
+      if (p == UTIL_QUEUE_PRIORITY_LOW &&
+          pool.num_low_priority >= pool.max_low_priority)
+         break;
+
+      LIST_FOR_EACH_ENTRY(iter, &pool.queues[p], pool_link) {
+         uint32_t idle = pool_idle_indices(iter);
+
+         if (!idle || !queue_pop(iter, job))
+            continue;
+
+         *thread_index = ffs(idle) - 1;
+         p_atomic_set(&iter->running, iter->running | (1u << *thread_index));
+         if (p == UTIL_QUEUE_PRIORITY_LOW)
+            pool.num_low_priority++;
+
+         LIST_DEL(&iter->pool_link);
+         LIST_ADDTAIL(&iter->pool_link, &pool.queues[p]);
+         *queue = iter;
+         return true;
+      }
+   }
+   return false;
+}
+
+/* Must be called with the lock held. */
+static void
+pool_put_job(struct util_queue *queue, int thread_index)
+{
+   /* A full barrier, so that either the next pool_get_job sees a job that
+    * was just added, or its producer sees the free index, see
+    * queue_job_added.
+    */
+   p_atomic_xchg(&queue->running, queue->running & ~(1u << thread_index));
+   if (queue->priority == UTIL_QUEUE_PRIORITY_LOW)
+      pool.num_low_priority--;
+
+   if (!queue->running && p_atomic_read(&queue->kill_threads))
+      cnd_broadcast(&pool.idle_cond);
+}
+
+/* Producers only wake up or start a thread if none is idle, but several
+ * jobs may have been added before that thread gets to look. Whoever takes a
+ * job passes it on if there are more. Must be called with the lock held.
+ */
+static void
+pool_wake_more(void)
+{
+   if (!pool_has_job())
+      return;
+
+   if (p_atomic_read(&pool.num_idle))
+      pool_wake_one();
+   else
+      pool_start_thread();
+}
+
+/* Must be called with the lock held, which is dropped while sleeping.
+ * Returns false when the thread should exit.
+ */
+static bool
+pool_wait_for_job(struct util_queue **queue, struct util_queue_job *job,
+                  int *thread_index)
+{
+   while (!pool.kill_threads) {
+      uint32_t seq = 0;
+      bool found;
+
+      if (pool_get_job(queue, job, thread_index))
+         break;
+
+      /* Producers add the job before checking num_idle, so look again. */
+      p_atomic_inc(&pool.num_idle);
+#ifdef UTIL_QUEUE_FUTEX
+      seq = p_atomic_read(&pool.work_seq);
+#endif
+      found = pool_get_job(queue, job, thread_index);
+      if (!found) {
+         /* Whatever the thread that is on its way was woken up for is gone */
+         p_atomic_set(&pool.waking, 0);
+         pool_sleep(seq);
+      }
+      p_atomic_dec(&pool.num_idle);
+
+      /* Allow waking up the next one. A full barrier, so that either a
+       * producer that saw waking set or this thread sees the new job.
+       */
+      p_atomic_xchg(&pool.waking, 0);
+
+      if (found)
+         break;
+   }
+
+   if (pool.kill_threads)
+      return false;
+
+   pool_wake_more();
+   return true;
+}
+
+/* Called after adding a job to a shared queue. */
+static void
+pool_notify(void)
+{
+   if (!p_atomic_read(&pool.num_idle)) {
+      if (p_atomic_read(&pool.num_threads) < pool.max_threads) {
+         mtx_lock(&pool.lock);
+         pool_start_thread();
+         mtx_unlock(&pool.lock);
+      }
+      return;
+   }
+
+#ifdef UTIL_QUEUE_FUTEX
+   pool_wake_one();
+#else
+   mtx_lock(&pool.lock);
+   pool_wake_one();
+   mtx_unlock(&pool.lock);
+#endif
+}
+
+static bool
+pool_add_queue(struct util_queue *queue)
+{
+   bool ok = true;
+
+   call_once(&pool_once_flag, pool_init);
+
+   mtx_lock(&pool.lock);
+   /* Make sure there is a thread to run the jobs */
+   if (!pool.num_threads)
+      ok = pool_start_thread();
+   if (ok)
+      LIST_ADDTAIL(&queue->pool_link, &pool.queues[queue->priority]);
+   mtx_unlock(&pool.lock);
+
+   return ok;
+}
+
+/* Pool threads don't pick jobs of a killed queue anymore, so only the
+ * running ones have to finish.
+ */
+static void
+pool_remove_queue(struct util_queue *queue)
+{
+   mtx_lock(&pool.lock);
+   while (queue->running)
+      cnd_wait(&pool.idle_cond, &pool.lock);
+   LIST_DELINIT(&queue->pool_link);
+   mtx_unlock(&pool.lock);
+}
+
+static void
+pool_shutdown(void)
+{
+   unsigned i, num_threads;
+
+   if (!p_atomic_read(&pool.num_threads))
+      return;
+
+   mtx_lock(&pool.lock);
+   pool.kill_threads = 1;
+   num_threads = pool.num_threads;
+   mtx_unlock(&pool.lock);
+
+   pool_wake_all();
+   for (i = 0; i < num_threads; i++)
+      thrd_join(pool.threads[i], NULL);
+
+   mtx_lock(&pool.lock);
+   pool.num_threads = 0;
+   pool.kill_threads = 0;
+   mtx_unlock(&pool.lock);
+}
 
 /****************************************************************************
  * util_queue implementation
@@ -133,6 +802,69 @@ struct thread_input {
    int thread_index;
 };
 
+static void
+run_job(struct util_queue_job *job, int thread_index)
+{
+   /* Dropped jobs have no fence */
+   if (job->fence) {
+      job->execute(job->job, thread_index);
+      util_queue_fence_signal(job->fence);
+      if (job->cleanup)
+         job->cleanup(job->job, thread_index);
+   }
+}
+
+static int
+pool_thread_func(void *input)
+{
+   struct util_queue *queue, *last_queue = NULL;
+   struct util_queue_job job;
+   int thread_index, last_index = -1;
+
+   mtx_lock(&pool.lock);
+   while (pool_wait_for_job(&queue, &job, &thread_index)) {
+      mtx_unlock(&pool.lock);
+
+      /* Name the thread after what it's doing, like a queue's own thread */
+      if (queue->name &&
+          (queue != last_queue || thread_index != last_index)) {
+         char name[16];
+         util_snprintf(name, sizeof(name), "%s:%i", queue->name, thread_index);
+         u_thread_setname(name);
+         last_queue = queue;
+         last_index = thread_index;
+      }
+
+      run_job(&job, thread_index);
+
+      mtx_lock(&pool.lock);
+      pool_put_job(queue, thread_index);
+   }
+   mtx_unlock(&pool.lock);
+
+   return 0;
+}
+
+/* Returns false when the thread should exit. */
+static bool
+util_queue_get_job(struct util_queue *queue, struct util_queue_job *job)
+{
+   while (!p_atomic_read(&queue->kill_threads)) {
+      if (queue_pop(queue, job))
+         return true;
+
+      uint32_t seq = queue_prepare_sleep(&queue->has_queued);
+
+      if (p_atomic_read(&queue->kill_threads))
+         break;
+      if (queue_pop(queue, job))
+         return true;
+
+      queue_sleep(&queue->has_queued, seq);
+   }
+   return false;
+}
+
 static int
 util_queue_thread_func(void *input)
 {
@@ -150,46 +882,12 @@ util_queue_thread_func(void *input)
    while (1) {
       struct util_queue_job job;
 
-      mtx_lock(&queue->lock);
-      assert(queue->num_queued >= 0 && queue->num_queued <= queue->max_jobs);
-
-      /* wait if the queue is empty */
-      while (!queue->kill_threads && queue->num_queued == 0)
-         cnd_wait(&queue->has_queued_cond, &queue->lock);
-
-      if (queue->kill_threads) {
-         mtx_unlock(&queue->lock);
+      if (!util_queue_get_job(queue, &job))
          break;
-      }
 
-      job = queue->jobs[queue->read_idx];
-      memset(&queue->jobs[queue->read_idx], 0, sizeof(struct util_queue_job));
-      queue->read_idx = (queue->read_idx + 1) % queue->max_jobs;
-
-      queue->num_queued--;
-      cnd_signal(&queue->has_space_cond);
-      mtx_unlock(&queue->lock);
-
-      if (job.job) {
-         job.execute(job.job, thread_index);
-         util_queue_fence_signal(job.fence);
-         if (job.cleanup)
-            job.cleanup(job.job, thread_index);
-      }
+      run_job(&job, thread_index);
    }
 
-   /* signal remaining jobs before terminating */
-   mtx_lock(&queue->lock);
-   for (unsigned i = queue->read_idx; i != queue->write_idx;
-        i = (i + 1) % queue->max_jobs) {
-      if (queue->jobs[i].job) {
-         util_queue_fence_signal(queue->jobs[i].fence);
-         queue->jobs[i].job = NULL;
-      }
-   }
-   queue->read_idx = queue->write_idx;
-   queue->num_queued = 0;
-   mtx_unlock(&queue->lock);
    return 0;
 }
 
@@ -200,7 +898,7 @@ util_queue_init(struct util_queue *queue,
                 unsigned num_threads,
                 unsigned flags)
 {
-   unsigned i;
+   unsigned i, ring_size = 1;
 
    memset(queue, 0, sizeof(*queue));
    queue->name = name;
@@ -208,16 +906,37 @@ util_queue_init(struct util_queue *queue,
    queue->num_threads = num_threads;
    queue->max_jobs = max_jobs;
 
-   queue->jobs = (struct util_queue_job*)
-                 calloc(max_jobs, sizeof(struct util_queue_job));
-   if (!queue->jobs)
+   while (ring_size < max_jobs)
+      ring_size *= 2;
+   queue->ring_mask = ring_size - 1;
+   queue->slots = (struct util_queue_slot*)
+                  calloc(ring_size, sizeof(struct util_queue_slot));
+   if (!queue->slots)
       goto fail;
 
+   for (i = 0; i < ring_size; i++)
+      queue->slots[i].seq = i;
+
    (void) mtx_init(&queue->lock, mtx_plain);
+   event_init(&queue->has_queued);
+   event_init(&queue->has_space);
+
+   if (flags & UTIL_QUEUE_INIT_SHARED_THREADS) {
+      queue->num_threads = CLAMP(num_threads, 1, UTIL_QUEUE_MAX_SHARED_THREADS);
 
-   queue->num_queued = 0;
-   cnd_init(&queue->has_queued_cond);
-   cnd_init(&queue->has_space_cond);
+      if (flags & UTIL_QUEUE_INIT_HIGH_PRIORITY)
+         queue->priority = UTIL_QUEUE_PRIORITY_HIGH;
+      else if (flags & UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY)
+         queue->priority = UTIL_QUEUE_PRIORITY_LOW;
+      else
+         queue->priority = UTIL_QUEUE_PRIORITY_NORMAL;
+
+      if (!pool_add_queue(queue))
+         goto fail;
+
+      add_to_atexit_list(queue);
+      return true;
+   }
 
    queue->threads = (thrd_t*) calloc(num_threads, sizeof(thrd_t));
    if (!queue->threads)
@@ -266,11 +985,11 @@ util_queue_init(struct util_queue *queue,
 fail:
    free(queue->threads);
 
-   if (queue->jobs) {
-      cnd_destroy(&queue->has_space_cond);
-      cnd_destroy(&queue->has_queued_cond);
+   if (queue->slots) {
+      event_destroy(&queue->has_space);
+      event_destroy(&queue->has_queued);
       mtx_destroy(&queue->lock);
-      free(queue->jobs);
+      free(queue->slots);
    }
    /* also util_queue_is_initialized can be used to check for success */
    memset(queue, 0, sizeof(*queue));
@@ -280,17 +999,30 @@ fail:
 static void
 util_queue_killall_and_wait(struct util_queue *queue)
 {
+   struct util_queue_job job;
    unsigned i;
 
    /* Signal all threads to terminate. */
-   mtx_lock(&queue->lock);
-   queue->kill_threads = 1;
-   cnd_broadcast(&queue->has_queued_cond);
-   mtx_unlock(&queue->lock);
+   p_atomic_set(&queue->kill_threads, 1);
+
+   if (queue->flags & UTIL_QUEUE_INIT_SHARED_THREADS) {
+      pool_remove_queue(queue);
+   } else {
+      queue_wake(&queue->has_queued);
+
+      for (i = 0; i < queue->num_threads; i++)
+         thrd_join(queue->threads[i], NULL);
+      queue->num_threads = 0;
+   }
+
+   /* signal remaining jobs */
+   while (queue_pop(queue, &job)) {
+      if (job.fence)
+         util_queue_fence_signal(job.fence);
+   }
 
-   for (i = 0; i < queue->num_threads; i++)
-      thrd_join(queue->threads[i], NULL);
-   queue->num_threads = 0;
+   /* Producers waiting for space give up once they see kill_threads */
+   queue_wake(&queue->has_space);
 }
 
 void
@@ -299,13 +1031,28 @@ util_queue_destroy(struct util_queue *queue)
    util_queue_killall_and_wait(queue);
    remove_from_atexit_list(queue);
 
-   cnd_destroy(&queue->has_space_cond);
-   cnd_destroy(&queue->has_queued_cond);
+   event_destroy(&queue->has_space);
+   event_destroy(&queue->has_queued);
    mtx_destroy(&queue->lock);
-   free(queue->jobs);
+   free(queue->overflow);
+   free(queue->slots);
    free(queue->threads);
 }
 
+/* Wake up whoever runs the jobs of the queue. */
+static void
+queue_job_added(struct util_queue *queue)
+{
+   if (queue->flags & UTIL_QUEUE_INIT_SHARED_THREADS) {
+      /* If all jobs the queue may run at once are running, the thread that
+       * finishes one of them takes the new job.
+       */
+      if (pool_idle_indices(queue))
+         pool_notify();
+   } else
+      queue_wake_sleepers(&queue->has_queued);
+}
+
 void
 util_queue_add_job(struct util_queue *queue,
                    void *job,
@@ -313,68 +1060,56 @@ util_queue_add_job(struct util_queue *queue,
                    util_queue_execute_func execute,
                    util_queue_execute_func cleanup)
 {
-   struct util_queue_job *ptr;
+   struct util_queue_job entry = { job, fence, execute, cleanup };
 
-   assert(fence->signalled);
+   assert(util_queue_fence_is_signalled(fence));
 
-   mtx_lock(&queue->lock);
-   if (queue->kill_threads) {
-      mtx_unlock(&queue->lock);
+   if (p_atomic_read(&queue->kill_threads)) {
       /* well no good option here, but any leaks will be
        * short-lived as things are shutting down..
        */
       return;
    }
 
-   fence->signalled = false;
+   util_queue_fence_reset(fence);
 
-   assert(queue->num_queued >= 0 && queue->num_queued <= queue->max_jobs);
+   /* Once jobs have overflowed, new ones go after them until the threads
+    * have caught up.
+    */
+   if (!p_atomic_read(&queue->num_overflow) && ring_reserve(queue)) {
+      ring_push(queue, &entry);
+      queue_job_added(queue);
+      return;
+   }
 
-   if (queue->num_queued == queue->max_jobs) {
-      if (queue->flags & UTIL_QUEUE_INIT_RESIZE_IF_FULL) {
-         /* If the queue is full, make it larger to avoid waiting for a free
-          * slot.
-          */
-         unsigned new_max_jobs = queue->max_jobs + 8;
-         struct util_queue_job *jobs =
-            (struct util_queue_job*)calloc(new_max_jobs,
-                                           sizeof(struct util_queue_job));
-         assert(jobs);
-
-         /* Copy all queued jobs into the new list. */
-         unsigned num_jobs = 0;
-         unsigned i = queue->read_idx;
-
-         do {
-            jobs[num_jobs++] = queue->jobs[i];
-            i = (i + 1) % queue->max_jobs;
-         } while (i != queue->write_idx);
-
-         assert(num_jobs == queue->num_queued);
-
-         free(queue->jobs);
-         queue->jobs = jobs;
-         queue->read_idx = 0;
-         queue->write_idx = num_jobs;
-         queue->max_jobs = new_max_jobs;
-      } else {
-         /* Wait until there is a free slot. */
-         while (queue->num_queued == queue->max_jobs)
-            cnd_wait(&queue->has_space_cond, &queue->lock);
-      }
+   if (queue->flags & UTIL_QUEUE_INIT_RESIZE_IF_FULL) {
+      /* If the queue is full, queue the job elsewhere to avoid waiting for
+       * a free slot.
+       */
+      mtx_lock(&queue->lock);
+      overflow_push(queue, &entry);
+      mtx_unlock(&queue->lock);
+
+      queue_job_added(queue);
+      return;
    }
 
-   ptr = &queue->jobs[queue->write_idx];
-   assert(ptr->job == NULL);
-   ptr->job = job;
-   ptr->fence = fence;
-   ptr->execute = execute;
-   ptr->cleanup = cleanup;
-   queue->write_idx = (queue->write_idx + 1) % queue->max_jobs;
+   /* Wait until there is a free slot. */
+   while (!ring_reserve(queue)) {
+      uint32_t seq = queue_prepare_sleep(&queue->has_space);
 
-   queue->num_queued++;
-   cnd_signal(&queue->has_queued_cond);
-   mtx_unlock(&queue->lock);
+      if (p_atomic_read(&queue->kill_threads)) {
+         util_queue_fence_signal(fence);
+         return;
+      }
+      if (ring_reserve(queue))
+         break;
+
+      queue_sleep(&queue->has_space, seq);
+   }
+
+   ring_push(queue, &entry);
+   queue_job_added(queue);
 }
 
 /**
@@ -395,20 +1130,47 @@ util_queue_drop_job(struct util_queue *queue, struct util_queue_fence *fence)
    if (util_queue_fence_is_signalled(fence))
       return;
 
-   mtx_lock(&queue->lock);
-   for (unsigned i = queue->read_idx; i != queue->write_idx;
-        i = (i + 1) % queue->max_jobs) {
-      if (queue->jobs[i].fence == fence) {
-         if (queue->jobs[i].cleanup)
-            queue->jobs[i].cleanup(queue->jobs[i].job, -1);
-
-         /* Just clear it. The threads will treat as a no-op job. */
-         memset(&queue->jobs[i], 0, sizeof(queue->jobs[i]));
+   /* Whoever swaps the fence pointer out of the slot owns the job, this or
+    * a queue thread.
+    */
+   unsigned end = p_atomic_read(&queue->write_idx);
+   for (unsigned pos = p_atomic_read(&queue->read_idx);
+        (int) (end - pos) > 0; pos++) {
+      struct util_queue_slot *slot = &queue->slots[pos & queue->ring_mask];
+
+      if (p_atomic_read(&slot->seq) != pos + 1 ||
+          p_atomic_read(&slot->job.fence) != fence)
+         continue;
+
+      void *job = slot->job.job;
+      util_queue_execute_func cleanup = slot->job.cleanup;
+
+      if (p_atomic_cmpxchg(&slot->job.fence, fence, NULL) == fence) {
+         if (cleanup)
+            cleanup(job, -1);
          removed = true;
-         break;
       }
+      break;
+   }
+
+   if (!removed && p_atomic_read(&queue->num_overflow)) {
+      mtx_lock(&queue->lock);
+      for (int i = 0; i < queue->num_overflow; i++) {
+         struct util_queue_job *entry =
+            &queue->overflow[(queue->overflow_read + i) % queue->overflow_size];
+
+         if (entry->fence == fence) {
+            if (entry->cleanup)
+               entry->cleanup(entry->job, -1);
+
+            /* Just clear it. The threads will treat as a no-op job. */
+            entry->fence = NULL;
+            removed = true;
+            break;
+         }
+      }
+      mtx_unlock(&queue->lock);
    }
-   mtx_unlock(&queue->lock);
 
    if (removed)
       util_queue_fence_signal(fence);
@@ -419,8 +1181,10 @@ util_queue_drop_job(struct util_queue *queue, struct util_queue_fence *fence)
 int64_t
 util_queue_get_thread_time_nano(struct util_queue *queue, unsigned thread_index)
 {
-   /* Allow some flexibility by not raising an error. */
-   if (thread_index >= queue->num_threads)
+   /* Allow some flexibility by not raising an error. Pool threads don't
+    * belong to any queue.
+    */
+   if (!queue->threads || thread_index >= queue->num_threads)
       return 0;
 
    return u_thread_get_time_nano(queue->threads[thread_index]);
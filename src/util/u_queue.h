@@ -28,14 +28,33 @@
  *
  * Jobs can be added from any thread. After that, the wait call can be used
  * to wait for completion of the job.
+ *
+ * By default, each queue starts its own threads. Queues initialized with
+ * UTIL_QUEUE_INIT_SHARED_THREADS instead run their jobs on a process-wide
+ * pool of threads, whose size is the number of CPUs or MESA_THREAD_POOL_SIZE,
+ * but at least two. Idle pool threads take jobs from whichever shared queue
+ * has any, the ones with a higher priority first. Jobs of a queue still start
+ * in the order they were added, and at most num_threads of them run at the
+ * same time, each with a different thread_index below num_threads.
+ *
+ * A job of a shared queue must not wait for jobs of other queues on the
+ * pool, since all pool threads could end up waiting. Pool threads always
+ * run at the normal scheduling priority: on a shared queue,
+ * UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY only puts the jobs behind those of
+ * other queues, and queues that need SCHED_IDLE have to keep their own
+ * threads.
  */
 
 #ifndef U_QUEUE_H
 #define U_QUEUE_H
 
+#include <assert.h>
 #include <string.h>
 
+#include "util/futex.h"
 #include "util/list.h"
+#include "util/macros.h"
+#include "util/u_atomic.h"
 #include "util/u_thread.h"
 
 #ifdef __cplusplus
@@ -44,16 +63,72 @@ extern "C" {
 
 #define UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY      (1 << 0)
 #define UTIL_QUEUE_INIT_RESIZE_IF_FULL            (1 << 1)
+#define UTIL_QUEUE_INIT_SHARED_THREADS            (1 << 2)
+#define UTIL_QUEUE_INIT_HIGH_PRIORITY             (1 << 3)
+
+/* The most jobs of a shared queue that can run at the same time */
+#define UTIL_QUEUE_MAX_SHARED_THREADS             32
+
+#if defined(HAVE_LINUX_FUTEX_H)
+#define UTIL_QUEUE_FUTEX
+#endif
 
 /* Job completion fence.
  * Put this into your job structure.
  */
+#ifdef UTIL_QUEUE_FUTEX
+/* 0 = signalled, 1 = unsignalled, 2 = unsignalled and somebody may be
+ * sleeping on the futex. Waiting for and signalling a fence only enter the
+ * kernel in the last case.
+ */
+struct util_queue_fence {
+   uint32_t val;
+};
+
+static inline void
+util_queue_fence_init(struct util_queue_fence *fence)
+{
+   fence->val = 0;
+}
+
+static inline void
+util_queue_fence_destroy(struct util_queue_fence *fence)
+{
+   assert(fence->val == 0);
+}
+
+void _util_queue_fence_wait(struct util_queue_fence *fence);
+
+static inline void
+util_queue_fence_wait(struct util_queue_fence *fence)
+{
+   if (unlikely(p_atomic_read(&fence->val) != 0))
+      _util_queue_fence_wait(fence);
+}
+
+static inline bool
+util_queue_fence_is_signalled(struct util_queue_fence *fence)
+{
+   return p_atomic_read(&fence->val) == 0;
+}
+#else
 struct util_queue_fence {
    mtx_t mutex;
    cnd_t cond;
    int signalled;
 };
 
+void util_queue_fence_init(struct util_queue_fence *fence);
+void util_queue_fence_destroy(struct util_queue_fence *fence);
+void util_queue_fence_wait(struct util_queue_fence *fence);
+
+static inline bool
+util_queue_fence_is_signalled(struct util_queue_fence *fence)
+{
+   return fence->signalled != 0;
+}
+#endif
+
 typedef void (*util_queue_execute_func)(void *job, int thread_index);
 
 struct util_queue_job {
@@ -63,20 +138,62 @@ struct util_queue_job {
    util_queue_execute_func cleanup;
 };
 
+/* A counter to sleep on until it changes. Bit 0 is set while somebody may be
+ * sleeping, see queue_prepare_sleep.
+ */
+struct util_queue_event {
+   uint32_t seq;
+#ifndef UTIL_QUEUE_FUTEX
+   mtx_t lock;
+   cnd_t cond;
+#endif
+};
+
+/* An entry of the job ring. The sequence number says whose turn it is: it's
+ * the ring position while the slot is free, the position + 1 once a job has
+ * been published in it, and the position + ring size after the job has been
+ * taken out.
+ */
+struct util_queue_slot {
+   unsigned seq;
+   struct util_queue_job job;
+};
+
 /* Put this into your context. */
 struct util_queue {
    const char *name;
-   mtx_t lock;
-   cnd_t has_queued_cond;
-   cnd_t has_space_cond;
    thrd_t *threads;
    unsigned flags;
-   int num_queued;
    unsigned num_threads;
    int kill_threads;
    int max_jobs;
-   int write_idx, read_idx; /* ring buffer pointers */
-   struct util_queue_job *jobs;
+
+   /* Lock-free ring of jobs, see util_queue_add_job. Producers and threads
+    * claim positions with compare-and-swap.
+    */
+   struct util_queue_slot *slots;
+   unsigned ring_mask;
+   unsigned write_idx, read_idx;
+   int num_queued; /* jobs in the ring, limited to max_jobs */
+
+   /* What idle threads and producers waiting for space sleep on */
+   struct util_queue_event has_queued;
+   struct util_queue_event has_space;
+
+   /* Jobs that didn't fit into the ring with UTIL_QUEUE_INIT_RESIZE_IF_FULL,
+    * in order, protected by lock.
+    */
+   mtx_t lock;
+   struct util_queue_job *overflow;
+   unsigned overflow_size, overflow_read;
+   int num_overflow;
+
+   /* UTIL_QUEUE_INIT_SHARED_THREADS only, protected by the pool's lock.
+    * Bit i of running is set while a job runs with thread_index i.
+    */
+   unsigned priority;
+   uint32_t running;
+   struct list_head pool_link;
 
    /* for cleanup at exit(), protected by exit_mutex */
    struct list_head head;
@@ -88,8 +205,6 @@ bool util_queue_init(struct util_queue *queue,
                      unsigned num_threads,
                      unsigned flags);
 void util_queue_destroy(struct util_queue *queue);
-void util_queue_fence_init(struct util_queue_fence *fence);
-void util_queue_fence_destroy(struct util_queue_fence *fence);
 
 /* optional cleanup callback is called after fence is signaled: */
 void util_queue_add_job(struct util_queue *queue,
@@ -100,7 +215,6 @@ void util_queue_add_job(struct util_queue *queue,
 void util_queue_drop_job(struct util_queue *queue,
                          struct util_queue_fence *fence);
 
-void util_queue_fence_wait(struct util_queue_fence *fence);
 int64_t util_queue_get_thread_time_nano(struct util_queue *queue,
                                         unsigned thread_index);
 
@@ -108,13 +222,7 @@ int64_t util_queue_get_thread_time_nano(struct util_queue *queue,
 static inline bool
 util_queue_is_initialized(struct util_queue *queue)
 {
-   return queue->threads != NULL;
-}
-
-static inline bool
-util_queue_fence_is_signalled(struct util_queue_fence *fence)
-{
-   return fence->signalled != 0;
+   return queue->slots != NULL;
 }
 
 /* Convenient structure for monitoring the queue externally and passing